@@ -0,0 +1,22 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstdint>
+
+/**
+ * @brief Heap traffic of one thread since it started
+ *
+ * Global operator new and delete are replaced to count every allocation
+ * into thread-local counters, so a benchmark can check that a loop does not
+ * touch the heap while worker threads allocate as they please. Counting
+ * costs two increments per call.
+ */
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;                     // Requested by allocations
+};
+
+AllocationCounts threadAllocations();
+
+#endif // ALLOC_TRACKER_H
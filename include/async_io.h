@@ -0,0 +1,132 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "job_system.h"
+
+/**
+ * @brief Scheduling class of a read; lower values are issued first
+ */
+enum class IoPriority { Immediate, High, Normal, Background };
+
+const int IO_PRIORITY_COUNT = 4;
+
+/**
+ * @brief Outcome of a read, handed to its callback
+ */
+struct IoResult {
+    uint64_t id = 0;
+    int error = 0;                          // errno value; ECANCELED if cancelled
+    std::vector<unsigned char> data;        // Empty on error
+    double seconds = 0.0;                   // From read() to completion
+};
+
+using IoCallback = std::function<void(IoResult& result)>;
+
+/**
+ * @brief Asynchronous file reads for asset streaming
+ *
+ * Reads whole files or byte ranges of them (archive entries), batched and
+ * issued highest priority first. Large reads are split into slices so a
+ * background stream cannot hold the device queue against an urgent read.
+ *
+ * On Linux the reads go through io_uring, driven by one submission thread;
+ * where io_uring is unavailable a small pool of threads uses pread instead.
+ * Completions run as jobs on the JobSystem, or on the thread that calls
+ * poll() when the read asks for the main thread (e.g. for GL uploads).
+ */
+class AsyncIo {
+public:
+    enum class Backend { IoUring, ThreadPool };
+
+    explicit AsyncIo(JobSystem* jobs = nullptr, bool allowIoUring = true);
+    ~AsyncIo();
+
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo& operator=(const AsyncIo&) = delete;
+
+    uint64_t read(const std::string& path, IoPriority priority, IoCallback callback, bool mainThread = false);
+    uint64_t read(const std::string& path, uint64_t offset, uint64_t length, IoPriority priority,
+                  IoCallback callback, bool mainThread = false);
+    bool cancel(uint64_t id);
+
+    size_t poll();
+    void waitAll();
+
+    Backend backend() const { return activeBackend; }
+    const char* backendName() const;
+    uint64_t bytesRead() const { return totalBytes.load(); }
+
+private:
+    struct Request {
+        uint64_t id = 0;
+        std::string path;
+        int fd = -1;
+        uint64_t offset = 0;
+        uint64_t length = 0;                // 0 until opened for whole-file reads
+        bool wholeFile = false;
+        IoPriority priority = IoPriority::Normal;
+        IoCallback callback;
+        bool mainThread = false;
+        bool cancelled = false;
+        int error = 0;
+        std::vector<unsigned char> buffer;
+        uint64_t submitted = 0;             // Bytes handed to the backend so far
+        int slicesInFlight = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    struct Slice;
+    struct Ring;
+
+    bool openRequest(Request& request);
+    Request* nextPending();
+    void finish(Request* request);
+
+    void ringLoop();
+    void fillRing(unsigned& queued);
+    void completeSlice(Slice* slice, int result);
+
+    void workerLoop();
+
+    int acquireFile(const std::string& path);
+    void releaseFile(const std::string& path);
+
+    JobSystem* jobSystem;
+    Backend activeBackend = Backend::ThreadPool;
+    std::unique_ptr<Ring> ring;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable allDone;
+    std::unordered_map<uint64_t, std::unique_ptr<Request>> requests;
+    std::deque<Request*> pending[IO_PRIORITY_COUNT];
+    std::deque<Slice*> retries;             // Remainders of short reads
+    std::vector<IoResult> mainThreadResults;
+    std::vector<IoCallback> mainThreadCallbacks;
+    uint64_t nextId = 1;
+    bool stopping = false;
+
+    struct OpenFile {
+        int fd = -1;
+        int users = 0;
+    };
+    std::mutex fileMutex;
+    std::unordered_map<std::string, OpenFile> openFiles;
+
+    std::atomic<uint64_t> totalBytes{0};
+};
+
+#endif // ASYNC_IO_H
@@ -0,0 +1,47 @@
+#ifndef BATCH_TRANSFORM_H
+#define BATCH_TRANSFORM_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**
+ * @brief Per-instance matrices as laid out in instance buffers
+ *
+ * The normal matrix is the inverse transpose of the model's upper 3x3, so
+ * shaders no longer invert a matrix per vertex.
+ */
+struct InstanceMatrices {
+    glm::mat4 model;
+    glm::mat3 normal;
+};
+
+/**
+ * @brief Instance transforms as structure-of-arrays
+ *
+ * Each component lives in its own array so the SIMD kernels can load four
+ * or eight instances with one instruction.
+ */
+struct TransformSoA {
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    size_t size() const { return px.size(); }
+    void reserve(size_t count);
+    void clear();
+    void push(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+};
+
+/**
+ * @brief Name of the kernel picked for this CPU ("avx", "sse" or "scalar")
+ */
+const char* batchTransformKernel();
+
+void buildInstanceMatrices(const TransformSoA& transforms, InstanceMatrices* out);
+void buildInstanceMatrices(const TransformSoA& transforms, size_t begin, size_t end, InstanceMatrices* out);
+void buildInstanceMatricesScalar(const TransformSoA& transforms, size_t begin, size_t end, InstanceMatrices* out);
+
+#endif // BATCH_TRANSFORM_H
@@ -0,0 +1,17 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+
+/**
+ * @brief Run a developer benchmark by name and print its results
+ *
+ * @param name Benchmark name, as given to `EscapeTheAbyss --bench <name>`
+ * @return int Process exit status
+ *
+ * Benchmarks run after the GL context is created, so they can measure
+ * driver-side costs as well as CPU kernels.
+ */
+int runBenchmark(const std::string& name);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,180 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Axis-aligned bounding box
+ */
+struct AABB {
+    glm::vec3 min = glm::vec3( 1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void expand(const AABB& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return max - min; }
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    bool overlaps(const AABB& b) const {
+        return min.x <= b.max.x && max.x >= b.min.x &&
+               min.y <= b.max.y && max.y >= b.min.y &&
+               min.z <= b.max.z && max.z >= b.min.z;
+    }
+
+    /**
+     * @brief Bounds of this box after an affine transform (Arvo's method)
+     */
+    AABB transformed(const glm::mat4& m) const;
+};
+
+/**
+ * @brief Entries in the fixed traversal stacks
+ *
+ * Traversal holds at most one entry per level below the root plus one, so a
+ * tree may be at most BVH_STACK_SIZE - 1 levels deep. build() stays near
+ * log2(n); trees loaded from files are checked with Bvh::depth().
+ */
+const uint32_t BVH_STACK_SIZE = 64;
+
+/**
+ * @brief Bounding volume hierarchy over a flat list of boxes
+ *
+ * Nodes are stored depth-first in one array so traversal only touches
+ * contiguous memory. A node is either an interior node, whose left child is
+ * the next node and whose right child is at `rightOrFirst`, or a leaf
+ * covering `count` entries of `primitives` starting at `rightOrFirst`.
+ */
+class Bvh {
+public:
+    struct Node {
+        AABB bounds;
+        uint32_t rightOrFirst;
+        uint32_t count; // 0 for interior nodes
+    };
+
+    /**
+     * @brief Rebuild the hierarchy from a set of primitive bounds
+     *
+     * @param boxes Bounds of each primitive; the index is the primitive id
+     */
+    void build(const std::vector<AABB>& boxes);
+
+    /**
+     * @brief Visit every primitive whose bounds overlap the given box
+     */
+    template <typename Visitor>
+    void queryAABB(const AABB& box, Visitor&& visit) const;
+
+    /**
+     * @brief Visit every primitive in a leaf whose bounds pass a custom overlap test
+     *
+     * The test prunes whole subtrees, so it must be conservative: a box it
+     * rejects must not contain a box it accepts. Primitives are not tested;
+     * the visitor checks them itself if it needs to.
+     */
+    template <typename Test, typename Visitor>
+    void query(Test&& overlaps, Visitor&& visit) const;
+
+    /**
+     * @brief Visit primitives whose bounds (inflated by radius) are hit by a ray
+     *
+     * The visitor receives the primitive id and must return the new closest
+     * hit distance (or the current one), which is used to prune the traversal.
+     */
+    template <typename Visitor>
+    void raycast(const glm::vec3& origin, const glm::vec3& dir, float radius, float maxDist, Visitor&& visit) const;
+
+    bool empty() const { return nodes.empty(); }
+    static uint32_t depth(const Node* nodes, size_t count);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> primitives;
+
+private:
+    uint32_t buildRecursive(const std::vector<AABB>& boxes, uint32_t first, uint32_t count);
+};
+
+/**
+ * @brief Slab test of a ray against a box
+ *
+ * @return Entry distance along the ray, or a negative value on a miss.
+ * A ray starting inside the box reports 0.
+ */
+float intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDir, const AABB& box, float maxDist);
+
+template <typename Visitor>
+void Bvh::queryAABB(const AABB& box, Visitor&& visit) const {
+    if (nodes.empty()) return;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!node.bounds.overlaps(box)) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                visit(primitives[node.rightOrFirst + i]);
+            }
+        } else {
+            uint32_t self = static_cast<uint32_t>(&node - nodes.data());
+            stack[top++] = node.rightOrFirst;
+            stack[top++] = self + 1;
+        }
+    }
+}
+
+template <typename Test, typename Visitor>
+void Bvh::query(Test&& overlaps, Visitor&& visit) const {
+    if (nodes.empty()) return;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!overlaps(node.bounds)) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                visit(primitives[node.rightOrFirst + i]);
+            }
+        } else {
+            uint32_t self = static_cast<uint32_t>(&node - nodes.data());
+            stack[top++] = node.rightOrFirst;
+            stack[top++] = self + 1;
+        }
+    }
+}
+
+template <typename Visitor>
+void Bvh::raycast(const glm::vec3& origin, const glm::vec3& dir, float radius, float maxDist, Visitor&& visit) const {
+    if (nodes.empty()) return;
+
+    glm::vec3 invDir = 1.0f / dir;
+    glm::vec3 pad(radius);
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        AABB inflated{node.bounds.min - pad, node.bounds.max + pad};
+        if (intersectRayAABB(origin, invDir, inflated, maxDist) < 0.0f) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                maxDist = visit(primitives[node.rightOrFirst + i], maxDist);
+            }
+        } else {
+            uint32_t self = static_cast<uint32_t>(&node - nodes.data());
+            stack[top++] = node.rightOrFirst;
+            stack[top++] = self + 1;
+        }
+    }
+}
+
+#endif // BVH_H
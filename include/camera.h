@@ -0,0 +1,53 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <glm/glm.hpp>
+#include "collision.h"
+
+enum class CameraMode {
+    FirstPerson,
+    ThirdPerson
+};
+
+/**
+ * @brief First- and third-person camera rigs driven by the player
+ *
+ * The first-person rig sits at the player's eye. The third-person rig hangs
+ * the camera on a boom behind and above the player; the boom is sphere-cast
+ * through the collision world every frame so it shortens instead of clipping
+ * into walls, and lengthens again with critically damped spring smoothing.
+ */
+class CameraSystem {
+public:
+    CameraMode mode = CameraMode::FirstPerson;
+
+    // Third-person tuning
+    float boomLength = 3.0f;      // Rest length of the boom behind the player
+    float boomHeight = 0.6f;      // Pivot height above the player's eye
+    float probeRadius = 0.25f;    // Radius of the sphere used to probe the boom
+    float followTime = 0.08f;     // Smoothing time of the pivot following the player
+    float extendTime = 0.35f;     // Smoothing time of the boom growing back out
+
+    void toggleMode();
+    void update(const glm::vec3& eye, const glm::vec3& front, float deltaTime, const CollisionWorld& world);
+
+    const glm::vec3& position() const { return camPosition; }
+    const glm::vec3& front() const { return camFront; }
+    const glm::mat4& view() const { return viewMatrix; }
+
+private:
+    glm::vec3 camPosition = glm::vec3(0.0f);
+    glm::vec3 camFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+
+    glm::vec3 pivot = glm::vec3(0.0f);
+    glm::vec3 pivotVelocity = glm::vec3(0.0f);
+    float boom = 0.0f;
+    float boomVelocity = 0.0f;
+    bool snapNextUpdate = true;
+};
+
+float smoothDamp(float current, float target, float& velocity, float smoothTime, float deltaTime);
+glm::vec3 smoothDamp(const glm::vec3& current, const glm::vec3& target, glm::vec3& velocity, float smoothTime, float deltaTime);
+
+#endif // CAMERA_H
@@ -0,0 +1,65 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "spatial_grid.h"
+
+/**
+ * @brief Result of a ray or sphere cast against the collision world
+ */
+struct CastHit {
+    float distance;     // Distance travelled along the cast direction
+    glm::vec3 point;    // Centre of the ray/sphere at the moment of impact
+    glm::vec3 normal;   // Surface normal of the box face that was hit
+    uint32_t collider;  // Index of the collider that was hit
+};
+
+/**
+ * @brief Grid cell size used for the colliders' spatial grid
+ */
+const float COLLISION_GRID_CELL_SIZE = 4.0f;
+
+/**
+ * @brief Static level colliders and the structures used to query them
+ *
+ * Colliders are boxes, which is what walls, doors and furniture bounds
+ * reduce to. Add all colliders, then call build() once before querying;
+ * it builds a BVH for casts and a spatial grid for broad-phase overlap
+ * queries. A level file can instead supply both prebuilt through load().
+ *
+ * A collider can be switched off in place, such as a dead monster's box;
+ * casts and overlap queries skip it, and so does the physics broad phase.
+ * The flag is read with relaxed atomics, since navmesh tiles query the
+ * world on worker threads while the game thread switches colliders.
+ */
+class CollisionWorld {
+public:
+    uint32_t addBox(const AABB& box);
+    void clear();
+    void build();
+    void load(const AABB* colliders, size_t count, const Bvh::Node* nodes, size_t nodeCount,
+              const uint32_t* primitives, size_t primitiveCount);
+
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, CastHit& hit) const;
+    bool sphereCast(const glm::vec3& origin, const glm::vec3& dir, float radius, float maxDist, CastHit& hit) const;
+    void overlapAABB(const AABB& box, std::vector<uint32_t>& out) const;
+
+    const AABB& collider(uint32_t index) const { return boxes[index]; }
+    const Bvh& hierarchy() const { return bvh; }
+    const SpatialGrid& grid() const { return spatialGrid; }
+    SpatialGrid& grid() { return spatialGrid; }
+    size_t size() const { return boxes.size(); }
+    void setEnabled(uint32_t index, bool enabled);
+    bool enabled(uint32_t index) const { return __atomic_load_n(&enabledFlags[index], __ATOMIC_RELAXED) != 0; }
+
+private:
+    std::vector<AABB> boxes;
+    std::vector<uint8_t> enabledFlags;      // Per collider, 1 unless switched off
+    Bvh bvh;
+    SpatialGrid spatialGrid;
+};
+
+#endif // COLLISION_H
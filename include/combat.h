@@ -0,0 +1,160 @@
+#ifndef COMBAT_H
+#define COMBAT_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "gltf.h"
+#include "spatial_grid.h"
+
+class JobSystem;
+
+using TargetId = uint32_t;
+using SwingId = uint32_t;
+
+/**
+ * @brief Grid cell size for the targets' broad phase
+ */
+const float COMBAT_GRID_CELL_SIZE = 4.0f;
+
+/**
+ * @brief Blade poses per sub-step of a sweep, and the most one sweep may take
+ *
+ * Each sub-step culls the hitboxes again against the part of the path it
+ * covers, so a long sweep only tests boxes near each stretch. The limit is
+ * only reached by a teleport and is counted in CombatStats::clamped.
+ */
+const int COMBAT_STEP_SAMPLES = 32;
+const int COMBAT_MAX_SAMPLES = 1 << 20;
+
+/**
+ * @brief A box attached to one bone, in the bone's space
+ */
+struct Hitbox {
+    int bone;                               // Index into HitboxSet::bones
+    glm::vec3 center;
+    glm::vec3 halfExtents;
+};
+
+/**
+ * @brief Hitboxes of one kind of monster and the bones they hang on
+ *
+ * Bone matrices are in model space. Nothing animates skeletons yet, so they
+ * hold the bind pose; whatever poses them later only has to call
+ * updateBounds() afterwards.
+ */
+struct HitboxSet {
+    std::vector<glm::mat4> bones;
+    std::vector<std::string> boneNames;
+    std::vector<Hitbox> boxes;
+    AABB bounds;                            // Model-space bounds of every box in the current pose
+
+    void fromSkeleton(const std::vector<SceneNode>& nodes, const Skin& skin);
+    void fromBounds(const AABB& modelBounds);
+    void updateBounds();
+};
+
+/**
+ * @brief A blade striking a target
+ */
+struct MeleeHit {
+    SwingId swing;
+    TargetId target;
+    int bone;                               // Bone of the hitbox struck
+    float time;                             // 0 at the blade's pose of the previous tick, 1 at this tick's
+    glm::vec3 point;                        // On the hitbox's surface, nearest the blade
+    glm::vec3 normal;                       // Out of the hitbox towards the blade
+};
+
+/**
+ * @brief Counters for the last tick
+ */
+struct CombatStats {
+    size_t swings = 0, targets = 0;
+    size_t candidates = 0;                  // Targets the broad phase passed to the sweeps
+    size_t samples = 0;                     // Blade poses tested against hitboxes
+    size_t clamped = 0;                     // Sweeps cut to COMBAT_MAX_SAMPLES, spaced wider than the radius
+    size_t hits = 0;
+    double seconds = 0.0;
+};
+
+/**
+ * @brief Melee hit detection: blades swept between ticks against per-bone hitboxes
+ *
+ * A blade is a capsule from hilt to tip. Each tick a swing is moved to its
+ * new pose, and resolve() tests the whole movement since the previous tick,
+ * not just where the blade ended up, so a swing that passes through a
+ * monster within one frame still hits it at any frame rate.
+ *
+ * The sweep samples poses between the two ticks, the blade's and the
+ * target's, no further apart than the blade's radius, so any hitbox the
+ * blade's core passes through is found; the first pose that touches gives
+ * the time of the hit. Targets are found through a SpatialGrid over their
+ * swept bounds, rebuilt only in ticks that have swings and after targets
+ * moved, so only monsters near a blade are posed and tested, and a crowd
+ * standing still costs nothing. All swings queued in a tick are resolved
+ * together, in parallel on the job system, and a swing strikes each target
+ * at most once.
+ */
+class CombatSystem {
+public:
+    TargetId addTarget(const HitboxSet* hitboxes, const glm::mat4& transform);
+    void moveTarget(TargetId target, const glm::mat4& transform);
+    void removeTarget(TargetId target);
+    void reserveTargets(size_t count);
+
+    SwingId beginSwing(float radius);
+    void sweep(SwingId swing, const glm::vec3& hilt, const glm::vec3& tip);
+    void endSwing(SwingId swing);
+
+    const std::vector<MeleeHit>& resolve(JobSystem* jobs);
+
+    const CombatStats& stats() const { return lastStats; }
+    void report(std::ostream& out) const;
+
+private:
+    struct Target {
+        const HitboxSet* hitboxes = nullptr;    // Null for a removed target, whose id is reused
+        glm::mat4 previous, current;
+        AABB previousBounds, currentBounds;     // World space
+        bool moved = false;                     // Since the last resolve
+    };
+
+    struct BoxSweep {
+        const Hitbox* box;
+        glm::mat4 from, to;                     // Bone to world at the previous and current tick
+    };
+
+    struct Swing {
+        float radius = 0.0f;
+        glm::vec3 hilt[2], tip[2];              // Previous and current tick
+        bool active = false;
+        bool started = false;                   // Has a previous pose to sweep from
+        bool queued = false;                    // Moved this tick
+        std::vector<TargetId> struck;
+        std::vector<MeleeHit> hits;             // This tick's, written by one job
+        std::vector<BoxSweep> boxes;            // Scratch: hitboxes near the current sub-step
+        size_t candidates = 0, samples = 0, clamped = 0;
+    };
+
+    bool sweepTarget(Swing& swing, SwingId id, TargetId target, MeleeHit& hit) const;
+    void resolveSwing(SwingId id);
+
+    std::vector<Target> targets;
+    std::vector<TargetId> freeTargets;
+    std::vector<TargetId> movedTargets;
+    std::vector<Swing> swings;
+    std::vector<SwingId> freeSwings;
+    std::vector<SwingId> queue;
+    std::vector<AABB> sweptBounds;              // Per target
+    SpatialGrid grid;
+    bool gridStale = true;                      // Some target was added, removed or moved since the grid was built
+    size_t liveTargets = 0;
+    std::vector<MeleeHit> hits;
+    CombatStats lastStats;
+};
+
+#endif // COMBAT_H
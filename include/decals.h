@@ -0,0 +1,78 @@
+#ifndef DECALS_H
+#define DECALS_H
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "job_system.h"
+#include "light_culling.h"
+
+/**
+ * @brief Number of decals kept alive; the oldest is overwritten when full
+ */
+const int MAX_DECALS = 1024;
+
+/**
+ * @brief Maximum number of decals a single draw evaluates
+ */
+const int MAX_DECALS_PER_DRAW = 8;
+
+/**
+ * @brief Texture unit the decal buffer is bound to
+ */
+const GLuint DECAL_TEXTURE_UNIT = 1;
+
+enum class DecalType {
+    Blood = 0,
+    Scorch = 1
+};
+
+/**
+ * @brief Decals chosen for one draw, newest first
+ */
+struct DecalAssignment {
+    int count = 0;
+    int indices[MAX_DECALS_PER_DRAW] = {};
+};
+
+/**
+ * @brief Persistent projected decals with a fixed cost
+ *
+ * Decals live in a ring buffer of MAX_DECALS box projectors mirrored into a
+ * texture buffer. There is no mesh per decal: each draw is culled against the
+ * decal bounds the same way lights are, and the fragment shader projects its
+ * world position into the assigned boxes. Cost is therefore bounded by
+ * MAX_DECALS_PER_DRAW per fragment however many marks have been left.
+ */
+class DecalSystem {
+public:
+    ~DecalSystem();
+
+    void create();
+    void spawn(DecalType type, const glm::vec3& position, const glm::vec3& normal, float size, float time);
+    void clear();
+    void cull(const std::vector<BoundingSphere>& objects, JobSystem& jobs);
+    void upload();
+    void bind() const;
+    void apply(GLuint program, size_t object) const;
+
+    int liveCount() const { return count; }
+
+private:
+    void cullRange(const std::vector<BoundingSphere>& objects, size_t begin, size_t end);
+
+    // Ring buffer state
+    int head = 0;
+    int count = 0;
+    std::vector<glm::vec4> texels;           // 4 texels per decal, mirrors the GPU buffer
+    std::vector<float> boundsX, boundsY, boundsZ, boundsR, spawnTime;
+    int dirtyBegin = MAX_DECALS, dirtyEnd = 0;
+
+    std::vector<DecalAssignment> objectDecals;
+
+    GLuint buffer = 0;
+    GLuint texture = 0;
+};
+
+#endif // DECALS_H
@@ -0,0 +1,77 @@
+#ifndef ENTITY_POOL_H
+#define ENTITY_POOL_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+const uint32_t ENTITY_NONE = 0xFFFFFFFFu;
+
+/**
+ * @brief A pooled entity: its slot and which occupant of that slot it is
+ *
+ * A slot's generation is bumped every time its entity is despawned, so a
+ * handle kept past that no longer matches and cannot reach whatever was
+ * spawned into the slot next.
+ */
+struct EntityHandle {
+    uint32_t index = ENTITY_NONE;           // Slot, which also indexes the owner's component arrays
+    uint32_t generation = 0;
+
+    bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Counters for one pool
+ */
+struct EntityPoolStats {
+    uint32_t live = 0, capacity = 0;
+    uint32_t peak = 0;                      // Most live at once
+    uint64_t spawned = 0, despawned = 0;
+    uint64_t rejected = 0;                  // Spawns refused because every slot was taken
+};
+
+/**
+ * @brief Fixed number of entity slots, handed out and recycled without touching the heap
+ *
+ * create() allocates everything up front. The owner sizes each of its
+ * component arrays, and the scene rows or instance slots its entities draw
+ * from, to capacity() once and indexes them by EntityHandle::index, so
+ * spawning an entity only claims a slot and despawning it only returns one.
+ * Freed slots are reused last in, first out, so a new entity lands on
+ * component data that was touched recently.
+ *
+ * Live slots are also kept densely in live(), in no particular order, for
+ * systems that visit every entity.
+ */
+class EntityPool {
+public:
+    void create(uint32_t capacity);
+
+    EntityHandle spawn();
+    bool despawn(EntityHandle entity);
+
+    bool alive(EntityHandle entity) const {
+        return entity.index < generations.size() && generations[entity.index] == entity.generation && denseIndex[entity.index] != ENTITY_NONE;
+    }
+    EntityHandle handle(uint32_t index) const { return {index, generations[index]}; }
+
+    const uint32_t* live() const { return dense.data(); }
+    uint32_t size() const { return liveCount; }
+    uint32_t capacity() const { return static_cast<uint32_t>(generations.size()); }
+
+    const EntityPoolStats& stats() const { return currentStats; }
+    void report(std::ostream& out, const char* name) const;
+
+private:
+    std::vector<uint32_t> generations;      // Per slot
+    std::vector<uint32_t> freeSlots;        // Stack of the first freeCount entries
+    std::vector<uint32_t> dense;            // Live slots in the first liveCount entries
+    std::vector<uint32_t> denseIndex;       // Per slot: its place in dense, or ENTITY_NONE when free
+    uint32_t freeCount = 0;
+    uint32_t liveCount = 0;
+    EntityPoolStats currentStats;
+};
+
+#endif // ENTITY_POOL_H
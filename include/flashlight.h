@@ -0,0 +1,59 @@
+#ifndef FLASHLIGHT_H
+#define FLASHLIGHT_H
+
+#include <functional>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "light_culling.h"
+
+/**
+ * @brief Texture units used by the flashlight permutation
+ */
+const GLuint FLASHLIGHT_COOKIE_UNIT = 2;
+const GLuint FLASHLIGHT_SHADOW_UNIT = 3;
+
+/**
+ * @brief Resolution of the optional flashlight shadow map
+ */
+const int FLASHLIGHT_SHADOW_SIZE = 512;
+
+/**
+ * @brief The player's flashlight: a projected-texture spot light with its own fast path
+ *
+ * The flashlight is not part of the generic light list. Draws whose bounds
+ * touch its cone use the FLASHLIGHT shader permutation, which projects a
+ * cookie texture from the player's eye and optionally tests a low-resolution
+ * shadow map rendered every frame. Everything else uses the base shader and
+ * pays nothing for it.
+ */
+class Flashlight {
+public:
+    bool enabled = false;
+    glm::vec3 color = glm::vec3(1.0f, 0.95f, 0.85f);
+    float intensity = 2.0f;
+    float range = 15.0f;
+    float outerAngle = glm::radians(22.0f);
+
+    ~Flashlight();
+
+    void create(bool withShadows);
+    void update(const glm::vec3& eye, const glm::vec3& front, const glm::vec3& up);
+    bool affects(const BoundingSphere& bounds) const;
+    void renderShadowMap(GLuint depthProgram, const std::function<void(GLint modelLoc)>& drawCasters) const;
+    void apply(GLuint program) const;
+
+    bool hasShadows() const { return shadowFBO != 0; }
+
+private:
+    void createCookie();
+
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+
+    GLuint cookie = 0;
+    GLuint shadowMap = 0;
+    GLuint shadowFBO = 0;
+};
+
+#endif // FLASHLIGHT_H
@@ -0,0 +1,44 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Uniform block binding point of the per-frame data
+ */
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+/**
+ * @brief Per-frame data shared by every shader (std140 layout)
+ *
+ * Must match the FrameData block declared in the shaders. Filled once per
+ * frame, so individual draws never re-upload the camera matrices.
+ */
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPos;   // xyz: camera position, w: unused
+    glm::vec4 time;        // x: seconds since start, y: frame delta
+};
+
+/**
+ * @brief Uniform buffer holding FrameData
+ */
+class FrameUniforms {
+public:
+    ~FrameUniforms();
+
+    void create();
+    void update(const FrameData& data);
+    void attach(GLuint program) const;
+
+    const FrameData& data() const { return current; }
+
+private:
+    GLuint ubo = 0;
+    FrameData current{};
+};
+
+#endif // FRAME_UNIFORMS_H
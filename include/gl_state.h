@@ -0,0 +1,113 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+#include <ostream>
+#include <GL/glew.h>
+
+/**
+ * @brief Number of texture units the cache tracks; higher units pass through
+ */
+const int GL_STATE_TEXTURE_UNITS = 16;
+
+/**
+ * @brief Shadow copy of the GL binding and render state
+ *
+ * Every subsystem binds through this instead of calling GL directly, so a
+ * bind of what is already bound never reaches the driver. State starts out
+ * unknown, so the first call of each kind is always issued.
+ *
+ * The element array binding belongs to the bound VAO and is not cached.
+ * Code that changes state behind the cache's back (or deletes a bound
+ * object) must call the matching forget or invalidate().
+ *
+ * With validation on, every filtered call first checks that the driver
+ * really has the cached value, and validate() compares everything; a stale
+ * cache is reported on std::cerr.
+ */
+class GlStateCache {
+public:
+    enum Category { Program, VertexArray, Buffer, Texture, Sampler, Capability, Blend, Depth, Cull, Framebuffer, CategoryCount };
+
+    struct Counters {
+        uint64_t issued = 0;
+        uint64_t filtered = 0;
+    };
+
+    GlStateCache();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindSampler(GLuint unit, GLuint sampler);
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    void bindRenderbuffer(GLuint renderbuffer);
+
+    void enable(GLenum capability) { setEnabled(capability, true); }
+    void disable(GLenum capability) { setEnabled(capability, false); }
+    void setEnabled(GLenum capability, bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+    void blendFunci(GLuint drawBuffer, GLenum source, GLenum destination);
+    void depthMask(GLboolean write);
+    void depthFunc(GLenum func);
+    void cullFace(GLenum face);
+
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vao);
+    void forgetBuffer(GLuint buffer);
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint framebuffer);
+    void forgetRenderbuffer(GLuint renderbuffer);
+    void invalidate();
+
+    void setValidation(bool enabled) { validation = enabled; }
+    bool validating() const { return validation; }
+    int validate(const char* where);
+
+    const Counters& counters(Category category) const { return stats[category]; }
+    void resetCounters();
+    void report(std::ostream& out) const;
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    enum BufferTarget { ArrayBuffer, UniformBuffer, TextureBuffer, CopyReadBuffer, CopyWriteBuffer, PixelUnpackBuffer, BufferTargetCount };
+    enum TextureTarget { Texture2D, TextureBufferTarget, Texture2DArray, TextureCubeMap, Texture3D, TextureTargetCount };
+    enum Cap { CapBlend, CapDepthTest, CapCullFace, CapPolygonOffsetFill, CapScissorTest, CapCount };
+
+    static int bufferSlot(GLenum target);
+    static int textureSlot(GLenum target);
+    static int capSlot(GLenum capability);
+
+    bool filter(Category category, bool redundant, GLenum query, GLint cached);
+    int checkBlend(const char* where);
+    void activeTexture(GLuint unit);
+    void mismatch(const char* where, const char* what, GLint cached, GLint actual);
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint buffers[BufferTargetCount];
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][TextureTargetCount];
+    GLuint samplers[GL_STATE_TEXTURE_UNITS];
+    GLuint drawFramebuffer;
+    GLuint readFramebuffer;
+    GLuint renderbuffer;
+    GLuint caps[CapCount];              // 0/1, or UNKNOWN
+    GLenum blendSource, blendDestination;
+    GLuint depthWrite;
+    GLenum depthCompare;
+    GLenum cullMode;
+
+    bool validation = false;
+    Counters stats[CategoryCount];
+};
+
+/**
+ * @brief The cache for the one GL context the game creates
+ */
+GlStateCache& glState();
+
+#endif // GL_STATE_H
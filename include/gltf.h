@@ -0,0 +1,122 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "bvh.h"
+#include "json.h"
+#include "mapped_file.h"
+
+/**
+ * @brief A validated glTF accessor, resolved to memory inside the mapped file
+ *
+ * componentType uses the GL enum values, which glTF shares.
+ */
+struct GltfAccessor {
+    const unsigned char* data = nullptr;   // First element
+    size_t count = 0;
+    size_t stride = 0;                     // Bytes from one element to the next
+    int componentType = 0;
+    int components = 0;                    // 1 (SCALAR) to 16 (MAT4)
+    bool normalized = false;
+    int bufferView = -1;
+    size_t viewOffset = 0;                 // Byte offset of the first element inside its bufferView
+
+    size_t componentSize() const;
+    size_t elementSize() const { return componentSize() * components; }
+    bool tightlyPacked() const { return stride == elementSize(); }
+    float readFloat(size_t element, int component) const;
+    uint32_t readIndex(size_t element) const;
+};
+
+/**
+ * @brief Node of the imported scene graph
+ */
+struct SceneNode {
+    std::string name;
+    int parent = -1;
+    std::vector<int> children;
+    int mesh = -1;                          // glTF mesh index
+    int skin = -1;
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::mat4 local = glm::mat4(1.0f);
+    glm::mat4 world = glm::mat4(1.0f);
+};
+
+/**
+ * @brief Joints of a skinned mesh and their inverse bind matrices
+ */
+struct Skin {
+    std::string name;
+    std::vector<int> joints;                // Node indices
+    std::vector<glm::mat4> inverseBindMatrices;
+    int skeleton = -1;
+};
+
+/**
+ * @brief A binary glTF 2.0 file, mapped and validated
+ *
+ * Every bufferView and accessor is bounds-checked once at load, so mesh
+ * import can then read through the resolved pointers without further checks.
+ * Buffers must live in the GLB's binary chunk; external and data-URI buffers
+ * are rejected. Animations are not read; skins are, for the hitboxes and
+ * ragdoll built from the skeleton.
+ */
+class GltfAsset {
+public:
+    bool load(const std::string& path, std::string& error);
+
+    const JsonValue& json() const { return document; }
+    const GltfAccessor* accessor(int index) const;
+    bool bufferView(int index, const unsigned char*& data, size_t& length) const;
+    const std::string& directory() const { return baseDirectory; }
+
+    std::vector<SceneNode> nodes;
+    std::vector<Skin> skins;
+
+private:
+    struct View {
+        const unsigned char* data = nullptr;
+        size_t length = 0;
+        size_t stride = 0;
+    };
+
+    bool parseContainer(std::string& error);
+    bool parseViews(std::string& error);
+    bool parseAccessors(std::string& error);
+    bool parseNodes(std::string& error);
+    bool parseSkins(std::string& error);
+
+    MappedFile file;
+    JsonValue document;
+    const unsigned char* binary = nullptr;
+    size_t binaryLength = 0;
+    std::vector<View> views;
+    std::vector<GltfAccessor> accessors;
+    std::string baseDirectory;
+};
+
+/**
+ * @brief One mesh to export, interleaved as position/normal/texcoord floats
+ */
+struct GlbMeshSource {
+    const unsigned char* vertices = nullptr;
+    size_t vertexCount = 0;
+    size_t stride = 0;
+    size_t normalOffset = 0;
+    size_t texCoordOffset = 0;
+    const uint32_t* indices = nullptr;
+    size_t indexCount = 0;
+    AABB bounds;
+    std::string imagePath;                  // Embedded as the base color texture if not empty
+};
+
+bool writeGlb(const std::string& path, const std::vector<GlbMeshSource>& meshes, std::string& error);
+
+#endif // GLTF_H
@@ -0,0 +1,180 @@
+#ifndef GPU_ALLOCATOR_H
+#define GPU_ALLOCATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+#include <GL/glew.h>
+#include "gl_state.h"
+
+/**
+ * @brief Two-level segregated fit allocator over a range of byte offsets
+ *
+ * O(1) allocate and free (Masmano et al. 2004): free blocks are binned by a
+ * power-of-two first level and 16 linear second-level classes, and two
+ * bitmaps find the smallest non-empty class that fits. Neighbouring free
+ * blocks are merged on free. Only bookkeeping lives here; the memory itself
+ * is a GL buffer somewhere else.
+ */
+class TlsfAllocator {
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    void reset(uint64_t capacity);
+    uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+    void free(uint32_t block);
+
+    uint64_t capacity() const { return totalBytes; }
+    uint64_t usedBytes() const { return usedTotal; }
+    uint64_t largestFreeBlock() const;
+
+private:
+    static const int SL_LOG2 = 4;
+    static const int SL_COUNT = 1 << SL_LOG2;
+    static const int FL_SHIFT = SL_LOG2 + 2;
+    static const uint64_t SMALL_BLOCK = 1ull << FL_SHIFT;
+    static const int FL_COUNT = 40;
+    static const uint64_t MIN_SPLIT = 16;
+
+    struct Block {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t prevPhysical = INVALID, nextPhysical = INVALID;
+        uint32_t prevFree = INVALID, nextFree = INVALID;
+        bool isFree = false;
+    };
+
+    static void mapping(uint64_t size, int& fl, int& sl);
+    uint32_t newBlock();
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    uint32_t findFree(uint64_t size);
+    uint32_t split(uint32_t block, uint64_t size);
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    uint64_t flBitmap = 0;
+    uint32_t slBitmap[FL_COUNT] = {};
+    uint32_t heads[FL_COUNT][SL_COUNT];
+    uint64_t totalBytes = 0;
+    uint64_t usedTotal = 0;
+};
+
+/**
+ * @brief Utilization and fragmentation of one arena
+ *
+ * Fragmentation is 1 - largest free block / total free: 0 when all free space
+ * is one block, approaching 1 when it is scattered in slivers.
+ */
+struct ArenaStats {
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+    uint64_t largestFree = 0;
+    uint32_t allocations = 0;
+    double utilization = 0.0;
+    double fragmentation = 0.0;
+};
+
+/**
+ * @brief Fixed-alignment allocations with stable handles that compaction can move
+ *
+ * Every allocation is aligned to the arena's alignment, which need not be a
+ * power of two: a vertex arena uses the vertex stride so offset / stride is
+ * a valid baseVertex.
+ */
+class GpuArena {
+public:
+    static const uint32_t INVALID = TlsfAllocator::INVALID;
+
+    using MoveFunction = std::function<void(uint64_t source, uint64_t destination, uint64_t size)>;
+
+    void reset(uint64_t capacity, uint64_t alignment);
+    uint32_t allocate(uint64_t size);
+    void free(uint32_t handle);
+    uint64_t offset(uint32_t handle) const { return entries[handle].offset; }
+    uint64_t size(uint32_t handle) const { return entries[handle].size; }
+
+    uint64_t compact(uint64_t budgetBytes, const MoveFunction& move);
+    ArenaStats stats() const;
+
+private:
+    struct Entry {
+        uint32_t block = INVALID;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    TlsfAllocator tlsf;
+    uint64_t align = 1;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeHandles;
+    uint32_t liveCount = 0;
+    std::vector<uint32_t> compactOrder;     // Scratch for compact(), kept so each pass does not allocate
+    bool settled = true;                    // A full compact() pass ran and nothing was freed since
+};
+
+/**
+ * @brief Location of one mesh inside a MeshBuffer
+ */
+struct MeshRange {
+    uint32_t vertices = GpuArena::INVALID;
+    uint32_t indices = GpuArena::INVALID;
+    GLsizei indexCount = 0;
+
+    bool valid() const { return vertices != GpuArena::INVALID; }
+};
+
+/**
+ * @brief Shared vertex and index buffers for every mesh of one vertex format
+ *
+ * Meshes are drawn with glDrawElementsBaseVertex from a single VAO. Ranges
+ * are handles, so compact() can slide meshes down to close the holes left by
+ * unloaded ones without their owners noticing; baseVertex and firstIndex are
+ * looked up at draw time.
+ */
+class MeshBuffer {
+public:
+    ~MeshBuffer();
+
+    /**
+     * @brief Allocate the GL buffers and describe Format on the shared VAO
+     *
+     * @tparam Format VertexFormat of every mesh stored here
+     * @param vertexBytes Capacity of the vertex buffer
+     * @param indexBytes Capacity of the index buffer
+     */
+    template <typename Format>
+    void create(GLsizeiptr vertexBytes, GLsizeiptr indexBytes) {
+        createBuffers(vertexBytes, indexBytes, static_cast<GLuint>(Format::stride));
+        Format::setupAttributes();
+        glState().bindVertexArray(0);
+    }
+
+    MeshRange add(const void* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount);
+    void remove(MeshRange& range);
+
+    GLint baseVertex(const MeshRange& range) const;
+    const void* firstIndex(const MeshRange& range) const;
+
+    void bind() const;
+    void draw(const MeshRange& range) const;
+
+    uint64_t compact(uint64_t budgetBytes);
+    ArenaStats vertexStats() const { return vertexArena.stats(); }
+    ArenaStats indexStats() const { return indexArena.stats(); }
+    void report(std::ostream& out) const;
+
+    bool created() const { return VAO != 0; }
+
+private:
+    void createBuffers(GLsizeiptr vertexBytes, GLsizeiptr indexBytes, GLuint vertexStride);
+    void moveWithin(GLuint buffer, uint64_t source, uint64_t destination, uint64_t size) const;
+
+    GpuArena vertexArena;
+    GpuArena indexArena;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint stride = 0;
+};
+
+#endif // GPU_ALLOCATOR_H
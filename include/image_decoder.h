@@ -0,0 +1,73 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Dimensions and pixel layout of a decoded image
+ *
+ * Pixels are 8 bits per channel, rows top to bottom and tightly packed.
+ */
+struct ImageInfo {
+    int width = 0;
+    int height = 0;
+    int channels = 0;                       // 1, 3 or 4
+    bool bgr = false;                       // Blue first, as stored in BMP files; uploaded with GL_BGR(A)
+
+    size_t rowBytes() const { return static_cast<size_t>(width) * channels; }
+    size_t byteSize() const { return rowBytes() * height; }
+};
+
+/**
+ * @brief One image decoding backend
+ *
+ * probe() reads only the header and says whether the backend takes the
+ * image. decode() then writes exactly info.byteSize() bytes to a caller
+ * owned destination, which may be a mapped pixel unpack buffer.
+ */
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool probe(const unsigned char* bytes, size_t length, ImageInfo& info) const = 0;
+    virtual bool decode(const unsigned char* bytes, size_t length, const ImageInfo& info,
+                        unsigned char* pixels, std::string& error) const = 0;
+};
+
+/**
+ * @brief Registry of image decoders, tried in order
+ *
+ * Built in: uncompressed BMP, JPEG through libjpeg-turbo when the build
+ * found it, and stb_image for everything else.
+ */
+namespace image_decode {
+
+void addDecoder(std::unique_ptr<ImageDecoder> decoder);
+const std::vector<std::unique_ptr<ImageDecoder>>& decoders();
+
+const ImageDecoder* find(const unsigned char* bytes, size_t length, ImageInfo& info);
+bool decode(const unsigned char* bytes, size_t length, ImageInfo& info, std::vector<unsigned char>& pixels,
+            std::string& error);
+
+} // namespace image_decode
+
+/**
+ * @brief Encoders for cooked assets
+ *
+ * JPEG needs libjpeg at build time; BMP always works and round-trips
+ * through the BMP decoder's copy path.
+ */
+namespace image_encode {
+
+bool jpegAvailable();
+bool jpeg(const ImageInfo& info, const unsigned char* pixels, int quality, std::vector<unsigned char>& out,
+          std::string& error);
+void bmp(const ImageInfo& info, const unsigned char* pixels, std::vector<unsigned char>& out);
+
+} // namespace image_encode
+
+#endif // IMAGE_DECODER_H
@@ -0,0 +1,47 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed pool of worker threads running fire-and-forget jobs
+ *
+ * Subsystems either submit() independent jobs, or split a data-parallel loop
+ * with parallelFor(), which also runs chunks on the calling thread so it never
+ * deadlocks when called from inside a job.
+ */
+class JobSystem {
+public:
+    explicit JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> job);
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+    void waitIdle();
+
+    unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    void workerLoop();
+    bool runOne();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    size_t active = 0;
+    bool stopping = false;
+};
+
+#endif // JOB_SYSTEM_H
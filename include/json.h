@@ -0,0 +1,52 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Minimal read-only JSON document (RFC 8259)
+ *
+ * Enough for asset manifests such as glTF: numbers are doubles, objects keep
+ * their member order, and lookups of missing keys or out-of-range indices
+ * return a shared null value so chains like `doc["a"][0]["b"]` never throw.
+ */
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    static bool parse(const char* text, size_t length, JsonValue& out, std::string& error);
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Type::Null; }
+    bool isNumber() const { return kind == Type::Number; }
+    bool isString() const { return kind == Type::String; }
+    bool isArray() const { return kind == Type::Array; }
+    bool isObject() const { return kind == Type::Object; }
+
+    bool boolean(bool fallback = false) const { return kind == Type::Bool ? flag : fallback; }
+    double number(double fallback = 0.0) const { return kind == Type::Number ? value : fallback; }
+    int integer(int fallback = -1) const;
+    const std::string& string() const { return text; }
+
+    size_t size() const;
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue& operator[](int index) const { return (*this)[static_cast<size_t>(index)]; } // Negative is out of range
+    const JsonValue& operator[](const char* key) const;
+    bool has(const char* key) const;
+    const std::vector<std::pair<std::string, JsonValue>>& members() const { return fields; }
+
+private:
+    friend class JsonParser;
+
+    Type kind = Type::Null;
+    bool flag = false;
+    double value = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> fields;
+};
+
+#endif // JSON_H
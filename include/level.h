@@ -0,0 +1,148 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "mapped_file.h"
+
+class CollisionWorld;
+class PotentiallyVisibleSet;
+
+/**
+ * @brief Sections of a level file; unknown types are skipped by the loader
+ */
+enum class LevelSection : uint32_t {
+    Strings = 1,        // Zero-terminated names, referenced by byte offset
+    Materials,          // LevelMaterial[]
+    Entities,           // LevelEntity[]
+    Colliders,          // AABB[] of the collision world
+    BvhNodes,           // Bvh::Node[] built over the colliders
+    BvhPrimitives,      // uint32_t[] primitive order of the BVH
+    Grid,               // LevelGrid
+    GridCells,          // uint32_t[cellsX * cellsZ + 1] bucket starts of the spatial grid
+    GridItems,          // uint32_t[] bucketed collider indices
+    Visibility,         // A whole ".pvs" image
+};
+
+const uint32_t LEVEL_NO_MATERIAL = 0xFFFFFFFFu;
+const uint32_t LEVEL_NO_COLLIDER = 0xFFFFFFFFu;
+
+/**
+ * @brief Material flags
+ */
+const uint32_t LEVEL_MATERIAL_VIRTUAL_TEXTURE = 1;  // The source is a virtual texture rather than a model
+
+/**
+ * @brief Entity flags
+ */
+const uint32_t LEVEL_ENTITY_CASTS_SHADOW = 1;      // Drawn into the flashlight and moon shadow maps
+const uint32_t LEVEL_ENTITY_STATIC = 2;            // Never moves, so it occludes when visibility is baked
+
+/**
+ * @brief What an entity is drawn with; names are string table offsets
+ */
+struct LevelMaterial {
+    uint32_t name;
+    uint32_t source;        // Model name, or virtual texture path
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+/**
+ * @brief One placed object of the level
+ */
+struct LevelEntity {
+    uint32_t name;
+    uint32_t material;      // Index into the materials, or LEVEL_NO_MATERIAL
+    uint32_t flags;
+    uint32_t collider;      // Its own box in the colliders, or LEVEL_NO_COLLIDER
+    float position[3];
+    float rotation[4];      // Quaternion, w x y z
+    float scale[3];
+
+    glm::vec3 translation() const { return glm::vec3(position[0], position[1], position[2]); }
+    glm::quat orientation() const { return glm::quat(rotation[0], rotation[1], rotation[2], rotation[3]); }
+    glm::vec3 size() const { return glm::vec3(scale[0], scale[1], scale[2]); }
+};
+
+/**
+ * @brief Placement of the collision world's spatial grid
+ */
+struct LevelGrid {
+    float origin[3];
+    float cellSize;
+    int32_t cellsX, cellsZ;
+    uint32_t itemCount;
+    uint32_t reserved;
+};
+
+/**
+ * @brief A baked level (".lvl"), used through a read-only mapping
+ *
+ * The file is a header, a table of typed sections and the sections
+ * themselves, each 16-byte aligned. Every array is stored exactly as it is
+ * laid out in memory, so opening a level only checks the header, bounds-checks
+ * the section table and turns offsets into pointers into the mapping.
+ * Collision structures are copied out with memcpy and the visibility set is
+ * used in place; nothing is built at load time.
+ *
+ * The layout follows the in-memory structs, so any change to them must bump
+ * LEVEL_FILE_VERSION. Files of another version are refused with a message
+ * asking for a re-export.
+ */
+class Level {
+public:
+    bool open(const std::string& path, std::string& error);
+    void close();
+    bool loaded() const { return file.isOpen(); }
+
+    size_t entityCount() const { return entityTotal; }
+    const LevelEntity& entity(size_t index) const { return entities[index]; }
+    size_t materialCount() const { return materialTotal; }
+    const LevelMaterial& material(uint32_t index) const { return materials[index]; }
+    const char* string(uint32_t offset) const;
+
+    bool loadCollision(CollisionWorld& world, std::string& error) const;
+    bool loadVisibility(PotentiallyVisibleSet& visibility, std::string& error) const;
+
+private:
+    struct Span {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+    const Span& section(LevelSection type) const;
+
+    MappedFile file;
+    std::vector<Span> sections;             // Indexed by section type
+    const LevelEntity* entities = nullptr;
+    const LevelMaterial* materials = nullptr;
+    size_t entityTotal = 0, materialTotal = 0;
+};
+
+/**
+ * @brief Collects a level in memory and writes it in the layout Level maps
+ */
+class LevelWriter {
+public:
+    uint32_t addString(const std::string& text);
+    uint32_t addMaterial(const std::string& name, const std::string& source, uint32_t flags);
+    void addEntity(const std::string& name, uint32_t material, uint32_t flags, uint32_t collider,
+                   const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void setCollision(const CollisionWorld& world);
+    void setVisibility(std::vector<unsigned char> bytes) { visibility = std::move(bytes); }
+
+    bool write(const std::string& path, std::string& error) const;
+
+private:
+    std::vector<char> strings;
+    std::vector<LevelMaterial> materials;
+    std::vector<LevelEntity> entities;
+    std::vector<std::pair<LevelSection, std::vector<unsigned char>>> collision;
+    std::vector<unsigned char> visibility;
+};
+
+#endif // LEVEL_H
@@ -0,0 +1,95 @@
+#ifndef LIGHT_CULLING_H
+#define LIGHT_CULLING_H
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "job_system.h"
+
+/**
+ * @brief Maximum number of lights in the scene light buffer
+ */
+const int MAX_SCENE_LIGHTS = 64;
+
+/**
+ * @brief Maximum number of lights a single draw evaluates
+ */
+const int MAX_LIGHTS_PER_DRAW = 4;
+
+/**
+ * @brief Uniform block binding point of the scene light buffer
+ */
+const GLuint LIGHT_UNIFORM_BINDING = 1;
+
+enum class LightType {
+    Point,
+    Spot
+};
+
+/**
+ * @brief A point or spot light placed in the level
+ */
+struct Light {
+    LightType type = LightType::Point;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); // Spot lights only
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float range = 10.0f;
+    float outerAngle = glm::radians(30.0f);             // Spot lights only, half-angle
+};
+
+/**
+ * @brief Bounding sphere of a drawable object in world space
+ */
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+/**
+ * @brief Lights chosen for one draw, ordered by significance
+ */
+struct LightAssignment {
+    int count = 0;
+    glm::ivec4 indices = glm::ivec4(0);
+};
+
+/**
+ * @brief CPU light culling and per-draw light selection
+ *
+ * Every object is tested against every light's bounding sphere (and cone, for
+ * spot lights) four lights at a time with SSE, with objects split across the
+ * job system. The MAX_LIGHTS_PER_DRAW most significant lights that survive are
+ * assigned to the object, so the fragment shader only loops over those.
+ */
+class LightCuller {
+public:
+    ~LightCuller();
+
+    void create();
+    void setLights(const std::vector<Light>& lights);
+    void cull(const std::vector<BoundingSphere>& objects, JobSystem& jobs);
+    void upload();
+    void attach(GLuint program) const;
+    void apply(GLuint program, size_t object) const;
+
+    const std::vector<Light>& lights() const { return sceneLights; }
+    const std::vector<LightAssignment>& assignments() const { return objectLights; }
+
+private:
+    void cullRange(const std::vector<BoundingSphere>& objects, size_t begin, size_t end);
+
+    std::vector<Light> sceneLights;
+    std::vector<LightAssignment> objectLights;
+
+    // Structure-of-arrays copy of the lights, padded to a multiple of 4
+    std::vector<float> posX, posY, posZ, range, intensity;
+    std::vector<float> dirX, dirY, dirZ, cosOuter, sinOuter;
+
+    GLuint ubo = 0;
+    bool dirty = true;
+};
+
+#endif // LIGHT_CULLING_H
@@ -0,0 +1,55 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+
+/**
+ * @brief Uncompressed vertex and index streams of one mesh
+ *
+ * What the cooker reads from Assimp and what the decoder hands back to
+ * ModelLoader. Normals and texture coordinates may be empty.
+ */
+struct MeshStreams {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+    std::string texture;                    // Diffuse texture, relative to the model directory
+    AABB bounds;
+};
+
+/**
+ * @brief Compressed mesh container (".mesh" files)
+ *
+ * Each mesh is stored as:
+ * - positions quantized to 16 bits within the mesh bounds,
+ * - normals as 16-bit octahedral pairs,
+ * - texture coordinates quantized to 16 bits within their own range,
+ * - indices as zigzagged deltas in LEB128 varints.
+ *
+ * Vertex attributes are delta coded per component and split into low and
+ * high byte planes, so each plane has a skewed byte distribution. Every
+ * plane then goes through an order-0 rANS coder, or is stored raw when that
+ * would not make it smaller.
+ */
+namespace mesh_codec {
+
+void encode(const MeshStreams& mesh, std::vector<uint8_t>& out);
+bool decode(const uint8_t* data, size_t length, MeshStreams& out, size_t& consumed, std::string& error);
+
+bool writeFile(const std::string& path, const std::vector<MeshStreams>& meshes, std::string& error);
+bool readFile(const std::string& path, std::vector<MeshStreams>& meshes, std::string& error);
+
+// Exposed for the codec benchmark
+size_t ransEncode(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+bool ransDecode(const uint8_t* data, size_t length, uint8_t* out, size_t outLength, size_t& consumed);
+const char* decodeKernel();
+
+} // namespace mesh_codec
+
+#endif // MESH_CODEC_H
@@ -5,6 +5,21 @@
 #include <vector>
 #include <GL/glew.h>
 #include <assimp/scene.h>
+#include "bvh.h"
+#include "gltf.h"
+#include "mesh_codec.h"
+#include "vertex_format.h"
+#include "gpu_allocator.h"
+#include "image_decoder.h"
+
+/**
+ * @brief Vertex layout models are packed into
+ *
+ * Shaders that draw models get their inputs from ModelVertex::glslInputs().
+ */
+using ModelVertex = StandardVertex;
+
+class JobSystem;
 
 struct Texture {
     GLuint id;
@@ -13,10 +28,15 @@ struct Texture {
 };
 
 struct Mesh {
-    std::vector<GLfloat> vertices;
-    std::vector<GLuint> indices;
+    std::vector<unsigned char> vertices;  // Interleaved ModelVertex data; empty if uploaded straight from a GLB
+    std::vector<GLuint> indices;          // Empty if uploaded straight from a GLB
     std::vector<Texture> textures;
-    GLuint VAO, VBO, EBO;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    MeshRange range;                      // Location in the shared MeshBuffer, if one is used
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;   // GLB indices keep their stored width
+    glm::mat4 transform = glm::mat4(1.0f); // World transform of the glTF node; identity for OBJ
+    int skin = -1;                        // Index into ModelLoader::skins
 };
 
 class ModelLoader {
@@ -25,19 +45,48 @@ public:
     ~ModelLoader();
 
     std::vector<Mesh> meshes;
+    AABB bounds; // Object-space bounds of all loaded meshes
+
+    // Scene data imported from GLB files; empty for OBJ
+    std::vector<SceneNode> nodes;
+    std::vector<Skin> skins;
+
+    MeshBuffer* sharedGeometry = nullptr;   // Set before loading to place meshes in a mega-buffer
+    static bool preferDirectStateAccess;    // Cleared by --no-dsa to force the GL 3.3 path
+    static bool directStateAccessSupported();
+    static bool cookModel(const std::string& model_name, JobSystem* jobs = nullptr);
+    bool usesDirectStateAccess() const { return directStateAccess; }
 
     void loadModel(const std::string& model_name);
+    bool loadObj(const std::string& model_name);
+    bool loadCooked(const std::string& model_name);
+    bool loadGlb(const std::string& path);
     void draw();
+    void draw(GLint modelLocation, const glm::mat4& transform);
+
+    size_t zeroCopyMeshes = 0;              // Meshes of the last GLB load uploaded from the file without repacking
 
 private:
+    bool directStateAccess = false;         // Decided per load; meshes then share ModelVertex's VAO
+    bool nodeTransforms = false;            // Whether any mesh has a non-identity node transform
+    GLuint unpackBuffer = 0;                // Pixel unpack buffer textures are decoded into
+
+    void beginLoad();
+    Mesh buildMesh(const MeshStreams& streams, const std::string& model_name);
+    void uploadMesh(Mesh& mesh, const void* vertexData, size_t vertexCount, const void* indexData);
+
+    bool processPrimitive(const GltfAsset& asset, const JsonValue& primitive, const SceneNode& node, Mesh& out);
+    GLuint loadGltfTexture(const GltfAsset& asset, int material, std::string& path);
 
+    GLuint uploadTexture(const ImageInfo* image, const void* pixels, int levels = 1);
     GLuint loadTextureFromFile(const std::string& texturePath);
+    GLuint loadTextureFromMemory(const unsigned char* bytes, size_t length, const std::string& name);
 
-    GLuint loadTexture(aiMaterial *material, aiTextureType type, const std::string &model_name);
+    static bool importObj(const std::string& model_name, std::vector<MeshStreams>& streams);
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene, const std::string &model_name);
+    static MeshStreams processMesh(aiMesh *mesh, const aiScene *scene);
 
-    void processNode(aiNode *node, const aiScene *scene, const std::string &model_name);
+    static void processNode(aiNode *node, const aiScene *scene, std::vector<MeshStreams>& streams);
 };
 
 #endif // MODEL_LOADER_H
\ No newline at end of file
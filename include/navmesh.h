@@ -0,0 +1,205 @@
+#ifndef NAVMESH_H
+#define NAVMESH_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "bvh.h"
+
+class CollisionWorld;
+class JobSystem;
+
+/**
+ * @brief Size of a navigation cell and of a tile in cells
+ */
+const float NAV_CELL_SIZE = 0.25f;
+const int NAV_TILE_CELLS = 32;
+
+/**
+ * @brief Size of the agents the mesh is built for
+ *
+ * Obstacles are grown by the radius, so a path through free cells keeps
+ * an agent's body clear of them. Anything lower than the step height
+ * above the floor, such as the floor itself, is walked over.
+ */
+const float NAV_AGENT_RADIUS = 0.35f;
+const float NAV_AGENT_HEIGHT = 1.8f;
+const float NAV_STEP_HEIGHT = 0.3f;
+
+/**
+ * @brief How far an obstacle may drift before the tiles under it are rebuilt
+ */
+const float NAV_OBSTACLE_TOLERANCE = 0.05f;
+
+using NavPathId = uint32_t;
+const NavPathId NO_NAV_PATH = 0xFFFFFFFFu;
+
+/**
+ * @brief Where a path request stands
+ */
+enum class NavPathState : uint8_t {
+    Pending,                                // Waiting to be planned, or replanned after a tile changed
+    Ready,
+    Failed                                  // No way through; asked again after the next tile change
+};
+
+/**
+ * @brief A box that moves, such as a door leaf or a crate, blocking what lies under it
+ */
+struct NavObstacle {
+    glm::vec3 center;
+    glm::quat rotation;
+    glm::vec3 halfExtents;
+};
+
+/**
+ * @brief Counters for the navigation mesh
+ */
+struct NavMeshStats {
+    size_t tiles = 0;
+    size_t rebuilding = 0;                  // Tiles with a rebuild in flight
+    uint64_t rebuilt = 0;                   // Tiles swapped in since creation
+    uint64_t planned = 0, failed = 0;       // Path plans, and those that found no way
+    uint64_t replanned = 0;                 // Paths sent back to planning because a tile under them changed
+    size_t pendingPaths = 0;
+    double lastLatencyMs = 0.0;             // From an obstacle moving to the rebuilt tile being swapped in
+    double averageLatencyMs = 0.0;
+    double worstLatencyMs = 0.0;
+};
+
+/**
+ * @brief Tiled grid navigation mesh that follows moving obstacles
+ *
+ * The walkable area is split into square tiles of NAV_TILE_CELLS cells;
+ * each cell is free or blocked by a level collider or an obstacle. When an
+ * obstacle moves by more than NAV_OBSTACLE_TOLERANCE, the tiles under its
+ * old and new footprint are rebuilt on the job system from a snapshot of
+ * the obstacles, and update() swaps each finished tile in whole, with an
+ * atomic pointer store, so a reader sees either the old tile or the new
+ * one and never half of each. A tile that changes again while it is being
+ * rebuilt is rebuilt once more after that.
+ *
+ * Free cells are labelled by connected region whenever tiles are swapped,
+ * so a path with no way through, such as into the house with the door
+ * shut, fails at once instead of searching the whole mesh.
+ *
+ * Paths are requested, then planned with A* in update(), a few each call.
+ * Every path remembers the tiles it crosses; when one of them is swapped
+ * it goes back to planning, so agents never walk on through a door that
+ * has just closed, and a failed path is tried again once something changed.
+ */
+class NavMesh {
+public:
+    NavMesh() = default;
+    NavMesh(const NavMesh&) = delete;
+    NavMesh& operator=(const NavMesh&) = delete;
+
+    void create(const AABB& area, float floor, const CollisionWorld* level, JobSystem* jobs);
+
+    uint32_t addObstacle(const NavObstacle& obstacle);
+    void moveObstacle(uint32_t obstacle, const NavObstacle& placement);
+    void markDirty(const AABB& box);
+
+    void reservePaths(size_t count);
+    NavPathId requestPath(const glm::vec3& from, const glm::vec3& to);
+    void movePath(NavPathId path, const glm::vec3& from, const glm::vec3& to);
+    void releasePath(NavPathId path);
+    NavPathState pathState(NavPathId path) const { return paths[path].state; }
+    const std::vector<glm::vec3>& waypoints(NavPathId path) const { return paths[path].waypoints; }
+    uint32_t revision(NavPathId path) const { return paths[path].revision; }
+
+    void update(size_t maxPlans);
+
+    bool walkable(const glm::vec3& position) const;
+
+    const NavMeshStats& stats() const { return currentStats; }
+    void report(std::ostream& out) const;
+
+private:
+    /**
+     * @brief One tile's cells, immutable once published
+     */
+    struct Tile {
+        uint32_t version = 0;
+        std::vector<uint8_t> blocked;       // NAV_TILE_CELLS squared, row by row
+    };
+
+    struct TileSlot {
+        std::shared_ptr<const Tile> tile;   // Read and written with atomic loads and stores
+        bool building = false;
+        bool dirty = false;                 // Changed again since its rebuild started
+        std::chrono::steady_clock::time_point dirtySince;
+        uint32_t version = 0;
+    };
+
+    struct Built {
+        int tile;
+        std::shared_ptr<const Tile> cells;
+        std::chrono::steady_clock::time_point dirtySince;
+    };
+
+    struct Completions {
+        std::mutex mutex;
+        std::vector<Built> tiles;
+    };
+
+    struct Path {
+        bool used = false;
+        NavPathState state = NavPathState::Pending;
+        glm::vec3 from, to;
+        std::vector<glm::vec3> waypoints;
+        std::vector<int> tiles;             // Tiles the plan crosses, sorted
+        uint32_t revision = 0;              // Bumped whenever the waypoints change
+    };
+
+    static std::shared_ptr<const Tile> buildTile(int tileX, int tileZ, const glm::vec3& origin, float floor,
+                                                 const CollisionWorld* level, const std::vector<NavObstacle>& obstacles,
+                                                 uint32_t version);
+    AABB tileBounds(int tile) const;
+    AABB footprint(const NavObstacle& obstacle) const;
+    void startRebuild(int tile);
+    void publish(Built& built);
+    void snapshotTiles();
+    void labelRegions();
+    void plan(Path& path);
+    bool nearestFree(glm::ivec2& cell) const;
+    bool blockedCell(int x, int z) const;
+    bool lineOfSight(int x0, int z0, int x1, int z1) const;
+    glm::ivec2 cellOf(const glm::vec3& position) const;
+    glm::vec3 cellCenter(int x, int z) const;
+
+    const CollisionWorld* level = nullptr;
+    JobSystem* jobs = nullptr;
+    glm::vec3 origin = glm::vec3(0.0f);     // Corner of the first tile, on the floor
+    float floor = 0.0f;
+    int tilesX = 0, tilesZ = 0;
+    std::vector<TileSlot> tiles;
+    std::vector<NavObstacle> obstacles;     // Where each was rasterized last
+    std::shared_ptr<Completions> completions = std::make_shared<Completions>();
+    std::vector<Built> finished;            // Taken from completions in update()
+
+    std::vector<Path> paths;
+    std::vector<NavPathId> freePaths;
+    std::vector<NavPathId> planQueue;       // Oldest first
+
+    // A* scratch, one entry per cell of the whole mesh
+    std::vector<float> cost;
+    std::vector<int> cameFrom;
+    std::vector<uint32_t> visited;          // Search stamp that last touched the cell
+    uint32_t stamp = 0;
+    std::vector<std::pair<float, int>> open;
+    std::vector<const Tile*> planTiles;     // Tiles as of the last update(), read by planning and labelling
+    std::vector<int> rawPath;
+    std::vector<uint32_t> regions;          // Per cell: connected area of free cells, 0 when blocked
+    std::vector<int> flood;
+
+    NavMeshStats currentStats;
+    uint64_t latencySamples = 0;
+};
+
+#endif // NAVMESH_H
@@ -0,0 +1,69 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "render_target.h"
+#include "batch_transform.h"
+#include "vertex_format.h"
+
+/**
+ * @brief Weighted blended order-independent transparency (McGuire & Bavoil 2013)
+ *
+ * Transparent surfaces are accumulated into their own targets: a weighted sum
+ * of premultiplied color (RGBA16F) and the product of (1 - alpha) (R8). Both
+ * targets share the scene's depth buffer read-only, so opaque geometry still
+ * occludes. A final full-screen pass resolves the average color over the
+ * scene. Nothing is sorted on the CPU.
+ */
+class OitPass {
+public:
+    ~OitPass();
+
+    static bool supported();
+
+    void resize(const SceneTarget& scene);
+    void begin() const;
+    void end() const;
+    void composite(const SceneTarget& scene, GLuint compositeProgram) const;
+
+private:
+    void release();
+
+    GLuint fbo = 0;
+    GLuint accum = 0;
+    GLuint revealage = 0;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @brief Camera-independent transparent quads: fog cards, glass panes, cobwebs
+ *
+ * All quads are drawn with one instanced call. Their matrices are built by
+ * the batch transform kernel straight into the mapped instance buffer.
+ */
+class TransparentQuads {
+public:
+    using Vertex = StandardVertex;  // Instance attributes start at location 3
+
+    ~TransparentQuads();
+
+    void create();
+    void add(const glm::vec3& center, const glm::vec2& size, float yaw, const glm::vec4& tint);
+    void clear();
+    void draw();
+
+    size_t size() const { return transforms.size(); }
+
+private:
+    void upload();
+
+    TransformSoA transforms;
+    std::vector<glm::vec4> tints;   // rgb: color, a: peak opacity
+    GLuint VAO = 0, VBO = 0, instanceVBO = 0, tintVBO = 0;
+    bool dirty = false;
+};
+
+#endif // OIT_H
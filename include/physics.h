@@ -0,0 +1,240 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "bvh.h"
+#include "spatial_grid.h"
+
+class CollisionWorld;
+class JobSystem;
+
+/**
+ * @brief Identifies a rigid body; also used for the fixed world in joints
+ */
+using BodyId = uint32_t;
+const BodyId PHYSICS_WORLD = 0xFFFFFFFFu;
+
+/**
+ * @brief Fixed simulation step, and how many steps one update may catch up
+ */
+const float PHYSICS_TIMESTEP = 1.0f / 60.0f;
+const int PHYSICS_MAX_STEPS = 4;
+
+/**
+ * @brief Convex shapes a body can have, centred on the body's position
+ */
+enum class ShapeType : uint8_t {
+    Sphere,
+    Capsule,            // Along the local Y axis
+    Box,
+};
+
+struct CollisionShape {
+    ShapeType type = ShapeType::Sphere;
+    glm::vec3 halfExtents = glm::vec3(0.0f);    // Box
+    float radius = 0.0f;                        // Sphere, capsule
+    float halfHeight = 0.0f;                    // Capsule: half the distance between the cap centres
+
+    static CollisionShape sphere(float radius);
+    static CollisionShape capsule(float radius, float halfHeight);
+    static CollisionShape box(const glm::vec3& halfExtents);
+};
+
+/**
+ * @brief How to create a body; a mass of zero makes it kinematic
+ */
+struct RigidBodyDesc {
+    CollisionShape shape;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float mass = 1.0f;
+    float friction = 0.6f;
+    float restitution = 0.1f;
+    uint32_t group = 0;         // Bodies sharing a nonzero group do not collide, like the bones of one ragdoll
+};
+
+/**
+ * @brief Counters for the last step
+ */
+struct PhysicsStats {
+    size_t bodies = 0, awake = 0;
+    size_t pairs = 0, contacts = 0;
+    size_t islands = 0, largestIsland = 0;
+    double seconds = 0.0;                       // Wall time of the last update
+};
+
+/**
+ * @brief Rigid bodies for doors, pickups and debris
+ *
+ * A sequential-impulse solver with warm starting: contacts and joints are
+ * velocity constraints solved a few iterations at a time, and each contact
+ * remembers its impulses from the step before, matched by feature, so
+ * stacks settle instead of jittering. Penetration is fed back as a bias
+ * velocity, and contacts are created slightly before shapes touch so fast
+ * bodies do not tunnel.
+ *
+ * The broad phase uses the level's CollisionWorld as it is: bodies collide
+ * with its enabled boxes through its spatial grid, and a SpatialGrid of the
+ * same kind over the bodies themselves is rebuilt every step. Contact
+ * generation runs over the pairs on the job system. Spheres and capsules are
+ * reduced to points with a radius and tested against boxes four at a time by
+ * a SIMD kernel; two boxes are clipped against each other on their
+ * separating axis.
+ *
+ * Bodies and joints can be switched off and set up again in place, so a
+ * pool of them preallocated up front serves debris and ragdolls without
+ * growing the world. A disabled body is in no pair and no island.
+ *
+ * Bodies touching each other, directly or through joints, form an island.
+ * Islands share no dynamic body, so they are solved in parallel. An island
+ * whose bodies have all been nearly still for a while falls asleep and costs
+ * nothing until something awake touches it or it is pushed.
+ */
+class PhysicsWorld {
+public:
+    void setLevel(const CollisionWorld* world) { level = world; }
+    void setGravity(const glm::vec3& value) { gravity = value; }
+
+    BodyId addBody(const RigidBodyDesc& desc);
+    uint32_t addHinge(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis, float minAngle, float maxAngle,
+                      float friction);
+    uint32_t addConeJoint(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis, float coneAngle,
+                          float friction);
+
+    void resetBody(BodyId body, const RigidBodyDesc& desc);
+    void resetConeJoint(uint32_t joint, BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis,
+                        float coneAngle, float friction);
+    void setBodyEnabled(BodyId body, bool enabled);
+    void setJointEnabled(uint32_t joint, bool enabled);
+
+    void update(float elapsed, JobSystem* jobs);
+    void step(float dt, JobSystem* jobs);
+
+    void applyImpulse(BodyId body, const glm::vec3& impulse, const glm::vec3& point);
+    void setVelocity(BodyId body, const glm::vec3& linear, const glm::vec3& angular);
+    void moveKinematic(BodyId body, const glm::vec3& target);
+    void wake(BodyId body);
+
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, BodyId& body, float& distance) const;
+
+    glm::vec3 position(BodyId body) const { return bodies[body].position; }
+    glm::quat orientation(BodyId body) const { return bodies[body].orientation; }
+    glm::vec3 velocity(BodyId body) const { return bodies[body].linearVelocity; }
+    const AABB& bounds(BodyId body) const { return bodies[body].bounds; }
+    bool awake(BodyId body) const { return bodies[body].awake; }
+    bool enabled(BodyId body) const { return bodies[body].enabled; }
+    size_t bodyCount() const { return bodies.size(); }
+    size_t jointCount() const { return joints.size(); }
+
+    const PhysicsStats& stats() const { return lastStats; }
+    void report(std::ostream& out) const;
+
+    static bool simdContacts;               // Use the SSE contact kernel where available
+
+    /**
+     * @brief Contact point, normal from the first body towards the second
+     */
+    struct Contact {
+        glm::vec3 point;
+        glm::vec3 normal;
+        float depth;                            // Penetration; negative while still apart
+        uint32_t feature;                       // Which face point, edge or cap made it, for warm starting
+        float normalImpulse, tangentImpulse[2];
+        // Solver state
+        glm::vec3 rA, rB, tangent[2];
+        float normalMass, tangentMass[2], bias;
+    };
+
+private:
+    struct Body {
+        CollisionShape shape;
+        glm::vec3 position, linearVelocity = glm::vec3(0.0f), angularVelocity = glm::vec3(0.0f);
+        glm::quat orientation;
+        float invMass;
+        glm::vec3 invInertiaLocal;
+        glm::mat3 invInertia;                   // World space, refreshed every step
+        float friction, restitution;
+        float sleepTime = 0.0f;
+        uint32_t island = 0;                    // Island of the last step, woken together
+        uint32_t group = 0;
+        bool enabled = true;
+        bool awake = true;
+        bool kinematic;
+        bool hasTarget = false;
+        glm::vec3 target;
+        AABB bounds;
+    };
+
+    static const int MAX_MANIFOLD_CONTACTS = 8;
+    struct Manifold {
+        BodyId a, b;                            // b has PHYSICS_LEVEL_COLLIDER set for level boxes
+        int count = 0;
+        float friction, restitution;
+        Contact contacts[MAX_MANIFOLD_CONTACTS];
+    };
+
+    /**
+     * @brief A hinge turns about one axis between two angles. A cone joint
+     * turns any way, as long as b's axis stays within maxAngle of a's.
+     */
+    enum class JointType : uint8_t { Hinge, Cone };
+
+    struct Joint {
+        JointType type;
+        bool enabled;
+        BodyId a, b;
+        glm::vec3 localPivotA, localPivotB;
+        glm::vec3 localAxisA, localAxisB;
+        glm::vec3 localReferenceA, localReferenceB; // Hinge: perpendicular to the axis; the angle is measured between them
+        float minAngle, maxAngle, friction;
+        // Solver state
+        float pointImpulse[3], swingImpulse[2], limitImpulse, frictionImpulse[3];
+        glm::vec3 rA, rB, error, swingError, swing[2], axis;    // Cone: axis is the one the axes bend apart about
+        float pointMass[3], swingMass[2], axialMass, frictionMass[3], angle, limitSign;
+    };
+
+    struct Island {
+        std::vector<BodyId> bodies;
+        std::vector<uint32_t> manifolds;
+        std::vector<uint32_t> joints;
+    };
+
+    void findPairs();
+    bool wakeTouched();
+    void collidePairs(JobSystem* jobs);
+    void buildIslands();
+    void solveIsland(Island& island, float dt);
+    void initBody(Body& body, const RigidBodyDesc& desc);
+    Joint coneJoint(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis, float coneAngle,
+                    float friction) const;
+    void refreshBody(Body& body);
+    void wakeIsland(uint32_t island);
+
+    const CollisionWorld* level = nullptr;
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    float accumulator = 0.0f;
+
+    std::vector<Body> bodies;
+    std::vector<Joint> joints;
+    std::unordered_set<uint64_t> jointed;   // Hinged body pairs, which do not collide; lower id in the high half
+    SpatialGrid bodyGrid;
+    std::vector<std::pair<BodyId, BodyId>> pairs;
+    std::vector<Manifold> manifolds;
+    std::unordered_map<uint64_t, uint32_t> previous;    // Pair key to index in previousManifolds
+    std::vector<Manifold> previousManifolds;
+    std::vector<Island> islands;            // The first islandCount are this step's; the rest keep their capacity
+    size_t islandCount = 0;
+    std::vector<AABB> bodyBounds;           // Scratch for findPairs()
+    std::vector<uint32_t> islandSlot;       // Scratch for buildIslands(): island of each root body
+    uint32_t nextIsland = 1;                // Island ids are never reused, so a sleeping island wakes alone
+    std::vector<uint32_t> islandParent;
+    PhysicsStats lastStats;
+};
+
+#endif // PHYSICS_H
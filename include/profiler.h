@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+/**
+ * @brief GPU time of a span of GL commands, read back without stalling
+ *
+ * Keeps a small ring of GL_TIMESTAMP query pairs and only reads results that
+ * are already available, so the reported time lags a few frames behind.
+ * Timestamps, unlike GL_TIME_ELAPSED, let one timer's span enclose
+ * another's, so a whole-frame timer can run around the section timers.
+ */
+class GpuTimer {
+public:
+    ~GpuTimer();
+
+    void create();
+    void begin();
+    void end();
+
+    float milliseconds() const { return averageMs; }
+
+private:
+    static const int QUERY_COUNT = 4;
+    GLuint queries[QUERY_COUNT * 2] = {};   // Start and end timestamp of each span
+    bool pending[QUERY_COUNT] = {};
+    int current = 0;
+    float averageMs = 0.0f;
+};
+
+/**
+ * @brief Frame timings, averaged over recent frames
+ *
+ * Named CPU sections are measured with ScopedCpuTimer; GPU sections are
+ * attached GpuTimers. Averages are exponential so they react within about
+ * half a second while ignoring single-frame spikes.
+ *
+ * Frame time runs from one beginFrame() to endFrame() and includes waiting
+ * for the swap. Work time is what the frame actually costs: the CPU time up
+ * to endWork(), called before the swap, or the GPU time of the attached
+ * frame timer, whichever is longer.
+ */
+class FrameProfiler {
+public:
+    struct Section {
+        std::string name;
+        float cpuMs = 0.0f;
+        GpuTimer* gpu = nullptr;
+    };
+
+    void beginFrame();
+    void endWork();
+    void endFrame();
+
+    int section(const std::string& name);
+    void addCpuSample(int section, float ms);
+    void attachGpuTimer(int section, GpuTimer* timer);
+    void attachFrameTimer(GpuTimer* timer) { frameGpu = timer; }
+
+    float frameMs() const { return averageFrameMs; }
+    float lastFrameMs() const { return latestFrameMs; }
+    float workMs() const;
+    float sectionMs(int section) const { return sections[section].cpuMs; }
+    void report(std::ostream& out) const;
+
+private:
+    std::vector<Section> sections;
+    std::chrono::steady_clock::time_point frameStart;
+    float averageFrameMs = 16.6f;
+    float latestFrameMs = 16.6f;
+    float averageWorkMs = 0.0f;
+    GpuTimer* frameGpu = nullptr;
+};
+
+/**
+ * @brief Adds the lifetime of this object to a profiler section
+ */
+class ScopedCpuTimer {
+public:
+    ScopedCpuTimer(FrameProfiler& profiler, int section)
+        : profiler(profiler), index(section), start(std::chrono::steady_clock::now()) {}
+    ~ScopedCpuTimer() {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        profiler.addCpuSample(index, elapsed.count());
+    }
+
+private:
+    FrameProfiler& profiler;
+    int index;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // PROFILER_H
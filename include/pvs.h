@@ -0,0 +1,87 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "mapped_file.h"
+
+class CollisionWorld;
+class JobSystem;
+
+/**
+ * @brief Cell an object is given when it is too big for one cell; always visible
+ */
+const int PVS_ALWAYS_VISIBLE = -1;
+
+/**
+ * @brief How a level is divided into cells and sampled
+ */
+struct PvsBakeOptions {
+    AABB bounds;                            // Region to divide; cameras outside it see everything
+    float cellSize = 4.0f;                  // Horizontal cell size; cells span the full height of the bounds
+    float margin = 1.0f;                    // Cells are grown by this much when sampled, so objects may overhang their cell
+    int samplesPerPair = 256;               // Rays tried between two cells before they are declared hidden
+    float sampleLow = 0.3f;                 // Height band, above the bounds' floor, that rays are cast between
+    float sampleHigh = 2.5f;
+};
+
+/**
+ * @brief Baked cell-to-cell visibility of the static level (".pvs")
+ *
+ * The baker divides the level into a grid of cells and, for every pair,
+ * casts rays between random points of the two against the static collision
+ * BVH; one unblocked ray makes the pair visible. Visibility is symmetric,
+ * and pairs are spread over the job system.
+ *
+ * Each cell's row of the visibility matrix is a bitset. Most rows repeat
+ * (every cell in open woods sees the same things), so the file stores each
+ * distinct row once and a row index per cell. The file is used through a
+ * read-only mapping: a query is one index load and one bit test, with no
+ * decoding. The same bytes can also be embedded in a level file and
+ * attached from that file's mapping.
+ */
+class PotentiallyVisibleSet {
+public:
+    static bool bake(const CollisionWorld& world, const PvsBakeOptions& options, JobSystem* jobs,
+                     std::vector<unsigned char>& out, std::string& error);
+    static bool bake(const CollisionWorld& world, const PvsBakeOptions& options, JobSystem* jobs,
+                     const std::string& path, std::string& error);
+
+    bool open(const std::string& path, std::string& error);
+    bool attach(const unsigned char* data, size_t size, std::string& error);
+    bool loaded() const { return rowIndex != nullptr; }
+
+    int cellAt(const glm::vec3& position) const;
+    int objectCell(const AABB& bounds) const;
+
+    /**
+     * @brief Whether anything in one cell may be seen from another
+     *
+     * Cells outside the grid, including PVS_ALWAYS_VISIBLE, are always visible.
+     */
+    bool visible(int fromCell, int toCell) const {
+        if (fromCell < 0 || toCell < 0) return true;
+        const uint64_t* row = rows + static_cast<size_t>(rowIndex[fromCell]) * rowWords;
+        return (row[toCell >> 6] >> (toCell & 63)) & 1u;
+    }
+    bool visible(const glm::vec3& from, const glm::vec3& to) const { return visible(cellAt(from), cellAt(to)); }
+
+    int cellCount() const { return cellsX * cellsZ; }
+    size_t uniqueRows() const { return rowCount; }
+
+private:
+    MappedFile file;
+    glm::vec3 origin = glm::vec3(0.0f);
+    float cellSize = 1.0f;
+    float margin = 0.0f;
+    int cellsX = 0, cellsZ = 0;
+    uint32_t rowWords = 0;
+    size_t rowCount = 0;
+    const uint32_t* rowIndex = nullptr;
+    const uint64_t* rows = nullptr;
+};
+
+#endif // PVS_H
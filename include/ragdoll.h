@@ -0,0 +1,146 @@
+#ifndef RAGDOLL_H
+#define RAGDOLL_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "bvh.h"
+#include "gltf.h"
+#include "physics.h"
+
+using RagdollId = uint32_t;
+const RagdollId NO_RAGDOLL = 0xFFFFFFFFu;
+
+/**
+ * @brief Collision group of the first ragdoll slot; each slot has its own, so a ragdoll's limbs pass through each other
+ */
+const uint32_t RAGDOLL_GROUP_BASE = 0x10000;
+
+/**
+ * @brief Seconds a ragdoll falls before it may be frozen to make room, so none freezes standing
+ */
+const float RAGDOLL_MIN_AGE = 1.0f;
+
+/**
+ * @brief A bone of a ragdoll template, moved by the body it belongs to
+ */
+struct RagdollBone {
+    std::string name;
+    int parent;                             // Bone index, or -1
+    glm::mat4 bind;                         // Model-space bone matrix
+    int body;                               // Body that carries it: its own, or an ancestor's
+};
+
+/**
+ * @brief A body of a ragdoll template, in model space in the bind pose
+ */
+struct RagdollBody {
+    int bone;                               // Bone it stands in for
+    int parent;                             // Body it hangs from, or -1 for the root
+    CollisionShape shape;                   // In model units
+    glm::vec3 center;
+    glm::quat rotation;                     // A capsule lies along its Y
+    float mass;
+    glm::vec3 pivot;                        // Where it joins its parent
+    glm::vec3 axis;                         // Rest direction of the limb, the middle of its cone
+};
+
+/**
+ * @brief Bodies and joints for one kind of monster, built from its skeleton
+ *
+ * Bodies are listed parents first. Bones too short for a body of their own,
+ * such as fingers, ride on the nearest ancestor that has one, so a detailed
+ * skeleton does not blow the body budget.
+ */
+struct RagdollTemplate {
+    std::vector<RagdollBone> bones;
+    std::vector<RagdollBody> bodies;
+    float coneAngle = 0.8f;                 // How far a limb may bend from its rest direction, in radians
+    float jointFriction = 2.0f;             // N·m, so limbs flop and settle instead of swinging
+
+    void fromSkeleton(const std::vector<SceneNode>& nodes, const Skin& skin, float mass);
+    void fromBounds(const AABB& modelBounds, float mass);
+};
+
+/**
+ * @brief Counters for the ragdolls
+ */
+struct RagdollStats {
+    size_t active = 0, frozen = 0;
+    size_t waiting = 0;                     // Spawned while the pool had no room to give
+    size_t bodies = 0, bodyBudget = 0;      // Pooled bodies in use, and in the pool
+    size_t joints = 0, jointBudget = 0;
+    size_t frozenForBudget = 0;             // Since creation, frozen to make room for newer ones
+};
+
+/**
+ * @brief Ragdolls for killed monsters, drawn from a fixed pool of bodies and joints
+ *
+ * create() adds the whole budget of bodies and joints to the physics world
+ * up front, disabled; a ragdoll takes what it needs from the pool and
+ * gives it back when it goes, so killing monsters never grows the world or
+ * allocates. When a ragdoll needs more than the pool has left, the oldest
+ * ragdolls are frozen: they keep their last pose as a static one, costing
+ * nothing, and return their bodies and joints. Those already asleep go
+ * first, then those that have fallen for RAGDOLL_MIN_AGE; if none can go,
+ * the new ragdoll waits in its dying pose until one can. A mass kill
+ * therefore never simulates more than the budget.
+ *
+ * Each ragdoll is its own island in the physics world, so the world's
+ * update solves them in parallel on the job system. update() only reads
+ * the bodies back into bone poses.
+ */
+class RagdollSystem {
+public:
+    void create(PhysicsWorld* world, size_t bodyBudget, size_t jointBudget, size_t maxRagdolls);
+    void reserve(const RagdollTemplate& ragdoll);
+
+    RagdollId spawn(const RagdollTemplate& ragdoll, const glm::mat4& transform, const glm::vec3& velocity);
+    void release(RagdollId id);
+    void update(float elapsed);
+
+    bool frozen(RagdollId id) const { return ragdolls[id].frozen; }
+    bool waiting(RagdollId id) const { return ragdolls[id].waiting; }
+    const std::vector<glm::mat4>& pose(RagdollId id) const { return ragdolls[id].pose; }
+    glm::mat4 carried(RagdollId id, int bone) const;
+    const AABB& bounds(RagdollId id) const { return ragdolls[id].bounds; }
+
+    const RagdollStats& stats() const { return currentStats; }
+    void report(std::ostream& out) const;
+
+private:
+    struct Ragdoll {
+        const RagdollTemplate* ragdoll = nullptr;   // Null for a free slot
+        bool frozen = false;
+        bool waiting = false;
+        uint64_t born = 0;
+        float age = 0.0f;                       // Seconds simulated
+        glm::mat4 transform;                    // Spawn placement, kept while waiting
+        glm::vec3 velocity;
+        std::vector<BodyId> bodies;             // Per template body, while active
+        std::vector<uint32_t> joints;
+        std::vector<glm::mat4> boneFromBody;    // Per bone: its matrix relative to its body's
+        std::vector<glm::mat4> pose;            // Per bone, world space
+        AABB bounds;
+    };
+
+    bool activate(Ragdoll& ragdoll, RagdollId id);
+    bool makeRoom(size_t bodyCount, size_t jointCount);
+    void freeze(Ragdoll& ragdoll);
+    void giveBack(Ragdoll& ragdoll);
+    void readPose(Ragdoll& ragdoll);
+
+    PhysicsWorld* world = nullptr;
+    std::vector<Ragdoll> ragdolls;
+    std::vector<RagdollId> freeRagdolls;
+    std::vector<RagdollId> queue;               // Waiting, oldest first
+    std::vector<BodyId> freeBodies;
+    std::vector<uint32_t> freeJoints;
+    uint64_t spawned = 0;
+    RagdollStats currentStats;
+};
+
+#endif // RAGDOLL_H
@@ -0,0 +1,39 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+/**
+ * @brief Off-screen target the scene is rendered into
+ *
+ * Color and depth are textures so later passes (transparency, decals,
+ * post effects) can attach or sample them. The result is blitted to the
+ * window at the end of the frame.
+ */
+class SceneTarget {
+public:
+    ~SceneTarget();
+
+    void resize(int width, int height);
+    void bind() const;
+    void blitToScreen() const;
+
+    GLuint framebuffer() const { return fbo; }
+    GLuint colorTexture() const { return color; }
+    GLuint depthTexture() const { return depth; }
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+private:
+    void release();
+
+    GLuint fbo = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+};
+
+void drawFullscreenTriangle();
+
+#endif // RENDER_TARGET_H
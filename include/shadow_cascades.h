@@ -0,0 +1,90 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "bvh.h"
+
+/**
+ * @brief Texture unit of the moonlight shadow map array
+ */
+const GLuint MOON_SHADOW_UNIT = 6;
+
+/**
+ * @brief Cascade layout: count, resolution of each layer and how far shadows reach
+ */
+const int SHADOW_CASCADE_COUNT = 4;
+const int SHADOW_CASCADE_SIZE = 2048;
+const float SHADOW_DISTANCE = 60.0f;
+
+/**
+ * @brief Cascaded shadow maps for the directional moonlight
+ *
+ * The view frustum up to SHADOW_DISTANCE is split into slices, closer ones
+ * smaller, and each slice gets one layer of a depth texture array. A layer
+ * covers the bounding sphere of its slice, so its size does not change as
+ * the camera turns, and its origin is snapped to whole shadow texels in a
+ * fixed light space; together these keep shadow edges from shimmering as
+ * the player moves.
+ *
+ * Casters are culled per cascade with a BVH over their bounds, against the
+ * cascade's box in light space stretched towards the moon, and the depth
+ * range is fitted to the casters that survive. The near cascades are
+ * redrawn every frame and the far ones every few frames, staggered so no
+ * two share a frame; a far cascade is redrawn early only once the view
+ * leaves the area it covers. The shader picks the first cascade that covers
+ * a fragment using each cascade's own matrix, so a cascade drawn a few
+ * frames ago is still sampled consistently.
+ */
+class ShadowCascades {
+public:
+    glm::vec3 direction = glm::normalize(glm::vec3(-0.35f, 0.8f, -0.5f));  // Towards the moon
+    glm::vec3 color = glm::vec3(0.55f, 0.62f, 0.8f);
+    float intensity = 0.35f;
+
+    ~ShadowCascades();
+
+    void create();
+    void setCasters(const std::vector<AABB>& bounds);
+    void moveCasters(const std::vector<AABB>& bounds);
+    size_t casterCount() const { return casterBounds.size(); }
+    void update(const glm::mat4& view, float fovY, float aspect, float nearPlane);
+    void render(GLuint depthProgram, const std::function<void(uint32_t caster, GLint modelLoc)>& drawCaster);
+    void apply(GLuint program) const;
+
+    bool created() const { return shadowMap != 0; }
+    void report(std::ostream& out) const;
+
+private:
+    struct Cascade {
+        float splitNear = 0.0f, splitFar = 0.0f;
+        float radius = 0.0f;                // Bounding sphere of the slice, padded for far cascades
+        glm::vec3 center = glm::vec3(0.0f); // Sphere centre when last drawn
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        float texelWorldSize = 0.0f;
+        int interval = 1;                   // Redrawn every this many frames
+        bool valid = false;                 // Drawn at least once
+        bool due = false;                   // Drawn this frame
+        std::vector<uint32_t> casters;      // Survivors of this frame's culling
+    };
+
+    void fit(Cascade& cascade, const glm::vec3& center);
+
+    Cascade cascades[SHADOW_CASCADE_COUNT];
+    std::vector<AABB> casterBounds;
+    Bvh casterHierarchy;
+    glm::mat4 lightView = glm::mat4(1.0f);
+    uint64_t frame = 0;
+
+    // Totals for report()
+    uint64_t framesCounted = 0, cascadesDrawn = 0, castersDrawn = 0, earlyRedraws = 0;
+
+    GLuint shadowMap = 0;
+    GLuint framebuffers[SHADOW_CASCADE_COUNT] = {};
+};
+
+#endif // SHADOW_CASCADES_H
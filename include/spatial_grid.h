@@ -0,0 +1,70 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+
+/**
+ * @brief Uniform grid over the ground plane for broad-phase queries
+ *
+ * Items are boxes, bucketed into every cell their XZ footprint touches.
+ * Buckets are stored compressed: `cellStart[c]` to `cellStart[c + 1]` is the
+ * range of `items` in cell c, so a build is a counting sort and the arrays
+ * can be saved and loaded as they are. Items outside the grid are clamped
+ * into the border cells.
+ *
+ * An item spanning several cells is reported once per query, from the first
+ * cell shared by the item and the query, so queries need no scratch state
+ * and can run on several threads at once.
+ */
+class SpatialGrid {
+public:
+    void build(const std::vector<AABB>& boxes, float cellSize);
+    void assign(const glm::vec3& origin, float cellSize, int cellsX, int cellsZ, const uint32_t* cellStart,
+                const uint32_t* items, size_t itemCount, const AABB* boxes, size_t boxCount);
+    void clear();
+
+    /**
+     * @brief Visit every item whose box overlaps the given box
+     */
+    template <typename Visitor>
+    void query(const AABB& box, Visitor&& visit) const;
+
+    bool empty() const { return bounds.empty(); }
+    int cellX(float x) const { return std::min(cellsX - 1, std::max(0, static_cast<int>(std::floor((x - origin.x) / cellSize)))); }
+    int cellZ(float z) const { return std::min(cellsZ - 1, std::max(0, static_cast<int>(std::floor((z - origin.z) / cellSize)))); }
+
+    glm::vec3 origin = glm::vec3(0.0f);
+    float cellSize = 1.0f;
+    int cellsX = 0, cellsZ = 0;
+    std::vector<uint32_t> cellStart;        // cellsX * cellsZ + 1 entries
+    std::vector<uint32_t> items;
+    std::vector<AABB> bounds;               // Per item
+    std::vector<uint32_t> fill;             // Scratch for build(), kept so rebuilding does not allocate
+};
+
+template <typename Visitor>
+void SpatialGrid::query(const AABB& box, Visitor&& visit) const {
+    if (bounds.empty()) return;
+    int x0 = cellX(box.min.x), x1 = cellX(box.max.x);
+    int z0 = cellZ(box.min.z), z1 = cellZ(box.max.z);
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            int cell = z * cellsX + x;
+            for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+                uint32_t item = items[i];
+                const AABB& itemBox = bounds[item];
+                if (!itemBox.overlaps(box)) continue;
+                // Report from the first cell both ranges share only
+                if (std::max(cellX(itemBox.min.x), x0) != x || std::max(cellZ(itemBox.min.z), z0) != z) continue;
+                visit(item);
+            }
+        }
+    }
+}
+
+#endif // SPATIAL_GRID_H
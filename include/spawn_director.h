@@ -0,0 +1,107 @@
+#ifndef SPAWN_DIRECTOR_H
+#define SPAWN_DIRECTOR_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include "entity_pool.h"
+
+/**
+ * @brief Tuning of the spawn director
+ */
+struct SpawnDirectorSettings {
+    float intensity = 4.0f;                 // Living monsters wanted within nearRadius of the player
+    float nearRadius = 20.0f;
+    float spawnRadiusMin = 10.0f, spawnRadiusMax = 18.0f;
+    float despawnRadius = 35.0f;            // Unseen monsters farther than this go at once
+    float unseenSeconds = 6.0f;             // Unseen this long, living monsters beyond nearRadius and corpses anywhere go
+    float spawnInterval = 1.0f;             // Seconds between spawns
+    float ground = 0.0f;                    // Height of spawn points
+    int spawnAttempts = 8;                  // Spots tried per spawn, the first half behind the player
+    uint32_t minMonsters = 1;               // Throttling never takes the cap below this
+    uint32_t maxMonsters = 32;
+    float frameBudgetMs = 14.0f;            // CPU or GPU work per frame, leaving headroom under one 60 Hz refresh
+    float adjustInterval = 0.5f;            // Seconds between cap adjustments
+};
+
+/**
+ * @brief What the director needs to know about one pooled monster this frame
+ */
+struct DirectedMonster {
+    EntityHandle entity;
+    glm::vec3 position;
+    bool seen;                              // In the camera's view and not hidden by the PVS
+    bool dead;
+};
+
+/**
+ * @brief Counters for the director
+ */
+struct SpawnDirectorStats {
+    uint32_t living = 0, corpses = 0;
+    uint32_t near = 0;                      // Living within nearRadius
+    uint32_t cap = 0;                       // Most monsters, living or dead, the frame budget allows now
+    float workMs = 0.0f;
+    uint64_t spawned = 0;
+    uint64_t blocked = 0;                   // Spawns skipped because no spot passed the test
+    uint64_t despawnedFar = 0, despawnedUnseen = 0, despawnedBudget = 0;
+};
+
+/**
+ * @brief Keeps a steady number of monsters around the player within the frame budget
+ *
+ * Each update the director compares the living monsters near the player
+ * with the wanted intensity and asks for at most one new monster, at a
+ * spot on a ring around the player. The caller's test decides whether a
+ * spot is usable; the game accepts only spots the camera cannot see,
+ * either out of view or in a cell the PVS hides, so monsters never pop in
+ * on screen. Spots behind the player are tried first.
+ *
+ * Monsters the camera has not seen for a while are removed: far ones at
+ * once, living ones beyond nearRadius and corpses after unseenSeconds.
+ * Visible monsters are never removed.
+ *
+ * Monster count drives most of the frame cost, so the director caps it from
+ * the profiler's work time, the CPU or GPU cost of a frame without the swap
+ * wait so vsync does not read as load. Additive increase and multiplicative
+ * decrease: over budget the cap drops by a quarter, and unseen monsters are
+ * removed down to it, corpses and the farthest first; comfortably under
+ * budget while the cap is what holds monsters back, it grows by one. A slow
+ * machine settles on fewer monsters instead of a lower frame rate.
+ */
+class SpawnDirector {
+public:
+    using SpotTest = std::function<bool(const glm::vec3& position)>;
+
+    void create(const SpawnDirectorSettings& settings, uint32_t capacity, uint32_t seed);
+    void update(float elapsed, float workMs, const glm::vec3& player, const glm::vec3& front,
+                const std::vector<DirectedMonster>& monsters, const SpotTest& canSpawn);
+
+    const std::vector<EntityHandle>& despawns() const { return despawnList; }
+    const std::vector<glm::vec3>& spawns() const { return spawnList; }
+    uint32_t cap() const { return currentCap; }
+
+    const SpawnDirectorStats& stats() const { return currentStats; }
+    void report(std::ostream& out) const;
+
+private:
+    void throttle(float elapsed, float workMs, uint32_t total);
+    void spawnNear(const glm::vec3& player, const glm::vec3& front, const SpotTest& canSpawn);
+
+    SpawnDirectorSettings settings;
+    std::vector<float> unseenTime;          // Per pool slot
+    std::vector<uint32_t> unseenGeneration; // Per pool slot: the occupant unseenTime belongs to
+    std::vector<std::pair<float, uint32_t>> candidates; // Scratch: removal order and index into monsters
+    std::vector<EntityHandle> despawnList;
+    std::vector<glm::vec3> spawnList;
+    std::minstd_rand rng;
+    uint32_t currentCap = 0;
+    float cooldown = 0.0f;
+    float sinceAdjust = 0.0f;
+    SpawnDirectorStats currentStats;
+};
+
+#endif // SPAWN_DIRECTOR_H
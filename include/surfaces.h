@@ -0,0 +1,71 @@
+#ifndef SURFACES_H
+#define SURFACES_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "model_loader.h"
+
+class JobSystem;
+
+/**
+ * @brief Where the cooked surface textures live
+ */
+const char* const WOODS_GROUND_TEXTURE = "../assets/virtual/woods_ground.vt";
+const char* const HOUSE_WALLS_TEXTURE = "../assets/virtual/house_walls.vt";
+
+/**
+ * @brief Size of the surfaces in metres; the textures hold 128 texels per metre
+ */
+const float WOODS_GROUND_SIZE = 64.0f;
+const float HOUSE_WALLS_PERIMETER = 64.0f;
+const float HOUSE_WALLS_TEXTURE_HEIGHT = 4.0f;
+
+/**
+ * @brief The doorway out of the house, where the door hangs
+ */
+const float HOUSE_NEAR_Z = -7.0f;           // Inside face of the wall with the door, facing the woods
+const float HOUSE_WALL_THICKNESS = 0.15f;
+const float HOUSE_DOOR_HALF_WIDTH = 1.5f;
+const float HOUSE_DOOR_HEIGHT = 2.2f;
+
+/**
+ * @brief Large static surfaces: the woods ground and the house walls, and the boxes of props
+ *
+ * Plain quads in ModelVertex format, built once on the CPU. Their texture
+ * coordinates span the whole surface, so each one is textured by a single
+ * virtual texture instead of a tiling image.
+ */
+class SurfaceMesh {
+public:
+    ~SurfaceMesh();
+
+    void addQuad(const glm::vec3& origin, const glm::vec3& edgeU, const glm::vec3& edgeV,
+                 const glm::vec2& uvOrigin, const glm::vec2& uvExtent);
+    void create();
+    void draw(GLint modelLoc, const glm::mat4& transform) const;
+    bool created() const { return VAO != 0; }
+
+    void addCollider(const AABB& collider) { colliders.push_back(collider); }
+
+    const AABB& bounds() const { return box; }
+    const std::vector<AABB>& collisionBoxes() const { return colliders; }
+
+private:
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<GLuint> indices;
+    std::vector<AABB> colliders;            // Solid volumes behind the quads, for the collision world
+    AABB box;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+};
+
+void buildWoodsGround(SurfaceMesh& mesh, float floorHeight);
+void buildHouseWalls(SurfaceMesh& mesh, float floorHeight);
+void buildPropBox(SurfaceMesh& mesh, const glm::vec3& halfExtents, float u);
+
+bool cookSurfaceTextures(JobSystem* jobs);
+
+#endif // SURFACES_H
@@ -0,0 +1,67 @@
+#ifndef TEXTURE_COOK_H
+#define TEXTURE_COOK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "image_decoder.h"
+#include "mapped_file.h"
+
+class JobSystem;
+
+enum class MipFilter { Box, Kaiser };
+
+/**
+ * @brief How a mip chain is filtered
+ */
+struct MipOptions {
+    MipFilter filter = MipFilter::Kaiser;
+    bool gammaCorrect = true;               // Filter color in linear space; alpha is always linear
+    float alphaCutoff = 0.5f;               // Alpha-test reference whose coverage is kept per level; 0 disables
+};
+
+/**
+ * @brief A cooked texture file mapped for upload
+ *
+ * The pixels of all levels follow each other, largest first, and point
+ * into the mapping.
+ */
+struct CookedTexture {
+    MappedFile file;
+    ImageInfo info;                         // Level 0; always RGB(A) order
+    int levels = 0;
+    const unsigned char* pixels = nullptr;
+};
+
+/**
+ * @brief Offline mip chain generation and the cooked texture format (".tex")
+ *
+ * Each level is filtered from the previous one in 32-bit float with a
+ * separable, wrapping kernel: a 2x2 box or a Kaiser-windowed sinc. Color is
+ * converted from sRGB to linear before filtering and back after, and for
+ * textures with alpha the alpha of each level is rescaled so the fraction
+ * of texels passing the alpha test matches level 0.
+ *
+ * A .tex file holds every level uncompressed, so loading one is a mapped
+ * read and a glTexImage2D per level, with no decode or mip generation.
+ */
+namespace texture_cook {
+
+int levelCount(int width, int height);
+ImageInfo levelInfo(const ImageInfo& base, int level);
+size_t chainSize(const ImageInfo& base, int levels);
+
+void generateMips(const ImageInfo& info, const unsigned char* pixels, const MipOptions& options,
+                  ImageInfo& outInfo, std::vector<unsigned char>& chain);
+
+bool writeFile(const std::string& path, const ImageInfo& info, int levels, const std::vector<unsigned char>& chain,
+               std::string& error);
+bool readFile(const std::string& path, CookedTexture& texture, std::string& error);
+
+std::string cookedPath(const std::string& imagePath);
+bool cookFile(const std::string& imagePath, const MipOptions& options, std::string& error);
+bool cookFiles(const std::vector<std::string>& imagePaths, const MipOptions& options, JobSystem* jobs);
+
+} // namespace texture_cook
+
+#endif // TEXTURE_COOK_H
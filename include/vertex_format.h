@@ -0,0 +1,358 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "bvh.h"
+
+/**
+ * @brief Source streams a vertex format packs from
+ *
+ * Importers (Assimp, glTF) fill whichever streams they have; missing streams
+ * are null and the attributes that read them write zeros.
+ */
+struct VertexSource {
+    size_t count = 0;
+    const glm::vec3* positions = nullptr;
+    const glm::vec3* normals = nullptr;
+    const glm::vec2* texCoords = nullptr;
+    const glm::vec2* lightmapCoords = nullptr;
+    const glm::uvec4* joints = nullptr;
+    const glm::vec4* weights = nullptr;
+    AABB bounds;                            // Used by quantized positions
+};
+
+namespace vertex_attrib {
+
+/**
+ * @brief Convert a float to IEEE half precision (round to nearest, no denormals)
+ */
+inline uint16_t toHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (exponent <= 0) return static_cast<uint16_t>(sign);
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00u);
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u) half++; // Round to nearest
+    return static_cast<uint16_t>(half);
+}
+
+inline int16_t toSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint8_t toUnorm8(float value) {
+    return static_cast<uint8_t>(std::lround(glm::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+/**
+ * @brief Pack a unit vector into GL_INT_2_10_10_10_REV
+ */
+inline uint32_t toSnorm1010102(const glm::vec3& v) {
+    auto component = [](float f) { return static_cast<uint32_t>(std::lround(glm::clamp(f, -1.0f, 1.0f) * 511.0f)) & 0x3FFu; };
+    return component(v.x) | (component(v.y) << 10) | (component(v.z) << 20);
+}
+
+// Each attribute declares its GL storage, its GLSL input type and how it packs
+// one vertex. `location` in the generated GLSL is the attribute's position in
+// the format. `integer` attributes use glVertexAttribIPointer.
+
+struct PositionF32 {
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr GLint components = 3;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 3 * sizeof(float);
+    static constexpr const char* glslType = "vec3";
+    static constexpr const char* name = "aPos";
+    static constexpr const char* define = nullptr;
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        std::memcpy(out, &src.positions[i], size);
+    }
+};
+
+/**
+ * @brief Position quantized to 16-bit snorm within the mesh bounds
+ *
+ * The shader maps it back with the positionScale/positionBias uniforms,
+ * see quantizedPositionScale().
+ */
+struct PositionSnorm16 {
+    static constexpr GLenum type = GL_SHORT;
+    static constexpr GLint components = 4;
+    static constexpr GLboolean normalized = GL_TRUE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 4 * sizeof(int16_t);
+    static constexpr const char* glslType = "vec4";
+    static constexpr const char* name = "aPosQuantized";
+    static constexpr const char* define = "VERTEX_QUANTIZED_POSITION";
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec3 center = src.bounds.center();
+        glm::vec3 halfExtent = glm::max(src.bounds.extent() * 0.5f, glm::vec3(1e-6f));
+        glm::vec3 unit = (src.positions[i] - center) / halfExtent;
+        int16_t q[4] = {toSnorm16(unit.x), toSnorm16(unit.y), toSnorm16(unit.z), 0};
+        std::memcpy(out, q, size);
+    }
+};
+
+struct NormalF32 {
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr GLint components = 3;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 3 * sizeof(float);
+    static constexpr const char* glslType = "vec3";
+    static constexpr const char* name = "aNormal";
+    static constexpr const char* define = nullptr;
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec3 n = src.normals ? src.normals[i] : glm::vec3(0.0f);
+        std::memcpy(out, &n, size);
+    }
+};
+
+struct NormalPacked1010102 {
+    static constexpr GLenum type = GL_INT_2_10_10_10_REV;
+    static constexpr GLint components = 4;
+    static constexpr GLboolean normalized = GL_TRUE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = sizeof(uint32_t);
+    static constexpr const char* glslType = "vec4";
+    static constexpr const char* name = "aNormalPacked";
+    static constexpr const char* define = "VERTEX_PACKED_NORMAL";
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        uint32_t packed = toSnorm1010102(src.normals ? src.normals[i] : glm::vec3(0.0f));
+        std::memcpy(out, &packed, size);
+    }
+};
+
+struct TexCoordF32 {
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr GLint components = 2;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 2 * sizeof(float);
+    static constexpr const char* glslType = "vec2";
+    static constexpr const char* name = "aTexCoord";
+    static constexpr const char* define = nullptr;
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec2 uv = src.texCoords ? src.texCoords[i] : glm::vec2(0.0f);
+        std::memcpy(out, &uv, size);
+    }
+};
+
+struct TexCoordF16 {
+    static constexpr GLenum type = GL_HALF_FLOAT;
+    static constexpr GLint components = 2;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 2 * sizeof(uint16_t);
+    static constexpr const char* glslType = "vec2";
+    static constexpr const char* name = "aTexCoord";
+    static constexpr const char* define = nullptr;
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec2 uv = src.texCoords ? src.texCoords[i] : glm::vec2(0.0f);
+        uint16_t h[2] = {toHalf(uv.x), toHalf(uv.y)};
+        std::memcpy(out, h, size);
+    }
+};
+
+struct LightmapCoordF32 {
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr GLint components = 2;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 2 * sizeof(float);
+    static constexpr const char* glslType = "vec2";
+    static constexpr const char* name = "aLightmapCoord";
+    static constexpr const char* define = "VERTEX_LIGHTMAP";
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec2 uv = src.lightmapCoords ? src.lightmapCoords[i] : glm::vec2(0.0f);
+        std::memcpy(out, &uv, size);
+    }
+};
+
+struct JointsU8 {
+    static constexpr GLenum type = GL_UNSIGNED_BYTE;
+    static constexpr GLint components = 4;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = true;
+    static constexpr size_t size = 4;
+    static constexpr const char* glslType = "uvec4";
+    static constexpr const char* name = "aJoints";
+    static constexpr const char* define = "VERTEX_SKINNED";
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::uvec4 j = src.joints ? src.joints[i] : glm::uvec4(0u);
+        for (int c = 0; c < 4; c++) out[c] = static_cast<unsigned char>(j[c]);
+    }
+};
+
+struct WeightsUnorm8 {
+    static constexpr GLenum type = GL_UNSIGNED_BYTE;
+    static constexpr GLint components = 4;
+    static constexpr GLboolean normalized = GL_TRUE;
+    static constexpr bool integer = false;
+    static constexpr size_t size = 4;
+    static constexpr const char* glslType = "vec4";
+    static constexpr const char* name = "aWeights";
+    static constexpr const char* define = nullptr;
+    static void pack(const VertexSource& src, size_t i, unsigned char* out) {
+        glm::vec4 w = src.weights ? src.weights[i] : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+        for (int c = 0; c < 4; c++) out[c] = toUnorm8(w[c]);
+    }
+};
+
+} // namespace vertex_attrib
+
+/**
+ * @brief A vertex layout declared once, at compile time
+ *
+ * @tparam Attribs Attribute descriptors from vertex_attrib, in location order
+ *
+ * The same list generates the interleaved packing loop, the VAO attribute
+ * setup and the GLSL input block, so the three can no longer drift apart.
+ * Every format is its own type: packing a quantized or skinned mesh is a
+ * straight-line loop with no per-vertex branching on the layout.
+ */
+template <typename... Attribs>
+struct VertexFormat {
+    static constexpr size_t attributeCount = sizeof...(Attribs);
+    static constexpr size_t stride = (Attribs::size + ... + 0);
+
+    /**
+     * @brief Byte offset of the attribute at a location
+     */
+    static constexpr size_t offset(size_t location) {
+        constexpr size_t sizes[] = {Attribs::size...};
+        size_t result = 0;
+        for (size_t i = 0; i < location; i++) result += sizes[i];
+        return result;
+    }
+
+    /**
+     * @brief Whether the attribute at a location has exactly this encoding
+     *
+     * Lets importers tell when a file's vertex data can be uploaded as-is.
+     */
+    static constexpr bool attributeMatches(size_t location, GLenum type, GLint components, bool normalized) {
+        constexpr GLenum types[] = {Attribs::type...};
+        constexpr GLint counts[] = {Attribs::components...};
+        constexpr bool norms[] = {(Attribs::normalized == GL_TRUE)...};
+        return location < attributeCount && types[location] == type && counts[location] == components &&
+               norms[location] == normalized;
+    }
+
+    /**
+     * @brief Interleave the source streams into this layout
+     *
+     * @param src Source streams
+     * @param out Receives src.count * stride bytes
+     */
+    static void pack(const VertexSource& src, std::vector<unsigned char>& out) {
+        out.resize(src.count * stride);
+        unsigned char* dst = out.data();
+        for (size_t i = 0; i < src.count; i++) {
+            unsigned char* cursor = dst + i * stride;
+            ((Attribs::pack(src, i, cursor), cursor += Attribs::size), ...);
+        }
+    }
+
+    /**
+     * @brief Describe this layout to the bound VAO, reading from the bound GL_ARRAY_BUFFER
+     */
+    static void setupAttributes() {
+        GLuint location = 0;
+        (setupAttribute<Attribs>(location++), ...);
+    }
+
+    /**
+     * @brief Describe this layout on a VAO with direct state access (GL 4.5)
+     *
+     * @param vao Vertex array object
+     * @param binding Vertex buffer binding index the attributes read from
+     */
+    static void setupAttributesDSA(GLuint vao, GLuint binding) {
+        GLuint location = 0;
+        (setupAttributeDSA<Attribs>(vao, binding, location++), ...);
+    }
+
+    /**
+     * @brief The one VAO all buffers in this format share on the DSA path
+     *
+     * The attribute layout is set once; meshes only swap the buffer bound to
+     * binding 0 and the element buffer. Lives as long as the GL context.
+     */
+    static GLuint sharedVertexArray() {
+        static GLuint vao = 0;
+        if (!vao) {
+            glCreateVertexArrays(1, &vao);
+            setupAttributesDSA(vao, 0);
+        }
+        return vao;
+    }
+
+    /**
+     * @brief GLSL declarations of the vertex inputs, plus the feature defines
+     *
+     * Prepended to vertex shaders through createShaderProgram's defines.
+     */
+    static std::string glslInputs() {
+        std::string block;
+        int location = 0;
+        ((block += Attribs::define ? std::string("#define ") + Attribs::define + "\n" : std::string()), ...);
+        ((block += "layout (location = " + std::to_string(location++) + ") in " + Attribs::glslType + " " + Attribs::name + ";\n"), ...);
+        return block;
+    }
+
+private:
+    template <typename A>
+    static void setupAttribute(GLuint location) {
+        const void* pointer = reinterpret_cast<const void*>(offset(location));
+        if (A::integer) {
+            glVertexAttribIPointer(location, A::components, A::type, stride, pointer);
+        } else {
+            glVertexAttribPointer(location, A::components, A::type, A::normalized, stride, pointer);
+        }
+        glEnableVertexAttribArray(location);
+    }
+
+    template <typename A>
+    static void setupAttributeDSA(GLuint vao, GLuint binding, GLuint location) {
+        if (A::integer) {
+            glVertexArrayAttribIFormat(vao, location, A::components, A::type, static_cast<GLuint>(offset(location)));
+        } else {
+            glVertexArrayAttribFormat(vao, location, A::components, A::type, A::normalized, static_cast<GLuint>(offset(location)));
+        }
+        glVertexArrayAttribBinding(vao, location, binding);
+        glEnableVertexArrayAttrib(vao, location);
+    }
+};
+
+// Formats used by the game. Locations 0-2 keep their meaning across formats
+// so the same shaders work with any of them.
+using StandardVertex = VertexFormat<vertex_attrib::PositionF32, vertex_attrib::NormalF32, vertex_attrib::TexCoordF32>;
+using QuantizedVertex = VertexFormat<vertex_attrib::PositionSnorm16, vertex_attrib::NormalPacked1010102, vertex_attrib::TexCoordF16>;
+using SkinnedVertex = VertexFormat<vertex_attrib::PositionF32, vertex_attrib::NormalF32, vertex_attrib::TexCoordF32,
+                                   vertex_attrib::JointsU8, vertex_attrib::WeightsUnorm8>;
+using LightmappedVertex = VertexFormat<vertex_attrib::PositionF32, vertex_attrib::NormalF32, vertex_attrib::TexCoordF32,
+                                       vertex_attrib::LightmapCoordF32>;
+
+/**
+ * @brief Scale that maps QuantizedVertex positions back to object space
+ *
+ * @param bounds Bounds the mesh was quantized against
+ * @return glm::vec3 Half extent of the bounds; the matching bias is bounds.center()
+ */
+inline glm::vec3 quantizedPositionScale(const AABB& bounds) {
+    return glm::max(bounds.extent() * 0.5f, glm::vec3(1e-6f));
+}
+
+#endif // VERTEX_FORMAT_H
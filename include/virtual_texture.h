@@ -0,0 +1,184 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "async_io.h"
+#include "image_decoder.h"
+#include "job_system.h"
+
+/**
+ * @brief Texture units used by the VIRTUAL_TEXTURE permutation
+ */
+const GLuint VIRTUAL_PAGE_TABLE_UNIT = 4;
+const GLuint VIRTUAL_CACHE_UNIT = 5;
+
+/**
+ * @brief Tile layout written by the cooker
+ *
+ * Each tile stores its content plus a border copied from its neighbours,
+ * so bilinear filtering inside the physical cache never reads another tile.
+ */
+const int VIRTUAL_TILE_SIZE = 128;
+const int VIRTUAL_TILE_BORDER = 4;
+
+/**
+ * @brief Physical tiles per side of each texture's cache; fixes its memory
+ */
+const int VIRTUAL_CACHE_TILES = 16;
+
+/**
+ * @brief Feedback is rendered at the window size divided by this
+ */
+const int VIRTUAL_FEEDBACK_DIVISOR = 8;
+
+/**
+ * @brief A rectangle of one mip level to be filled by a VirtualTexelSource
+ *
+ * Coordinates are texels of that level and extend past its edges by the
+ * tile border; the source decides what lies beyond. A level is never
+ * smaller than one tile, so once one side reaches the tile size it stops
+ * shrinking while the other side keeps halving.
+ */
+struct VirtualTexelRect {
+    int level = 0;
+    int levelWidth = 0, levelHeight = 0;
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+};
+
+/**
+ * @brief Fills a rectangle with tightly packed RGB texels; called from worker threads
+ */
+using VirtualTexelSource = std::function<void(const VirtualTexelRect& rect, unsigned char* rgb)>;
+
+bool cookVirtualTexture(const std::string& path, int width, int height, const VirtualTexelSource& source,
+                        JobSystem* jobs, std::string& error);
+
+/**
+ * @brief A sparse virtual texture streamed into a fixed-size tile cache
+ *
+ * The texture lives on disk as a ".vt" archive of encoded tiles for every
+ * mip level. Only tiles the feedback pass saw on screen are resident, in an
+ * atlas of VIRTUAL_CACHE_TILES^2 slots that are recycled least recently
+ * used first. A page table texture, with one texel per tile and one mip
+ * level per virtual level, tells the shader which slot holds each tile;
+ * tiles that are not resident point at their nearest resident ancestor, and
+ * the single tile of the coarsest level stays resident as the last fallback.
+ *
+ * Tiles are read with AsyncIo and decoded in the completion callbacks on the
+ * job system, so the main thread only uploads finished tiles, a few per
+ * frame.
+ */
+class VirtualTexture {
+public:
+    ~VirtualTexture();
+
+    bool create(const std::string& path, AsyncIo& io, int id);
+    bool created() const { return cache != 0; }
+
+    void request(int level, int x, int y);
+    void update();
+    void apply(GLuint program, float lodBias = 0.0f) const;
+
+    int id() const { return textureId; }
+    int levels() const { return levelCount; }
+    size_t residentTiles() const;
+    size_t cacheBytes() const;
+    void report(std::ostream& out) const;
+
+private:
+    struct Tile {
+        uint64_t offset = 0;                // In the archive
+        uint32_t length = 0;
+        int level = 0, x = 0, y = 0;
+        int slot = -1;                      // Cache slot, or -1 if not resident
+        uint64_t requested = 0;             // Last frame the feedback asked for it
+        uint64_t lastUsed = 0;
+        uint64_t ioId = 0;                  // Read that can still be cancelled, or 0
+        bool pending = false;               // Being read, decoded or waiting for upload
+    };
+
+    struct DecodedTile {
+        int tile;
+        int error;
+        ImageInfo info;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Completions {
+        std::mutex mutex;
+        std::vector<DecodedTile> tiles;
+    };
+
+    int tileIndex(int level, int x, int y) const;
+    int tilesX(int level) const { return std::max(1, (width / tileSize) >> level); }
+    int tilesY(int level) const { return std::max(1, (height / tileSize) >> level); }
+    void load(int tile);
+    bool upload(const DecodedTile& decoded);
+    int allocateSlot();
+    void rebuildPageTable();
+
+    std::string path;
+    AsyncIo* io = nullptr;
+    int textureId = 0;
+    int width = 0, height = 0;
+    int tileSize = 0, border = 0;
+    int levelCount = 0;
+
+    std::vector<Tile> tiles;
+    std::vector<int> levelOffsets;
+    std::vector<int> slotTiles;             // Tile held by each cache slot, or -1
+    std::vector<int> wanted;                // Requested this frame and not resident
+    std::vector<int> loading;
+    std::vector<DecodedTile> ready;         // Decoded, waiting for an upload slot in the frame budget
+    std::shared_ptr<Completions> completions = std::make_shared<Completions>();
+    uint64_t frame = 1;
+    bool pageTableDirty = true;
+
+    // Counters for report()
+    uint64_t uploads = 0, evictions = 0, cancellations = 0, failures = 0;
+
+    GLuint pageTable = 0;
+    GLuint cache = 0;
+};
+
+/**
+ * @brief Low-resolution pass that records which virtual tiles are visible
+ *
+ * Surfaces are drawn with the VIRTUAL_FEEDBACK permutation, which writes
+ * the tile coordinates, mip level and texture id each pixel needs. The
+ * result is read back through two pixel pack buffers, so collect() reads
+ * the previous frame's requests without waiting on the GPU.
+ */
+class VirtualTextureFeedback {
+public:
+    ~VirtualTextureFeedback();
+
+    void resize(int windowWidth, int windowHeight);
+    void begin() const;
+    void end();
+    void collect(const std::vector<VirtualTexture*>& textures);
+
+    float lodBias() const;
+
+private:
+    void release();
+
+    GLuint fbo = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    GLuint readback[2] = {0, 0};
+    GLsync fences[2] = {nullptr, nullptr};
+    int current = 0;
+    int feedbackWidth = 0, feedbackHeight = 0;
+};
+
+#endif // VIRTUAL_TEXTURE_H
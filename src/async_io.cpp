@@ -0,0 +1,664 @@
+#include "async_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define ASYNC_IO_URING 1
+#endif
+#endif
+
+/**
+ * @brief Largest read issued at once; longer reads are split
+ */
+const uint64_t IO_SLICE_BYTES = 1 << 20;
+
+/**
+ * @brief Submission queue size; one entry stays reserved for the wake-up poll
+ */
+const unsigned IO_RING_DEPTH = 64;
+
+/**
+ * @brief Most slices each priority may have on the ring at once
+ *
+ * Buffered reads that miss the page cache queue up in the kernel, so a full
+ * ring of background slices would sit in front of an urgent read. Capping
+ * the low priorities keeps room, and queue depth, for the high ones.
+ */
+const unsigned IO_PRIORITY_SLICES[IO_PRIORITY_COUNT] = {IO_RING_DEPTH - 1, IO_RING_DEPTH - 1, 16, 8};
+
+/**
+ * @brief Reader threads of the fallback backend
+ */
+const unsigned IO_WORKER_THREADS = 4;
+
+/**
+ * @brief File descriptors kept open between reads, for archives read entry by entry
+ */
+const size_t IO_MAX_OPEN_FILES = 64;
+
+/**
+ * @brief One slice of a request in flight on the ring
+ */
+struct AsyncIo::Slice {
+    Request* request;
+    uint64_t offset;                        // Within the request
+    uint64_t length;
+    struct iovec iov;
+};
+
+#ifdef ASYNC_IO_URING
+
+/**
+ * @brief An io_uring instance, set up with raw system calls
+ *
+ * Only the ring thread touches it. Submission entries are prepared in
+ * order and published together, so one io_uring_enter covers a batch.
+ */
+struct AsyncIo::Ring {
+    int fd = -1;
+    int wakeFd = -1;                        // eventfd polled on the ring to interrupt waits
+    unsigned entries = 0;
+    unsigned localTail = 0;
+    void* sqMap = MAP_FAILED;
+    void* cqMap = MAP_FAILED;
+    size_t sqMapSize = 0, cqMapSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned readsInFlight = 0;
+    unsigned priorityInFlight[IO_PRIORITY_COUNT] = {};
+
+    bool setup(unsigned depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0) return false;
+
+        entries = params.sq_entries;
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+        sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) return false;
+        cqMap = singleMap ? sqMap : mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqMap);
+        char* cq = static_cast<char*>(cqMap);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        return wakeFd >= 0;
+    }
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapSize);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqMapSize);
+        if (fd >= 0) close(fd);
+        if (wakeFd >= 0) close(wakeFd);
+    }
+
+    /**
+     * @brief Claim the next submission entry, or nullptr if the queue is full
+     */
+    io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= entries) return nullptr;
+        unsigned index = localTail & *sqMask;
+        sqArray[index] = index;
+        localTail++;
+        std::memset(&sqes[index], 0, sizeof(io_uring_sqe));
+        return &sqes[index];
+    }
+
+    /**
+     * @brief Publish prepared entries and wait for at least one completion
+     */
+    void submitAndWait() {
+        unsigned toSubmit = localTail - *sqTail;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+            if (errno != EINTR) break;
+            toSubmit = 0;
+        }
+    }
+
+    /**
+     * @brief Publish prepared entries without waiting
+     */
+    void submit() {
+        unsigned toSubmit = localTail - *sqTail;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (toSubmit > 0 && syscall(__NR_io_uring_enter, fd, toSubmit, 0, 0, nullptr, 0) < 0) {
+            if (errno != EINTR) break;
+            toSubmit = 0;
+        }
+    }
+
+    /**
+     * @brief Poll the eventfd on the ring so wake() interrupts waits
+     *
+     * A full queue is flushed to the kernel once and the entry claimed again.
+     *
+     * @return bool False if the queue is still full; the caller retries later
+     */
+    bool armWake() {
+        io_uring_sqe* sqe = nextSqe();
+        if (!sqe) {
+            submit();
+            sqe = nextSqe();
+            if (!sqe) return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeFd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = 0;
+        return true;
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written; // A full counter already means a pending wake-up
+    }
+};
+
+#else
+
+struct AsyncIo::Ring {
+    bool setup(unsigned) { return false; }
+    void wake() {}
+};
+
+#endif
+
+/**
+ * @brief Start the backend
+ *
+ * @param jobs Job system that runs completion callbacks; without one, every
+ * callback waits for poll()
+ * @param allowIoUring False forces the thread pool backend
+ */
+AsyncIo::AsyncIo(JobSystem* jobs, bool allowIoUring) : jobSystem(jobs), ring(new Ring()) {
+    if (allowIoUring && ring->setup(IO_RING_DEPTH)) {
+        activeBackend = Backend::IoUring;
+        threads.emplace_back(&AsyncIo::ringLoop, this);
+        return;
+    }
+    ring.reset();
+    activeBackend = Backend::ThreadPool;
+    for (unsigned i = 0; i < IO_WORKER_THREADS; i++) {
+        threads.emplace_back(&AsyncIo::workerLoop, this);
+    }
+}
+
+/**
+ * @brief Drop queued reads, wait for reads already issued, and stop
+ *
+ * Callbacks of reads that have not completed are not called.
+ */
+AsyncIo::~AsyncIo() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (auto& queue : pending) {
+            for (Request* request : queue) request->cancelled = true;
+            queue.clear();
+        }
+    }
+    wake.notify_all();
+    if (ring) ring->wake();
+    for (auto& thread : threads) thread.join();
+
+    for (Slice* slice : retries) delete slice;
+    for (auto& entry : openFiles) close(entry.second.fd);
+}
+
+const char* AsyncIo::backendName() const {
+    return activeBackend == Backend::IoUring ? "io_uring" : "thread pool";
+}
+
+/**
+ * @brief Read a whole file
+ *
+ * @param path File to read
+ * @param priority Scheduling class
+ * @param callback Receives the file contents or the error
+ * @param mainThread Run the callback from poll() instead of the job system
+ * @return uint64_t Request id, for cancel()
+ */
+uint64_t AsyncIo::read(const std::string& path, IoPriority priority, IoCallback callback, bool mainThread) {
+    return read(path, 0, 0, priority, std::move(callback), mainThread);
+}
+
+/**
+ * @brief Read a byte range of a file, such as one entry of an archive
+ *
+ * @param path File to read
+ * @param offset First byte
+ * @param length Number of bytes; 0 reads to the end of the file
+ * @param priority Scheduling class
+ * @param callback Receives the bytes or the error
+ * @param mainThread Run the callback from poll() instead of the job system
+ * @return uint64_t Request id, for cancel()
+ */
+uint64_t AsyncIo::read(const std::string& path, uint64_t offset, uint64_t length, IoPriority priority,
+                       IoCallback callback, bool mainThread) {
+    auto request = std::make_unique<Request>();
+    request->path = path;
+    request->offset = offset;
+    request->length = length;
+    request->wholeFile = length == 0;
+    request->priority = priority;
+    request->callback = std::move(callback);
+    request->mainThread = mainThread || !jobSystem;
+    request->start = std::chrono::steady_clock::now();
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = request->id = nextId++;
+        pending[static_cast<int>(priority)].push_back(request.get());
+        requests[id] = std::move(request);
+    }
+    if (ring) {
+        ring->wake();
+    } else {
+        wake.notify_one();
+    }
+    return id;
+}
+
+/**
+ * @brief Cancel a read
+ *
+ * @param id Request id
+ * @return bool False if the read already completed
+ *
+ * Queued reads are dropped at once. Slices already issued finish, but their
+ * data is discarded; the callback then sees ECANCELED.
+ */
+bool AsyncIo::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = requests.find(id);
+    if (found == requests.end() || found->second->cancelled) return false;
+
+    Request* request = found->second.get();
+    request->cancelled = true;
+    auto& queue = pending[static_cast<int>(request->priority)];
+    queue.erase(std::remove(queue.begin(), queue.end(), request), queue.end());
+    if (request->slicesInFlight == 0) finish(request);
+    return true;
+}
+
+/**
+ * @brief Run callbacks of reads that asked for the main thread
+ *
+ * @return size_t Number of callbacks run
+ */
+size_t AsyncIo::poll() {
+    std::vector<IoResult> results;
+    std::vector<IoCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.swap(mainThreadResults);
+        callbacks.swap(mainThreadCallbacks);
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        if (callbacks[i]) callbacks[i](results[i]);
+    }
+    return results.size();
+}
+
+/**
+ * @brief Block until every read has completed, then run main-thread callbacks
+ *
+ * Callbacks handed to the job system may still be running on return.
+ */
+void AsyncIo::waitAll() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this]() { return requests.empty(); });
+    }
+    poll();
+}
+
+/**
+ * @brief Highest-priority queued request, left in its queue
+ *
+ * Called with the mutex held.
+ */
+AsyncIo::Request* AsyncIo::nextPending() {
+    for (auto& queue : pending) {
+        if (!queue.empty()) return queue.front();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Open the request's file and size its buffer
+ *
+ * Called without the mutex held; the caller keeps the request alive by
+ * counting the open as a slice in flight.
+ */
+bool AsyncIo::openRequest(Request& request) {
+    int fd = acquireFile(request.path);
+    if (fd < 0) return false;
+
+    if (request.wholeFile) {
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            releaseFile(request.path);
+            errno = error;
+            return false;
+        }
+        uint64_t size = static_cast<uint64_t>(info.st_size);
+        request.length = size > request.offset ? size - request.offset : 0;
+    }
+    request.buffer.resize(request.length);
+    request.fd = fd;
+    return true;
+}
+
+/**
+ * @brief Deliver a finished request and forget it
+ *
+ * Called with the mutex held, once no slice of the request is in flight.
+ */
+void AsyncIo::finish(Request* request) {
+    auto owned = std::move(requests[request->id]);
+    requests.erase(request->id);
+    if (request->fd >= 0) releaseFile(request->path);
+
+    if (!stopping) {
+        auto result = std::make_shared<IoResult>();
+        result->id = request->id;
+        result->error = request->cancelled ? ECANCELED : request->error;
+        if (!result->error) result->data = std::move(request->buffer);
+        result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - request->start).count();
+
+        if (request->mainThread) {
+            mainThreadResults.push_back(std::move(*result));
+            mainThreadCallbacks.push_back(std::move(request->callback));
+        } else {
+            IoCallback callback = std::move(request->callback);
+            jobSystem->submit([callback, result]() { callback(*result); });
+        }
+    }
+    if (requests.empty()) allDone.notify_all();
+}
+
+#ifdef ASYNC_IO_URING
+
+/**
+ * @brief Submission thread of the io_uring backend
+ *
+ * Keeps the ring topped up from the priority queues, then sleeps in the
+ * kernel until a read completes or the eventfd is written.
+ */
+void AsyncIo::ringLoop() {
+    bool wakeArmed = false;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping && ring->readsInFlight == 0) break;
+        }
+        // Ahead of the reads, so they cannot take the entry the wake-up needs
+        if (!wakeArmed) wakeArmed = ring->armWake();
+        unsigned queued = 0;
+        fillRing(queued);
+        ring->submitAndWait();
+
+        // Reap completions
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        bool rearm = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+                if (cqe.user_data == 0) {
+                    rearm = true;
+                } else {
+                    completeSlice(reinterpret_cast<Slice*>(static_cast<uintptr_t>(cqe.user_data)), cqe.res);
+                }
+            }
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+        if (rearm) {
+            uint64_t count;
+            while (::read(ring->wakeFd, &count, sizeof(count)) > 0) {}
+            wakeArmed = ring->armWake();
+        }
+    }
+}
+
+/**
+ * @brief Queue read slices until the ring is full or nothing is pending
+ *
+ * @param queued Incremented per entry prepared
+ */
+void AsyncIo::fillRing(unsigned& queued) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping && ring->readsInFlight < IO_RING_DEPTH - 1) {
+        Slice* slice = nullptr;
+        if (!retries.empty()) {
+            slice = retries.front();
+            retries.pop_front();
+            if (slice->request->cancelled || slice->request->error) {
+                Request* request = slice->request;
+                delete slice;
+                if (--request->slicesInFlight == 0) finish(request);
+                continue;
+            }
+        } else {
+            Request* request = nullptr;
+            for (int priority = 0; priority < IO_PRIORITY_COUNT && !request; priority++) {
+                if (!pending[priority].empty() && ring->priorityInFlight[priority] < IO_PRIORITY_SLICES[priority]) {
+                    request = pending[priority].front();
+                }
+            }
+            if (!request) break;
+
+            if (request->fd < 0) {
+                // Open outside the lock; the pseudo-slice keeps cancel() from freeing it
+                request->slicesInFlight++;
+                lock.unlock();
+                bool opened = openRequest(*request);
+                int error = errno;
+                lock.lock();
+                request->slicesInFlight--;
+                if (!opened) request->error = error;
+                if (!opened || request->cancelled || request->length == 0) {
+                    auto& queue = pending[static_cast<int>(request->priority)];
+                    queue.erase(std::remove(queue.begin(), queue.end(), request), queue.end());
+                    if (request->slicesInFlight == 0) finish(request);
+                    continue;
+                }
+            }
+
+            uint64_t length = std::min(IO_SLICE_BYTES, request->length - request->submitted);
+            slice = new Slice{request, request->submitted, length, {}};
+            request->submitted += length;
+            request->slicesInFlight++;
+            if (request->submitted == request->length) pending[static_cast<int>(request->priority)].pop_front();
+        }
+
+        io_uring_sqe* sqe = ring->nextSqe();
+        if (!sqe) {
+            retries.push_front(slice);
+            break;
+        }
+        slice->iov.iov_base = slice->request->buffer.data() + slice->offset;
+        slice->iov.iov_len = slice->length;
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = slice->request->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(&slice->iov);
+        sqe->len = 1;
+        sqe->off = slice->request->offset + slice->offset;
+        sqe->user_data = reinterpret_cast<uintptr_t>(slice);
+        ring->readsInFlight++;
+        ring->priorityInFlight[static_cast<int>(slice->request->priority)]++;
+        queued++;
+    }
+}
+
+/**
+ * @brief Account for a completed slice; short reads queue their remainder
+ *
+ * Called with the mutex held.
+ */
+void AsyncIo::completeSlice(Slice* slice, int result) {
+    Request* request = slice->request;
+    ring->readsInFlight--;
+    ring->priorityInFlight[static_cast<int>(request->priority)]--;
+
+    if (result < 0) {
+        if (!request->error) request->error = -result;
+    } else {
+        totalBytes += result;
+        uint64_t read = static_cast<uint64_t>(result);
+        if (read < slice->length && !request->cancelled && !request->error) {
+            if (read == 0) {
+                request->error = EIO; // File shrank under us
+            } else {
+                slice->offset += read;
+                slice->length -= read;
+                retries.push_back(slice);
+                return;
+            }
+        }
+    }
+    delete slice;
+
+    if (request->error) {
+        auto& queue = pending[static_cast<int>(request->priority)];
+        queue.erase(std::remove(queue.begin(), queue.end(), request), queue.end());
+    }
+    request->slicesInFlight--;
+    if (request->slicesInFlight == 0 &&
+        (request->cancelled || request->error || request->submitted == request->length)) {
+        finish(request);
+    }
+}
+
+#else
+
+void AsyncIo::ringLoop() {}
+void AsyncIo::fillRing(unsigned&) {}
+void AsyncIo::completeSlice(Slice*, int) {}
+
+#endif
+
+/**
+ * @brief Reader thread of the fallback backend
+ *
+ * Takes whole requests in priority order and reads them with pread, one
+ * slice at a time so cancellation takes effect between slices.
+ */
+void AsyncIo::workerLoop() {
+    while (true) {
+        Request* request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || nextPending(); });
+            if (stopping) return;
+            request = nextPending();
+            pending[static_cast<int>(request->priority)].pop_front();
+            request->slicesInFlight = 1;
+        }
+
+        int error = openRequest(*request) ? 0 : errno;
+        uint64_t done = 0;
+        while (!error && done < request->length) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (request->cancelled || stopping) break;
+            }
+            size_t length = static_cast<size_t>(std::min(IO_SLICE_BYTES, request->length - done));
+            ssize_t result = pread(request->fd, request->buffer.data() + done, length, static_cast<off_t>(request->offset + done));
+            if (result < 0) {
+                if (errno != EINTR) error = errno;
+                continue;
+            }
+            if (result == 0) {
+                error = EIO; // File shrank under us
+                break;
+            }
+            done += static_cast<uint64_t>(result);
+            totalBytes += static_cast<uint64_t>(result);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        request->error = error;
+        request->submitted = request->length;
+        request->slicesInFlight = 0;
+        finish(request);
+    }
+}
+
+/**
+ * @brief Open a file, or reuse its descriptor if it is already open
+ *
+ * @return int Descriptor, or -1 with errno set
+ */
+int AsyncIo::acquireFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    auto found = openFiles.find(path);
+    if (found != openFiles.end()) {
+        found->second.users++;
+        return found->second.fd;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    // Keep the cache bounded by closing descriptors nobody is reading
+    if (openFiles.size() >= IO_MAX_OPEN_FILES) {
+        for (auto it = openFiles.begin(); it != openFiles.end();) {
+            if (it->second.users == 0) {
+                close(it->second.fd);
+                it = openFiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    openFiles[path] = {fd, 1};
+    return fd;
+}
+
+void AsyncIo::releaseFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    auto found = openFiles.find(path);
+    if (found != openFiles.end()) found->second.users--;
+}
@@ -0,0 +1,279 @@
+#include "batch_transform.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_TRANSFORM_X86 1
+#endif
+
+/**
+ * @brief Reserve room for a number of instances in every array
+ */
+void TransformSoA::reserve(size_t count) {
+    for (auto* lane : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}) {
+        lane->reserve(count);
+    }
+}
+
+/**
+ * @brief Remove all instances
+ */
+void TransformSoA::clear() {
+    for (auto* lane : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}) {
+        lane->clear();
+    }
+}
+
+/**
+ * @brief Append an instance
+ *
+ * @param position Translation
+ * @param rotation Unit quaternion
+ * @param scale Per-axis scale; must be non-zero for the normal matrix
+ */
+void TransformSoA::push(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+    qx.push_back(rotation.x); qy.push_back(rotation.y); qz.push_back(rotation.z); qw.push_back(rotation.w);
+    sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+}
+
+/**
+ * @brief Overwrite an existing instance
+ */
+void TransformSoA::set(size_t i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+    qx[i] = rotation.x; qy[i] = rotation.y; qz[i] = rotation.z; qw[i] = rotation.w;
+    sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+}
+
+/**
+ * @brief Reference kernel, one instance at a time
+ *
+ * @param t Source transforms
+ * @param begin First instance to build
+ * @param end One past the last instance
+ * @param out Destination, indexed from begin
+ *
+ * Model = T * R * S, built directly from the quaternion rather than by
+ * chaining glm::translate/rotate/scale. The normal matrix is R * S^-1,
+ * which equals the inverse transpose of R * S.
+ */
+void buildInstanceMatricesScalar(const TransformSoA& t, size_t begin, size_t end, InstanceMatrices* out) {
+    for (size_t i = begin; i < end; i++) {
+        float x = t.qx[i], y = t.qy[i], z = t.qz[i], w = t.qw[i];
+        float xx = x * x, yy = y * y, zz = z * z;
+        float xy = x * y, xz = x * z, yz = y * z;
+        float wx = w * x, wy = w * y, wz = w * z;
+
+        glm::vec3 r0(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy));
+        glm::vec3 r1(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx));
+        glm::vec3 r2(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy));
+
+        InstanceMatrices& m = out[i - begin];
+        m.model[0] = glm::vec4(r0 * t.sx[i], 0.0f);
+        m.model[1] = glm::vec4(r1 * t.sy[i], 0.0f);
+        m.model[2] = glm::vec4(r2 * t.sz[i], 0.0f);
+        m.model[3] = glm::vec4(t.px[i], t.py[i], t.pz[i], 1.0f);
+        m.normal[0] = r0 / t.sx[i];
+        m.normal[1] = r1 / t.sy[i];
+        m.normal[2] = r2 / t.sz[i];
+    }
+}
+
+#ifdef BATCH_TRANSFORM_X86
+
+/**
+ * @brief Matrix entries for four instances, one register per entry
+ */
+struct Lanes4 {
+    __m128 model[3][3];
+    __m128 normal[3][3];
+};
+
+/**
+ * @brief Compute rotation-scale and normal entries for four instances
+ */
+static inline void computeLanes(__m128 x, __m128 y, __m128 z, __m128 w,
+                                __m128 sx, __m128 sy, __m128 sz, Lanes4& l) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    __m128 r[3][3];
+    r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+    r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+    r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+    r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+    r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+    r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+    r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+    r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+    r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+    __m128 scale[3] = {sx, sy, sz};
+    for (int c = 0; c < 3; c++) {
+        __m128 inv = _mm_div_ps(one, scale[c]);
+        for (int row = 0; row < 3; row++) {
+            l.model[c][row] = _mm_mul_ps(r[c][row], scale[c]);
+            l.normal[c][row] = _mm_mul_ps(r[c][row], inv);
+        }
+    }
+}
+
+/**
+ * @brief Transpose and store four instances' matrices
+ *
+ * Each column gathered across four lanes is transposed so every instance
+ * receives its own contiguous column.
+ */
+static inline void storeLanes(const Lanes4& l, __m128 px, __m128 py, __m128 pz, InstanceMatrices* out) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (int c = 0; c < 4; c++) {
+        __m128 a = c < 3 ? l.model[c][0] : px;
+        __m128 b = c < 3 ? l.model[c][1] : py;
+        __m128 d = c < 3 ? l.model[c][2] : pz;
+        __m128 e = c < 3 ? zero : one;
+        _MM_TRANSPOSE4_PS(a, b, d, e);
+        _mm_storeu_ps(&out[0].model[c][0], a);
+        _mm_storeu_ps(&out[1].model[c][0], b);
+        _mm_storeu_ps(&out[2].model[c][0], d);
+        _mm_storeu_ps(&out[3].model[c][0], e);
+    }
+
+    for (int c = 0; c < 3; c++) {
+        __m128 a = l.normal[c][0], b = l.normal[c][1], d = l.normal[c][2], e = zero;
+        _MM_TRANSPOSE4_PS(a, b, d, e);
+        // Columns are 3 floats wide, so store through a temporary to stay inside the struct
+        alignas(16) float tmp[4][4];
+        _mm_store_ps(tmp[0], a);
+        _mm_store_ps(tmp[1], b);
+        _mm_store_ps(tmp[2], d);
+        _mm_store_ps(tmp[3], e);
+        for (int i = 0; i < 4; i++) {
+            std::memcpy(&out[i].normal[c][0], tmp[i], 3 * sizeof(float));
+        }
+    }
+}
+
+/**
+ * @brief SSE kernel: four instances per iteration
+ */
+static void buildSSE(const TransformSoA& t, size_t begin, size_t end, InstanceMatrices* out) {
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        Lanes4 lanes;
+        computeLanes(_mm_loadu_ps(&t.qx[i]), _mm_loadu_ps(&t.qy[i]), _mm_loadu_ps(&t.qz[i]), _mm_loadu_ps(&t.qw[i]),
+                     _mm_loadu_ps(&t.sx[i]), _mm_loadu_ps(&t.sy[i]), _mm_loadu_ps(&t.sz[i]), lanes);
+        storeLanes(lanes, _mm_loadu_ps(&t.px[i]), _mm_loadu_ps(&t.py[i]), _mm_loadu_ps(&t.pz[i]), out + (i - begin));
+    }
+    buildInstanceMatricesScalar(t, i, end, out + (i - begin));
+}
+
+/**
+ * @brief AVX kernel: eight instances per iteration
+ *
+ * The matrix entries are computed eight wide, then each half goes through
+ * the same transpose-and-store as the SSE kernel.
+ */
+__attribute__((target("avx")))
+static void buildAVX(const TransformSoA& t, size_t begin, size_t end, InstanceMatrices* out) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&t.qx[i]), y = _mm256_loadu_ps(&t.qy[i]);
+        __m256 z = _mm256_loadu_ps(&t.qz[i]), w = _mm256_loadu_ps(&t.qw[i]);
+        __m256 scale[3] = {_mm256_loadu_ps(&t.sx[i]), _mm256_loadu_ps(&t.sy[i]), _mm256_loadu_ps(&t.sz[i])};
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        __m256 r[3][3];
+        r[0][0] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+        r[0][1] = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+        r[0][2] = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+        r[1][0] = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+        r[1][1] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+        r[1][2] = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+        r[2][0] = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+        r[2][1] = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+        r[2][2] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+        Lanes4 low, high;
+        for (int c = 0; c < 3; c++) {
+            __m256 inv = _mm256_div_ps(one, scale[c]);
+            for (int row = 0; row < 3; row++) {
+                __m256 m = _mm256_mul_ps(r[c][row], scale[c]);
+                __m256 n = _mm256_mul_ps(r[c][row], inv);
+                low.model[c][row] = _mm256_castps256_ps128(m);
+                high.model[c][row] = _mm256_extractf128_ps(m, 1);
+                low.normal[c][row] = _mm256_castps256_ps128(n);
+                high.normal[c][row] = _mm256_extractf128_ps(n, 1);
+            }
+        }
+
+        InstanceMatrices* dst = out + (i - begin);
+        storeLanes(low, _mm_loadu_ps(&t.px[i]), _mm_loadu_ps(&t.py[i]), _mm_loadu_ps(&t.pz[i]), dst);
+        storeLanes(high, _mm_loadu_ps(&t.px[i + 4]), _mm_loadu_ps(&t.py[i + 4]), _mm_loadu_ps(&t.pz[i + 4]), dst + 4);
+    }
+    buildSSE(t, i, end, out + (i - begin));
+}
+
+#endif
+
+typedef void (*BatchTransformKernel)(const TransformSoA&, size_t, size_t, InstanceMatrices*);
+
+struct KernelChoice {
+    BatchTransformKernel kernel;
+    const char* name;
+};
+
+/**
+ * @brief Pick the widest kernel the CPU supports, once
+ */
+static const KernelChoice& selectKernel() {
+    static const KernelChoice choice = []() -> KernelChoice {
+#ifdef BATCH_TRANSFORM_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx")) return {buildAVX, "avx"};
+        return {buildSSE, "sse"};
+#else
+        return {buildInstanceMatricesScalar, "scalar"};
+#endif
+    }();
+    return choice;
+}
+
+/**
+ * @brief Name of the kernel picked for this CPU ("avx", "sse" or "scalar")
+ */
+const char* batchTransformKernel() {
+    return selectKernel().name;
+}
+
+/**
+ * @brief Build model and normal matrices for every instance
+ *
+ * @param transforms Source transforms
+ * @param out Destination with room for transforms.size() entries; may be a
+ *            mapped instance buffer, as only whole entries are written
+ */
+void buildInstanceMatrices(const TransformSoA& transforms, InstanceMatrices* out) {
+    selectKernel().kernel(transforms, 0, transforms.size(), out);
+}
+
+/**
+ * @brief Build model and normal matrices for instances [begin, end)
+ *
+ * @param out Destination for instance `begin`; lets jobs fill disjoint ranges
+ */
+void buildInstanceMatrices(const TransformSoA& transforms, size_t begin, size_t end, InstanceMatrices* out) {
+    selectKernel().kernel(transforms, begin, end, out);
+}
@@ -0,0 +1,1034 @@
+#include "benchmarks.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <GL/glew.h>
+#include "async_io.h"
+#include "batch_transform.h"
+#include "gltf.h"
+#include "gpu_allocator.h"
+#include "image_decoder.h"
+#include "mapped_file.h"
+#include "mesh_codec.h"
+#include "model_loader.h"
+#include "gl_state.h"
+#include "collision.h"
+#include "combat.h"
+#include "physics.h"
+#include "ragdoll.h"
+#include "alloc_tracker.h"
+#include "entity_pool.h"
+#include "navmesh.h"
+#include "surfaces.h"
+
+/**
+ * @brief Time a function, repeating it until at least `minSeconds` elapsed
+ *
+ * @return double Average seconds per call
+ */
+static double timeIt(const std::function<void()>& fn, double minSeconds = 0.2) {
+    fn(); // Warm caches and page in outputs
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        fn();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < minSeconds);
+    return elapsed.count() / calls;
+}
+
+/**
+ * @brief Compare the chained glm path against the batch transform kernels
+ *
+ * Builds model and normal matrices for 1k, 10k and 100k random instances.
+ */
+static int benchTransforms() {
+    std::cout << "batch transform kernel: " << batchTransformKernel() << std::endl;
+    std::cout << std::setw(10) << "instances" << std::setw(14) << "glm ns/inst"
+              << std::setw(14) << "scalar" << std::setw(14) << "simd" << std::setw(10) << "speedup" << std::endl;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+
+    for (size_t count : {1000u, 10000u, 100000u}) {
+        TransformSoA transforms;
+        transforms.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            glm::quat q = glm::normalize(glm::quat(spread(rng), spread(rng), spread(rng), spread(rng)));
+            transforms.push(glm::vec3(spread(rng), spread(rng), spread(rng)) * 50.0f, q,
+                            glm::vec3(1.0f + 0.5f * spread(rng)));
+        }
+        std::vector<InstanceMatrices> out(count);
+
+        double glmTime = timeIt([&]() {
+            for (size_t i = 0; i < count; i++) {
+                glm::quat q(transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i]);
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.px[i], transforms.py[i], transforms.pz[i]));
+                model = model * glm::mat4_cast(q);
+                model = glm::scale(model, glm::vec3(transforms.sx[i], transforms.sy[i], transforms.sz[i]));
+                out[i].model = model;
+                out[i].normal = glm::transpose(glm::inverse(glm::mat3(model)));
+            }
+        });
+        double scalarTime = timeIt([&]() { buildInstanceMatricesScalar(transforms, 0, count, out.data()); });
+        double simdTime = timeIt([&]() { buildInstanceMatrices(transforms, out.data()); });
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(10) << count
+                  << std::setw(14) << glmTime * 1e9 / count
+                  << std::setw(14) << scalarTime * 1e9 / count
+                  << std::setw(14) << simdTime * 1e9 / count
+                  << std::setw(9) << glmTime / simdTime << "x" << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compile a minimal program that draws ModelVertex meshes
+ *
+ * Keeps the fragment work trivial so the submission benchmark measures the
+ * CPU and driver side.
+ */
+static GLuint createSubmissionProgram() {
+    std::string vertexSource = "#version 330 core\n" + ModelVertex::glslInputs() +
+        "void main() { gl_Position = vec4(aPos * 0.001, 1.0); }\n";
+    const char* fragmentSource = "#version 330 core\nout vec4 color;\nvoid main() { color = vec4(1.0); }\n";
+    const char* vertexPointer = vertexSource.c_str();
+
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexPointer, nullptr);
+    glCompileShader(vertexShader);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
+    glCompileShader(fragmentShader);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return program;
+}
+
+/**
+ * @brief Compare draw submission cost of the GL 3.3 and DSA model paths
+ *
+ * Loads the same model through both paths and times 100 full-model draws
+ * followed by glFinish, reported per mesh draw call.
+ */
+static int benchSubmission() {
+    if (!ModelLoader::directStateAccessSupported()) {
+        std::cerr << "Direct state access is not supported by this driver" << std::endl;
+        return 1;
+    }
+
+    GLuint program = createSubmissionProgram();
+    glState().useProgram(program);
+
+    const int draws = 100;
+    bool preferred = ModelLoader::preferDirectStateAccess;
+    std::cout << std::setw(8) << "path" << std::setw(10) << "meshes" << std::setw(16) << "us/draw call" << std::endl;
+    for (bool dsa : {false, true}) {
+        ModelLoader::preferDirectStateAccess = dsa;
+        ModelLoader model;
+        model.loadModel("spider_man");
+        if (model.meshes.empty()) return 1;
+
+        double seconds = timeIt([&]() {
+            for (int i = 0; i < draws; i++) model.draw();
+            glFinish();
+        });
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(8) << (dsa ? "dsa" : "gl33")
+                  << std::setw(10) << model.meshes.size()
+                  << std::setw(16) << seconds * 1e6 / (draws * model.meshes.size()) << std::endl;
+    }
+
+    ModelLoader::preferDirectStateAccess = preferred;
+    glDeleteProgram(program);
+    return 0;
+}
+
+/**
+ * @brief Stress the mesh sub-allocator with level-streaming churn
+ *
+ * Fills a 256 MB arena with mesh-sized blocks, then frees and allocates at
+ * random, and finally compacts in 1 MB steps as the game would per frame.
+ * Runs on the CPU only; moves are not copied.
+ */
+static int benchSuballocator() {
+    const uint64_t capacity = 256ull * 1024 * 1024;
+    const uint64_t stride = ModelVertex::stride;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint64_t> meshVertices(200, 60000);
+
+    GpuArena arena;
+    arena.reset(capacity, stride);
+    std::vector<uint32_t> live;
+    while (arena.stats().utilization < 0.8) {
+        uint32_t handle = arena.allocate(meshVertices(rng) * stride);
+        if (handle == GpuArena::INVALID) break;
+        live.push_back(handle);
+    }
+
+    const int operations = 200000;
+    int failures = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < operations; i++) {
+        if (!live.empty() && (rng() & 1)) {
+            size_t victim = rng() % live.size();
+            arena.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        } else {
+            uint32_t handle = arena.allocate(meshVertices(rng) * stride);
+            if (handle == GpuArena::INVALID) {
+                failures++;
+            } else {
+                live.push_back(handle);
+            }
+        }
+    }
+    std::chrono::duration<double> churn = std::chrono::steady_clock::now() - start;
+
+    auto print = [](const char* label, const ArenaStats& stats) {
+        std::cout << std::setw(16) << label << std::fixed << std::setprecision(1)
+                  << std::setw(8) << stats.allocations << " allocs"
+                  << std::setw(8) << stats.utilization * 100.0 << "% used"
+                  << std::setw(8) << stats.fragmentation * 100.0 << "% fragmented"
+                  << std::setw(10) << stats.largestFree / (1024 * 1024) << " MB largest free" << std::endl;
+    };
+    std::cout << std::fixed << std::setprecision(1) << operations << " alloc/free: "
+              << churn.count() * 1e9 / operations << " ns/op, " << failures << " failed" << std::endl;
+    print("after churn", arena.stats());
+
+    uint64_t moved = 0, step;
+    int frames = 0;
+    start = std::chrono::steady_clock::now();
+    while ((step = arena.compact(1024 * 1024, [](uint64_t, uint64_t, uint64_t) {})) > 0) {
+        moved += step;
+        frames++;
+    }
+    std::chrono::duration<double> compaction = std::chrono::steady_clock::now() - start;
+    print("after compaction", arena.stats());
+    std::cout << moved / (1024 * 1024) << " MB moved over " << frames << " frames, "
+              << compaction.count() * 1e6 / std::max(frames, 1) << " us CPU per frame" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Compare Assimp OBJ import against the native GLB loader
+ *
+ * Imports the model from OBJ, writes it as a GLB in ModelVertex's layout,
+ * then times loading both to the GPU, including glFinish.
+ */
+static int benchGlb() {
+    const char* modelName = "spider_man";
+    ModelLoader obj;
+    double objSeconds = timeIt([&]() {
+        obj.loadObj(modelName);
+        glFinish();
+    }, 1.0);
+    if (obj.meshes.empty()) return 1;
+
+    std::vector<GlbMeshSource> sources;
+    size_t vertices = 0;
+    for (const Mesh& mesh : obj.meshes) {
+        GlbMeshSource source;
+        source.vertices = mesh.vertices.data();
+        source.vertexCount = mesh.vertices.size() / ModelVertex::stride;
+        source.stride = ModelVertex::stride;
+        source.normalOffset = ModelVertex::offset(1);
+        source.texCoordOffset = ModelVertex::offset(2);
+        source.indices = mesh.indices.data();
+        source.indexCount = mesh.indices.size();
+        for (size_t v = 0; v < source.vertexCount; v++) {
+            glm::vec3 position;
+            std::memcpy(&position, source.vertices + v * source.stride, sizeof(position));
+            source.bounds.expand(position);
+        }
+        if (!mesh.textures.empty()) source.imagePath = mesh.textures[0].path;
+        vertices += source.vertexCount;
+        sources.push_back(source);
+    }
+
+    std::string path = "/tmp/escape_the_abyss_bench.glb";
+    std::string error;
+    if (!writeGlb(path, sources, error)) {
+        std::cerr << "GLB export failed: " << error << std::endl;
+        return 1;
+    }
+
+    ModelLoader glb;
+    double glbSeconds = timeIt([&]() {
+        glb.loadGlb(path);
+        glFinish();
+    }, 1.0);
+    std::remove(path.c_str());
+    if (glb.meshes.size() != obj.meshes.size()) {
+        std::cerr << "GLB round trip lost meshes" << std::endl;
+        return 1;
+    }
+
+    std::cout << modelName << ": " << obj.meshes.size() << " meshes, " << vertices << " vertices, "
+              << glb.zeroCopyMeshes << " uploaded zero-copy" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(8) << "obj" << std::setw(12) << objSeconds * 1e3 << " ms" << std::endl
+              << std::setw(8) << "glb" << std::setw(12) << glbSeconds * 1e3 << " ms" << std::endl
+              << std::setprecision(1) << "speedup " << objSeconds / glbSeconds << "x" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Compare OBJ import against the compressed mesh format
+ *
+ * Cooks the model, then reports file sizes, pure decode throughput and the
+ * full load time to the GPU for both paths. The OS page cache is warm for
+ * both files, so disk savings come on top of these numbers.
+ */
+static int benchCodec() {
+    const char* modelName = "spider_man";
+    if (!ModelLoader::cookModel(modelName)) return 1;
+
+    std::string base = std::string("../assets/models/") + modelName + "/" + modelName;
+    auto fileSize = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        return static_cast<double>(file.tellg());
+    };
+
+    std::vector<MeshStreams> streams;
+    std::string error;
+    double decodeSeconds = timeIt([&]() {
+        if (!mesh_codec::readFile(base + ".mesh", streams, error)) std::cerr << error << std::endl;
+    }, 1.0);
+    double decodedBytes = 0;
+    for (const MeshStreams& mesh : streams) {
+        decodedBytes += mesh.positions.size() * ModelVertex::stride + mesh.indices.size() * sizeof(GLuint);
+    }
+
+    ModelLoader obj, cooked;
+    double objSeconds = timeIt([&]() {
+        obj.loadObj(modelName);
+        glFinish();
+    }, 1.0);
+    double cookedSeconds = timeIt([&]() {
+        cooked.loadCooked(modelName);
+        glFinish();
+    }, 1.0);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "obj " << fileSize(base + ".obj") / 1048576.0 << " MB, mesh " << fileSize(base + ".mesh") / 1048576.0
+              << " MB, decoded " << decodedBytes / 1048576.0 << " MB" << std::endl
+              << "decode (" << mesh_codec::decodeKernel() << "): " << decodeSeconds * 1e3 << " ms, "
+              << decodedBytes / decodeSeconds / 1e9 << " GB/s of vertex and index data" << std::endl
+              << std::setw(8) << "obj" << std::setw(12) << objSeconds * 1e3 << " ms load" << std::endl
+              << std::setw(8) << "mesh" << std::setw(12) << cookedSeconds * 1e3 << " ms load" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Measure streaming throughput and urgent-read latency of AsyncIo
+ *
+ * Writes a synthetic 1 GB asset set (256 files of 4 MB) to /tmp, then for
+ * each backend:
+ * - streams the whole set at background priority and reports throughput;
+ * - streams it again while issuing 64 KB immediate reads every 2 ms, and
+ *   reports their latency percentiles;
+ * - cancels whatever is still queued at that point.
+ * Pages are dropped with posix_fadvise before each pass so the reads reach
+ * the device.
+ */
+static int benchIo() {
+    const int fileCount = 256;
+    const size_t fileSize = 4 << 20;
+    const std::string directory = "/tmp/escape_the_abyss_io";
+    mkdir(directory.c_str(), 0755);
+
+    std::vector<std::string> paths;
+    std::vector<unsigned char> block(fileSize);
+    std::mt19937 rng(5);
+    for (auto& byte : block) byte = static_cast<unsigned char>(rng());
+    for (int i = 0; i < fileCount; i++) {
+        paths.push_back(directory + "/asset" + std::to_string(i) + ".bin");
+        std::ofstream out(paths.back(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(block.data()), block.size());
+        if (!out) {
+            std::cerr << "Cannot write the asset set to " << directory << std::endl;
+            return 1;
+        }
+    }
+    auto dropCache = [&]() {
+        for (const std::string& path : paths) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) continue;
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    };
+
+    JobSystem jobs;
+    for (bool ioUring : {true, false}) {
+        AsyncIo io(&jobs, ioUring);
+        if (ioUring && io.backend() != AsyncIo::Backend::IoUring) {
+            std::cout << "io_uring unavailable" << std::endl;
+            continue;
+        }
+
+        // Throughput: the whole set, batched
+        dropCache();
+        std::atomic<int> failures{0};
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& path : paths) {
+            io.read(path, IoPriority::Background, [&](IoResult& result) { if (result.error) failures++; });
+        }
+        io.waitAll();
+        jobs.waitIdle();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double gigabytes = static_cast<double>(fileCount) * fileSize / 1e9;
+
+        // Latency: urgent reads against a full background queue
+        dropCache();
+        std::vector<uint64_t> background;
+        for (const std::string& path : paths) {
+            background.push_back(io.read(path, IoPriority::Background, [](IoResult&) {}));
+        }
+        std::mutex latencyMutex;
+        std::vector<double> latencies;
+        std::uniform_int_distribution<int> pickFile(0, fileCount - 1);
+        std::uniform_int_distribution<uint64_t> pickOffset(0, fileSize - 65536);
+        for (int i = 0; i < 200; i++) {
+            io.read(paths[pickFile(rng)], pickOffset(rng), 65536, IoPriority::Immediate, [&](IoResult& result) {
+                std::lock_guard<std::mutex> lock(latencyMutex);
+                latencies.push_back(result.seconds);
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        int cancelled = 0;
+        for (uint64_t id : background) cancelled += io.cancel(id);
+        io.waitAll();
+        jobs.waitIdle();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] * 1e3; };
+        std::cout << std::fixed << std::setprecision(2) << std::setw(12) << io.backendName() << ": "
+                  << gigabytes / elapsed.count() << " GB/s streaming, " << failures << " failed; immediate 64 KB reads p50 "
+                  << percentile(0.5) << " ms, p99 " << percentile(0.99) << " ms; " << cancelled
+                  << " background reads cancelled" << std::endl;
+    }
+
+    for (const std::string& path : paths) unlink(path.c_str());
+    rmdir(directory.c_str());
+    return 0;
+}
+
+/**
+ * @brief Compare the image decoders per file format
+ *
+ * Decodes the game's textures with every registered decoder that takes
+ * them and reports throughput in MB/s of decoded pixels (and of encoded
+ * input). The BMP textures are 8-bit palette images, so a 24-bit BMP is
+ * also written from the largest JPEG to time the row-copy path.
+ */
+static int benchImages() {
+    struct Sample {
+        std::string format;
+        std::vector<unsigned char> bytes;
+    };
+    std::vector<Sample> samples;
+    const char* files[] = {
+        "spider_man/SpiderMan_Tex01_BM.jpg", "spider_man/SpiderMan_Tex02_BM.jpg", "spider_man/1RJEIUEY8H0QSVGTS3EZLVAF6.jpg",
+        "spider_man/default-grey.jpg", "monster/zombie_head.bmp", "monster/full.bmp", "monster/face2.bmp",
+        "monster/zombie_body.bmp", "monster/zombie_pants.bmp",
+    };
+    for (const char* file : files) {
+        MappedFile mapped;
+        if (!mapped.open(std::string("../assets/models/") + file)) {
+            std::cerr << "Missing " << file << std::endl;
+            continue;
+        }
+        const unsigned char* bytes = mapped.data();
+        std::string format = bytes[0] == 0xFF && bytes[1] == 0xD8 ? "jpeg" :
+                             bytes[0] == 0x89 && bytes[1] == 'P' ? "png" :
+                             bytes[0] == 'B' && bytes[1] == 'M' ? "bmp " + std::to_string(bytes[28]) + "-bit" : "other";
+        samples.push_back({format, std::vector<unsigned char>(bytes, bytes + mapped.size())});
+    }
+    if (samples.empty()) return 1;
+
+    // 24-bit bottom-up BMP with the first sample's pixels
+    ImageInfo info;
+    std::vector<unsigned char> pixels;
+    std::string error;
+    if (image_decode::decode(samples[0].bytes.data(), samples[0].bytes.size(), info, pixels, error) && info.channels == 3) {
+        size_t stride = (info.rowBytes() + 3) & ~size_t(3);
+        std::vector<unsigned char> bmp(54 + stride * info.height, 0);
+        auto put32 = [&](size_t offset, uint32_t value) { std::memcpy(&bmp[offset], &value, 4); };
+        bmp[0] = 'B';
+        bmp[1] = 'M';
+        put32(2, static_cast<uint32_t>(bmp.size()));
+        put32(10, 54);
+        put32(14, 40);
+        put32(18, static_cast<uint32_t>(info.width));
+        put32(22, static_cast<uint32_t>(info.height));
+        bmp[26] = 1;
+        bmp[28] = 24;
+        for (int y = 0; y < info.height; y++) {
+            const unsigned char* source = &pixels[(info.height - 1 - y) * info.rowBytes()];
+            unsigned char* row = &bmp[54 + y * stride];
+            for (int x = 0; x < info.width; x++) {
+                row[x * 3] = source[x * 3 + 2];
+                row[x * 3 + 1] = source[x * 3 + 1];
+                row[x * 3 + 2] = source[x * 3];
+            }
+        }
+        samples.push_back({"bmp 24-bit", std::move(bmp)});
+    }
+
+    std::vector<std::string> formats;
+    for (const Sample& sample : samples) {
+        if (std::find(formats.begin(), formats.end(), sample.format) == formats.end()) formats.push_back(sample.format);
+    }
+
+    std::cout << std::left << std::setw(12) << "format" << std::setw(16) << "decoder" << std::right
+              << std::setw(12) << "MB pixels" << std::setw(14) << "MB/s pixels" << std::setw(14) << "MB/s input"
+              << std::endl << std::fixed << std::setprecision(1);
+    for (const std::string& format : formats) {
+        for (const auto& decoder : image_decode::decoders()) {
+            std::vector<const Sample*> taken;
+            std::vector<ImageInfo> infos;
+            double inputBytes = 0, outputBytes = 0;
+            size_t largest = 0;
+            for (const Sample& sample : samples) {
+                if (sample.format != format) continue;
+                ImageInfo probed;
+                if (!decoder->probe(sample.bytes.data(), sample.bytes.size(), probed)) continue;
+                taken.push_back(&sample);
+                infos.push_back(probed);
+                inputBytes += sample.bytes.size();
+                outputBytes += probed.byteSize();
+                largest = std::max(largest, probed.byteSize());
+            }
+            if (taken.empty()) continue;
+
+            std::vector<unsigned char> destination(largest);
+            bool failed = false;
+            double seconds = timeIt([&]() {
+                for (size_t i = 0; i < taken.size(); i++) {
+                    const Sample& sample = *taken[i];
+                    if (!decoder->decode(sample.bytes.data(), sample.bytes.size(), infos[i], destination.data(), error)) {
+                        failed = true;
+                    }
+                }
+            }, 0.5);
+            if (failed) std::cerr << decoder->name() << " failed on " << format << ": " << error << std::endl;
+
+            std::cout << std::left << std::setw(12) << format << std::setw(16) << decoder->name() << std::right
+                      << std::setw(12) << outputBytes / 1048576.0 << std::setw(14) << outputBytes / seconds / 1048576.0
+                      << std::setw(14) << inputBytes / seconds / 1048576.0 << std::endl;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Step a pile of rigid bodies falling into a walled yard
+ *
+ * Drops 200, 400 and 800 boxes, spheres and capsules at once and steps them
+ * for ten seconds of game time on the job system, with the SIMD contact
+ * kernel and with the scalar one. Reports the average and worst step and
+ * the counters of the last step, when most of the pile is still awake.
+ */
+static int benchPhysics() {
+    CollisionWorld level;
+    const glm::vec3 yardMin(-6.0f, -1.0f, -6.0f), yardMax(6.0f, 0.0f, 6.0f);
+    AABB floor;
+    floor.min = yardMin;
+    floor.max = yardMax;
+    level.addBox(floor);
+    for (int side = 0; side < 4; side++) {
+        AABB wall;
+        wall.min = glm::vec3(side == 1 ? 6.0f : -6.5f, 0.0f, side == 3 ? 6.0f : -6.5f);
+        wall.max = glm::vec3(side == 0 ? -6.0f : 6.5f, 4.0f, side == 2 ? -6.0f : 6.5f);
+        level.addBox(wall);
+    }
+    level.build();
+
+    JobSystem jobs;
+    std::cout << std::setw(8) << "bodies" << std::setw(8) << "kernel" << std::setw(12) << "avg ms" << std::setw(12)
+              << "worst ms" << std::setw(10) << "awake" << std::setw(10) << "contacts" << std::setw(10) << "islands"
+              << std::endl << std::fixed << std::setprecision(3);
+    for (int count : {200, 400, 800}) {
+        for (bool simd : {true, false}) {
+            PhysicsWorld::simdContacts = simd;
+            PhysicsWorld world;
+            world.setLevel(&level);
+            std::mt19937 rng(42);
+            std::uniform_real_distribution<float> spread(-5.0f, 5.0f), height(0.5f, 12.0f), tilt(-0.2f, 0.2f);
+            for (int i = 0; i < count; i++) {
+                RigidBodyDesc desc;
+                desc.shape = i % 3 == 0 ? CollisionShape::box(glm::vec3(0.25f, 0.2f, 0.3f))
+                           : i % 3 == 1 ? CollisionShape::sphere(0.25f) : CollisionShape::capsule(0.15f, 0.25f);
+                desc.position = glm::vec3(spread(rng), height(rng), spread(rng));
+                desc.orientation = glm::normalize(glm::quat(1.0f, tilt(rng), tilt(rng), tilt(rng)));
+                world.addBody(desc);
+            }
+
+            const int steps = 600;
+            double total = 0.0, worst = 0.0;
+            for (int i = 0; i < steps; i++) {
+                auto start = std::chrono::steady_clock::now();
+                world.step(PHYSICS_TIMESTEP, &jobs);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                total += seconds;
+                worst = std::max(worst, seconds);
+            }
+            const PhysicsStats& stats = world.stats();
+            std::cout << std::setw(8) << count << std::setw(8) << (simd ? "simd" : "scalar") << std::setw(12)
+                      << total / steps * 1e3 << std::setw(12) << worst * 1e3 << std::setw(10) << stats.awake
+                      << std::setw(10) << stats.contacts << std::setw(10) << stats.islands << std::endl;
+        }
+    }
+    PhysicsWorld::simdContacts = true;
+    return 0;
+}
+
+/**
+ * @brief Resolve melee swings against growing crowds, and fast swings at several tick rates
+ *
+ * First sweeps 16 blades a tick through crowds of 100, 1000 and 10000
+ * targets spread over a field that grows with them, as a spawner keeps the
+ * density even, standing still and then all moving every tick. The sweeps
+ * should cost the same at every size; a walking crowd adds moving its
+ * targets and rebuilding the grid. Then
+ * swings a blade through half a circle in 0.15 s at a target 5 cm thin,
+ * placed at 100 angles along the arc, ticking at 15 to 240 Hz, and counts
+ * the targets struck by the swept test and by testing only each tick's
+ * pose of the blade.
+ */
+static int benchMelee() {
+    HitboxSet figure;
+    AABB figureBounds;
+    figureBounds.min = glm::vec3(-0.3f, 0.0f, -0.2f);
+    figureBounds.max = glm::vec3(0.3f, 1.8f, 0.2f);
+    figure.fromBounds(figureBounds);
+
+    JobSystem jobs;
+    const int swingCount = 16, ticks = 200;
+    std::cout << std::setw(8) << "targets" << std::setw(8) << "crowd" << std::setw(12) << "avg ms" << std::setw(12)
+              << "candidates" << std::setw(10) << "samples" << std::setw(8) << "hits" << std::endl
+              << std::fixed << std::setprecision(3);
+    for (int count : {100, 1000, 10000}) {
+        for (bool walking : {false, true}) {
+            CombatSystem combat;
+            std::mt19937 rng(7);
+            float field = 4.0f * std::sqrt(static_cast<float>(count));
+            std::uniform_real_distribution<float> spread(-field * 0.5f, field * 0.5f), turn(0.0f, 6.2832f);
+            std::vector<glm::vec3> positions;
+            std::vector<float> headings;
+            std::vector<TargetId> ids;
+            for (int i = 0; i < count; i++) {
+                positions.push_back(glm::vec3(spread(rng), 0.0f, spread(rng)));
+                headings.push_back(turn(rng));
+                glm::mat4 model = glm::rotate(glm::translate(glm::mat4(1.0f), positions[i]), headings[i], glm::vec3(0, 1, 0));
+                ids.push_back(combat.addTarget(&figure, model));
+            }
+
+            // Each fighter circles a target of its own, a metre and a half away
+            double total = 0.0;
+            size_t candidates = 0, samples = 0, hits = 0;
+            std::vector<SwingId> swings(swingCount);
+            for (int tick = 0; tick < ticks; tick++) {
+                int phase = tick % 10;
+                for (int s = 0; s < swingCount; s++) {
+                    if (phase == 0) swings[s] = combat.beginSwing(0.04f);
+                    glm::vec3 fighter = positions[s * count / swingCount] + glm::vec3(1.5f, 0.0f, 0.0f);
+                    float angle = 2.0f + phase * 0.25f;
+                    glm::vec3 dir(std::cos(angle), 0.0f, std::sin(angle));
+                    combat.sweep(swings[s], fighter + glm::vec3(0, 1.2f, 0) + dir * 0.3f,
+                                 fighter + glm::vec3(0, 1.2f, 0) + dir * 1.2f);
+                    if (phase == 9) combat.endSwing(swings[s]);
+                }
+                auto start = std::chrono::steady_clock::now();
+                if (walking) {
+                    // Shuffling on the spot, so the fighters still reach them
+                    for (int i = 0; i < count; i++) {
+                        glm::vec3 step(0.02f * std::sin(tick * 0.3f + i), 0.0f, 0.0f);
+                        combat.moveTarget(ids[i], glm::rotate(glm::translate(glm::mat4(1.0f), positions[i] + step),
+                                                              headings[i], glm::vec3(0, 1, 0)));
+                    }
+                }
+                hits += combat.resolve(&jobs).size();
+                total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                candidates += combat.stats().candidates;
+                samples += combat.stats().samples;
+            }
+            std::cout << std::setw(8) << count << std::setw(8) << (walking ? "walking" : "still") << std::setw(12)
+                      << total / ticks * 1e3 << std::setw(12) << static_cast<double>(candidates) / ticks << std::setw(10)
+                      << samples / ticks << std::setw(8) << hits << std::endl;
+        }
+    }
+
+    HitboxSet slab;
+    AABB slabBounds;
+    slabBounds.min = glm::vec3(-0.025f, 0.0f, -0.3f);
+    slabBounds.max = glm::vec3(0.025f, 1.8f, 0.3f);
+    slab.fromBounds(slabBounds);
+    const float swingTime = 0.15f, placements = 100;
+    std::cout << std::endl << std::setw(8) << "Hz" << std::setw(10) << "swept" << std::setw(10) << "per tick" << std::endl;
+    for (int rate : {15, 30, 60, 144, 240}) {
+        int struck[2] = {0, 0};
+        for (int swept = 0; swept < 2; swept++) {
+            for (int p = 0; p < placements; p++) {
+                // A metre out, somewhere on the arc, thin along the blade's path
+                float placed = 3.1416f * (p + 0.5f) / placements;
+                glm::mat4 model = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(placed), 0.0f, std::sin(placed))),
+                                              -placed - 1.5708f, glm::vec3(0, 1, 0));
+                CombatSystem combat;
+                combat.addTarget(&slab, model);
+                float dt = 1.0f / rate;
+                SwingId swing = combat.beginSwing(0.04f);
+                for (float t = 0.0f; t < swingTime + dt; t += dt) {
+                    float angle = 3.1416f * std::min(t / swingTime, 1.0f);
+                    glm::vec3 dir(std::cos(angle), 0.0f, std::sin(angle));
+                    if (!swept) swing = combat.beginSwing(0.04f);
+                    combat.sweep(swing, glm::vec3(0, 1.2f, 0) + dir * 0.3f, glm::vec3(0, 1.2f, 0) + dir * 1.2f);
+                    if (!swept) combat.endSwing(swing);
+                    if (!combat.resolve(nullptr).empty()) {
+                        struck[swept]++;
+                        break;
+                    }
+                }
+            }
+        }
+        std::cout << std::setw(8) << rate << std::setw(9) << struck[1] << "%" << std::setw(9) << struck[0] << "%"
+                  << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * @brief Kill a crowd of monsters in one frame and let them fall, under several budgets
+ *
+ * 48 humanoids of 24 bones each die at once on flat ground and are
+ * simulated for ten seconds with pools of 100, 200 and 400 bodies, and
+ * with one big enough for all of them. Reports the average and worst
+ * frame, physics and ragdoll update together, the most bodies simulated
+ * at once, and how many ragdolls ended frozen.
+ */
+static int benchRagdoll() {
+    struct Bone {
+        const char* name;
+        int parent;
+        glm::vec3 position;
+    };
+    static const Bone humanoid[] = {
+        {"hips", -1, {0.0f, 1.0f, 0.0f}}, {"spine", 0, {0.0f, 1.15f, 0.0f}}, {"chest", 1, {0.0f, 1.35f, 0.0f}},
+        {"neck", 2, {0.0f, 1.55f, 0.0f}}, {"head", 3, {0.0f, 1.62f, 0.0f}}, {"headEnd", 4, {0.0f, 1.85f, 0.0f}},
+        {"shoulder.L", 2, {0.08f, 1.5f, 0.0f}}, {"arm.L", 6, {0.2f, 1.5f, 0.0f}}, {"forearm.L", 7, {0.48f, 1.5f, 0.0f}},
+        {"hand.L", 8, {0.74f, 1.5f, 0.0f}}, {"finger.L", 9, {0.8f, 1.5f, 0.0f}},
+        {"shoulder.R", 2, {-0.08f, 1.5f, 0.0f}}, {"arm.R", 11, {-0.2f, 1.5f, 0.0f}},
+        {"forearm.R", 12, {-0.48f, 1.5f, 0.0f}}, {"hand.R", 13, {-0.74f, 1.5f, 0.0f}},
+        {"finger.R", 14, {-0.8f, 1.5f, 0.0f}},
+        {"thigh.L", 0, {0.1f, 0.95f, 0.0f}}, {"shin.L", 16, {0.1f, 0.52f, 0.0f}}, {"foot.L", 17, {0.1f, 0.08f, 0.0f}},
+        {"toe.L", 18, {0.1f, 0.02f, 0.16f}},
+        {"thigh.R", 0, {-0.1f, 0.95f, 0.0f}}, {"shin.R", 20, {-0.1f, 0.52f, 0.0f}}, {"foot.R", 21, {-0.1f, 0.08f, 0.0f}},
+        {"toe.R", 22, {-0.1f, 0.02f, 0.16f}},
+    };
+    std::vector<SceneNode> nodes(sizeof(humanoid) / sizeof(humanoid[0]));
+    Skin skin;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i].name = humanoid[i].name;
+        nodes[i].parent = humanoid[i].parent;
+        if (humanoid[i].parent >= 0) nodes[humanoid[i].parent].children.push_back(static_cast<int>(i));
+        nodes[i].world = glm::translate(glm::mat4(1.0f), humanoid[i].position);
+        skin.joints.push_back(static_cast<int>(i));
+    }
+    RagdollTemplate ragdoll;
+    ragdoll.fromSkeleton(nodes, skin, 70.0f);
+
+    CollisionWorld level;
+    AABB ground;
+    ground.min = glm::vec3(-30.0f, -1.0f, -30.0f);
+    ground.max = glm::vec3(30.0f, 0.0f, 30.0f);
+    level.addBox(ground);
+    level.build();
+
+    JobSystem jobs;
+    const int kills = 48, frames = 600;
+    std::cout << ragdoll.bodies.size() << " bodies per ragdoll" << std::endl;
+    std::cout << std::setw(8) << "budget" << std::setw(12) << "avg ms" << std::setw(12) << "worst ms" << std::setw(12)
+              << "most bodies" << std::setw(8) << "frozen" << std::endl << std::fixed << std::setprecision(3);
+    for (size_t budget : {size_t(100), size_t(200), size_t(400), kills * ragdoll.bodies.size()}) {
+        PhysicsWorld world;
+        world.setLevel(&level);
+        RagdollSystem ragdolls;
+        ragdolls.create(&world, budget, budget, kills);
+        for (int i = 0; i < kills; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((i % 8) * 2.5f - 9.0f, 0.0f, (i / 8) * 2.5f - 6.0f));
+            ragdolls.spawn(ragdoll, glm::rotate(model, 0.7f * i, glm::vec3(0, 1, 0)), glm::vec3(1.5f, 0.5f, 0.0f));
+        }
+
+        double total = 0.0, worst = 0.0;
+        size_t most = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            world.step(PHYSICS_TIMESTEP, &jobs);
+            ragdolls.update(PHYSICS_TIMESTEP);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            total += seconds;
+            worst = std::max(worst, seconds);
+            most = std::max(most, ragdolls.stats().bodies);
+        }
+        std::cout << std::setw(8) << budget << std::setw(12) << total / frames * 1e3 << std::setw(12) << worst * 1e3
+                  << std::setw(12) << most << std::setw(8) << ragdolls.stats().frozen << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * @brief Churn monsters through spawn, kill and despawn, pooled and heap-allocated
+ *
+ * The pooled path is what the game does: an EntityPool slot, preallocated
+ * transform and instance rows, a combat target and a ragdoll from reserved
+ * pools. The heap path gives every monster its own object with vectors of
+ * bones and hitboxes, as ModelLoader-style objects would. The allocation
+ * tracker counts heap calls during the churn; any on the pooled path fail
+ * the benchmark.
+ */
+static int benchSpawn() {
+    const uint32_t capacity = 256;
+    const int operations = 200000;
+    AABB modelBounds;
+    modelBounds.min = glm::vec3(-0.4f, 0.0f, -0.3f);
+    modelBounds.max = glm::vec3(0.4f, 1.8f, 0.3f);
+    HitboxSet hitboxes;
+    hitboxes.fromBounds(modelBounds);
+    RagdollTemplate ragdoll;
+    ragdoll.fromBounds(modelBounds, 90.0f);
+
+    struct Monster {
+        TargetId target = 0;
+        RagdollId corpse = NO_RAGDOLL;
+    };
+    PhysicsWorld world;
+    RagdollSystem ragdolls;
+    ragdolls.create(&world, 64, 64, capacity);
+    ragdolls.reserve(ragdoll);
+    CombatSystem combat;
+    combat.reserveTargets(capacity);
+    EntityPool pool;
+    pool.create(capacity);
+    std::vector<Monster> monsters(capacity);
+    TransformSoA transforms;
+    transforms.reserve(capacity);
+    for (uint32_t i = 0; i < capacity; i++) transforms.push(glm::vec3(0.0f), glm::quat(1, 0, 0, 0), glm::vec3(1.0f));
+    std::vector<InstanceMatrices> instances(capacity);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-40.0f, 40.0f);
+    auto spawn = [&]() {
+        EntityHandle entity = pool.spawn();
+        if (!pool.alive(entity)) return;
+        uint32_t slot = entity.index;
+        transforms.set(slot, glm::vec3(coord(rng), 0.0f, coord(rng)), glm::quat(1, 0, 0, 0), glm::vec3(1.0f));
+        buildInstanceMatrices(transforms, slot, slot + 1, instances.data() + slot);
+        monsters[slot] = {combat.addTarget(&hitboxes, instances[slot].model), NO_RAGDOLL};
+    };
+    auto killMonster = [&](Monster& monster, const glm::mat4& model) {
+        if (monster.corpse != NO_RAGDOLL) return;
+        combat.removeTarget(monster.target);
+        monster.corpse = ragdolls.spawn(ragdoll, model, glm::vec3(0.0f, 0.0f, 2.0f));
+    };
+    auto dropMonster = [&](Monster& monster) {
+        if (monster.corpse != NO_RAGDOLL) ragdolls.release(monster.corpse);
+        else combat.removeTarget(monster.target);
+    };
+    auto kill = [&](uint32_t slot) { killMonster(monsters[slot], instances[slot].model); };
+    auto despawn = [&](uint32_t slot) {
+        dropMonster(monsters[slot]);
+        pool.despawn(pool.handle(slot));
+    };
+    auto churn = [&](int count) {
+        for (int i = 0; i < count; i++) {
+            uint32_t roll = rng() % 3;
+            if (roll == 0 || pool.size() == 0) {
+                spawn();
+            } else {
+                uint32_t slot = pool.live()[rng() % pool.size()];
+                if (roll == 1) kill(slot);
+                else despawn(slot);
+            }
+        }
+    };
+
+    // One pass fills every slot and pool once, as the first minutes of play would
+    for (uint32_t i = 0; i < capacity; i++) spawn();
+    for (uint32_t i = 0; i < capacity; i++) kill(i);
+    while (pool.size() > 0) despawn(pool.live()[0]);
+
+    AllocationCounts before = threadAllocations();
+    auto start = std::chrono::steady_clock::now();
+    churn(operations);
+    double pooledSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    AllocationCounts after = threadAllocations();
+    uint64_t pooledAllocations = after.allocations - before.allocations;
+
+    // The same churn with every monster its own heap object
+    struct HeapMonster {
+        std::string name;
+        std::vector<glm::mat4> bones;
+        std::vector<Hitbox> boxes;
+        TransformSoA transform;
+        InstanceMatrices instance;
+        Monster state;
+    };
+    std::vector<std::unique_ptr<HeapMonster>> heap;
+    before = threadAllocations();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < operations; i++) {
+        uint32_t roll = rng() % 3;
+        if (roll == 0 || heap.empty()) {
+            if (heap.size() == capacity) continue;
+            auto monster = std::make_unique<HeapMonster>();
+            monster->name = "monster in the woods";
+            monster->bones = hitboxes.bones;
+            monster->boxes = hitboxes.boxes;
+            monster->transform.push(glm::vec3(coord(rng), 0.0f, coord(rng)), glm::quat(1, 0, 0, 0), glm::vec3(1.0f));
+            buildInstanceMatrices(monster->transform, &monster->instance);
+            monster->state = {combat.addTarget(&hitboxes, monster->instance.model), NO_RAGDOLL};
+            heap.push_back(std::move(monster));
+        } else {
+            size_t index = rng() % heap.size();
+            if (roll == 1) {
+                killMonster(heap[index]->state, heap[index]->instance.model);
+            } else {
+                dropMonster(heap[index]->state);
+                heap[index] = std::move(heap.back());
+                heap.pop_back();
+            }
+        }
+    }
+    double heapSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    after = threadAllocations();
+    uint64_t heapAllocations = after.allocations - before.allocations;
+
+    std::cout << operations << " spawn/kill/despawn operations on " << capacity << " monsters" << std::endl
+              << std::fixed << std::setprecision(1);
+    std::cout << std::setw(8) << "pooled" << std::setw(10) << pooledSeconds / operations * 1e9 << " ns/op"
+              << std::setw(10) << pooledAllocations << " heap allocations" << std::endl;
+    std::cout << std::setw(8) << "heap" << std::setw(10) << heapSeconds / operations * 1e9 << " ns/op" << std::setw(10)
+              << heapAllocations << " heap allocations" << std::endl;
+    pool.report(std::cout, "Pool");
+    if (pooledAllocations != 0) {
+        std::cerr << "ERROR::SPAWN:: pooled spawning allocated " << pooledAllocations << " times" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Swing the house's double door open and shut under monsters planning paths into the house
+ *
+ * Every 20 frames the door flips, which rebuilds the tiles around the
+ * doorway on the workers and sends every path through it back to
+ * planning. Reports how long rebuilt tiles take to be swapped in and what
+ * the per-frame update costs.
+ */
+static int benchNavmesh() {
+    const float floor = 0.0f;
+    CollisionWorld level;
+    SurfaceMesh ground, walls;
+    buildWoodsGround(ground, floor);
+    buildHouseWalls(walls, floor);
+    for (const SurfaceMesh* surface : {&ground, &walls}) {
+        for (const AABB& box : surface->collisionBoxes()) level.addBox(box);
+    }
+    level.build();
+
+    JobSystem jobs;
+    NavMesh nav;
+    auto start = std::chrono::steady_clock::now();
+    nav.create(ground.bounds(), floor, &level, &jobs);
+    double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const glm::vec3 leafHalf(HOUSE_DOOR_HALF_WIDTH * 0.5f - 0.03f, HOUSE_DOOR_HEIGHT * 0.5f - 0.05f, 0.03f);
+    const float doorZ = HOUSE_NEAR_Z - HOUSE_WALL_THICKNESS * 0.5f;
+    auto leaf = [&](float side, bool open) {
+        glm::vec3 hinge(side * (HOUSE_DOOR_HALF_WIDTH - 0.04f), floor + 0.05f + leafHalf.y, doorZ);
+        if (!open) return NavObstacle{hinge - glm::vec3(side * leafHalf.x, 0.0f, 0.0f), glm::quat(1, 0, 0, 0), leafHalf};
+        glm::quat swung = glm::angleAxis(side * 1.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+        return NavObstacle{hinge + swung * glm::vec3(-side * leafHalf.x, 0.0f, 0.0f), swung, leafHalf};
+    };
+    uint32_t leaves[2] = {nav.addObstacle(leaf(-1.0f, false)), nav.addObstacle(leaf(1.0f, false))};
+
+    const int agents = 32, frames = 600;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coord(-28.0f, 28.0f);
+    nav.reservePaths(agents);
+    for (int i = 0; i < agents; i++) nav.requestPath(glm::vec3(coord(rng), floor, -20.0f - std::abs(coord(rng)) * 0.8f), glm::vec3(0.0f, floor, 0.0f));
+
+    double total = 0.0, worst = 0.0;
+    bool open = false;
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame % 20 == 19) {
+            open = !open;
+            nav.moveObstacle(leaves[0], leaf(-1.0f, open));
+            nav.moveObstacle(leaves[1], leaf(1.0f, open));
+        }
+        auto begin = std::chrono::steady_clock::now();
+        nav.update(2);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        total += ms;
+        worst = std::max(worst, ms);
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+    jobs.waitIdle();
+
+    const NavMeshStats& stats = nav.stats();
+    std::cout << std::fixed << std::setprecision(3) << stats.tiles << " tiles built in " << createMs << " ms" << std::endl;
+    std::cout << "update: " << total / frames << " ms avg, " << worst << " ms worst" << std::endl;
+    nav.report(std::cout);
+    return 0;
+}
+
+/**
+ * @brief Run a developer benchmark by name and print its results
+ *
+ * @param name Benchmark name, as given to `EscapeTheAbyss --bench <name>`
+ * @return int Process exit status
+ */
+int runBenchmark(const std::string& name) {
+    if (name == "transforms") return benchTransforms();
+    if (name == "submission") return benchSubmission();
+    if (name == "suballoc") return benchSuballocator();
+    if (name == "glb") return benchGlb();
+    if (name == "codec") return benchCodec();
+    if (name == "io") return benchIo();
+    if (name == "images") return benchImages();
+    if (name == "physics") return benchPhysics();
+    if (name == "melee") return benchMelee();
+    if (name == "ragdoll") return benchRagdoll();
+    if (name == "spawn") return benchSpawn();
+    if (name == "navmesh") return benchNavmesh();
+
+    std::cerr << "Unknown benchmark: " << name << std::endl;
+    return 1;
+}
@@ -0,0 +1,129 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Maximum number of primitives stored in a single leaf
+ */
+const uint32_t BVH_LEAF_SIZE = 4;
+
+/**
+ * @brief Transform a box and return the bounds of the result
+ *
+ * @param m Affine transform to apply
+ * @return AABB Box enclosing the transformed corners
+ *
+ * Uses Arvo's method: each output axis is accumulated from the min/max of the
+ * matrix entries times the source extents, which avoids transforming 8 corners.
+ */
+AABB AABB::transformed(const glm::mat4& m) const {
+    AABB result;
+    for (int axis = 0; axis < 3; axis++) {
+        result.min[axis] = result.max[axis] = m[3][axis];
+        for (int col = 0; col < 3; col++) {
+            float a = m[col][axis] * min[col];
+            float b = m[col][axis] * max[col];
+            result.min[axis] += std::min(a, b);
+            result.max[axis] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Slab test of a ray against a box
+ *
+ * @param origin Ray origin
+ * @param invDir Component-wise reciprocal of the ray direction
+ * @param box Box to test
+ * @param maxDist Maximum distance along the ray
+ * @return float Entry distance, 0 if the origin is inside, or -1 on a miss
+ */
+float intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDir, const AABB& box, float maxDist) {
+    glm::vec3 t0 = (box.min - origin) * invDir;
+    glm::vec3 t1 = (box.max - origin) * invDir;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDist));
+    return enter <= exit ? enter : -1.0f;
+}
+
+/**
+ * @brief Rebuild the hierarchy from a set of primitive bounds
+ *
+ * @param boxes Bounds of each primitive; the index is the primitive id
+ *
+ * Splits at the centroid median of the longest axis. This is cheaper to build
+ * than a SAH split and good enough for the few hundred static colliders a
+ * level holds; it also bounds the depth to log2(n), well within
+ * BVH_STACK_SIZE.
+ */
+void Bvh::build(const std::vector<AABB>& boxes) {
+    nodes.clear();
+    primitives.resize(boxes.size());
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+        primitives[i] = i;
+    }
+    if (boxes.empty()) return;
+
+    nodes.reserve(2 * boxes.size());
+    buildRecursive(boxes, 0, static_cast<uint32_t>(boxes.size()));
+}
+
+/**
+ * @brief Levels below the root on the longest path to a leaf
+ *
+ * @param nodes Nodes laid out as build() does, children after their parent
+ * @param count Number of nodes
+ * @return uint32_t 0 for a single leaf or an empty tree
+ */
+uint32_t Bvh::depth(const Node* nodes, size_t count) {
+    std::vector<uint32_t> levels(count, 0);
+    uint32_t deepest = 0;
+    for (size_t i = 0; i < count; i++) {
+        deepest = std::max(deepest, levels[i]);
+        if (nodes[i].count > 0) continue;
+        levels[i + 1] = std::max(levels[i + 1], levels[i] + 1);
+        levels[nodes[i].rightOrFirst] = std::max(levels[nodes[i].rightOrFirst], levels[i] + 1);
+    }
+    return deepest;
+}
+
+/**
+ * @brief Build the subtree covering primitives[first, first + count)
+ *
+ * @return uint32_t Index of the subtree root in the node array
+ */
+uint32_t Bvh::buildRecursive(const std::vector<AABB>& boxes, uint32_t first, uint32_t count) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({});
+
+    AABB bounds, centroids;
+    for (uint32_t i = first; i < first + count; i++) {
+        bounds.expand(boxes[primitives[i]]);
+        centroids.expand(boxes[primitives[i]].center());
+    }
+    nodes[index].bounds = bounds;
+
+    if (count <= BVH_LEAF_SIZE) {
+        nodes[index].rightOrFirst = first;
+        nodes[index].count = count;
+        return index;
+    }
+
+    glm::vec3 extent = centroids.extent();
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    uint32_t half = count / 2;
+    std::nth_element(primitives.begin() + first, primitives.begin() + first + half, primitives.begin() + first + count,
+                     [&](uint32_t a, uint32_t b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+
+    buildRecursive(boxes, first, half);
+    uint32_t right = buildRecursive(boxes, first + half, count - half);
+
+    nodes[index].rightOrFirst = right;
+    nodes[index].count = 0;
+    return index;
+}
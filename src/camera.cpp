@@ -0,0 +1,104 @@
+#include "camera.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+/**
+ * @brief World up vector shared by both rigs
+ */
+const glm::vec3 WORLD_UP = glm::vec3(0.0f, 1.0f, 0.0f);
+
+/**
+ * @brief Critically damped spring towards a target
+ *
+ * @param current Current value
+ * @param target Value to approach
+ * @param velocity Spring velocity, carried between calls
+ * @param smoothTime Approximate time to reach the target
+ * @param deltaTime Frame time in seconds
+ * @return float New value
+ *
+ * Closed-form integration of a critically damped spring (Game Programming
+ * Gems 4, ch. 1.10). Unlike lerping by a fixed factor per frame, the result
+ * after one second is the same at 30 fps and at 144 fps.
+ */
+float smoothDamp(float current, float target, float& velocity, float smoothTime, float deltaTime) {
+    float omega = 2.0f / std::max(smoothTime, 1e-4f);
+    float x = omega * deltaTime;
+    float decay = 1.0f / (1.0f + x + 0.48f * x * x + 0.235f * x * x * x);
+    float change = current - target;
+    float temp = (velocity + omega * change) * deltaTime;
+    velocity = (velocity - omega * temp) * decay;
+    return target + (change + temp) * decay;
+}
+
+/**
+ * @brief Component-wise critically damped spring towards a target
+ */
+glm::vec3 smoothDamp(const glm::vec3& current, const glm::vec3& target, glm::vec3& velocity, float smoothTime, float deltaTime) {
+    glm::vec3 result;
+    for (int i = 0; i < 3; i++) {
+        result[i] = smoothDamp(current[i], target[i], velocity[i], smoothTime, deltaTime);
+    }
+    return result;
+}
+
+/**
+ * @brief Switch between the first- and third-person rigs
+ *
+ * The third-person rig starts from its rest pose instead of springing out
+ * from the player's head.
+ */
+void CameraSystem::toggleMode() {
+    mode = mode == CameraMode::FirstPerson ? CameraMode::ThirdPerson : CameraMode::FirstPerson;
+    snapNextUpdate = true;
+}
+
+/**
+ * @brief Update the active rig and compute this frame's view matrix
+ *
+ * @param eye Position of the player's eyes
+ * @param front Normalized look direction of the player
+ * @param deltaTime Frame time in seconds
+ * @param world Static colliders the boom must not pass through
+ */
+void CameraSystem::update(const glm::vec3& eye, const glm::vec3& front, float deltaTime, const CollisionWorld& world) {
+    camFront = front;
+
+    if (mode == CameraMode::FirstPerson) {
+        camPosition = eye;
+    } else {
+        glm::vec3 targetPivot = eye + WORLD_UP * boomHeight;
+        if (snapNextUpdate) {
+            pivot = targetPivot;
+            pivotVelocity = glm::vec3(0.0f);
+        } else {
+            pivot = smoothDamp(pivot, targetPivot, pivotVelocity, followTime, deltaTime);
+        }
+
+        // Probe from the player (always outside walls) to the pivot, then along the boom
+        float allowed = boomLength;
+        CastHit hit;
+        glm::vec3 toPivot = pivot - eye;
+        float pivotDist = glm::length(toPivot);
+        glm::vec3 base = pivot;
+        if (pivotDist > 1e-4f && world.sphereCast(eye, toPivot / pivotDist, probeRadius, pivotDist, hit)) {
+            base = hit.point;
+            allowed = 0.0f;
+        } else if (world.sphereCast(pivot, -front, probeRadius, boomLength, hit)) {
+            allowed = hit.distance;
+        }
+
+        // Pull in immediately so the camera never enters geometry, ease back out
+        if (snapNextUpdate || allowed < boom) {
+            boom = allowed;
+            boomVelocity = 0.0f;
+        } else {
+            boom = std::min(smoothDamp(boom, allowed, boomVelocity, extendTime, deltaTime), allowed);
+        }
+
+        camPosition = base - front * boom;
+    }
+
+    snapNextUpdate = false;
+    viewMatrix = glm::lookAt(camPosition, camPosition + camFront, WORLD_UP);
+}
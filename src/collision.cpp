@@ -0,0 +1,127 @@
+#include "collision.h"
+#include <cmath>
+
+/**
+ * @brief Add a static box collider
+ *
+ * @param box World-space bounds of the collider
+ * @return uint32_t Collider index reported back in CastHit
+ *
+ * The BVH is not updated until build() is called.
+ */
+uint32_t CollisionWorld::addBox(const AABB& box) {
+    boxes.push_back(box);
+    enabledFlags.push_back(1);
+    return static_cast<uint32_t>(boxes.size() - 1);
+}
+
+/**
+ * @brief Remove all colliders and the hierarchy built over them
+ */
+void CollisionWorld::clear() {
+    boxes.clear();
+    enabledFlags.clear();
+    build();
+}
+
+/**
+ * @brief Rebuild the BVH and the grid over the current set of colliders
+ */
+void CollisionWorld::build() {
+    bvh.build(boxes);
+    spatialGrid.build(boxes, COLLISION_GRID_CELL_SIZE);
+}
+
+/**
+ * @brief Replace the colliders and BVH with prebuilt ones
+ *
+ * @param colliders Collider boxes
+ * @param nodes BVH nodes built over exactly these boxes
+ * @param primitives BVH primitive order
+ *
+ * Copies the arrays as they are. The grid is not touched; the caller
+ * assigns it through grid() when it has one, or calls build() instead.
+ */
+void CollisionWorld::load(const AABB* colliders, size_t count, const Bvh::Node* nodes, size_t nodeCount,
+                          const uint32_t* primitives, size_t primitiveCount) {
+    boxes.assign(colliders, colliders + count);
+    enabledFlags.assign(count, 1);
+    bvh.nodes.assign(nodes, nodes + nodeCount);
+    bvh.primitives.assign(primitives, primitives + primitiveCount);
+}
+
+/**
+ * @brief Switch a collider off, or back on, for every query
+ *
+ * Nothing is rebuilt: the collider keeps its place in the BVH and the grid.
+ */
+void CollisionWorld::setEnabled(uint32_t index, bool enabled) {
+    __atomic_store_n(&enabledFlags[index], static_cast<uint8_t>(enabled), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Cast a ray against all colliders
+ *
+ * @param origin Ray origin
+ * @param dir Normalized ray direction
+ * @param maxDist Maximum distance to test
+ * @param hit Filled with the closest hit, if any
+ * @return bool True if something was hit within maxDist
+ */
+bool CollisionWorld::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, CastHit& hit) const {
+    return sphereCast(origin, dir, 0.0f, maxDist, hit);
+}
+
+/**
+ * @brief Sweep a sphere against all colliders
+ *
+ * @param origin Sphere centre at the start of the sweep
+ * @param dir Normalized sweep direction
+ * @param radius Sphere radius
+ * @param maxDist Maximum sweep distance
+ * @param hit Filled with the closest hit, if any
+ * @return bool True if the sphere touched a collider within maxDist
+ *
+ * Each box is inflated by the radius and tested with a ray (the Minkowski sum
+ * with square corners). This is slightly conservative at box edges, which is
+ * the safe direction for keeping a camera or a body out of walls.
+ */
+bool CollisionWorld::sphereCast(const glm::vec3& origin, const glm::vec3& dir, float radius, float maxDist, CastHit& hit) const {
+    glm::vec3 invDir = 1.0f / dir;
+    glm::vec3 pad(radius);
+    bool found = false;
+
+    bvh.raycast(origin, dir, radius, maxDist, [&](uint32_t index, float closest) {
+        if (!enabled(index)) return closest;
+        AABB inflated{boxes[index].min - pad, boxes[index].max + pad};
+        float t = intersectRayAABB(origin, invDir, inflated, closest);
+        if (t < 0.0f || (found && t >= hit.distance)) return closest;
+
+        found = true;
+        hit.distance = t;
+        hit.point = origin + dir * t;
+        hit.collider = index;
+
+        // The face we entered through is the one whose slab was crossed last
+        glm::vec3 local = (hit.point - inflated.center()) / (inflated.extent() * 0.5f);
+        glm::vec3 mag = glm::abs(local);
+        int axis = mag.x > mag.y ? (mag.x > mag.z ? 0 : 2) : (mag.y > mag.z ? 1 : 2);
+        hit.normal = glm::vec3(0.0f);
+        hit.normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+        return t;
+    });
+
+    return found;
+}
+
+/**
+ * @brief Collect every collider whose bounds overlap a box
+ *
+ * @param box Query bounds
+ * @param out Receives collider indices; it is not cleared first
+ */
+void CollisionWorld::overlapAABB(const AABB& box, std::vector<uint32_t>& out) const {
+    bvh.queryAABB(box, [&](uint32_t index) {
+        if (enabled(index) && boxes[index].overlaps(box)) out.push_back(index);
+    });
+}
@@ -0,0 +1,467 @@
+#include "combat.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "job_system.h"
+
+namespace {
+
+/**
+ * @brief A hitbox placed in the world: centre, orthonormal axes and half extents along them
+ */
+struct OrientedBox {
+    glm::vec3 center;
+    glm::vec3 axes[3];
+    glm::vec3 half;
+};
+
+/**
+ * @brief Place a hitbox by a bone-to-world matrix, which may carry scale
+ *
+ * Matrices blended between two ticks are not quite orthogonal, so the axes
+ * are straightened again.
+ */
+OrientedBox placeBox(const Hitbox& box, const glm::mat4& boneToWorld) {
+    OrientedBox placed;
+    placed.center = glm::vec3(boneToWorld * glm::vec4(box.center, 1.0f));
+    glm::vec3 columns[3] = {glm::vec3(boneToWorld[0]), glm::vec3(boneToWorld[1]), glm::vec3(boneToWorld[2])};
+    glm::vec3 lengths(glm::length(columns[0]), glm::length(columns[1]), glm::length(columns[2]));
+    placed.axes[0] = columns[0] / lengths.x;
+    placed.axes[1] = glm::normalize(columns[1] - placed.axes[0] * glm::dot(placed.axes[0], columns[1]));
+    placed.axes[2] = glm::cross(placed.axes[0], placed.axes[1]);
+    placed.half = box.halfExtents * lengths;
+    return placed;
+}
+
+glm::vec3 toBox(const OrientedBox& box, const glm::vec3& p) {
+    glm::vec3 d = p - box.center;
+    return glm::vec3(glm::dot(box.axes[0], d), glm::dot(box.axes[1], d), glm::dot(box.axes[2], d));
+}
+
+glm::vec3 fromBox(const OrientedBox& box, const glm::vec3& local) {
+    return box.center + box.axes[0] * local.x + box.axes[1] * local.y + box.axes[2] * local.z;
+}
+
+/**
+ * @brief Nearest points of a segment and a box, in the box's space
+ *
+ * The squared distance from a point moving along the segment to the box is
+ * convex, so a ternary search over the segment finds its minimum.
+ *
+ * @return float Distance; 0 if the segment enters the box
+ */
+float segmentToBox(const glm::vec3& a, const glm::vec3& b, const glm::vec3& half, glm::vec3& onSegment, glm::vec3& onBox) {
+    auto distance2 = [&](float t) {
+        glm::vec3 p = a + (b - a) * t;
+        glm::vec3 d = p - glm::clamp(p, -half, half);
+        return glm::dot(d, d);
+    };
+    float lo = 0.0f, hi = 1.0f;
+    for (int i = 0; i < 24; i++) {
+        float m1 = lo + (hi - lo) / 3.0f, m2 = hi - (hi - lo) / 3.0f;
+        if (distance2(m1) <= distance2(m2)) hi = m2;
+        else lo = m1;
+    }
+    onSegment = a + (b - a) * ((lo + hi) * 0.5f);
+    onBox = glm::clamp(onSegment, -half, half);
+    return glm::length(onSegment - onBox);
+}
+
+glm::mat4 blendMatrix(const glm::mat4& from, const glm::mat4& to, float t) {
+    glm::mat4 blended;
+    for (int c = 0; c < 4; c++) blended[c] = glm::mix(from[c], to[c], t);
+    return blended;
+}
+
+AABB localBox(const Hitbox& box) {
+    AABB local;
+    local.min = box.center - box.halfExtents;
+    local.max = box.center + box.halfExtents;
+    return local;
+}
+
+} // namespace
+
+/**
+ * @brief One box per bone of a skin, from the joint to its child joints
+ *
+ * @param nodes Scene graph of the model, with world matrices
+ * @param skin Skin whose joints become the bones
+ *
+ * A bone's box spans its joint and the joints under it, padded by a
+ * quarter of the bone's length all round. End bones, such as a head or a
+ * hand, get a cube half their parent bone's length across.
+ */
+void HitboxSet::fromSkeleton(const std::vector<SceneNode>& nodes, const Skin& skin) {
+    bones.clear();
+    boneNames.clear();
+    boxes.clear();
+    std::vector<int> jointOf(nodes.size(), -1);
+    for (size_t j = 0; j < skin.joints.size(); j++) {
+        jointOf[skin.joints[j]] = static_cast<int>(j);
+        bones.push_back(nodes[skin.joints[j]].world);
+        boneNames.push_back(nodes[skin.joints[j]].name);
+    }
+
+    std::vector<AABB> spans(bones.size());
+    std::vector<float> lengths(bones.size(), 0.0f);
+    for (size_t j = 0; j < bones.size(); j++) {
+        glm::mat4 toBone = glm::inverse(bones[j]);
+        spans[j].expand(glm::vec3(0.0f));
+        for (int child : nodes[skin.joints[j]].children) {
+            if (jointOf[child] < 0) continue;
+            glm::vec3 local = glm::vec3(toBone * bones[jointOf[child]][3]);
+            spans[j].expand(local);
+            lengths[j] = std::max(lengths[j], glm::length(local));
+        }
+    }
+    for (size_t j = 0; j < bones.size(); j++) {
+        float length = lengths[j];
+        if (length == 0.0f) {
+            int parent = nodes[skin.joints[j]].parent;
+            length = parent >= 0 && jointOf[parent] >= 0 ? lengths[jointOf[parent]] * 0.5f : 0.0f;
+            if (length == 0.0f) continue;
+            spans[j].expand(glm::vec3(length * 0.5f));
+            spans[j].expand(glm::vec3(-length * 0.5f));
+        }
+        boxes.push_back({static_cast<int>(j), spans[j].center(), spans[j].extent() * 0.5f + glm::vec3(length * 0.25f)});
+    }
+    updateBounds();
+}
+
+/**
+ * @brief Head, torso and legs boxes over a model without a skeleton
+ *
+ * @param modelBounds Model-space bounds of a standing figure, Y up
+ *
+ * Each box gets a bone of its own, so hits still say where they landed.
+ */
+void HitboxSet::fromBounds(const AABB& modelBounds) {
+    struct Part {
+        const char* name;
+        float x0, x1, y0, y1;               // Fractions of the bounds
+    };
+    static const Part parts[] = {
+        {"head", 0.3f, 0.7f, 0.85f, 1.0f},
+        {"torso", 0.15f, 0.85f, 0.5f, 0.85f},
+        {"legs", 0.2f, 0.8f, 0.0f, 0.5f},
+    };
+    bones.clear();
+    boneNames.clear();
+    boxes.clear();
+    glm::vec3 size = modelBounds.extent();
+    for (const Part& part : parts) {
+        glm::vec3 low(modelBounds.min.x + size.x * part.x0, modelBounds.min.y + size.y * part.y0, modelBounds.min.z);
+        glm::vec3 high(modelBounds.min.x + size.x * part.x1, modelBounds.min.y + size.y * part.y1, modelBounds.max.z);
+        boxes.push_back({static_cast<int>(bones.size()), (low + high) * 0.5f, (high - low) * 0.5f});
+        bones.push_back(glm::mat4(1.0f));
+        boneNames.push_back(part.name);
+    }
+    updateBounds();
+}
+
+/**
+ * @brief Recompute the model-space bounds after the bones moved
+ */
+void HitboxSet::updateBounds() {
+    bounds = AABB();
+    for (const Hitbox& box : boxes) bounds.expand(localBox(box).transformed(bones[box.bone]));
+}
+
+/**
+ * @brief Add a target, such as a monster
+ *
+ * @param hitboxes Its hitboxes; shared by every target of the same kind, and must outlive the target
+ * @param transform Model matrix
+ */
+TargetId CombatSystem::addTarget(const HitboxSet* hitboxes, const glm::mat4& transform) {
+    TargetId id;
+    if (!freeTargets.empty()) {
+        id = freeTargets.back();
+        freeTargets.pop_back();
+    } else {
+        id = static_cast<TargetId>(targets.size());
+        targets.emplace_back();
+    }
+    Target& target = targets[id];
+    target.hitboxes = hitboxes;
+    target.previous = target.current = transform;
+    target.previousBounds = target.currentBounds = hitboxes->bounds.transformed(transform);
+    target.moved = false;
+    gridStale = true;
+    liveTargets++;
+    return id;
+}
+
+/**
+ * @brief Set where a target is this tick; the next resolve sweeps it from where it was
+ */
+void CombatSystem::moveTarget(TargetId id, const glm::mat4& transform) {
+    Target& target = targets[id];
+    target.current = transform;
+    target.currentBounds = target.hitboxes->bounds.transformed(transform);
+    if (!target.moved) movedTargets.push_back(id);
+    target.moved = true;
+    gridStale = true;
+}
+
+/**
+ * @brief Remove a target; swings that struck it forget it, so its id can be reused
+ */
+void CombatSystem::removeTarget(TargetId target) {
+    targets[target].hitboxes = nullptr;
+    targets[target].moved = false;
+    freeTargets.push_back(target);
+    gridStale = true;
+    liveTargets--;
+    for (Swing& swing : swings) {
+        swing.struck.erase(std::remove(swing.struck.begin(), swing.struck.end(), target), swing.struck.end());
+    }
+}
+
+/**
+ * @brief Make room for this many targets, so adding and removing them never allocates
+ */
+void CombatSystem::reserveTargets(size_t count) {
+    targets.reserve(count);
+    freeTargets.reserve(count);
+    movedTargets.reserve(count);
+    sweptBounds.reserve(count);
+}
+
+/**
+ * @brief Start a swing
+ *
+ * @param radius Radius of the blade's capsule
+ * @return SwingId Handle for sweep() and endSwing()
+ */
+SwingId CombatSystem::beginSwing(float radius) {
+    SwingId id;
+    if (!freeSwings.empty()) {
+        id = freeSwings.back();
+        freeSwings.pop_back();
+    } else {
+        id = static_cast<SwingId>(swings.size());
+        swings.emplace_back();
+    }
+    Swing& swing = swings[id];
+    swing.radius = std::max(radius, 0.001f);
+    swing.active = true;
+    swing.started = false;
+    swing.queued = false;
+    swing.struck.clear();
+    return id;
+}
+
+/**
+ * @brief Move a swing's blade to this tick's pose
+ *
+ * The first sweep of a swing only tests where the blade is; later ones test
+ * the whole movement from the previous tick's pose.
+ */
+void CombatSystem::sweep(SwingId id, const glm::vec3& hilt, const glm::vec3& tip) {
+    Swing& swing = swings[id];
+    swing.hilt[1] = hilt;
+    swing.tip[1] = tip;
+    if (!swing.started) {
+        swing.hilt[0] = hilt;
+        swing.tip[0] = tip;
+    }
+    if (!swing.queued) {
+        swing.queued = true;
+        queue.push_back(id);
+    }
+}
+
+/**
+ * @brief Finish a swing; a sweep queued this tick is still resolved
+ */
+void CombatSystem::endSwing(SwingId id) {
+    swings[id].active = false;
+    if (!swings[id].queued) freeSwings.push_back(id);
+}
+
+/**
+ * @brief Earliest contact of a swing's blade with one target's hitboxes between the two ticks
+ *
+ * Samples are spaced by the blade's radius over the combined travel of the
+ * blade and the target's centre, in sub-steps of COMBAT_STEP_SAMPLES. Only
+ * hitboxes whose bounds over a sub-step reach the blade's are posed in it;
+ * points of a blended matrix move linearly, so the box's bounds at either
+ * end of the sub-step enclose it.
+ */
+bool CombatSystem::sweepTarget(Swing& swing, SwingId id, TargetId targetId, MeleeHit& hit) const {
+    const Target& target = targets[targetId];
+    const HitboxSet& set = *target.hitboxes;
+
+    glm::vec3 center(set.bounds.center());
+    float targetTravel = glm::length(glm::vec3(target.current * glm::vec4(center, 1.0f)) -
+                                     glm::vec3(target.previous * glm::vec4(center, 1.0f)));
+    float travel = std::max(glm::length(swing.hilt[1] - swing.hilt[0]), glm::length(swing.tip[1] - swing.tip[0])) +
+                   targetTravel;
+    if (!std::isfinite(travel)) return false;
+    float wanted = std::ceil(travel / swing.radius);
+    if (wanted > COMBAT_MAX_SAMPLES) swing.clamped++;
+    int samples = std::max(1, static_cast<int>(std::min(wanted, static_cast<float>(COMBAT_MAX_SAMPLES))));
+
+    // The previous tick's pose was tested by the previous resolve
+    for (int first = swing.started ? 1 : 0; first <= samples; first += COMBAT_STEP_SAMPLES) {
+        int last = std::min(samples, first + COMBAT_STEP_SAMPLES - 1);
+        float t0 = static_cast<float>(first) / samples, t1 = static_cast<float>(last) / samples;
+
+        AABB reach;
+        for (float t : {t0, t1}) {
+            reach.expand(glm::mix(swing.hilt[0], swing.hilt[1], t));
+            reach.expand(glm::mix(swing.tip[0], swing.tip[1], t));
+        }
+        reach.min -= glm::vec3(swing.radius);
+        reach.max += glm::vec3(swing.radius);
+
+        swing.boxes.clear();
+        for (const Hitbox& box : set.boxes) {
+            BoxSweep candidate = {&box, target.previous * set.bones[box.bone], target.current * set.bones[box.bone]};
+            AABB swept = localBox(box).transformed(blendMatrix(candidate.from, candidate.to, t0));
+            swept.expand(localBox(box).transformed(blendMatrix(candidate.from, candidate.to, t1)));
+            if (swept.overlaps(reach)) swing.boxes.push_back(candidate);
+        }
+        if (swing.boxes.empty()) continue;
+
+        for (int s = first; s <= last; s++) {
+            float t = static_cast<float>(s) / samples;
+            glm::vec3 hilt = glm::mix(swing.hilt[0], swing.hilt[1], t);
+            glm::vec3 tip = glm::mix(swing.tip[0], swing.tip[1], t);
+            swing.samples++;
+
+            float nearest = swing.radius;
+            bool touched = false;
+            for (const BoxSweep& candidate : swing.boxes) {
+                OrientedBox box = placeBox(*candidate.box, blendMatrix(candidate.from, candidate.to, t));
+                glm::vec3 onBlade, onBox;
+                float distance = segmentToBox(toBox(box, hilt), toBox(box, tip), box.half, onBlade, onBox);
+                if (distance > nearest || (touched && distance == nearest)) continue;
+                nearest = distance;
+                touched = true;
+
+                glm::vec3 normal;
+                if (distance > 1e-6f) {
+                    normal = (onBlade - onBox) / distance;
+                } else {
+                    // The blade's core is inside: out through the nearest face
+                    glm::vec3 room = box.half - glm::abs(onBox);
+                    int axis = room.x <= room.y && room.x <= room.z ? 0 : (room.y <= room.z ? 1 : 2);
+                    normal = glm::vec3(0.0f);
+                    normal[axis] = onBox[axis] < 0.0f ? -1.0f : 1.0f;
+                    onBox[axis] = normal[axis] * box.half[axis];
+                }
+                hit.swing = id;
+                hit.target = targetId;
+                hit.bone = candidate.box->bone;
+                hit.time = t;
+                hit.point = fromBox(box, onBox);
+                hit.normal = box.axes[0] * normal.x + box.axes[1] * normal.y + box.axes[2] * normal.z;
+            }
+            if (touched) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Sweep one swing against the targets the grid puts near it
+ */
+void CombatSystem::resolveSwing(SwingId id) {
+    Swing& swing = swings[id];
+    swing.hits.clear();
+    swing.candidates = swing.samples = swing.clamped = 0;
+
+    AABB reach;
+    for (const glm::vec3& p : {swing.hilt[0], swing.tip[0], swing.hilt[1], swing.tip[1]}) reach.expand(p);
+    reach.min -= glm::vec3(swing.radius);
+    reach.max += glm::vec3(swing.radius);
+    grid.query(reach, [&](uint32_t target) {
+        if (!targets[target].hitboxes) return;
+        if (std::find(swing.struck.begin(), swing.struck.end(), target) != swing.struck.end()) return;
+        swing.candidates++;
+        MeleeHit hit;
+        if (sweepTarget(swing, id, target, hit)) swing.hits.push_back(hit);
+    });
+    std::sort(swing.hits.begin(), swing.hits.end(), [](const MeleeHit& a, const MeleeHit& b) {
+        return a.time < b.time || (a.time == b.time && a.target < b.target);
+    });
+    for (const MeleeHit& hit : swing.hits) swing.struck.push_back(hit.target);
+}
+
+/**
+ * @brief Resolve every swing swept this tick
+ *
+ * @param jobs Job system to spread the swings over, or null
+ * @return Hits of this tick, grouped by swing in the order they were swept and by time within a swing
+ *
+ * Afterwards every swing and target counts as being where it was moved,
+ * ready to be swept from there next tick.
+ */
+const std::vector<MeleeHit>& CombatSystem::resolve(JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    hits.clear();
+    lastStats = CombatStats();
+
+    lastStats.targets = liveTargets;
+
+    if (!queue.empty() && gridStale) {
+        sweptBounds.resize(targets.size());
+        for (size_t i = 0; i < targets.size(); i++) {
+            const Target& target = targets[i];
+            sweptBounds[i] = AABB();
+            if (!target.hitboxes) continue;
+            sweptBounds[i] = target.previousBounds;
+            sweptBounds[i].expand(target.currentBounds);
+        }
+        grid.build(sweptBounds, COMBAT_GRID_CELL_SIZE);
+        gridStale = false;
+    }
+
+    auto run = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) resolveSwing(queue[i]);
+    };
+    if (jobs) jobs->parallelFor(queue.size(), 1, run);
+    else run(0, queue.size());
+
+    // Gathered in queue order, so the result does not depend on which worker ran which swing
+    for (SwingId id : queue) {
+        Swing& swing = swings[id];
+        hits.insert(hits.end(), swing.hits.begin(), swing.hits.end());
+        lastStats.candidates += swing.candidates;
+        lastStats.samples += swing.samples;
+        lastStats.clamped += swing.clamped;
+        swing.hilt[0] = swing.hilt[1];
+        swing.tip[0] = swing.tip[1];
+        swing.started = true;
+        swing.queued = false;
+        if (!swing.active) freeSwings.push_back(id);
+    }
+    lastStats.swings = queue.size();
+    lastStats.hits = hits.size();
+    queue.clear();
+    // A target that moved sweeps a smaller box next tick, so the grid goes stale once more
+    for (TargetId id : movedTargets) {
+        Target& target = targets[id];
+        if (!target.moved) continue;            // Removed, and perhaps reused, since it moved
+        target.previous = target.current;
+        target.previousBounds = target.currentBounds;
+        target.moved = false;
+        gridStale = true;
+    }
+    movedTargets.clear();
+
+    lastStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return hits;
+}
+
+/**
+ * @brief Print the last tick's counters
+ */
+void CombatSystem::report(std::ostream& out) const {
+    out << "Combat: " << lastStats.swings << " swings, " << lastStats.targets << " targets, " << lastStats.candidates
+        << " near a blade, " << lastStats.samples << " blade poses (" << lastStats.clamped << " sweeps clamped), "
+        << lastStats.hits << " hits, " << lastStats.seconds * 1e3 << " ms" << std::endl;
+}
@@ -0,0 +1,203 @@
+#include "decals.h"
+#include <algorithm>
+#include <cmath>
+#include "gl_state.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DECALS_SSE 1
+#endif
+
+/**
+ * @brief Number of RGBA32F texels describing one decal
+ *
+ * Three rows of the world-to-decal transform, then type/seed/spawn time/opacity.
+ */
+const int DECAL_TEXELS = 4;
+
+/**
+ * @brief Destructor for DecalSystem
+ */
+DecalSystem::~DecalSystem() {
+    glState().forgetTexture(texture);
+    glState().forgetBuffer(buffer);
+    if (texture) glDeleteTextures(1, &texture);
+    if (buffer) glDeleteBuffers(1, &buffer);
+}
+
+/**
+ * @brief Allocate the ring buffer and its texture buffer view
+ */
+void DecalSystem::create() {
+    texels.assign(MAX_DECALS * DECAL_TEXELS, glm::vec4(0.0f));
+    boundsX.assign(MAX_DECALS, 1e30f);
+    boundsY.assign(MAX_DECALS, 0.0f);
+    boundsZ.assign(MAX_DECALS, 0.0f);
+    boundsR.assign(MAX_DECALS, 0.0f);
+    spawnTime.assign(MAX_DECALS, 0.0f);
+
+    glGenBuffers(1, &buffer);
+    glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &texture);
+    glState().bindTexture(DECAL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+/**
+ * @brief Leave a mark on a surface
+ *
+ * @param type Blood splatter or scorch mark
+ * @param position Point on the surface at the centre of the mark
+ * @param normal Surface normal; the decal projects along it
+ * @param size Half-width of the mark
+ * @param time Current game time, used to rank and age decals
+ *
+ * Overwrites the oldest decal when the ring is full, so spawning never
+ * allocates and the live count never exceeds MAX_DECALS.
+ */
+void DecalSystem::spawn(DecalType type, const glm::vec3& position, const glm::vec3& normal, float size, float time) {
+    int slot = head;
+    head = (head + 1) % MAX_DECALS;
+    count = std::min(count + 1, MAX_DECALS);
+
+    // Build a tangent frame around the normal, with a per-decal twist so repeats don't line up
+    glm::vec3 n = glm::normalize(normal);
+    glm::vec3 helper = std::fabs(n.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 t = glm::normalize(glm::cross(helper, n));
+    glm::vec3 b = glm::cross(n, t);
+    float seed = std::fmod(slot * 0.618034f + time * 0.1f, 1.0f);
+    float twist = seed * 6.2831853f;
+    glm::vec3 tangent = t * std::cos(twist) + b * std::sin(twist);
+    glm::vec3 bitangent = glm::cross(n, tangent);
+
+    float depth = size * 0.5f;
+    glm::vec4* out = &texels[slot * DECAL_TEXELS];
+    out[0] = glm::vec4(tangent / size, -glm::dot(tangent, position) / size);
+    out[1] = glm::vec4(bitangent / size, -glm::dot(bitangent, position) / size);
+    out[2] = glm::vec4(n / depth, -glm::dot(n, position) / depth);
+    out[3] = glm::vec4(static_cast<float>(type), seed, time, 1.0f);
+
+    boundsX[slot] = position.x;
+    boundsY[slot] = position.y;
+    boundsZ[slot] = position.z;
+    boundsR[slot] = std::sqrt(2.0f * size * size + depth * depth);
+    spawnTime[slot] = time;
+
+    dirtyBegin = std::min(dirtyBegin, slot);
+    dirtyEnd = std::max(dirtyEnd, slot + 1);
+}
+
+/**
+ * @brief Remove every decal
+ */
+void DecalSystem::clear() {
+    head = 0;
+    count = 0;
+    std::fill(boundsX.begin(), boundsX.end(), 1e30f);
+    std::fill(boundsR.begin(), boundsR.end(), 0.0f);
+}
+
+/**
+ * @brief Assign decals to every object
+ *
+ * @param objects World-space bounds of each draw, the same list the lights use
+ * @param jobs Job system the objects are split across
+ */
+void DecalSystem::cull(const std::vector<BoundingSphere>& objects, JobSystem& jobs) {
+    objectDecals.resize(objects.size());
+    jobs.parallelFor(objects.size(), 64, [&](size_t begin, size_t end) {
+        cullRange(objects, begin, end);
+    });
+}
+
+/**
+ * @brief Cull and rank decals for objects [begin, end)
+ *
+ * Sphere overlap runs on four decals per iteration. When more than
+ * MAX_DECALS_PER_DRAW decals touch an object, the newest ones win.
+ */
+void DecalSystem::cullRange(const std::vector<BoundingSphere>& objects, size_t begin, size_t end) {
+    int laneCount = (count + 3) & ~3;
+
+    for (size_t o = begin; o < end; o++) {
+        const BoundingSphere& sphere = objects[o];
+        DecalAssignment assignment;
+        float ages[MAX_DECALS_PER_DRAW] = {};
+
+        for (int base = 0; base < laneCount; base += 4) {
+            int mask;
+#ifdef DECALS_SSE
+            __m128 vx = _mm_sub_ps(_mm_loadu_ps(&boundsX[base]), _mm_set1_ps(sphere.center.x));
+            __m128 vy = _mm_sub_ps(_mm_loadu_ps(&boundsY[base]), _mm_set1_ps(sphere.center.y));
+            __m128 vz = _mm_sub_ps(_mm_loadu_ps(&boundsZ[base]), _mm_set1_ps(sphere.center.z));
+            __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+            __m128 reach = _mm_add_ps(_mm_loadu_ps(&boundsR[base]), _mm_set1_ps(sphere.radius));
+            mask = _mm_movemask_ps(_mm_cmplt_ps(lenSq, _mm_mul_ps(reach, reach)));
+#else
+            mask = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                glm::vec3 v = glm::vec3(boundsX[base + lane], boundsY[base + lane], boundsZ[base + lane]) - sphere.center;
+                float reach = boundsR[base + lane] + sphere.radius;
+                if (glm::dot(v, v) < reach * reach) mask |= 1 << lane;
+            }
+#endif
+            while (mask) {
+                int slot = base + __builtin_ctz(mask);
+                mask &= mask - 1;
+                float age = spawnTime[slot];
+
+                int pos = assignment.count < MAX_DECALS_PER_DRAW ? assignment.count++ : MAX_DECALS_PER_DRAW;
+                if (pos == MAX_DECALS_PER_DRAW) {
+                    if (age <= ages[MAX_DECALS_PER_DRAW - 1]) continue;
+                    pos = MAX_DECALS_PER_DRAW - 1;
+                }
+                while (pos > 0 && ages[pos - 1] < age) {
+                    ages[pos] = ages[pos - 1];
+                    assignment.indices[pos] = assignment.indices[pos - 1];
+                    pos--;
+                }
+                ages[pos] = age;
+                assignment.indices[pos] = slot;
+            }
+        }
+
+        objectDecals[o] = assignment;
+    }
+}
+
+/**
+ * @brief Upload the ring slots written since the last upload
+ */
+void DecalSystem::upload() {
+    if (dirtyBegin >= dirtyEnd) return;
+
+    glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER,
+                    dirtyBegin * DECAL_TEXELS * sizeof(glm::vec4),
+                    (dirtyEnd - dirtyBegin) * DECAL_TEXELS * sizeof(glm::vec4),
+                    &texels[dirtyBegin * DECAL_TEXELS]);
+
+    dirtyBegin = MAX_DECALS;
+    dirtyEnd = 0;
+}
+
+/**
+ * @brief Bind the decal buffer to DECAL_TEXTURE_UNIT
+ */
+void DecalSystem::bind() const {
+    glState().bindTexture(DECAL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+}
+
+/**
+ * @brief Set the decal list of one object before drawing it
+ *
+ * @param program Currently bound shader program
+ * @param object Index of the object, as passed to cull()
+ */
+void DecalSystem::apply(GLuint program, size_t object) const {
+    const DecalAssignment& assignment = objectDecals[object];
+    glUniform1i(glGetUniformLocation(program, "decalCount"), assignment.count);
+    glUniform1iv(glGetUniformLocation(program, "decalIndices"), MAX_DECALS_PER_DRAW, assignment.indices);
+}
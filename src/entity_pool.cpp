@@ -0,0 +1,75 @@
+#include "entity_pool.h"
+#include <algorithm>
+
+/**
+ * @brief Allocate every slot, all free; any live entities are dropped
+ *
+ * @param capacity Most entities alive at once
+ */
+void EntityPool::create(uint32_t capacity) {
+    generations.assign(capacity, 0);
+    denseIndex.assign(capacity, ENTITY_NONE);
+    dense.assign(capacity, ENTITY_NONE);
+    freeSlots.resize(capacity);
+    // Slot 0 on top, so a fresh pool fills from the front
+    for (uint32_t i = 0; i < capacity; i++) freeSlots[i] = capacity - 1 - i;
+    freeCount = capacity;
+    liveCount = 0;
+    currentStats = EntityPoolStats();
+    currentStats.capacity = capacity;
+}
+
+/**
+ * @brief Claim a slot
+ *
+ * @return The new entity's handle, or one that is not alive if the pool is full
+ */
+EntityHandle EntityPool::spawn() {
+    if (freeCount == 0) {
+        currentStats.rejected++;
+        return EntityHandle();
+    }
+    uint32_t index = freeSlots[--freeCount];
+    denseIndex[index] = liveCount;
+    dense[liveCount++] = index;
+
+    currentStats.live = liveCount;
+    currentStats.peak = std::max(currentStats.peak, liveCount);
+    currentStats.spawned++;
+    return {index, generations[index]};
+}
+
+/**
+ * @brief Return an entity's slot to the pool
+ *
+ * @return False if the handle was stale, in which case nothing happens
+ */
+bool EntityPool::despawn(EntityHandle entity) {
+    if (!alive(entity)) return false;
+    uint32_t index = entity.index;
+
+    // Fill the hole in the dense list with its last entry
+    uint32_t place = denseIndex[index];
+    uint32_t last = dense[--liveCount];
+    dense[place] = last;
+    denseIndex[last] = place;
+    denseIndex[index] = ENTITY_NONE;
+
+    generations[index]++;
+    freeSlots[freeCount++] = index;
+    currentStats.live = liveCount;
+    currentStats.despawned++;
+    return true;
+}
+
+/**
+ * @brief Print one line of counters
+ *
+ * @param name What the pool holds
+ */
+void EntityPool::report(std::ostream& out, const char* name) const {
+    out << name << ": " << currentStats.live << "/" << currentStats.capacity << " live, peak " << currentStats.peak
+        << ", " << currentStats.spawned << " spawned, " << currentStats.despawned << " despawned";
+    if (currentStats.rejected) out << ", " << currentStats.rejected << " refused";
+    out << std::endl;
+}
@@ -0,0 +1,181 @@
+#include "flashlight.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "gl_state.h"
+
+/**
+ * @brief Size of the generated cookie texture
+ */
+const int FLASHLIGHT_COOKIE_SIZE = 128;
+
+/**
+ * @brief Destructor for Flashlight
+ */
+Flashlight::~Flashlight() {
+    glState().forgetTexture(cookie);
+    glState().forgetTexture(shadowMap);
+    glState().forgetFramebuffer(shadowFBO);
+    if (cookie) glDeleteTextures(1, &cookie);
+    if (shadowMap) glDeleteTextures(1, &shadowMap);
+    if (shadowFBO) glDeleteFramebuffers(1, &shadowFBO);
+}
+
+/**
+ * @brief Create the cookie texture and, optionally, the shadow map
+ *
+ * @param withShadows Allocate and render a shadow map every frame
+ */
+void Flashlight::create(bool withShadows) {
+    createCookie();
+    if (!withShadows) return;
+
+    glGenTextures(1, &shadowMap);
+    glState().bindTexture(0, GL_TEXTURE_2D, shadowMap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, FLASHLIGHT_SHADOW_SIZE, FLASHLIGHT_SHADOW_SIZE, 0,
+                 GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &shadowFBO);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMap, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Flashlight shadow framebuffer is incomplete" << std::endl;
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Generate the beam pattern projected by the flashlight
+ *
+ * A bright hot spot, a faint dark ring from the reflector and a soft edge,
+ * with a little noise so the beam does not look like a perfect disc.
+ * Generated once at startup so no asset is needed.
+ */
+void Flashlight::createCookie() {
+    std::vector<unsigned char> pixels(FLASHLIGHT_COOKIE_SIZE * FLASHLIGHT_COOKIE_SIZE);
+    unsigned seed = 12345u;
+    for (int y = 0; y < FLASHLIGHT_COOKIE_SIZE; y++) {
+        for (int x = 0; x < FLASHLIGHT_COOKIE_SIZE; x++) {
+            float u = (x + 0.5f) / FLASHLIGHT_COOKIE_SIZE * 2.0f - 1.0f;
+            float v = (y + 0.5f) / FLASHLIGHT_COOKIE_SIZE * 2.0f - 1.0f;
+            float r = std::sqrt(u * u + v * v);
+
+            float hotSpot = std::exp(-r * r * 8.0f);
+            float ring = 1.0f - 0.25f * std::exp(-(r - 0.55f) * (r - 0.55f) * 200.0f);
+            float edge = glm::clamp((1.0f - r) / 0.2f, 0.0f, 1.0f);
+
+            seed = seed * 1664525u + 1013904223u;
+            float noise = 0.95f + 0.05f * ((seed >> 8) & 0xFF) / 255.0f;
+
+            float value = (0.45f + 0.55f * hotSpot) * ring * edge * noise;
+            pixels[y * FLASHLIGHT_COOKIE_SIZE + x] = static_cast<unsigned char>(glm::clamp(value, 0.0f, 1.0f) * 255.0f);
+        }
+    }
+
+    glGenTextures(1, &cookie);
+    glState().bindTexture(0, GL_TEXTURE_2D, cookie);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FLASHLIGHT_COOKIE_SIZE, FLASHLIGHT_COOKIE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glState().bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+/**
+ * @brief Follow the player
+ *
+ * @param eye Player eye position
+ * @param front Player look direction
+ * @param up World up vector
+ *
+ * The light is held slightly right of and below the eye, so its shadows
+ * are visible instead of hiding exactly behind what they are cast from.
+ */
+void Flashlight::update(const glm::vec3& eye, const glm::vec3& front, const glm::vec3& up) {
+    glm::vec3 right = glm::normalize(glm::cross(front, up));
+    position = eye + right * 0.2f - up * 0.15f;
+    direction = front;
+
+    glm::mat4 lightView = glm::lookAt(position, position + direction, up);
+    glm::mat4 lightProjection = glm::perspective(2.0f * outerAngle, 1.0f, 0.05f, range);
+    viewProjection = lightProjection * lightView;
+}
+
+/**
+ * @brief Whether a draw's bounds reach into the flashlight cone
+ *
+ * @param bounds World-space bounds of the draw
+ * @return bool False if the draw can use the base shader permutation
+ *
+ * Same sphere/cone test as the light culling.
+ */
+bool Flashlight::affects(const BoundingSphere& bounds) const {
+    if (!enabled) return false;
+
+    glm::vec3 v = bounds.center - position;
+    float lenSq = glm::dot(v, v);
+    float axial = glm::dot(v, direction);
+    float radial = std::sqrt(std::max(lenSq - axial * axial, 0.0f));
+    float closest = std::cos(outerAngle) * radial - axial * std::sin(outerAngle);
+
+    return closest <= bounds.radius && axial <= range + bounds.radius && axial >= -bounds.radius;
+}
+
+/**
+ * @brief Render the flashlight shadow map
+ *
+ * @param depthProgram Depth-only program with `model` and `lightViewProjection` uniforms
+ * @param drawCasters Draws the shadow casters; receives the model matrix location
+ *
+ * The caller must restore its own framebuffer and viewport afterwards.
+ */
+void Flashlight::renderShadowMap(GLuint depthProgram, const std::function<void(GLint)>& drawCasters) const {
+    if (!enabled || !shadowFBO) return;
+
+    glState().bindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    glViewport(0, 0, FLASHLIGHT_SHADOW_SIZE, FLASHLIGHT_SHADOW_SIZE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glState().enable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    glState().useProgram(depthProgram);
+    glUniformMatrix4fv(glGetUniformLocation(depthProgram, "lightViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    drawCasters(glGetUniformLocation(depthProgram, "model"));
+
+    glState().disable(GL_POLYGON_OFFSET_FILL);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Set the flashlight uniforms and textures on a FLASHLIGHT permutation
+ *
+ * @param program Currently bound flashlight program
+ */
+void Flashlight::apply(GLuint program) const {
+    glUniformMatrix4fv(glGetUniformLocation(program, "flashlightViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniform4fv(glGetUniformLocation(program, "flashlightPositionRange"), 1, glm::value_ptr(glm::vec4(position, range)));
+    glUniform4fv(glGetUniformLocation(program, "flashlightDirectionCos"), 1, glm::value_ptr(glm::vec4(direction, std::cos(outerAngle))));
+    glUniform3fv(glGetUniformLocation(program, "flashlightColor"), 1, glm::value_ptr(color * intensity));
+    glUniform1i(glGetUniformLocation(program, "flashlightCookie"), FLASHLIGHT_COOKIE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "flashlightShadow"), FLASHLIGHT_SHADOW_UNIT);
+
+    glState().bindTexture(FLASHLIGHT_COOKIE_UNIT, GL_TEXTURE_2D, cookie);
+    if (shadowMap) {
+        glState().bindTexture(FLASHLIGHT_SHADOW_UNIT, GL_TEXTURE_2D, shadowMap);
+    }
+}
@@ -0,0 +1,52 @@
+#include "frame_uniforms.h"
+#include "gl_state.h"
+
+/**
+ * @brief Destructor for FrameUniforms
+ *
+ * Deletes the uniform buffer if it was created.
+ */
+FrameUniforms::~FrameUniforms() {
+    glState().forgetBuffer(ubo);
+    if (ubo) glDeleteBuffers(1, &ubo);
+}
+
+/**
+ * @brief Create the uniform buffer and bind it to FRAME_UNIFORM_BINDING
+ */
+void FrameUniforms::create() {
+    glGenBuffers(1, &ubo);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, ubo);
+}
+
+/**
+ * @brief Upload this frame's data
+ *
+ * @param data Camera matrices and timing for the frame
+ *
+ * Orphans the previous contents so the driver does not stall on draws of the
+ * last frame that may still be reading them.
+ */
+void FrameUniforms::update(const FrameData& data) {
+    current = data;
+    glState().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &current);
+}
+
+/**
+ * @brief Connect a program's FrameData block to the shared binding point
+ *
+ * @param program Linked shader program
+ *
+ * GLSL 3.30 has no binding layout qualifier, so this is done once per program
+ * after linking. Programs without the block are ignored.
+ */
+void FrameUniforms::attach(GLuint program) const {
+    GLuint index = glGetUniformBlockIndex(program, "FrameData");
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, FRAME_UNIFORM_BINDING);
+    }
+}
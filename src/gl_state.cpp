@@ -0,0 +1,421 @@
+#include "gl_state.h"
+#include <iomanip>
+#include <iostream>
+
+/**
+ * @brief Names of the counter categories, in Category order
+ */
+static const char* const CATEGORY_NAMES[GlStateCache::CategoryCount] = {
+    "program", "vao", "buffer", "texture", "sampler", "enable", "blend", "depth", "cull", "framebuffer"
+};
+
+/**
+ * @brief Binding queries for the cached buffer targets; 0 where there is none in GL 3.3
+ */
+static const GLenum BUFFER_TARGETS[] = {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER};
+static const GLenum BUFFER_QUERIES[] = {GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, 0, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING};
+static const GLenum TEXTURE_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D};
+static const GLenum TEXTURE_QUERIES[] = {GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_3D};
+static const GLenum CAPABILITIES[] = {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_POLYGON_OFFSET_FILL, GL_SCISSOR_TEST};
+
+/**
+ * @brief Read one integer of driver state
+ */
+static GLint queryInteger(GLenum pname) {
+    GLint value = 0;
+    glGetIntegerv(pname, &value);
+    return value;
+}
+
+/**
+ * @brief Constructor for GlStateCache; everything starts unknown
+ */
+GlStateCache::GlStateCache() {
+    invalidate();
+}
+
+int GlStateCache::bufferSlot(GLenum target) {
+    for (int i = 0; i < BufferTargetCount; i++) {
+        if (BUFFER_TARGETS[i] == target) return i;
+    }
+    return -1;
+}
+
+int GlStateCache::textureSlot(GLenum target) {
+    for (int i = 0; i < TextureTargetCount; i++) {
+        if (TEXTURE_TARGETS[i] == target) return i;
+    }
+    return -1;
+}
+
+int GlStateCache::capSlot(GLenum capability) {
+    for (int i = 0; i < CapCount; i++) {
+        if (CAPABILITIES[i] == capability) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Count a call and decide whether it reaches the driver
+ *
+ * @param category Counter to update
+ * @param redundant The cache already holds the requested value
+ * @param query State to read back in validation mode, or 0 to skip
+ * @param cached Value the cache holds
+ * @return bool True if the call should be dropped
+ */
+bool GlStateCache::filter(Category category, bool redundant, GLenum query, GLint cached) {
+    if (!redundant) {
+        stats[category].issued++;
+        return false;
+    }
+    stats[category].filtered++;
+    if (validation && query) {
+        GLint actual = queryInteger(query);
+        if (actual != cached) mismatch("filtered call", CATEGORY_NAMES[category], cached, actual);
+    }
+    return true;
+}
+
+/**
+ * @brief Compare the cached blend function with all four of the driver's factors
+ *
+ * glBlendFunc sets the alpha factors along with the colour ones, so a
+ * glBlendFuncSeparate behind the cache's back shows up in either pair.
+ *
+ * @return int Number of mismatching factors
+ */
+int GlStateCache::checkBlend(const char* where) {
+    if (blendSource == UNKNOWN) return 0;
+    const GLenum queries[] = {GL_BLEND_SRC_RGB, GL_BLEND_SRC_ALPHA, GL_BLEND_DST_RGB, GL_BLEND_DST_ALPHA};
+    const char* const names[] = {"blend source rgb", "blend source alpha", "blend destination rgb", "blend destination alpha"};
+    int mismatches = 0;
+    for (int i = 0; i < 4; i++) {
+        GLenum cached = i < 2 ? blendSource : blendDestination;
+        GLint actual = queryInteger(queries[i]);
+        if (actual == static_cast<GLint>(cached)) continue;
+        mismatch(where, names[i], cached, actual);
+        mismatches++;
+    }
+    return mismatches;
+}
+
+void GlStateCache::mismatch(const char* where, const char* what, GLint cached, GLint actual) {
+    std::cerr << "GL state cache out of sync (" << where << "): " << what
+              << " cached " << cached << ", driver has " << actual << std::endl;
+}
+
+void GlStateCache::useProgram(GLuint id) {
+    if (filter(Program, program == id, GL_CURRENT_PROGRAM, id)) return;
+    glUseProgram(id);
+    program = id;
+}
+
+void GlStateCache::bindVertexArray(GLuint vao) {
+    if (filter(VertexArray, vertexArray == vao, GL_VERTEX_ARRAY_BINDING, vao)) return;
+    glBindVertexArray(vao);
+    vertexArray = vao;
+}
+
+/**
+ * @brief Bind a buffer to a generic target
+ *
+ * GL_ELEMENT_ARRAY_BUFFER is VAO state and always passes through, as do
+ * targets the cache does not track.
+ */
+void GlStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    int slot = bufferSlot(target);
+    if (slot < 0) {
+        stats[Buffer].issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (filter(Buffer, buffers[slot] == buffer, BUFFER_QUERIES[slot], buffer)) return;
+    glBindBuffer(target, buffer);
+    buffers[slot] = buffer;
+}
+
+/**
+ * @brief Bind a buffer to an indexed target; never filtered
+ *
+ * Indexed binds also replace the generic binding, which the cache follows.
+ */
+void GlStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    stats[Buffer].issued++;
+    glBindBufferBase(target, index, buffer);
+    int slot = bufferSlot(target);
+    if (slot >= 0) buffers[slot] = buffer;
+}
+
+void GlStateCache::activeTexture(GLuint unit) {
+    if (activeUnit == unit) return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+}
+
+/**
+ * @brief Bind a texture to a unit, switching the active unit only when needed
+ */
+void GlStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int slot = textureSlot(target);
+    if (unit >= GL_STATE_TEXTURE_UNITS || slot < 0) {
+        stats[Texture].issued++;
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        return;
+    }
+    if (textures[unit][slot] == texture) {
+        stats[Texture].filtered++;
+        if (validation) {
+            activeTexture(unit);
+            GLint actual = queryInteger(TEXTURE_QUERIES[slot]);
+            if (actual != static_cast<GLint>(texture)) mismatch("filtered call", "texture", texture, actual);
+        }
+        return;
+    }
+    stats[Texture].issued++;
+    activeTexture(unit);
+    glBindTexture(target, texture);
+    textures[unit][slot] = texture;
+}
+
+void GlStateCache::bindSampler(GLuint unit, GLuint sampler) {
+    if (unit >= GL_STATE_TEXTURE_UNITS) {
+        stats[Sampler].issued++;
+        glBindSampler(unit, sampler);
+        return;
+    }
+    if (samplers[unit] == sampler) {
+        stats[Sampler].filtered++;
+        if (validation) {
+            activeTexture(unit);
+            GLint actual = queryInteger(GL_SAMPLER_BINDING);
+            if (actual != static_cast<GLint>(sampler)) mismatch("filtered call", "sampler", sampler, actual);
+        }
+        return;
+    }
+    stats[Sampler].issued++;
+    glBindSampler(unit, sampler);
+    samplers[unit] = sampler;
+}
+
+/**
+ * @brief Bind a framebuffer; GL_FRAMEBUFFER sets both the draw and read bindings
+ */
+void GlStateCache::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool redundant = (!draw || drawFramebuffer == framebuffer) && (!read || readFramebuffer == framebuffer);
+    if (filter(Framebuffer, redundant, draw ? GL_DRAW_FRAMEBUFFER_BINDING : GL_READ_FRAMEBUFFER_BINDING, framebuffer)) return;
+    glBindFramebuffer(target, framebuffer);
+    if (draw) drawFramebuffer = framebuffer;
+    if (read) readFramebuffer = framebuffer;
+}
+
+/**
+ * @brief Bind a renderbuffer; counted with the framebuffers
+ */
+void GlStateCache::bindRenderbuffer(GLuint id) {
+    if (filter(Framebuffer, renderbuffer == id, GL_RENDERBUFFER_BINDING, id)) return;
+    glBindRenderbuffer(GL_RENDERBUFFER, id);
+    renderbuffer = id;
+}
+
+void GlStateCache::setEnabled(GLenum capability, bool enabled) {
+    int slot = capSlot(capability);
+    if (slot >= 0 && caps[slot] == static_cast<GLuint>(enabled)) {
+        stats[Capability].filtered++;
+        if (validation && (glIsEnabled(capability) == GL_TRUE) != enabled) {
+            mismatch("filtered call", "enable", enabled, !enabled);
+        }
+        return;
+    }
+    stats[Capability].issued++;
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    if (slot >= 0) caps[slot] = enabled;
+}
+
+/**
+ * @brief Set the blend function of every draw buffer, colour and alpha alike
+ */
+void GlStateCache::blendFunc(GLenum source, GLenum destination) {
+    bool redundant = blendSource == source && blendDestination == destination;
+    if (filter(Blend, redundant, 0, 0)) {
+        if (validation) checkBlend("filtered call");
+        return;
+    }
+    glBlendFunc(source, destination);
+    blendSource = source;
+    blendDestination = destination;
+}
+
+/**
+ * @brief Per-draw-buffer blend function; never filtered
+ *
+ * Buffers can now disagree, so the global blend function becomes unknown.
+ */
+void GlStateCache::blendFunci(GLuint drawBuffer, GLenum source, GLenum destination) {
+    stats[Blend].issued++;
+    glBlendFunci(drawBuffer, source, destination);
+    blendSource = blendDestination = UNKNOWN;
+}
+
+void GlStateCache::depthMask(GLboolean write) {
+    if (filter(Depth, depthWrite == write, GL_DEPTH_WRITEMASK, write)) return;
+    glDepthMask(write);
+    depthWrite = write;
+}
+
+void GlStateCache::depthFunc(GLenum func) {
+    if (filter(Depth, depthCompare == func, GL_DEPTH_FUNC, func)) return;
+    glDepthFunc(func);
+    depthCompare = func;
+}
+
+void GlStateCache::cullFace(GLenum face) {
+    if (filter(Cull, cullMode == face, GL_CULL_FACE_MODE, face)) return;
+    glCullFace(face);
+    cullMode = face;
+}
+
+/**
+ * @brief Drop cached bindings of a program about to be deleted
+ *
+ * Deleting a bound object unbinds it in GL; the cache must follow or a
+ * recycled name would be filtered as already bound.
+ */
+void GlStateCache::forgetProgram(GLuint id) {
+    if (program == id) program = UNKNOWN;
+}
+
+void GlStateCache::forgetVertexArray(GLuint vao) {
+    if (vertexArray == vao) vertexArray = UNKNOWN;
+}
+
+void GlStateCache::forgetBuffer(GLuint buffer) {
+    for (GLuint& bound : buffers) {
+        if (bound == buffer) bound = UNKNOWN;
+    }
+}
+
+void GlStateCache::forgetTexture(GLuint texture) {
+    for (auto& unit : textures) {
+        for (GLuint& bound : unit) {
+            if (bound == texture) bound = UNKNOWN;
+        }
+    }
+}
+
+void GlStateCache::forgetFramebuffer(GLuint framebuffer) {
+    if (drawFramebuffer == framebuffer) drawFramebuffer = UNKNOWN;
+    if (readFramebuffer == framebuffer) readFramebuffer = UNKNOWN;
+}
+
+void GlStateCache::forgetRenderbuffer(GLuint id) {
+    if (renderbuffer == id) renderbuffer = UNKNOWN;
+}
+
+/**
+ * @brief Forget everything, e.g. after third-party code touched GL state
+ */
+void GlStateCache::invalidate() {
+    program = vertexArray = UNKNOWN;
+    for (GLuint& bound : buffers) bound = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (auto& unit : textures) {
+        for (GLuint& bound : unit) bound = UNKNOWN;
+    }
+    for (GLuint& bound : samplers) bound = UNKNOWN;
+    drawFramebuffer = readFramebuffer = UNKNOWN;
+    renderbuffer = UNKNOWN;
+    for (GLuint& cap : caps) cap = UNKNOWN;
+    blendSource = blendDestination = UNKNOWN;
+    depthWrite = UNKNOWN;
+    depthCompare = UNKNOWN;
+    cullMode = UNKNOWN;
+}
+
+/**
+ * @brief Compare every known cached value with the driver
+ *
+ * @param where Label for the report, e.g. "end of frame"
+ * @return int Number of mismatches found
+ *
+ * Slow: one glGet per tracked value. Only meant for validation runs.
+ */
+int GlStateCache::validate(const char* where) {
+    int mismatches = 0;
+    auto check = [&](const char* what, GLuint cached, GLint actual) {
+        if (cached == UNKNOWN || static_cast<GLint>(cached) == actual) return;
+        mismatch(where, what, cached, actual);
+        mismatches++;
+    };
+
+    check("program", program, queryInteger(GL_CURRENT_PROGRAM));
+    check("vao", vertexArray, queryInteger(GL_VERTEX_ARRAY_BINDING));
+    for (int i = 0; i < BufferTargetCount; i++) {
+        if (BUFFER_QUERIES[i]) check("buffer", buffers[i], queryInteger(BUFFER_QUERIES[i]));
+    }
+    check("draw framebuffer", drawFramebuffer, queryInteger(GL_DRAW_FRAMEBUFFER_BINDING));
+    check("read framebuffer", readFramebuffer, queryInteger(GL_READ_FRAMEBUFFER_BINDING));
+    check("renderbuffer", renderbuffer, queryInteger(GL_RENDERBUFFER_BINDING));
+    for (int i = 0; i < CapCount; i++) {
+        check("enable", caps[i], glIsEnabled(CAPABILITIES[i]) == GL_TRUE);
+    }
+    mismatches += checkBlend(where);
+    check("depth mask", depthWrite, queryInteger(GL_DEPTH_WRITEMASK));
+    check("depth func", depthCompare, queryInteger(GL_DEPTH_FUNC));
+    check("cull face", cullMode, queryInteger(GL_CULL_FACE_MODE));
+
+    GLuint previousUnit = activeUnit;
+    for (GLuint unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (int i = 0; i < TextureTargetCount; i++) {
+            check("texture", textures[unit][i], queryInteger(TEXTURE_QUERIES[i]));
+        }
+        check("sampler", samplers[unit], queryInteger(GL_SAMPLER_BINDING));
+    }
+    if (previousUnit != UNKNOWN) {
+        glActiveTexture(GL_TEXTURE0 + previousUnit);
+    } else {
+        activeUnit = GL_STATE_TEXTURE_UNITS - 1;
+    }
+    return mismatches;
+}
+
+void GlStateCache::resetCounters() {
+    for (Counters& counter : stats) counter = Counters();
+}
+
+/**
+ * @brief Print issued and filtered calls per category
+ */
+void GlStateCache::report(std::ostream& out) const {
+    uint64_t issued = 0, filtered = 0;
+    out << "gl state:";
+    for (int i = 0; i < CategoryCount; i++) {
+        if (stats[i].issued + stats[i].filtered == 0) continue;
+        out << " " << CATEGORY_NAMES[i] << " " << stats[i].issued << "/" << stats[i].issued + stats[i].filtered;
+        issued += stats[i].issued;
+        filtered += stats[i].filtered;
+    }
+    double total = static_cast<double>(issued + filtered);
+    out << " | issued " << issued << ", filtered " << filtered << std::fixed << std::setprecision(1)
+        << " (" << (total > 0.0 ? 100.0 * filtered / total : 0.0) << "%)" << std::endl;
+}
+
+/**
+ * @brief The cache for the one GL context the game creates
+ *
+ * Never destroyed: global GL objects are constructed before the first call,
+ * so a function-local static would be destroyed before them, and their
+ * destructors still call forget*() on it at exit.
+ */
+GlStateCache& glState() {
+    static GlStateCache* cache = new GlStateCache();
+    return *cache;
+}
@@ -0,0 +1,486 @@
+#include "gltf.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+/**
+ * @brief GLB container constants (glTF 2.0 spec, section 4.4)
+ */
+const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+const uint32_t GLB_VERSION = 2;
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+/**
+ * @brief Read a little-endian 32-bit word from anywhere in the file
+ */
+static uint32_t readU32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Read a JSON count or byte offset, mapping negative or huge values to SIZE_MAX
+ *
+ * Casting such a double to size_t is undefined; SIZE_MAX fails every bounds check.
+ */
+static size_t readSize(const JsonValue& value) {
+    double number = value.number();
+    if (!(number >= 0.0) || number >= 9007199254740992.0) return SIZE_MAX; // Negative, NaN or beyond 2^53
+    return static_cast<size_t>(number);
+}
+
+static size_t componentSizeOf(int componentType) {
+    switch (componentType) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE: return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT: return 2;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+static int componentsOf(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+size_t GltfAccessor::componentSize() const {
+    return componentSizeOf(componentType);
+}
+
+/**
+ * @brief Read one component as float, applying normalization for integer types
+ */
+float GltfAccessor::readFloat(size_t element, int component) const {
+    const unsigned char* p = data + element * stride + component * componentSize();
+    switch (componentType) {
+    case GL_FLOAT: {
+        float v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case GL_BYTE: {
+        int8_t v = static_cast<int8_t>(*p);
+        return normalized ? std::max(v / 127.0f, -1.0f) : v;
+    }
+    case GL_UNSIGNED_BYTE:
+        return normalized ? *p / 255.0f : *p;
+    case GL_SHORT: {
+        int16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+    }
+    case GL_UNSIGNED_SHORT: {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return normalized ? v / 65535.0f : v;
+    }
+    case GL_UNSIGNED_INT: {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return static_cast<float>(v);
+    }
+    }
+    return 0.0f;
+}
+
+/**
+ * @brief Read an element of an unsigned integer scalar accessor
+ */
+uint32_t GltfAccessor::readIndex(size_t element) const {
+    const unsigned char* p = data + element * stride;
+    switch (componentType) {
+    case GL_UNSIGNED_BYTE: return *p;
+    case GL_UNSIGNED_SHORT: {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case GL_UNSIGNED_INT: return readU32(p);
+    }
+    return 0;
+}
+
+/**
+ * @brief Map, parse and validate a .glb file
+ *
+ * @param path File to load
+ * @param error Receives the reason on failure
+ * @return bool Whether the asset is usable
+ */
+bool GltfAsset::load(const std::string& path, std::string& error) {
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    size_t slash = path.find_last_of('/');
+    baseDirectory = slash == std::string::npos ? "." : path.substr(0, slash);
+
+    return parseContainer(error) && parseViews(error) && parseAccessors(error) &&
+           parseNodes(error) && parseSkins(error);
+}
+
+/**
+ * @brief Check the GLB header and split it into the JSON and binary chunks
+ */
+bool GltfAsset::parseContainer(std::string& error) {
+    const unsigned char* bytes = file.data();
+    size_t size = file.size();
+    if (size < 20 || readU32(bytes) != GLB_MAGIC) {
+        error = "not a GLB file";
+        return false;
+    }
+    if (readU32(bytes + 4) != GLB_VERSION) {
+        error = "unsupported glTF version " + std::to_string(readU32(bytes + 4));
+        return false;
+    }
+    size_t total = std::min<size_t>(readU32(bytes + 8), size);
+
+    size_t offset = 12;
+    uint32_t jsonLength = readU32(bytes + offset);
+    if (readU32(bytes + offset + 4) != GLB_CHUNK_JSON || offset + 8 + jsonLength > total) {
+        error = "missing or truncated JSON chunk";
+        return false;
+    }
+    if (!JsonValue::parse(reinterpret_cast<const char*>(bytes + offset + 8), jsonLength, document, error)) {
+        error = "invalid JSON: " + error;
+        return false;
+    }
+    offset += 8 + jsonLength;
+
+    if (offset + 8 <= total && readU32(bytes + offset + 4) == GLB_CHUNK_BIN) {
+        uint32_t binLength = readU32(bytes + offset);
+        if (offset + 8 + binLength > total) {
+            error = "truncated binary chunk";
+            return false;
+        }
+        binary = bytes + offset + 8;
+        binaryLength = binLength;
+    }
+
+    const JsonValue& buffers = document["buffers"];
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (i > 0 || buffers[i].has("uri")) {
+            error = "only the GLB binary chunk is supported as a buffer";
+            return false;
+        }
+        if (readSize(buffers[i]["byteLength"]) > binaryLength) {
+            error = "buffer 0 is larger than the binary chunk";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GltfAsset::parseViews(std::string& error) {
+    const JsonValue& list = document["bufferViews"];
+    views.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        const JsonValue& view = list[i];
+        size_t offset = readSize(view["byteOffset"]);
+        size_t length = readSize(view["byteLength"]);
+        size_t stride = readSize(view["byteStride"]);
+        if (view["buffer"].integer() != 0 || offset + length > binaryLength || offset + length < offset) {
+            error = "bufferView " + std::to_string(i) + " is out of bounds";
+            return false;
+        }
+        if (stride && (stride < 4 || stride > 252 || stride % 4)) {
+            error = "bufferView " + std::to_string(i) + " has an invalid byteStride";
+            return false;
+        }
+        views[i] = {binary + offset, length, stride};
+    }
+    return true;
+}
+
+/**
+ * @brief Resolve every accessor and check it fits its bufferView
+ *
+ * Sparse accessors and accessors without a bufferView are not supported.
+ */
+bool GltfAsset::parseAccessors(std::string& error) {
+    const JsonValue& list = document["accessors"];
+    accessors.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        const JsonValue& json = list[i];
+        GltfAccessor& accessor = accessors[i];
+        std::string name = "accessor " + std::to_string(i);
+
+        accessor.componentType = json["componentType"].integer(0);
+        accessor.components = componentsOf(json["type"].string());
+        accessor.normalized = json["normalized"].boolean();
+        accessor.count = readSize(json["count"]);
+        accessor.bufferView = json["bufferView"].integer();
+        accessor.viewOffset = readSize(json["byteOffset"]);
+
+        size_t componentSize = accessor.componentSize();
+        if (!componentSize || !accessor.components) {
+            error = name + " has an invalid type";
+            return false;
+        }
+        if (json.has("sparse") || accessor.bufferView < 0) {
+            error = name + " is sparse or has no bufferView";
+            return false;
+        }
+        if (accessor.bufferView >= static_cast<int>(views.size())) {
+            error = name + " references a missing bufferView";
+            return false;
+        }
+
+        const View& view = views[accessor.bufferView];
+        accessor.stride = view.stride ? view.stride : accessor.elementSize();
+        if (accessor.stride < accessor.elementSize() || accessor.viewOffset % componentSize) {
+            error = name + " is misaligned or overlaps itself";
+            return false;
+        }
+        // Compared by division, as count and byteOffset come from the file and may be huge
+        if (accessor.count == 0 || accessor.viewOffset > view.length ||
+            view.length - accessor.viewOffset < accessor.elementSize() ||
+            accessor.count - 1 > (view.length - accessor.viewOffset - accessor.elementSize()) / accessor.stride) {
+            error = name + " does not fit its bufferView";
+            return false;
+        }
+        accessor.data = view.data + accessor.viewOffset;
+    }
+    return true;
+}
+
+const GltfAccessor* GltfAsset::accessor(int index) const {
+    if (index < 0 || index >= static_cast<int>(accessors.size())) return nullptr;
+    return &accessors[index];
+}
+
+bool GltfAsset::bufferView(int index, const unsigned char*& data, size_t& length) const {
+    if (index < 0 || index >= static_cast<int>(views.size())) return false;
+    data = views[index].data;
+    length = views[index].length;
+    return true;
+}
+
+/**
+ * @brief Read node transforms and hierarchy, then compute world matrices
+ */
+bool GltfAsset::parseNodes(std::string& error) {
+    const JsonValue& list = document["nodes"];
+    nodes.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        const JsonValue& json = list[i];
+        SceneNode& node = nodes[i];
+        node.name = json["name"].string();
+        node.mesh = json["mesh"].integer();
+        node.skin = json["skin"].integer();
+
+        const JsonValue& matrix = json["matrix"];
+        if (matrix.size() == 16) {
+            float* m = glm::value_ptr(node.local);
+            for (int k = 0; k < 16; k++) m[k] = static_cast<float>(matrix[k].number());
+        } else {
+            const JsonValue& t = json["translation"];
+            const JsonValue& r = json["rotation"];
+            const JsonValue& s = json["scale"];
+            if (t.size() == 3) node.translation = glm::vec3(t[0].number(), t[1].number(), t[2].number());
+            if (r.size() == 4) node.rotation = glm::quat(r[3].number(), r[0].number(), r[1].number(), r[2].number());
+            if (s.size() == 3) node.scale = glm::vec3(s[0].number(), s[1].number(), s[2].number());
+            node.local = glm::translate(glm::mat4(1.0f), node.translation) * glm::mat4_cast(node.rotation) *
+                         glm::scale(glm::mat4(1.0f), node.scale);
+        }
+
+        const JsonValue& children = json["children"];
+        for (size_t c = 0; c < children.size(); c++) {
+            int child = children[c].integer();
+            if (child < 0 || child >= static_cast<int>(list.size()) || child == static_cast<int>(i)) {
+                error = "node " + std::to_string(i) + " has an invalid child";
+                return false;
+            }
+            node.children.push_back(child);
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (int child : nodes[i].children) {
+            if (nodes[child].parent >= 0) {
+                error = "node " + std::to_string(child) + " has two parents";
+                return false;
+            }
+            nodes[child].parent = static_cast<int>(i);
+        }
+    }
+
+    // Parents before children; a cycle leaves nodes unvisited
+    std::vector<int> stack;
+    size_t visited = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].parent < 0) stack.push_back(static_cast<int>(i));
+    }
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        SceneNode& node = nodes[index];
+        node.world = node.parent >= 0 ? nodes[node.parent].world * node.local : node.local;
+        visited++;
+        for (int child : node.children) stack.push_back(child);
+    }
+    if (visited != nodes.size()) {
+        error = "node hierarchy contains a cycle";
+        return false;
+    }
+    return true;
+}
+
+bool GltfAsset::parseSkins(std::string& error) {
+    const JsonValue& list = document["skins"];
+    skins.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        const JsonValue& json = list[i];
+        Skin& skin = skins[i];
+        skin.name = json["name"].string();
+        skin.skeleton = json["skeleton"].integer();
+
+        const JsonValue& joints = json["joints"];
+        for (size_t j = 0; j < joints.size(); j++) {
+            int joint = joints[j].integer();
+            if (joint < 0 || joint >= static_cast<int>(nodes.size())) {
+                error = "skin " + std::to_string(i) + " references a missing joint";
+                return false;
+            }
+            skin.joints.push_back(joint);
+        }
+
+        skin.inverseBindMatrices.assign(skin.joints.size(), glm::mat4(1.0f));
+        if (json.has("inverseBindMatrices")) {
+            const GltfAccessor* matrices = accessor(json["inverseBindMatrices"].integer());
+            if (!matrices || matrices->components != 16 || matrices->componentType != GL_FLOAT ||
+                matrices->count < skin.joints.size()) {
+                error = "skin " + std::to_string(i) + " has invalid inverse bind matrices";
+                return false;
+            }
+            for (size_t j = 0; j < skin.joints.size(); j++) {
+                std::memcpy(glm::value_ptr(skin.inverseBindMatrices[j]), matrices->data + j * matrices->stride, sizeof(glm::mat4));
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Append bytes to the binary chunk at a 4-byte boundary
+ *
+ * @return size_t Offset of the appended bytes
+ */
+static size_t appendAligned(std::vector<unsigned char>& bin, const void* data, size_t length) {
+    bin.resize((bin.size() + 3) & ~size_t(3), 0);
+    size_t offset = bin.size();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    bin.insert(bin.end(), bytes, bytes + length);
+    return offset;
+}
+
+/**
+ * @brief Write meshes as a GLB whose vertex layout matches the source
+ *
+ * @param path Output file
+ * @param meshes Meshes to write, one node each
+ * @param error Receives the reason on failure
+ * @return bool Whether the file was written
+ *
+ * Each mesh gets one interleaved vertex bufferView, so loading it back can
+ * upload the view as-is. Images are embedded byte for byte.
+ */
+bool writeGlb(const std::string& path, const std::vector<GlbMeshSource>& meshes, std::string& error) {
+    std::vector<unsigned char> bin;
+    std::ostringstream views, accessors, meshList, nodes, sceneNodes, materials, textures, images;
+    int viewCount = 0, accessorCount = 0, imageCount = 0;
+
+    auto addView = [&](size_t offset, size_t length, size_t stride, int target) {
+        views << (viewCount ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << length;
+        if (stride) views << ",\"byteStride\":" << stride;
+        if (target) views << ",\"target\":" << target;
+        views << "}";
+        return viewCount++;
+    };
+    auto addAccessor = [&](int view, size_t offset, int componentType, size_t count, const char* type, const std::string& extra) {
+        accessors << (accessorCount ? "," : "") << "{\"bufferView\":" << view << ",\"byteOffset\":" << offset
+                  << ",\"componentType\":" << componentType << ",\"count\":" << count << ",\"type\":\"" << type << "\"" << extra << "}";
+        return accessorCount++;
+    };
+
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const GlbMeshSource& mesh = meshes[m];
+        size_t vertexOffset = appendAligned(bin, mesh.vertices, mesh.vertexCount * mesh.stride);
+        int vertexView = addView(vertexOffset, mesh.vertexCount * mesh.stride, mesh.stride, 34962);
+        size_t indexOffset = appendAligned(bin, mesh.indices, mesh.indexCount * sizeof(uint32_t));
+        int indexView = addView(indexOffset, mesh.indexCount * sizeof(uint32_t), 0, 34963);
+
+        std::ostringstream minMax;
+        minMax << ",\"min\":[" << mesh.bounds.min.x << "," << mesh.bounds.min.y << "," << mesh.bounds.min.z
+               << "],\"max\":[" << mesh.bounds.max.x << "," << mesh.bounds.max.y << "," << mesh.bounds.max.z << "]";
+        int position = addAccessor(vertexView, 0, GL_FLOAT, mesh.vertexCount, "VEC3", minMax.str());
+        int normal = addAccessor(vertexView, mesh.normalOffset, GL_FLOAT, mesh.vertexCount, "VEC3", "");
+        int texCoord = addAccessor(vertexView, mesh.texCoordOffset, GL_FLOAT, mesh.vertexCount, "VEC2", "");
+        int indices = addAccessor(indexView, 0, GL_UNSIGNED_INT, mesh.indexCount, "SCALAR", "");
+
+        int material = -1;
+        if (!mesh.imagePath.empty()) {
+            std::ifstream image(mesh.imagePath, std::ios::binary);
+            std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(image)), std::istreambuf_iterator<char>());
+            if (!bytes.empty()) {
+                int imageView = addView(appendAligned(bin, bytes.data(), bytes.size()), bytes.size(), 0, 0);
+                images << (imageCount ? "," : "") << "{\"bufferView\":" << imageView << ",\"mimeType\":\"image/"
+                       << (mesh.imagePath.size() > 4 && mesh.imagePath.compare(mesh.imagePath.size() - 4, 4, ".png") == 0 ? "png" : "jpeg") << "\"}";
+                textures << (imageCount ? "," : "") << "{\"source\":" << imageCount << "}";
+                materials << (imageCount ? "," : "") << "{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":" << imageCount << "}}}";
+                material = imageCount++;
+            }
+        }
+
+        meshList << (m ? "," : "") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << position << ",\"NORMAL\":" << normal
+                 << ",\"TEXCOORD_0\":" << texCoord << "},\"indices\":" << indices;
+        if (material >= 0) meshList << ",\"material\":" << material;
+        meshList << "}]}";
+        nodes << (m ? "," : "") << "{\"mesh\":" << m << "}";
+        sceneNodes << (m ? "," : "") << m;
+    }
+    bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+    std::ostringstream json;
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"EscapeTheAbyss\"},\"scene\":0,\"scenes\":[{\"nodes\":[" << sceneNodes.str()
+         << "]}],\"nodes\":[" << nodes.str() << "],\"meshes\":[" << meshList.str() << "],\"accessors\":[" << accessors.str()
+         << "],\"bufferViews\":[" << views.str() << "],\"buffers\":[{\"byteLength\":" << bin.size() << "}]";
+    if (imageCount) {
+        json << ",\"materials\":[" << materials.str() << "],\"textures\":[" << textures.str() << "],\"images\":[" << images.str() << "]";
+    }
+    json << "}";
+    std::string jsonText = json.str();
+    jsonText.resize((jsonText.size() + 3) & ~size_t(3), ' ');
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    auto writeU32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    writeU32(GLB_MAGIC);
+    writeU32(GLB_VERSION);
+    writeU32(static_cast<uint32_t>(12 + 8 + jsonText.size() + 8 + bin.size()));
+    writeU32(static_cast<uint32_t>(jsonText.size()));
+    writeU32(GLB_CHUNK_JSON);
+    out.write(jsonText.data(), jsonText.size());
+    writeU32(static_cast<uint32_t>(bin.size()));
+    writeU32(GLB_CHUNK_BIN);
+    out.write(reinterpret_cast<const char*>(bin.data()), bin.size());
+    return static_cast<bool>(out);
+}
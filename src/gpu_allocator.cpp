@@ -0,0 +1,472 @@
+#include "gpu_allocator.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+/**
+ * @brief Largest capacity the first-level bins can describe
+ */
+const uint64_t TLSF_MAX_CAPACITY = 1ull << 43;
+
+/**
+ * @brief Round up to a multiple of any (not necessarily power-of-two) alignment
+ */
+static uint64_t roundUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Forget all blocks and make the whole range one free block
+ *
+ * @param capacity Size of the managed range in bytes
+ */
+void TlsfAllocator::reset(uint64_t capacity) {
+    blocks.clear();
+    unusedBlocks.clear();
+    flBitmap = 0;
+    std::fill(std::begin(slBitmap), std::end(slBitmap), 0u);
+    for (auto& row : heads) std::fill(std::begin(row), std::end(row), INVALID);
+    totalBytes = std::min(capacity, TLSF_MAX_CAPACITY);
+    usedTotal = 0;
+
+    if (totalBytes == 0) return;
+    uint32_t block = newBlock();
+    blocks[block].size = totalBytes;
+    blocks[block].isFree = true;
+    insertFree(block);
+}
+
+/**
+ * @brief First- and second-level bin of a block size
+ *
+ * Below SMALL_BLOCK the second level is linear in 4-byte steps; above it,
+ * each power of two is split into SL_COUNT equal classes.
+ */
+void TlsfAllocator::mapping(uint64_t size, int& fl, int& sl) {
+    if (size < SMALL_BLOCK) {
+        fl = 0;
+        sl = static_cast<int>(size / (SMALL_BLOCK / SL_COUNT));
+        return;
+    }
+    int log2 = 63 - __builtin_clzll(size);
+    sl = static_cast<int>((size >> (log2 - SL_LOG2)) ^ (1ull << SL_LOG2));
+    fl = log2 - FL_SHIFT + 1;
+}
+
+uint32_t TlsfAllocator::newBlock() {
+    if (!unusedBlocks.empty()) {
+        uint32_t block = unusedBlocks.back();
+        unusedBlocks.pop_back();
+        blocks[block] = Block();
+        return block;
+    }
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t block) {
+    int fl, sl;
+    mapping(blocks[block].size, fl, sl);
+    uint32_t head = heads[fl][sl];
+    blocks[block].prevFree = INVALID;
+    blocks[block].nextFree = head;
+    if (head != INVALID) blocks[head].prevFree = block;
+    heads[fl][sl] = block;
+    flBitmap |= 1ull << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t block) {
+    int fl, sl;
+    mapping(blocks[block].size, fl, sl);
+    uint32_t prev = blocks[block].prevFree;
+    uint32_t next = blocks[block].nextFree;
+    if (prev != INVALID) blocks[prev].nextFree = next;
+    if (next != INVALID) blocks[next].prevFree = prev;
+    if (heads[fl][sl] == block) {
+        heads[fl][sl] = next;
+        if (next == INVALID) {
+            slBitmap[fl] &= ~(1u << sl);
+            if (!slBitmap[fl]) flBitmap &= ~(1ull << fl);
+        }
+    }
+}
+
+/**
+ * @brief Find a free block of at least `size` bytes in O(1)
+ *
+ * The request is rounded up to the next class boundary so any block in the
+ * class found is large enough (good fit rather than best fit).
+ */
+uint32_t TlsfAllocator::findFree(uint64_t size) {
+    if (size >= SMALL_BLOCK) {
+        int log2 = 63 - __builtin_clzll(size);
+        size += (1ull << (log2 - SL_LOG2)) - 1;
+    }
+    int fl, sl;
+    mapping(size, fl, sl);
+    if (fl >= FL_COUNT) return INVALID;
+
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (!flMap) return INVALID;
+        fl = __builtin_ctzll(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = __builtin_ctz(slMap);
+    return heads[fl][sl];
+}
+
+/**
+ * @brief Cut a block in two; the first `size` bytes stay in `block`
+ *
+ * @return uint32_t The new block holding the remainder
+ */
+uint32_t TlsfAllocator::split(uint32_t block, uint64_t size) {
+    uint32_t rest = newBlock();
+    blocks[rest].offset = blocks[block].offset + size;
+    blocks[rest].size = blocks[block].size - size;
+    blocks[rest].prevPhysical = block;
+    blocks[rest].nextPhysical = blocks[block].nextPhysical;
+    if (blocks[rest].nextPhysical != INVALID) blocks[blocks[rest].nextPhysical].prevPhysical = rest;
+    blocks[block].nextPhysical = rest;
+    blocks[block].size = size;
+    return rest;
+}
+
+/**
+ * @brief Allocate an aligned range
+ *
+ * @param size Bytes needed (rounded up to 4)
+ * @param alignment Required alignment of the returned offset, a multiple of 4
+ * @param offset Receives the aligned offset
+ * @return uint32_t Block id to pass to free(), or INVALID when no block fits
+ *
+ * Leading padding large enough to be useful is returned to the free lists;
+ * smaller padding stays inside the block.
+ */
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+    size = roundUp(std::max<uint64_t>(size, 4), 4);
+    alignment = std::max<uint64_t>(alignment, 4);
+
+    uint32_t block = findFree(size + alignment - 4);
+    if (block == INVALID) return INVALID;
+    removeFree(block);
+
+    uint64_t aligned = roundUp(blocks[block].offset, alignment);
+    uint64_t padding = aligned - blocks[block].offset;
+    if (padding >= MIN_SPLIT) {
+        uint32_t rest = split(block, padding);
+        blocks[block].isFree = true;
+        insertFree(block);
+        block = rest;
+        padding = 0;
+    }
+
+    uint64_t needed = padding + size;
+    if (blocks[block].size - needed >= MIN_SPLIT) {
+        uint32_t rest = split(block, needed);
+        blocks[rest].isFree = true;
+        insertFree(rest);
+    }
+
+    blocks[block].isFree = false;
+    usedTotal += blocks[block].size;
+    offset = aligned;
+    return block;
+}
+
+/**
+ * @brief Return a block and merge it with free neighbours
+ *
+ * @param block Id returned by allocate()
+ */
+void TlsfAllocator::free(uint32_t block) {
+    usedTotal -= blocks[block].size;
+    blocks[block].isFree = true;
+
+    uint32_t prev = blocks[block].prevPhysical;
+    if (prev != INVALID && blocks[prev].isFree) {
+        removeFree(prev);
+        blocks[prev].size += blocks[block].size;
+        blocks[prev].nextPhysical = blocks[block].nextPhysical;
+        if (blocks[prev].nextPhysical != INVALID) blocks[blocks[prev].nextPhysical].prevPhysical = prev;
+        unusedBlocks.push_back(block);
+        block = prev;
+    }
+
+    uint32_t next = blocks[block].nextPhysical;
+    if (next != INVALID && blocks[next].isFree) {
+        removeFree(next);
+        blocks[block].size += blocks[next].size;
+        blocks[block].nextPhysical = blocks[next].nextPhysical;
+        if (blocks[block].nextPhysical != INVALID) blocks[blocks[block].nextPhysical].prevPhysical = block;
+        unusedBlocks.push_back(next);
+    }
+
+    insertFree(block);
+}
+
+/**
+ * @brief Size of the largest free block
+ *
+ * Only the highest non-empty bin is scanned.
+ */
+uint64_t TlsfAllocator::largestFreeBlock() const {
+    if (!flBitmap) return 0;
+    int fl = 63 - __builtin_clzll(flBitmap);
+    int sl = 31 - __builtin_clz(slBitmap[fl]);
+    uint64_t largest = 0;
+    for (uint32_t block = heads[fl][sl]; block != INVALID; block = blocks[block].nextFree) {
+        largest = std::max(largest, blocks[block].size);
+    }
+    return largest;
+}
+
+/**
+ * @brief Drop every allocation and manage a new range
+ *
+ * @param capacity Bytes in the range
+ * @param alignment Alignment of every allocation, a multiple of 4
+ */
+void GpuArena::reset(uint64_t capacity, uint64_t alignment) {
+    tlsf.reset(capacity);
+    align = alignment;
+    entries.clear();
+    freeHandles.clear();
+    liveCount = 0;
+    settled = true;
+}
+
+/**
+ * @brief Allocate `size` bytes
+ *
+ * @return uint32_t Handle, or INVALID when the arena is full or too fragmented
+ */
+uint32_t GpuArena::allocate(uint64_t size) {
+    uint64_t offset;
+    uint32_t block = tlsf.allocate(size, align, offset);
+    if (block == TlsfAllocator::INVALID) return INVALID;
+
+    uint32_t handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = static_cast<uint32_t>(entries.size());
+        entries.emplace_back();
+    }
+    entries[handle] = {block, offset, size};
+    liveCount++;
+    return handle;
+}
+
+void GpuArena::free(uint32_t handle) {
+    tlsf.free(entries[handle].block);
+    entries[handle].block = INVALID;
+    freeHandles.push_back(handle);
+    liveCount--;
+    settled = false;
+}
+
+/**
+ * @brief Slide allocations towards the start of the range
+ *
+ * @param budgetBytes Stop after moving this many bytes; spreads the work over frames
+ * @param move Copies `size` bytes from `source` to `destination`
+ * @return uint64_t Bytes moved; 0 once nothing can move lower
+ *
+ * Allocations are visited from the highest offset down. Each one is given a
+ * fresh block and moved only if that block starts lower, so holes near the
+ * start fill up and free space collects at the end in one piece.
+ *
+ * Only a free() opens a hole that something could move into: allocations
+ * fill holes, and a move frees space above everything still to visit. So
+ * once a pass has visited every allocation, later calls return at once
+ * until the next free().
+ */
+uint64_t GpuArena::compact(uint64_t budgetBytes, const MoveFunction& move) {
+    if (settled) return 0;
+
+    compactOrder.clear();
+    for (uint32_t handle = 0; handle < entries.size(); handle++) {
+        if (entries[handle].block != INVALID) compactOrder.push_back(handle);
+    }
+    std::sort(compactOrder.begin(), compactOrder.end(),
+              [&](uint32_t a, uint32_t b) { return entries[a].offset > entries[b].offset; });
+
+    uint64_t moved = 0;
+    settled = true;
+    for (uint32_t handle : compactOrder) {
+        if (moved >= budgetBytes) {
+            settled = false;
+            break;
+        }
+        Entry& entry = entries[handle];
+        uint64_t target;
+        uint32_t block = tlsf.allocate(entry.size, align, target);
+        if (block == TlsfAllocator::INVALID) continue;
+        if (target >= entry.offset) {
+            tlsf.free(block);
+            continue;
+        }
+        move(entry.offset, target, entry.size);
+        tlsf.free(entry.block);
+        entry.block = block;
+        entry.offset = target;
+        moved += entry.size;
+    }
+    return moved;
+}
+
+ArenaStats GpuArena::stats() const {
+    ArenaStats stats;
+    stats.capacity = tlsf.capacity();
+    stats.used = tlsf.usedBytes();
+    stats.largestFree = tlsf.largestFreeBlock();
+    stats.allocations = liveCount;
+    uint64_t free = stats.capacity - stats.used;
+    stats.utilization = stats.capacity ? static_cast<double>(stats.used) / stats.capacity : 0.0;
+    stats.fragmentation = free ? 1.0 - static_cast<double>(stats.largestFree) / free : 0.0;
+    return stats;
+}
+
+/**
+ * @brief Destructor for MeshBuffer
+ */
+MeshBuffer::~MeshBuffer() {
+    glState().forgetVertexArray(VAO);
+    glState().forgetBuffer(VBO);
+    glState().forgetBuffer(EBO);
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+}
+
+/**
+ * @brief Allocate both buffers and leave the VAO bound for the attribute setup
+ */
+void MeshBuffer::createBuffers(GLsizeiptr vertexBytes, GLsizeiptr indexBytes, GLuint vertexStride) {
+    stride = vertexStride;
+    vertexArena.reset(vertexBytes, stride);
+    indexArena.reset(indexBytes, sizeof(GLuint));
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glState().bindVertexArray(VAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Copy a mesh into the shared buffers
+ *
+ * @param vertexData Interleaved vertices in the buffer's format
+ * @param vertexCount Number of vertices
+ * @param indexData Indices relative to the mesh's first vertex
+ * @param indexCount Number of indices
+ * @return MeshRange Handles of the mesh; invalid if either buffer is full
+ *
+ * Uploads go through the copy-write target so the element binding of
+ * whatever VAO is bound is left alone.
+ */
+MeshRange MeshBuffer::add(const void* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount) {
+    MeshRange range;
+    range.vertices = vertexArena.allocate(vertexCount * stride);
+    if (range.vertices == GpuArena::INVALID) {
+        std::cerr << "Mesh buffer out of vertex space" << std::endl;
+        return MeshRange();
+    }
+    range.indices = indexArena.allocate(indexCount * sizeof(GLuint));
+    if (range.indices == GpuArena::INVALID) {
+        std::cerr << "Mesh buffer out of index space" << std::endl;
+        vertexArena.free(range.vertices);
+        return MeshRange();
+    }
+    range.indexCount = static_cast<GLsizei>(indexCount);
+
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexArena.offset(range.vertices), vertexCount * stride, vertexData);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexArena.offset(range.indices), indexCount * sizeof(GLuint), indexData);
+    return range;
+}
+
+/**
+ * @brief Release a mesh's space; the range is reset to invalid
+ */
+void MeshBuffer::remove(MeshRange& range) {
+    if (!range.valid()) return;
+    vertexArena.free(range.vertices);
+    indexArena.free(range.indices);
+    range = MeshRange();
+}
+
+GLint MeshBuffer::baseVertex(const MeshRange& range) const {
+    return static_cast<GLint>(vertexArena.offset(range.vertices) / stride);
+}
+
+const void* MeshBuffer::firstIndex(const MeshRange& range) const {
+    return reinterpret_cast<const void*>(static_cast<uintptr_t>(indexArena.offset(range.indices)));
+}
+
+void MeshBuffer::bind() const {
+    glState().bindVertexArray(VAO);
+}
+
+/**
+ * @brief Draw one mesh; bind() must have been called
+ */
+void MeshBuffer::draw(const MeshRange& range) const {
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, firstIndex(range), baseVertex(range));
+}
+
+/**
+ * @brief Copy a range to a non-overlapping place in the same buffer, on the GPU
+ */
+void MeshBuffer::moveWithin(GLuint buffer, uint64_t source, uint64_t destination, uint64_t size) const {
+    glState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, destination, size);
+}
+
+/**
+ * @brief Run one step of background compaction
+ *
+ * @param budgetBytes Bytes the GPU may copy this frame, shared by both buffers
+ * @return uint64_t Bytes moved
+ *
+ * Called once per frame. Copies are queued on the GL stream after the
+ * previous frame's draws, so meshes move without a stall.
+ */
+uint64_t MeshBuffer::compact(uint64_t budgetBytes) {
+    uint64_t moved = vertexArena.compact(budgetBytes, [this](uint64_t source, uint64_t destination, uint64_t size) {
+        moveWithin(VBO, source, destination, size);
+    });
+    if (moved < budgetBytes) {
+        moved += indexArena.compact(budgetBytes - moved, [this](uint64_t source, uint64_t destination, uint64_t size) {
+            moveWithin(EBO, source, destination, size);
+        });
+    }
+    return moved;
+}
+
+/**
+ * @brief Print utilization and fragmentation of both buffers
+ */
+void MeshBuffer::report(std::ostream& out) const {
+    auto print = [&](const char* name, const ArenaStats& stats) {
+        out << name << " " << stats.used / 1024 << "/" << stats.capacity / 1024 << " KB in " << stats.allocations
+            << " (" << std::fixed << std::setprecision(1) << stats.utilization * 100.0 << "% used, "
+            << stats.fragmentation * 100.0 << "% fragmented)";
+    };
+    out << "mesh buffer: ";
+    print("vertices", vertexStats());
+    out << ", ";
+    print("indices", indexStats());
+    out << std::endl;
+}
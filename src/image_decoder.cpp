@@ -0,0 +1,477 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "image_decoder.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+/**
+ * @brief Largest width or height accepted from an image header
+ */
+const int IMAGE_MAX_DIMENSION = 1 << 15;
+
+static uint16_t readU16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+static uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+/**
+ * @brief Uncompressed BMP files
+ *
+ * 24 and 32-bit images keep their BGR order, so decoding is a row copy (and
+ * a vertical flip for bottom-up files) straight into the destination. 8-bit
+ * palette images are expanded to RGB through a lookup table.
+ */
+class BmpDecoder : public ImageDecoder {
+public:
+    const char* name() const override { return "bmp"; }
+
+    bool probe(const unsigned char* bytes, size_t length, ImageInfo& info) const override {
+        Layout layout;
+        if (!parse(bytes, length, layout)) return false;
+        info.width = layout.width;
+        info.height = layout.height;
+        info.channels = layout.bitsPerPixel == 32 ? 4 : 3;
+        info.bgr = layout.bitsPerPixel != 8;
+        return true;
+    }
+
+    bool decode(const unsigned char* bytes, size_t length, const ImageInfo& info,
+                unsigned char* pixels, std::string& error) const override {
+        Layout layout;
+        if (!parse(bytes, length, layout) || layout.width != info.width || layout.height != info.height) {
+            error = "invalid BMP header";
+            return false;
+        }
+
+        size_t rowBytes = info.rowBytes();
+        for (int y = 0; y < layout.height; y++) {
+            int sourceRow = layout.topDown ? y : layout.height - 1 - y;
+            const unsigned char* source = bytes + layout.pixelOffset + static_cast<size_t>(sourceRow) * layout.stride;
+            unsigned char* row = pixels + static_cast<size_t>(y) * rowBytes;
+            if (layout.bitsPerPixel == 8) {
+                // Four-byte stores overlap by one; the last pixel is written alone
+                for (int x = 0; x + 1 < layout.width; x++) std::memcpy(row + x * 3, &layout.palette[source[x]], 4);
+                std::memcpy(row + (layout.width - 1) * 3, &layout.palette[source[layout.width - 1]], 3);
+            } else {
+                std::memcpy(row, source, rowBytes);
+            }
+        }
+
+        if (layout.bitsPerPixel == 32 && !layout.hasAlpha) {
+            for (size_t i = 3; i < info.byteSize(); i += 4) pixels[i] = 255;
+        }
+        return true;
+    }
+
+private:
+    struct Layout {
+        int width = 0, height = 0;
+        bool topDown = false;
+        int bitsPerPixel = 0;
+        size_t pixelOffset = 0;
+        size_t stride = 0;
+        bool hasAlpha = false;
+        uint32_t palette[256] = {};         // R, G, B, 0 in memory order
+    };
+
+    static bool parse(const unsigned char* bytes, size_t length, Layout& layout) {
+        if (length < 54 || bytes[0] != 'B' || bytes[1] != 'M') return false;
+        uint32_t headerSize = readU32(bytes + 14);
+        if (headerSize != 40 && headerSize != 108 && headerSize != 124) return false;
+
+        int32_t width = static_cast<int32_t>(readU32(bytes + 18));
+        int32_t height = static_cast<int32_t>(readU32(bytes + 22));
+        uint16_t bitsPerPixel = readU16(bytes + 28);
+        uint32_t compression = readU32(bytes + 30);
+        layout.topDown = height < 0;
+        if (height < 0) height = -height;
+        if (width <= 0 || height <= 0 || width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) return false;
+        layout.width = width;
+        layout.height = height;
+        layout.bitsPerPixel = bitsPerPixel;
+
+        const uint32_t BI_RGB = 0, BI_BITFIELDS = 3;
+        if (bitsPerPixel == 32 && compression == BI_BITFIELDS) {
+            // Only the usual BGRA layout is a plain copy; other masks go to stb
+            if (length < 70 || readU32(bytes + 54) != 0x00FF0000u || readU32(bytes + 58) != 0x0000FF00u ||
+                readU32(bytes + 62) != 0x000000FFu) {
+                return false;
+            }
+            layout.hasAlpha = headerSize > 40 && readU32(bytes + 66) == 0xFF000000u;
+        } else if (compression != BI_RGB || (bitsPerPixel != 8 && bitsPerPixel != 24 && bitsPerPixel != 32)) {
+            return false;
+        }
+
+        layout.pixelOffset = readU32(bytes + 10);
+        layout.stride = (static_cast<size_t>(width) * bitsPerPixel + 31) / 32 * 4;
+        if (layout.pixelOffset > length || layout.stride * height > length - layout.pixelOffset) return false;
+
+        if (bitsPerPixel == 32 && compression == BI_RGB) {
+            // Alpha is undefined in BI_RGB; honour it only if some pixel sets it
+            for (int y = 0; y < height && !layout.hasAlpha; y++) {
+                const unsigned char* row = bytes + layout.pixelOffset + y * layout.stride;
+                for (int x = 0; x < width; x++) {
+                    if (row[x * 4 + 3]) {
+                        layout.hasAlpha = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (bitsPerPixel == 8) {
+            uint32_t colors = readU32(bytes + 46);
+            if (colors == 0 || colors > 256) colors = 256;
+            size_t paletteOffset = 14 + static_cast<size_t>(headerSize);
+            if (paletteOffset + colors * 4 > layout.pixelOffset) return false;
+            for (uint32_t i = 0; i < colors; i++) {
+                const unsigned char* entry = bytes + paletteOffset + i * 4;
+                unsigned char rgb[4] = {entry[2], entry[1], entry[0], 0};
+                std::memcpy(&layout.palette[i], rgb, 4);
+            }
+        }
+        return true;
+    }
+};
+
+#ifdef HAVE_LIBJPEG
+
+/**
+ * @brief libjpeg error manager that returns to the caller instead of exiting
+ */
+struct JpegErrorManager {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static void jpegErrorExit(j_common_ptr cinfo) {
+    JpegErrorManager* errors = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, errors->message);
+    longjmp(errors->jump, 1);
+}
+
+static void jpegIgnoreMessage(j_common_ptr, int) {}
+
+/**
+ * @brief JPEG through libjpeg, whose libjpeg-turbo build uses SIMD for the
+ * IDCT, upsampling and color conversion
+ *
+ * Scanlines are decoded straight into the destination rows. CMYK images
+ * are left to stb.
+ */
+class JpegDecoder : public ImageDecoder {
+public:
+    const char* name() const override {
+#ifdef LIBJPEG_TURBO_VERSION
+        return "libjpeg-turbo";
+#else
+        return "libjpeg";
+#endif
+    }
+
+    bool probe(const unsigned char* bytes, size_t length, ImageInfo& info) const override {
+        if (length < 3 || bytes[0] != 0xFF || bytes[1] != 0xD8 || bytes[2] != 0xFF) return false;
+        std::string error;
+        return run(bytes, length, info, nullptr, error);
+    }
+
+    bool decode(const unsigned char* bytes, size_t length, const ImageInfo& info,
+                unsigned char* pixels, std::string& error) const override {
+        ImageInfo decoded = info;
+        return run(bytes, length, decoded, pixels, error);
+    }
+
+private:
+    /**
+     * @brief Read the header into info, then the pixels if a destination is given
+     *
+     * Kept free of objects with destructors, since errors longjmp out of it.
+     */
+    static bool run(const unsigned char* bytes, size_t length, ImageInfo& info, unsigned char* pixels,
+                    std::string& error) {
+        jpeg_decompress_struct cinfo;
+        JpegErrorManager errors;
+        cinfo.err = jpeg_std_error(&errors.manager);
+        errors.manager.error_exit = jpegErrorExit;
+        errors.manager.emit_message = jpegIgnoreMessage;
+        if (setjmp(errors.jump)) {
+            jpeg_destroy_decompress(&cinfo);
+            error = errors.message;
+            return false;
+        }
+
+        jpeg_create_decompress(&cinfo);
+        jpeg_mem_src(&cinfo, const_cast<unsigned char*>(bytes), static_cast<unsigned long>(length));
+        jpeg_read_header(&cinfo, TRUE);
+        bool gray = cinfo.jpeg_color_space == JCS_GRAYSCALE;
+        bool supported = gray || cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB;
+        int width = static_cast<int>(cinfo.image_width);
+        int height = static_cast<int>(cinfo.image_height);
+        if (!supported || width <= 0 || height <= 0 || width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) {
+            jpeg_destroy_decompress(&cinfo);
+            error = "unsupported JPEG";
+            return false;
+        }
+
+        if (!pixels) {
+            info.width = width;
+            info.height = height;
+            info.channels = gray ? 1 : 3;
+            info.bgr = false;
+            jpeg_destroy_decompress(&cinfo);
+            return true;
+        }
+        if (width != info.width || height != info.height || info.channels != (gray ? 1 : 3)) {
+            jpeg_destroy_decompress(&cinfo);
+            error = "JPEG header changed between probe and decode";
+            return false;
+        }
+
+        cinfo.out_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_start_decompress(&cinfo);
+        size_t rowBytes = info.rowBytes();
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW rows[16];
+            JDIMENSION count = 0;
+            for (; count < 16 && cinfo.output_scanline + count < cinfo.output_height; count++) {
+                rows[count] = pixels + (cinfo.output_scanline + count) * rowBytes;
+            }
+            jpeg_read_scanlines(&cinfo, rows, count);
+        }
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        return true;
+    }
+};
+
+#endif
+
+/**
+ * @brief Everything stb_image reads; decodes into its own buffer and copies
+ */
+class StbDecoder : public ImageDecoder {
+public:
+    const char* name() const override { return "stb_image"; }
+
+    bool probe(const unsigned char* bytes, size_t length, ImageInfo& info) const override {
+        int width, height, channels;
+        if (!stbi_info_from_memory(bytes, static_cast<int>(length), &width, &height, &channels)) return false;
+        if (width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) return false;
+        info.width = width;
+        info.height = height;
+        info.channels = channels == 2 ? 4 : channels; // Gray with alpha is expanded
+        info.bgr = false;
+        return true;
+    }
+
+    bool decode(const unsigned char* bytes, size_t length, const ImageInfo& info,
+                unsigned char* pixels, std::string& error) const override {
+        int width, height, channels;
+        unsigned char* data = stbi_load_from_memory(bytes, static_cast<int>(length), &width, &height, &channels,
+                                                    info.channels);
+        if (!data) {
+            error = stbi_failure_reason();
+            return false;
+        }
+        bool matches = width == info.width && height == info.height;
+        if (matches) std::memcpy(pixels, data, info.byteSize());
+        else error = "image size changed between probe and decode";
+        stbi_image_free(data);
+        return matches;
+    }
+};
+
+static std::vector<std::unique_ptr<ImageDecoder>>& registry() {
+    static std::vector<std::unique_ptr<ImageDecoder>> decoders = []() {
+        std::vector<std::unique_ptr<ImageDecoder>> builtIn;
+        builtIn.emplace_back(new BmpDecoder());
+#ifdef HAVE_LIBJPEG
+        builtIn.emplace_back(new JpegDecoder());
+#endif
+        builtIn.emplace_back(new StbDecoder());
+        return builtIn;
+    }();
+    return decoders;
+}
+
+/**
+ * @brief Register a decoder, tried before all registered so far
+ *
+ * Call during startup, before any thread decodes.
+ */
+void image_decode::addDecoder(std::unique_ptr<ImageDecoder> decoder) {
+    registry().insert(registry().begin(), std::move(decoder));
+}
+
+const std::vector<std::unique_ptr<ImageDecoder>>& image_decode::decoders() {
+    return registry();
+}
+
+/**
+ * @brief Find the first decoder that takes an image
+ *
+ * @param info Receives the image's layout as that decoder will write it
+ * @return const ImageDecoder* Decoder, or nullptr if none recognizes the data
+ */
+const ImageDecoder* image_decode::find(const unsigned char* bytes, size_t length, ImageInfo& info) {
+    for (const auto& decoder : registry()) {
+        if (decoder->probe(bytes, length, info)) return decoder.get();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Decode an image into a vector
+ *
+ * @param info Receives the image's layout
+ * @param pixels Receives info.byteSize() bytes of pixels
+ * @param error Set when false is returned
+ */
+bool image_decode::decode(const unsigned char* bytes, size_t length, ImageInfo& info,
+                          std::vector<unsigned char>& pixels, std::string& error) {
+    const ImageDecoder* decoder = find(bytes, length, info);
+    if (!decoder) {
+        error = "unrecognized image format";
+        return false;
+    }
+    pixels.resize(info.byteSize());
+    return decoder->decode(bytes, length, info, pixels.data(), error);
+}
+
+bool image_encode::jpegAvailable() {
+#ifdef HAVE_LIBJPEG
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_LIBJPEG
+
+/**
+ * @brief Compress rows to JPEG; free of objects with destructors, like JpegDecoder::run
+ */
+static bool compressJpeg(const ImageInfo& info, const unsigned char* pixels, int quality, unsigned char* row,
+                         unsigned char** buffer, unsigned long* size, std::string& error) {
+    jpeg_compress_struct cinfo;
+    JpegErrorManager errors;
+    cinfo.err = jpeg_std_error(&errors.manager);
+    errors.manager.error_exit = jpegErrorExit;
+    errors.manager.emit_message = jpegIgnoreMessage;
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        error = errors.message;
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, buffer, size);
+    cinfo.image_width = static_cast<JDIMENSION>(info.width);
+    cinfo.image_height = static_cast<JDIMENSION>(info.height);
+    cinfo.input_components = info.channels;
+    cinfo.in_color_space = info.channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    size_t rowBytes = info.rowBytes();
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const unsigned char* source = pixels + cinfo.next_scanline * rowBytes;
+        if (info.bgr) {
+            for (int x = 0; x < info.width; x++) {
+                row[x * 3] = source[x * 3 + 2];
+                row[x * 3 + 1] = source[x * 3 + 1];
+                row[x * 3 + 2] = source[x * 3];
+            }
+        } else {
+            std::memcpy(row, source, rowBytes);
+        }
+        JSAMPROW rows[1] = {row};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+#endif
+
+/**
+ * @brief Encode 1 or 3-channel pixels as a baseline JPEG
+ *
+ * @param quality libjpeg quality, 1 to 100
+ */
+bool image_encode::jpeg(const ImageInfo& info, const unsigned char* pixels, int quality, std::vector<unsigned char>& out,
+                        std::string& error) {
+#ifdef HAVE_LIBJPEG
+    if (info.channels != 1 && info.channels != 3) {
+        error = "JPEG takes 1 or 3 channels";
+        return false;
+    }
+    std::vector<unsigned char> row(info.rowBytes());
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    bool encoded = compressJpeg(info, pixels, quality, row.data(), &buffer, &size, error);
+    if (encoded) out.assign(buffer, buffer + size);
+    free(buffer);
+    return encoded;
+#else
+    (void)info;
+    (void)pixels;
+    (void)quality;
+    (void)out;
+    error = "built without libjpeg";
+    return false;
+#endif
+}
+
+/**
+ * @brief Encode pixels as an uncompressed, bottom-up BMP
+ *
+ * Gray images are written as 24-bit; 4-channel images as 32-bit BGRA.
+ */
+void image_encode::bmp(const ImageInfo& info, const unsigned char* pixels, std::vector<unsigned char>& out) {
+    int bitsPerPixel = info.channels == 4 ? 32 : 24;
+    int bytesPerPixel = bitsPerPixel / 8;
+    size_t stride = (static_cast<size_t>(info.width) * bytesPerPixel + 3) & ~static_cast<size_t>(3);
+    out.assign(54 + stride * info.height, 0);
+    auto put16 = [&](size_t offset, uint16_t value) { std::memcpy(&out[offset], &value, 2); };
+    auto put32 = [&](size_t offset, uint32_t value) { std::memcpy(&out[offset], &value, 4); };
+    out[0] = 'B';
+    out[1] = 'M';
+    put32(2, static_cast<uint32_t>(out.size()));
+    put32(10, 54);
+    put32(14, 40);
+    put32(18, static_cast<uint32_t>(info.width));
+    put32(22, static_cast<uint32_t>(info.height));
+    put16(26, 1);
+    put16(28, static_cast<uint16_t>(bitsPerPixel));
+
+    for (int y = 0; y < info.height; y++) {
+        const unsigned char* source = pixels + (info.height - 1 - y) * info.rowBytes();
+        unsigned char* row = &out[54 + y * stride];
+        for (int x = 0; x < info.width; x++) {
+            const unsigned char* texel = source + x * info.channels;
+            unsigned char* target = row + x * bytesPerPixel;
+            if (info.channels == 1) {
+                target[0] = target[1] = target[2] = texel[0];
+                continue;
+            }
+            target[0] = info.bgr ? texel[0] : texel[2];
+            target[1] = texel[1];
+            target[2] = info.bgr ? texel[2] : texel[0];
+            if (info.channels == 4) target[3] = texel[3];
+        }
+    }
+}
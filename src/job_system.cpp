@@ -0,0 +1,145 @@
+#include "job_system.h"
+#include <algorithm>
+
+/**
+ * @brief Start the worker threads
+ *
+ * @param workerCount Number of workers; 0 picks one less than the hardware
+ * thread count so the render thread keeps a core to itself
+ */
+JobSystem::JobSystem(unsigned workerCount) {
+    if (workerCount == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        workerCount = hw > 1 ? hw - 1 : 1;
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+/**
+ * @brief Finish queued jobs and join the workers
+ */
+JobSystem::~JobSystem() {
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief Queue a job for any worker
+ *
+ * @param job Work to run; it must not throw
+ */
+void JobSystem::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+/**
+ * @brief Run body over [0, count) split into chunks of at least `grain`
+ *
+ * @param count Number of items
+ * @param grain Minimum items per chunk, to keep scheduling overhead low
+ * @param body Called with each [begin, end) chunk, possibly concurrently
+ *
+ * Blocks until every chunk is done. The calling thread claims chunks too,
+ * so small loops finish without waking any worker.
+ */
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers.empty()) {
+        body(0, count);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> exited{0};
+    auto drain = [&]() {
+        size_t chunk;
+        while ((chunk = next.fetch_add(1)) < chunks) {
+            size_t begin = chunk * grain;
+            body(begin, std::min(begin + grain, count));
+        }
+    };
+
+    size_t helpers = std::min<size_t>(chunks - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++) {
+        submit([&]() {
+            drain();
+            exited.fetch_add(1, std::memory_order_release);
+        });
+    }
+    drain();
+
+    // Helpers reference this stack frame, so wait until every one has run,
+    // helping with queued work (possibly our own helpers) in the meantime
+    while (exited.load(std::memory_order_acquire) < helpers) {
+        if (!runOne()) std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief Block until the queue is empty and no job is running
+ */
+void JobSystem::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return queue.empty() && active == 0; });
+}
+
+/**
+ * @brief Pop and run one queued job on the calling thread
+ *
+ * @return bool False if the queue was empty
+ */
+bool JobSystem::runOne() {
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) return false;
+        job = std::move(queue.front());
+        queue.pop_front();
+        active++;
+    }
+    job();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active--;
+        if (queue.empty() && active == 0) idle.notify_all();
+    }
+    return true;
+}
+
+/**
+ * @brief Worker thread body: sleep until there is a job, run it, repeat
+ */
+void JobSystem::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            active++;
+        }
+        job();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            if (queue.empty() && active == 0) idle.notify_all();
+        }
+    }
+}
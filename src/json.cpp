@@ -0,0 +1,284 @@
+#include "json.h"
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief Nesting limit; deeper documents are rejected instead of overflowing the stack
+ */
+const int JSON_MAX_DEPTH = 256;
+
+/**
+ * @brief Recursive descent parser for JsonValue
+ */
+class JsonParser {
+public:
+    JsonParser(const char* text, size_t length) : cursor(text), end(text + length) {}
+
+    bool parseDocument(JsonValue& out) {
+        if (!parseValue(out, 0)) return false;
+        skipWhitespace();
+        if (cursor != end) return fail("trailing characters after document");
+        return true;
+    }
+
+    std::string error;
+    size_t offset(const char* begin) const { return static_cast<size_t>(cursor - begin); }
+
+private:
+    bool fail(const char* message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) cursor++;
+    }
+
+    bool literal(const char* word) {
+        size_t length = std::strlen(word);
+        if (static_cast<size_t>(end - cursor) < length || std::memcmp(cursor, word, length) != 0) return fail("invalid literal");
+        cursor += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out, int depth) {
+        if (depth > JSON_MAX_DEPTH) return fail("document nested too deeply");
+        skipWhitespace();
+        if (cursor >= end) return fail("unexpected end of document");
+
+        switch (*cursor) {
+        case '{': return parseObject(out, depth);
+        case '[': return parseArray(out, depth);
+        case '"':
+            out.kind = JsonValue::Type::String;
+            return parseString(out.text);
+        case 't':
+            out.kind = JsonValue::Type::Bool;
+            out.flag = true;
+            return literal("true");
+        case 'f':
+            out.kind = JsonValue::Type::Bool;
+            out.flag = false;
+            return literal("false");
+        case 'n':
+            out.kind = JsonValue::Type::Null;
+            return literal("null");
+        default:
+            return parseNumber(out);
+        }
+    }
+
+    bool parseNumber(JsonValue& out) {
+        const char* start = cursor;
+        if (cursor < end && *cursor == '-') cursor++;
+        if (cursor >= end || *cursor < '0' || *cursor > '9') return fail("invalid number");
+        while (cursor < end && ((*cursor >= '0' && *cursor <= '9') || *cursor == '.' || *cursor == 'e' ||
+                                *cursor == 'E' || *cursor == '+' || *cursor == '-')) {
+            cursor++;
+        }
+        // strtod needs a terminated string; numbers are short
+        std::string digits(start, cursor);
+        char* parsedEnd = nullptr;
+        out.value = std::strtod(digits.c_str(), &parsedEnd);
+        if (parsedEnd != digits.c_str() + digits.size()) return fail("invalid number");
+        out.kind = JsonValue::Type::Number;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned codepoint) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned& codepoint) {
+        if (end - cursor < 4) return fail("truncated unicode escape");
+        codepoint = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *cursor++;
+            codepoint <<= 4;
+            if (c >= '0' && c <= '9') codepoint |= c - '0';
+            else if (c >= 'a' && c <= 'f') codepoint |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') codepoint |= c - 'A' + 10;
+            else return fail("invalid unicode escape");
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        cursor++; // Opening quote
+        out.clear();
+        while (cursor < end) {
+            char c = *cursor++;
+            if (c == '"') return true;
+            if (static_cast<unsigned char>(c) < 0x20) return fail("control character in string");
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (cursor >= end) break;
+            switch (*cursor++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned codepoint;
+                if (!parseHex4(codepoint)) return false;
+                if (codepoint >= 0xD800 && codepoint < 0xDC00) {
+                    // High surrogate; the low half must follow
+                    unsigned low;
+                    if (end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u') return fail("unpaired surrogate");
+                    cursor += 2;
+                    if (!parseHex4(low) || low < 0xDC00 || low >= 0xE000) return fail("unpaired surrogate");
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, codepoint);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parseArray(JsonValue& out, int depth) {
+        cursor++;
+        out.kind = JsonValue::Type::Array;
+        skipWhitespace();
+        if (cursor < end && *cursor == ']') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            out.items.emplace_back();
+            if (!parseValue(out.items.back(), depth + 1)) return false;
+            skipWhitespace();
+            if (cursor >= end) return fail("unterminated array");
+            if (*cursor == ',') {
+                cursor++;
+                continue;
+            }
+            if (*cursor == ']') {
+                cursor++;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parseObject(JsonValue& out, int depth) {
+        cursor++;
+        out.kind = JsonValue::Type::Object;
+        skipWhitespace();
+        if (cursor < end && *cursor == '}') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            skipWhitespace();
+            if (cursor >= end || *cursor != '"') return fail("expected member name");
+            out.fields.emplace_back();
+            if (!parseString(out.fields.back().first)) return false;
+            skipWhitespace();
+            if (cursor >= end || *cursor != ':') return fail("expected ':'");
+            cursor++;
+            if (!parseValue(out.fields.back().second, depth + 1)) return false;
+            skipWhitespace();
+            if (cursor >= end) return fail("unterminated object");
+            if (*cursor == ',') {
+                cursor++;
+                continue;
+            }
+            if (*cursor == '}') {
+                cursor++;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    const char* cursor;
+    const char* end;
+};
+
+/**
+ * @brief Parse a JSON document
+ *
+ * @param text Document text, not necessarily null-terminated
+ * @param length Length of the text in bytes
+ * @param out Receives the root value
+ * @param error Receives a message and byte offset on failure
+ * @return bool Whether the whole text was a valid document
+ */
+bool JsonValue::parse(const char* text, size_t length, JsonValue& out, std::string& error) {
+    out = JsonValue();
+    JsonParser parser(text, length);
+    if (parser.parseDocument(out)) return true;
+    error = parser.error + " at byte " + std::to_string(parser.offset(text));
+    return false;
+}
+
+/**
+ * @brief Shared value returned for missing members and elements
+ */
+static const JsonValue& nullValue() {
+    static const JsonValue value;
+    return value;
+}
+
+/**
+ * @brief The number as an int, or fallback unless it is a whole number within int's range
+ *
+ * Files are untrusted, and casting NaN or an out-of-range double is undefined.
+ */
+int JsonValue::integer(int fallback) const {
+    if (kind != Type::Number || !std::isfinite(value) || value != std::floor(value)) return fallback;
+    if (value < static_cast<double>(INT_MIN) || value > static_cast<double>(INT_MAX)) return fallback;
+    return static_cast<int>(value);
+}
+
+size_t JsonValue::size() const {
+    if (kind == Type::Array) return items.size();
+    if (kind == Type::Object) return fields.size();
+    return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    if (kind != Type::Array || index >= items.size()) return nullValue();
+    return items[index];
+}
+
+/**
+ * @brief Look up an object member; linear, which beats hashing for glTF-sized objects
+ */
+const JsonValue& JsonValue::operator[](const char* key) const {
+    if (kind != Type::Object) return nullValue();
+    for (const auto& field : fields) {
+        if (field.first == key) return field.second;
+    }
+    return nullValue();
+}
+
+bool JsonValue::has(const char* key) const {
+    return !(*this)[key].isNull();
+}
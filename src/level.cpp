@@ -0,0 +1,351 @@
+#include "level.h"
+#include <cstring>
+#include <fstream>
+#include "collision.h"
+#include "pvs.h"
+
+const uint32_t LEVEL_FILE_MAGIC = 0x564C4D45;  // "EMLV"
+const uint32_t LEVEL_FILE_VERSION = 2;
+const size_t LEVEL_SECTION_ALIGNMENT = 16;
+const uint32_t LEVEL_SECTION_TYPES = static_cast<uint32_t>(LevelSection::Visibility) + 1;
+
+namespace {
+
+struct LevelHeader {
+    uint32_t magic, version;
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+struct LevelSectionEntry {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Sections are raw memory images; catch layout changes that would need a version bump
+static_assert(sizeof(LevelHeader) == 16, "level header layout");
+static_assert(sizeof(LevelSectionEntry) == 24, "level section entry layout");
+static_assert(sizeof(LevelMaterial) == 16, "level material layout");
+static_assert(sizeof(LevelEntity) == 56, "level entity layout");
+static_assert(sizeof(LevelGrid) == 32, "level grid layout");
+static_assert(sizeof(AABB) == 24, "collider layout");
+static_assert(sizeof(Bvh::Node) == 32, "BVH node layout");
+
+size_t alignUp(size_t value) {
+    return (value + LEVEL_SECTION_ALIGNMENT - 1) & ~(LEVEL_SECTION_ALIGNMENT - 1);
+}
+
+template <typename T>
+std::vector<unsigned char> bytesOf(const T* data, size_t count) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    return std::vector<unsigned char>(bytes, bytes + count * sizeof(T));
+}
+
+/**
+ * @brief Whether a stored BVH only refers to nodes and primitives that exist
+ *
+ * Children must come after their parent, as build() lays them out, so a
+ * corrupt file cannot make traversal loop, and the tree must be shallow
+ * enough for the fixed traversal stacks.
+ */
+bool validBvh(const Bvh::Node* nodes, size_t nodeCount, const uint32_t* primitives, size_t primitiveCount) {
+    for (size_t i = 0; i < nodeCount; i++) {
+        const Bvh::Node& node = nodes[i];
+        if (node.count > 0) {
+            if (static_cast<uint64_t>(node.rightOrFirst) + node.count > primitiveCount) return false;
+        } else if (i + 1 >= nodeCount || node.rightOrFirst <= i + 1 || node.rightOrFirst >= nodeCount) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < primitiveCount; i++) {
+        if (primitives[i] >= primitiveCount) return false;
+    }
+    return Bvh::depth(nodes, nodeCount) < BVH_STACK_SIZE;
+}
+
+/**
+ * @brief Whether stored grid buckets are in order and only refer to colliders that exist
+ */
+bool validGrid(const uint32_t* cellStart, size_t cellCount, const uint32_t* items, size_t itemCount,
+               size_t colliderCount) {
+    if (cellStart[0] != 0 || cellStart[cellCount - 1] != itemCount) return false;
+    for (size_t cell = 1; cell < cellCount; cell++) {
+        if (cellStart[cell] < cellStart[cell - 1]) return false;
+    }
+    for (size_t i = 0; i < itemCount; i++) {
+        if (items[i] >= colliderCount) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Map a level file and resolve its sections
+ *
+ * @param path File to open
+ * @param error Set on failure, including a version mismatch
+ * @return bool Whether the level can be used
+ */
+bool Level::open(const std::string& path, std::string& error) {
+    close();
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    LevelHeader header;
+    if (file.size() < sizeof(header)) {
+        error = path + " is not a level file";
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != LEVEL_FILE_MAGIC) {
+        error = path + " is not a level file";
+        close();
+        return false;
+    }
+    if (header.version != LEVEL_FILE_VERSION) {
+        error = path + " has format version " + std::to_string(header.version) + ", this build reads version " +
+                std::to_string(LEVEL_FILE_VERSION) + "; re-export it with --export-level";
+        close();
+        return false;
+    }
+    if (file.size() < sizeof(header) + static_cast<size_t>(header.sectionCount) * sizeof(LevelSectionEntry)) {
+        error = path + " has a truncated section table";
+        close();
+        return false;
+    }
+
+    // Fix-up: turn each section's offset into a pointer into the mapping
+    sections.assign(LEVEL_SECTION_TYPES, Span());
+    const LevelSectionEntry* table = reinterpret_cast<const LevelSectionEntry*>(file.data() + sizeof(header));
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        const LevelSectionEntry& entry = table[i];
+        if (entry.offset % LEVEL_SECTION_ALIGNMENT != 0 || entry.offset > file.size() ||
+            entry.size > file.size() - entry.offset) {
+            error = path + " has a section outside the file";
+            close();
+            return false;
+        }
+        if (entry.type >= LEVEL_SECTION_TYPES) continue;
+        sections[entry.type].data = file.data() + entry.offset;
+        sections[entry.type].size = static_cast<size_t>(entry.size);
+    }
+
+    const Span& entityBytes = section(LevelSection::Entities);
+    const Span& materialBytes = section(LevelSection::Materials);
+    const Span& stringBytes = section(LevelSection::Strings);
+    if (entityBytes.size % sizeof(LevelEntity) != 0 || materialBytes.size % sizeof(LevelMaterial) != 0 ||
+        (stringBytes.size > 0 && stringBytes.data[stringBytes.size - 1] != '\0')) {
+        error = path + " is corrupt";
+        close();
+        return false;
+    }
+    entities = reinterpret_cast<const LevelEntity*>(entityBytes.data);
+    entityTotal = entityBytes.size / sizeof(LevelEntity);
+    materials = reinterpret_cast<const LevelMaterial*>(materialBytes.data);
+    materialTotal = materialBytes.size / sizeof(LevelMaterial);
+    size_t colliderTotal = section(LevelSection::Colliders).size / sizeof(AABB);
+    for (size_t i = 0; i < entityTotal; i++) {
+        if ((entities[i].material != LEVEL_NO_MATERIAL && entities[i].material >= materialTotal) ||
+            (entities[i].collider != LEVEL_NO_COLLIDER && entities[i].collider >= colliderTotal)) {
+            error = path + " is corrupt";
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Unmap the level; entity and material references become invalid
+ */
+void Level::close() {
+    file.close();
+    sections.clear();
+    entities = nullptr;
+    materials = nullptr;
+    entityTotal = materialTotal = 0;
+}
+
+const Level::Span& Level::section(LevelSection type) const {
+    static const Span missing;
+    uint32_t index = static_cast<uint32_t>(type);
+    return index < sections.size() ? sections[index] : missing;
+}
+
+/**
+ * @brief Look up a string table entry
+ *
+ * @return const char* The string, or "" for an offset outside the table
+ */
+const char* Level::string(uint32_t offset) const {
+    const Span& strings = section(LevelSection::Strings);
+    if (offset >= strings.size) return "";
+    return reinterpret_cast<const char*>(strings.data + offset);
+}
+
+/**
+ * @brief Fill a collision world with the baked colliders, BVH and grid
+ *
+ * @param world World to replace the contents of; build() must not be called afterwards
+ * @param error Set if the collision sections are missing or inconsistent
+ */
+bool Level::loadCollision(CollisionWorld& world, std::string& error) const {
+    const Span& colliders = section(LevelSection::Colliders);
+    const Span& nodes = section(LevelSection::BvhNodes);
+    const Span& primitives = section(LevelSection::BvhPrimitives);
+    const Span& grid = section(LevelSection::Grid);
+    const Span& cells = section(LevelSection::GridCells);
+    const Span& items = section(LevelSection::GridItems);
+    if (colliders.size % sizeof(AABB) != 0 || nodes.size % sizeof(Bvh::Node) != 0 ||
+        primitives.size != colliders.size / sizeof(AABB) * sizeof(uint32_t) || grid.size != sizeof(LevelGrid)) {
+        error = "level has no usable collision";
+        return false;
+    }
+    LevelGrid placement;
+    std::memcpy(&placement, grid.data, sizeof(placement));
+    size_t cellCount = static_cast<size_t>(placement.cellsX) * placement.cellsZ + 1;
+    int minCells = colliders.size > 0 ? 1 : 0;     // Queries clamp into the grid, so it must have a cell to clamp to
+    if (placement.cellsX < minCells || placement.cellsZ < minCells || !(placement.cellSize > 0.0f) ||
+        cells.size != cellCount * sizeof(uint32_t) || items.size != static_cast<size_t>(placement.itemCount) * sizeof(uint32_t)) {
+        error = "level has a corrupt collision grid";
+        return false;
+    }
+
+    // Indices are used without checks at query time, so a corrupt file must not get that far
+    size_t count = colliders.size / sizeof(AABB);
+    const AABB* boxes = reinterpret_cast<const AABB*>(colliders.data);
+    const Bvh::Node* bvhNodes = reinterpret_cast<const Bvh::Node*>(nodes.data);
+    const uint32_t* order = reinterpret_cast<const uint32_t*>(primitives.data);
+    const uint32_t* cellStart = reinterpret_cast<const uint32_t*>(cells.data);
+    const uint32_t* cellItems = reinterpret_cast<const uint32_t*>(items.data);
+    if (!validBvh(bvhNodes, nodes.size / sizeof(Bvh::Node), order, count)) {
+        error = "level has a corrupt BVH";
+        return false;
+    }
+    if (!validGrid(cellStart, cellCount, cellItems, placement.itemCount, count)) {
+        error = "level has a corrupt collision grid";
+        return false;
+    }
+
+    world.load(boxes, count, bvhNodes, nodes.size / sizeof(Bvh::Node), order, count);
+    world.grid().assign(glm::vec3(placement.origin[0], placement.origin[1], placement.origin[2]), placement.cellSize,
+                        placement.cellsX, placement.cellsZ, cellStart, cellItems, placement.itemCount, boxes, count);
+    return true;
+}
+
+/**
+ * @brief Point a visibility set at the baked one inside the mapping
+ *
+ * The set reads straight from this level's file, so the level must stay open
+ * while it is in use.
+ */
+bool Level::loadVisibility(PotentiallyVisibleSet& visibility, std::string& error) const {
+    const Span& bytes = section(LevelSection::Visibility);
+    if (!bytes.data) {
+        error = "level has no baked visibility";
+        return false;
+    }
+    return visibility.attach(bytes.data, bytes.size, error);
+}
+
+/**
+ * @brief Add a string to the table
+ *
+ * @return uint32_t Its offset; equal strings share one entry
+ */
+uint32_t LevelWriter::addString(const std::string& text) {
+    for (size_t offset = 0; offset < strings.size(); offset += std::strlen(&strings[offset]) + 1) {
+        if (text == &strings[offset]) return static_cast<uint32_t>(offset);
+    }
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings.insert(strings.end(), text.begin(), text.end());
+    strings.push_back('\0');
+    return offset;
+}
+
+/**
+ * @brief Add a material
+ *
+ * @param source Model name, or virtual texture path with LEVEL_MATERIAL_VIRTUAL_TEXTURE
+ * @return uint32_t Index to give entities drawn with it
+ */
+uint32_t LevelWriter::addMaterial(const std::string& name, const std::string& source, uint32_t flags) {
+    materials.push_back({addString(name), addString(source), flags, 0});
+    return static_cast<uint32_t>(materials.size() - 1);
+}
+
+/**
+ * @brief Place an entity
+ *
+ * @param collider Index of its own box in the collision world given to setCollision, or LEVEL_NO_COLLIDER
+ */
+void LevelWriter::addEntity(const std::string& name, uint32_t material, uint32_t flags, uint32_t collider,
+                            const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    entities.push_back({addString(name), material, flags, collider,
+                        {position.x, position.y, position.z},
+                        {rotation.w, rotation.x, rotation.y, rotation.z},
+                        {scale.x, scale.y, scale.z}});
+}
+
+/**
+ * @brief Store a built collision world: its colliders, BVH and spatial grid
+ */
+void LevelWriter::setCollision(const CollisionWorld& world) {
+    std::vector<AABB> boxes(world.size());
+    for (size_t i = 0; i < boxes.size(); i++) boxes[i] = world.collider(static_cast<uint32_t>(i));
+    const Bvh& bvh = world.hierarchy();
+    const SpatialGrid& grid = world.grid();
+    LevelGrid placement = {{grid.origin.x, grid.origin.y, grid.origin.z}, grid.cellSize, grid.cellsX, grid.cellsZ,
+                           static_cast<uint32_t>(grid.items.size()), 0};
+
+    collision.clear();
+    collision.emplace_back(LevelSection::Colliders, bytesOf(boxes.data(), boxes.size()));
+    collision.emplace_back(LevelSection::BvhNodes, bytesOf(bvh.nodes.data(), bvh.nodes.size()));
+    collision.emplace_back(LevelSection::BvhPrimitives, bytesOf(bvh.primitives.data(), bvh.primitives.size()));
+    collision.emplace_back(LevelSection::Grid, bytesOf(&placement, 1));
+    collision.emplace_back(LevelSection::GridCells, bytesOf(grid.cellStart.data(), grid.cellStart.size()));
+    collision.emplace_back(LevelSection::GridItems, bytesOf(grid.items.data(), grid.items.size()));
+}
+
+/**
+ * @brief Write the level file
+ *
+ * @param path File to write
+ * @param error Set on failure
+ */
+bool LevelWriter::write(const std::string& path, std::string& error) const {
+    std::vector<std::pair<LevelSection, std::vector<unsigned char>>> parts;
+    parts.emplace_back(LevelSection::Strings, std::vector<unsigned char>(strings.begin(), strings.end()));
+    parts.emplace_back(LevelSection::Materials, bytesOf(materials.data(), materials.size()));
+    parts.emplace_back(LevelSection::Entities, bytesOf(entities.data(), entities.size()));
+    parts.insert(parts.end(), collision.begin(), collision.end());
+    if (!visibility.empty()) parts.emplace_back(LevelSection::Visibility, visibility);
+
+    LevelHeader header = {LEVEL_FILE_MAGIC, LEVEL_FILE_VERSION, static_cast<uint32_t>(parts.size()), 0};
+    std::vector<LevelSectionEntry> table;
+    size_t offset = alignUp(sizeof(header) + parts.size() * sizeof(LevelSectionEntry));
+    for (const auto& part : parts) {
+        table.push_back({static_cast<uint32_t>(part.first), 0, offset, part.second.size()});
+        offset = alignUp(offset + part.second.size());
+    }
+
+    std::vector<unsigned char> image(offset, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + sizeof(header), table.data(), table.size() * sizeof(LevelSectionEntry));
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (!parts[i].second.empty()) std::memcpy(image.data() + table[i].offset, parts[i].second.data(), parts[i].second.size());
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(image.data()), image.size());
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
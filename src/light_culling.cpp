@@ -0,0 +1,237 @@
+#include "light_culling.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include "gl_state.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIGHT_CULLING_SSE 1
+#endif
+
+/**
+ * @brief Layout of one light in the LightData uniform block (std140)
+ */
+struct GpuLight {
+    glm::vec4 positionRange;   // xyz: position, w: range
+    glm::vec4 directionCos;    // xyz: spot direction, w: cos(outer angle), -1 for point lights
+    glm::vec4 colorIntensity;  // rgb: color, a: intensity
+};
+
+/**
+ * @brief Smooth range window used by both the shader and the significance score
+ *
+ * @param distance Distance from the light
+ * @param range Light range
+ * @return float 1 at the light, falling smoothly to 0 at the range
+ */
+static float rangeWindow(float distance, float range) {
+    float ratio = distance / range;
+    float fade = std::max(1.0f - ratio * ratio * ratio * ratio, 0.0f);
+    return fade * fade;
+}
+
+/**
+ * @brief Destructor for LightCuller
+ */
+LightCuller::~LightCuller() {
+    glState().forgetBuffer(ubo);
+    if (ubo) glDeleteBuffers(1, &ubo);
+}
+
+/**
+ * @brief Create the light uniform buffer and bind it to LIGHT_UNIFORM_BINDING
+ */
+void LightCuller::create() {
+    glGenBuffers(1, &ubo);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_SCENE_LIGHTS * sizeof(GpuLight), nullptr, GL_DYNAMIC_DRAW);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, LIGHT_UNIFORM_BINDING, ubo);
+}
+
+/**
+ * @brief Replace the scene lights
+ *
+ * @param lights Lights to cull against; only the first MAX_SCENE_LIGHTS are used
+ *
+ * Rebuilds the structure-of-arrays copy the SIMD test reads. Padding lanes
+ * sit at infinity with zero range so they never pass the sphere test.
+ */
+void LightCuller::setLights(const std::vector<Light>& lights) {
+    sceneLights.assign(lights.begin(), lights.begin() + std::min<size_t>(lights.size(), MAX_SCENE_LIGHTS));
+    dirty = true;
+
+    size_t padded = (sceneLights.size() + 3) & ~size_t(3);
+    for (auto* lane : {&posX, &posY, &posZ, &range, &intensity, &dirX, &dirY, &dirZ, &sinOuter}) {
+        lane->assign(padded, 0.0f);
+    }
+    posX.assign(padded, 1e30f);
+    cosOuter.assign(padded, -1.0f);
+
+    for (size_t i = 0; i < sceneLights.size(); i++) {
+        const Light& light = sceneLights[i];
+        posX[i] = light.position.x;
+        posY[i] = light.position.y;
+        posZ[i] = light.position.z;
+        range[i] = light.range;
+        intensity[i] = light.intensity;
+
+        // Point lights get a zero axis and a 180 degree cone, which the cone test always passes
+        if (light.type == LightType::Spot) {
+            glm::vec3 dir = glm::normalize(light.direction);
+            dirX[i] = dir.x;
+            dirY[i] = dir.y;
+            dirZ[i] = dir.z;
+            cosOuter[i] = std::cos(light.outerAngle);
+            sinOuter[i] = std::sin(light.outerAngle);
+        }
+    }
+}
+
+/**
+ * @brief Assign lights to every object
+ *
+ * @param objects World-space bounds of each draw, indexed like the draws
+ * @param jobs Job system the objects are split across
+ */
+void LightCuller::cull(const std::vector<BoundingSphere>& objects, JobSystem& jobs) {
+    objectLights.resize(objects.size());
+    jobs.parallelFor(objects.size(), 64, [&](size_t begin, size_t end) {
+        cullRange(objects, begin, end);
+    });
+}
+
+/**
+ * @brief Cull and rank lights for objects [begin, end)
+ *
+ * Sphere-sphere and sphere-cone tests run on four lights per iteration. The
+ * cone test is the one from Wronski's "Cull that cone": the sphere is culled
+ * if it lies outside the cone's angle, beyond its range or behind its tip.
+ * Surviving lights are ranked by their intensity at the nearest point of the
+ * object's bounds and the strongest MAX_LIGHTS_PER_DRAW are kept.
+ */
+void LightCuller::cullRange(const std::vector<BoundingSphere>& objects, size_t begin, size_t end) {
+    size_t laneCount = posX.size();
+
+    for (size_t o = begin; o < end; o++) {
+        const BoundingSphere& sphere = objects[o];
+        LightAssignment assignment;
+        float scores[MAX_LIGHTS_PER_DRAW] = {};
+
+        for (size_t base = 0; base < laneCount; base += 4) {
+            int mask;
+#ifdef LIGHT_CULLING_SSE
+            __m128 cx = _mm_set1_ps(sphere.center.x);
+            __m128 cy = _mm_set1_ps(sphere.center.y);
+            __m128 cz = _mm_set1_ps(sphere.center.z);
+            __m128 radius = _mm_set1_ps(sphere.radius);
+
+            // Vector from the light to the object centre
+            __m128 vx = _mm_sub_ps(cx, _mm_loadu_ps(&posX[base]));
+            __m128 vy = _mm_sub_ps(cy, _mm_loadu_ps(&posY[base]));
+            __m128 vz = _mm_sub_ps(cz, _mm_loadu_ps(&posZ[base]));
+            __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+
+            // Sphere test
+            __m128 lightRange = _mm_loadu_ps(&range[base]);
+            __m128 reach = _mm_add_ps(lightRange, radius);
+            __m128 inside = _mm_cmplt_ps(lenSq, _mm_mul_ps(reach, reach));
+
+            // Cone test
+            __m128 axial = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&dirX[base])),
+                                                 _mm_mul_ps(vy, _mm_loadu_ps(&dirY[base]))),
+                                      _mm_mul_ps(vz, _mm_loadu_ps(&dirZ[base])));
+            __m128 radial = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lenSq, _mm_mul_ps(axial, axial)), _mm_setzero_ps()));
+            __m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&cosOuter[base]), radial),
+                                        _mm_mul_ps(axial, _mm_loadu_ps(&sinOuter[base])));
+            __m128 angleOk = _mm_cmple_ps(closest, radius);
+            __m128 frontOk = _mm_cmple_ps(axial, reach);
+            __m128 backOk = _mm_cmpge_ps(axial, _mm_sub_ps(_mm_setzero_ps(), radius));
+
+            mask = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(inside, angleOk), _mm_and_ps(frontOk, backOk)));
+#else
+            mask = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                size_t i = base + lane;
+                glm::vec3 v = sphere.center - glm::vec3(posX[i], posY[i], posZ[i]);
+                float lenSq = glm::dot(v, v);
+                float reach = range[i] + sphere.radius;
+                float axial = glm::dot(v, glm::vec3(dirX[i], dirY[i], dirZ[i]));
+                float radial = std::sqrt(std::max(lenSq - axial * axial, 0.0f));
+                float closest = cosOuter[i] * radial - axial * sinOuter[i];
+                if (lenSq < reach * reach && closest <= sphere.radius && axial <= reach && axial >= -sphere.radius) {
+                    mask |= 1 << lane;
+                }
+            }
+#endif
+            while (mask) {
+                int lane = __builtin_ctz(mask);
+                mask &= mask - 1;
+                size_t i = base + lane;
+
+                glm::vec3 v = sphere.center - glm::vec3(posX[i], posY[i], posZ[i]);
+                float nearest = std::max(glm::length(v) - sphere.radius, 0.0f);
+                float score = intensity[i] * rangeWindow(nearest, range[i]);
+
+                // Insertion into the small sorted list of the strongest lights
+                int slot = assignment.count < MAX_LIGHTS_PER_DRAW ? assignment.count++ : MAX_LIGHTS_PER_DRAW;
+                if (slot == MAX_LIGHTS_PER_DRAW) {
+                    if (score <= scores[MAX_LIGHTS_PER_DRAW - 1]) continue;
+                    slot = MAX_LIGHTS_PER_DRAW - 1;
+                }
+                while (slot > 0 && scores[slot - 1] < score) {
+                    scores[slot] = scores[slot - 1];
+                    assignment.indices[slot] = assignment.indices[slot - 1];
+                    slot--;
+                }
+                scores[slot] = score;
+                assignment.indices[slot] = static_cast<int>(i);
+            }
+        }
+
+        objectLights[o] = assignment;
+    }
+}
+
+/**
+ * @brief Upload the scene lights if they changed since the last upload
+ */
+void LightCuller::upload() {
+    if (!dirty) return;
+    dirty = false;
+
+    GpuLight gpuLights[MAX_SCENE_LIGHTS];
+    for (size_t i = 0; i < sceneLights.size(); i++) {
+        const Light& light = sceneLights[i];
+        gpuLights[i].positionRange = glm::vec4(light.position, light.range);
+        gpuLights[i].directionCos = glm::vec4(dirX[i], dirY[i], dirZ[i], cosOuter[i]);
+        gpuLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+    }
+
+    glState().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sceneLights.size() * sizeof(GpuLight), gpuLights);
+}
+
+/**
+ * @brief Connect a program's LightData block to the shared binding point
+ *
+ * @param program Linked shader program
+ */
+void LightCuller::attach(GLuint program) const {
+    GLuint index = glGetUniformBlockIndex(program, "LightData");
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, LIGHT_UNIFORM_BINDING);
+    }
+}
+
+/**
+ * @brief Set the compact light list of one object before drawing it
+ *
+ * @param program Currently bound shader program
+ * @param object Index of the object, as passed to cull()
+ */
+void LightCuller::apply(GLuint program, size_t object) const {
+    const LightAssignment& assignment = objectLights[object];
+    glUniform1i(glGetUniformLocation(program, "lightCount"), assignment.count);
+    glUniform4iv(glGetUniformLocation(program, "lightIndices"), 1, glm::value_ptr(assignment.indices));
+}
@@ -3,14 +3,44 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "model_loader.h"
+#include "camera.h"
+#include "collision.h"
+#include "frame_uniforms.h"
+#include "job_system.h"
+#include "light_culling.h"
+#include "decals.h"
+#include "oit.h"
+#include "profiler.h"
+#include "render_target.h"
+#include "flashlight.h"
+#include "batch_transform.h"
+#include "benchmarks.h"
+#include "gl_state.h"
+#include "async_io.h"
+#include "surfaces.h"
+#include "virtual_texture.h"
+#include "shadow_cascades.h"
+#include "pvs.h"
+#include "level.h"
+#include "physics.h"
+#include "combat.h"
+#include "ragdoll.h"
+#include "entity_pool.h"
+#include "spawn_director.h"
+#include "navmesh.h"
+#include <cstring>
+#include <map>
+#include <random>
+#include <sys/stat.h>
 
 const int WIDTH = 2400, HEIGHT = 1800;
 
-// Camera system variables
+// Player eye position and look direction (the first-person camera)
 glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f, 5.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -22,27 +52,171 @@ float lastX =  WIDTH / 2.0f;
 float lastY =  HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// Movement speed
-float cameraSpeed = 0.05f;
+// Movement speed in units per second
+float cameraSpeed = 3.0f;
+
+// Camera rigs, static colliders and the per-frame uniform buffer
+CameraSystem cameraSystem;
+CollisionWorld collisionWorld;
+FrameUniforms frameUniforms;
+int lastFrameTime = 0;
+
+// Worker threads and per-draw light selection
+JobSystem jobSystem;
+LightCuller lightCuller;
+DecalSystem decalSystem;
+std::vector<BoundingSphere> objectBounds; // Indexed like the draws: the level's entities, the props, then the pooled monsters
+
+// Streaming reads, and the virtually textured woods ground and house walls
+AsyncIo assetIo(&jobSystem);
+SurfaceMesh woodsGround, houseWalls;
+VirtualTexture groundTexture, wallTexture;
+VirtualTextureFeedback virtualFeedback;
+GLuint virtualProgram, virtualFlashlightProgram, feedbackProgram;
+
+// The baked level, its visibility between cells, and each object's cell in it
+const char* const LEVEL_PATH = "../assets/levels/woods.lvl";
+Level currentLevel;
+PotentiallyVisibleSet levelVisibility;  // Points into currentLevel's mapping
+std::vector<int> objectCells;           // Indexed like objectBounds
+int cameraCell = -1;
+bool exportLevel = false;               // --export-level: bake the scene as loaded into LEVEL_PATH at startup
+
+// A placed object, as the level stores it; its material names what kind of object it is
+struct SceneEntity {
+    std::string name;
+    std::string material;               // "spider_man" or "monster" for a model, "woods_ground" or "house_walls" for a surface
+    std::string source;                 // Model name or virtual texture path it is drawn with
+    uint32_t flags;                     // LEVEL_ENTITY_*
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+    uint32_t collider = LEVEL_NO_COLLIDER;  // Its own box in collisionWorld; surfaces have many, and keep none
+    ModelLoader* model = nullptr;       // Bound from the material: a loaded model,
+    SurfaceMesh* surface = nullptr;     // or a surface with its virtual texture
+    VirtualTexture* texture = nullptr;
+};
+std::vector<SceneEntity> sceneEntities; // Scene objects from 0 to firstProp
+std::vector<SceneEntity> monsterSpawns; // Monsters the level places; each comes out of the pool where it stands
+SceneEntity monsterTemplate;            // How every monster is sized, stood and flagged: the level's first, or the built-in one
+std::vector<size_t> shadowCasters;      // This frame's casters by caster id: flagged entities, then the monsters out
+size_t entityCasters = 0;               // How many of shadowCasters are entities
+std::vector<AABB> casterBounds;         // Indexed like shadowCasters
+std::vector<size_t> staticEntities;     // Entities flagged LEVEL_ENTITY_STATIC, which occlude in the visibility bake
+
+// Rigid bodies: the double door and the crates, pushed around by the player's body
+struct Prop {
+    BodyId body;
+    const SurfaceMesh* mesh;
+    glm::vec3 halfExtents;              // Of its box, for the navigation mesh
+};
+size_t firstProp = 0;                   // Objects from here on are props, which the level file does not hold
+PhysicsWorld physics;
+SurfaceMesh doorLeaf, crate;
+std::vector<Prop> props;                // Indexed from firstProp in objectBounds
+BodyId playerBody;
+const float PUSH_IMPULSE = 6.0f;        // E shoves the prop in view this hard, in N s
+const float PUSH_REACH = 2.5f;
+
+// Melee: a sword swung across the view with the right button, against the monster's hitboxes
+CombatSystem combat;
+HitboxSet monsterHitboxes;
+SwingId swordSwing;
+float swingTime = -1.0f;                // Seconds into the swing, negative between swings
+const float SWING_DURATION = 0.2f;
+const float SWING_ARC = 2.4f;           // Radians, from the right of the view to the left
+const float BLADE_LENGTH = 0.9f;
+const float BLADE_RADIUS = 0.04f;
+
+// A monster collapses as a ragdoll once the sword has struck it MONSTER_HEALTH times
+RagdollSystem ragdolls;
+RagdollTemplate monsterRagdoll;
+const int MONSTER_HEALTH = 3;
+const float MONSTER_MASS = 90.0f;
+const size_t RAGDOLL_BODY_BUDGET = 64;  // Bodies and joints simulated for ragdolls at once
+const size_t MAX_RAGDOLLS = 16;
+
+// Monsters, the level's and those that come and go in the woods, drawn from a fixed pool;
+// pool slot i is scene object firstMonster + i
+struct Monster {
+    TargetId target = 0;
+    int hits = 0;
+    RagdollId corpse = NO_RAGDOLL;      // Set once it is dead
+    uint32_t collider = LEVEL_NO_COLLIDER;  // Its box in collisionWorld while it lives, if the level placed it
+    NavPathId path = NO_NAV_PATH;       // Towards the player, while it lives and walks; level monsters hold their spot
+    uint32_t pathRevision = 0;          // Of the waypoints it is following
+    size_t waypoint = 0;
+    glm::vec3 goal;                     // Where the player was when the path was asked for
+};
+EntityPool monsterPool;
+std::vector<Monster> monsters;          // Indexed by pool slot
+size_t firstMonster = 0;
+const uint32_t MONSTER_POOL_SIZE = 32;
+const float MONSTER_SUMMON_DISTANCE = 4.0f; // M brings a monster out this far ahead
+const float MONSTER_SPEED = 1.6f;       // Walking pace, in m/s
+const float MONSTER_REACH = 1.2f;       // Stops this close to the player
+const float MONSTER_REPLAN_DISTANCE = 1.5f; // Asks for a new path once the player moved this far from its goal
+
+// Walkable floor for the monsters, rebuilt around the door leaves and crates as they move
+NavMesh navMesh;
+const size_t NAV_PLANS_PER_FRAME = 2;
+
+// Keeps monsters coming around the player within the frame budget
+SpawnDirector director;
+bool directorEnabled = true;            // --no-director: monsters only come out on M
+std::vector<DirectedMonster> directedMonsters; // Refilled every frame
+AABB monsterFootprint;                  // The monster's bounds relative to the point it stands on
+std::vector<uint32_t> spotOverlaps;
+
+// Off-screen scene target, transparency pass and frame timings
+SceneTarget sceneTarget;
+OitPass oitPass;
+TransparentQuads fogCards;
+GLuint oitProgram, compositeProgram;
+FrameProfiler profiler;
+GpuTimer oitTimer;
+GpuTimer frameTimer;
+int oitSection;
+bool oitStress = false; // --oit-stress: fill the view with fog cards and print pass timings
+int lastReportTime = 0;
+bool glStats = false;    // --gl-stats: print issued and filtered GL state calls
+
+// Player flashlight and its shader permutation
+Flashlight flashlight;
+GLuint flashlightProgram, shadowProgram;
+bool flashlightShadows = true; // --no-flashlight-shadows: skip the per-frame shadow map on low-end GPUs
+
+// Moonlight over the woods and its cascaded shadow maps
+ShadowCascades moonlight;
+bool moonShadows = true;       // --no-moon-shadows: light the woods without the cascades
+const float CAMERA_FOV = glm::radians(45.0f);
+const float CAMERA_ASPECT = 2400.0f / 1800.0f;
+const float CAMERA_NEAR = 0.1f;
 
 // Keyboard state tracking
 bool keys[256] = {false};
 
 // Shader and model loader (global variables)
 GLuint shaderProgram;
+MeshBuffer sceneGeometry;  // --mega-buffer: all model meshes suballocated from shared buffers
+bool megaBuffer = false;
+const uint64_t GEOMETRY_COMPACTION_BUDGET = 256 * 1024; // Bytes the GPU may move per frame
 ModelLoader modelLoader1, modelLoader2;
 glm::mat4 projection, view;
+TransformSoA sceneTransforms;              // Placement of each scene object, indexed like objectBounds
+std::vector<InstanceMatrices> sceneMatrices;
 
 /**
  * @brief Load shader from file
  *
  * @param shaderPath Path to the shader file
  * @param shaderType Type of shader to load (vertex or fragment)
+ * @param defines Preprocessor lines inserted after #version to select a permutation
  * @return GLuint Shader ID or 0 if loading fails
  *
  * This function reads a shader file, compiles the shader, and checks for errors.
  */
-GLuint loadShader(const char* shaderPath, GLenum shaderType) {
+GLuint loadShader(const char* shaderPath, GLenum shaderType, const std::string& defines = "") {
     std::ifstream shaderFile(shaderPath);
     if (!shaderFile.is_open()) {
         std::cerr << "Failed to load shader file: " << shaderPath << std::endl;
@@ -51,6 +225,10 @@ GLuint loadShader(const char* shaderPath, GLenum shaderType) {
     std::stringstream shaderStream;
     shaderStream << shaderFile.rdbuf();
     std::string shaderCode = shaderStream.str();
+    if (!defines.empty()) {
+        size_t versionEnd = shaderCode.find('\n') + 1;
+        shaderCode.insert(versionEnd, defines);
+    }
     const char* shaderSource = shaderCode.c_str();
 
     GLuint shader = glCreateShader(shaderType);
@@ -73,13 +251,16 @@ GLuint loadShader(const char* shaderPath, GLenum shaderType) {
  *
  * @param vertexPath Path to the vertex shader file
  * @param fragmentPath Path to the fragment shader file
+ * @param defines Preprocessor lines selecting a shader permutation
+ * @param vertexInputs Vertex input block from a VertexFormat, vertex stage only
  * @return GLuint Shader program ID
  *
  * This function creates, attaches, and links vertex and fragment shaders into a shader program.
  */
-GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
-    GLuint vertexShader = loadShader(vertexPath, GL_VERTEX_SHADER);
-    GLuint fragmentShader = loadShader(fragmentPath, GL_FRAGMENT_SHADER);
+GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath, const std::string& defines = "",
+                           const std::string& vertexInputs = "") {
+    GLuint vertexShader = loadShader(vertexPath, GL_VERTEX_SHADER, defines + vertexInputs);
+    GLuint fragmentShader = loadShader(fragmentPath, GL_FRAGMENT_SHADER, defines);
 
     GLuint curShaderProgram = glCreateProgram();
     glAttachShader(curShaderProgram, vertexShader);
@@ -100,6 +281,497 @@ GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
     return curShaderProgram;
 }
 
+/**
+ * @brief Lay the scene out as it is without a level file
+ *
+ * Spiderman stands on the left, facing right, and the Monster on the right.
+ * The ground and walls are built in world space.
+ */
+std::vector<SceneEntity> builtInEntities() {
+    glm::quat facing = glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+    return {
+        {"spider_man", "spider_man", "spider_man", LEVEL_ENTITY_CASTS_SHADOW, glm::vec3(-2.0f, 0.0f, 0.0f), facing, glm::vec3(1.5f)},
+        {"monster", "monster", "monster", LEVEL_ENTITY_CASTS_SHADOW, glm::vec3(2.0f, 0.0f, 0.0f), facing, glm::vec3(1.5f)},
+        {"woods_ground", "woods_ground", WOODS_GROUND_TEXTURE, LEVEL_ENTITY_STATIC, glm::vec3(0.0f), identity, glm::vec3(1.0f)},
+        {"house_walls", "house_walls", HOUSE_WALLS_TEXTURE, LEVEL_ENTITY_STATIC | LEVEL_ENTITY_CASTS_SHADOW,
+         glm::vec3(0.0f), identity, glm::vec3(1.0f)},
+    };
+}
+
+/**
+ * @brief Take the scene's entities from the level, in the order it lists them
+ *
+ * Entities without a material draw nothing and are left out.
+ */
+std::vector<SceneEntity> levelEntities() {
+    std::vector<SceneEntity> entities;
+    for (size_t i = 0; i < currentLevel.entityCount(); i++) {
+        const LevelEntity& entity = currentLevel.entity(i);
+        if (entity.material == LEVEL_NO_MATERIAL) continue;
+        const LevelMaterial& material = currentLevel.material(entity.material);
+        entities.push_back({currentLevel.string(entity.name), currentLevel.string(material.name),
+                            currentLevel.string(material.source), entity.flags, entity.translation(),
+                            entity.orientation(), entity.size(), entity.collider});
+    }
+    return entities;
+}
+
+/**
+ * @brief Point an entity at what draws it, by its material
+ *
+ * @return bool Whether the material is one the game knows
+ */
+bool bindEntity(SceneEntity& entity) {
+    if (entity.material == "spider_man") entity.model = &modelLoader2;
+    else if (entity.material == "monster") entity.model = &modelLoader1;
+    else if (entity.material == "woods_ground") entity.surface = &woodsGround, entity.texture = &groundTexture;
+    else if (entity.material == "house_walls") entity.surface = &houseWalls, entity.texture = &wallTexture;
+    else return false;
+    return true;
+}
+
+/**
+ * @brief Model name or texture path the scene binds to a material
+ *
+ * @param material Material name
+ * @param fallback Binding used when no entity has the material
+ */
+std::string materialSource(const std::string& material, const char* fallback) {
+    for (const SceneEntity& entity : sceneEntities) {
+        if (entity.material == material) return entity.source;
+    }
+    return material == monsterTemplate.material ? monsterTemplate.source : fallback;
+}
+
+/**
+ * @brief World-space bounds of a scene entity
+ *
+ * @param index Index of the entity in objectBounds
+ */
+AABB entityBounds(size_t index) {
+    const SceneEntity& entity = sceneEntities[index];
+    if (entity.model) return entity.model->bounds.transformed(sceneMatrices[index].model);
+    return entity.surface->bounds().transformed(sceneMatrices[index].model);
+}
+
+/**
+ * @brief World-space bounds of the monster model placed as an entity says
+ */
+AABB monsterBounds(const SceneEntity& placement) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), placement.position) * glm::mat4_cast(placement.rotation) *
+                      glm::scale(glm::mat4(1.0f), placement.scale);
+    return modelLoader1.bounds.transformed(model);
+}
+
+/**
+ * @brief Export the scene as placed now, with its collision and baked visibility, as a level file
+ *
+ * @param path File to write
+ * @param error Set on failure
+ */
+bool writeLevel(const char* path, std::string& error) {
+    LevelWriter writer;
+    std::map<std::string, uint32_t> materials;
+    for (const std::vector<SceneEntity>* entities : {&sceneEntities, &monsterSpawns}) {
+        for (const SceneEntity& entity : *entities) {
+            if (!materials.count(entity.material)) {
+                uint32_t flags = entity.surface ? LEVEL_MATERIAL_VIRTUAL_TEXTURE : 0;
+                materials[entity.material] = writer.addMaterial(entity.material, entity.source, flags);
+            }
+            writer.addEntity(entity.name, materials[entity.material], entity.flags, entity.collider, entity.position,
+                             entity.rotation, entity.scale);
+        }
+    }
+    writer.setCollision(collisionWorld);
+
+    // Visibility is baked against the static entities only; characters do not occlude
+    CollisionWorld staticWorld;
+    for (size_t index : staticEntities) {
+        const SceneEntity& entity = sceneEntities[index];
+        if (!entity.surface) staticWorld.addBox(entityBounds(index));
+        else for (const AABB& box : entity.surface->collisionBoxes()) staticWorld.addBox(box);
+    }
+    staticWorld.build();
+    PvsBakeOptions options;
+    for (size_t index : staticEntities) options.bounds.expand(entityBounds(index));
+    std::vector<unsigned char> visibility;
+    if (!PotentiallyVisibleSet::bake(staticWorld, options, &jobSystem, visibility, error)) return false;
+    writer.setVisibility(std::move(visibility));
+
+    mkdir("../assets/levels", 0755);
+    if (!writer.write(path, error)) return false;
+    std::cout << "Exported " << path << std::endl;
+    return true;
+}
+
+/**
+ * @brief Hang the double door in the doorway and put crates in the room
+ *
+ * @param floorHeight Height the models stand on
+ *
+ * Each leaf hinges on its jamb and swings either way until it is square
+ * with the wall. The player is a kinematic sphere at the eye, so walking
+ * into a leaf or a crate pushes it.
+ */
+void setupProps(float floorHeight) {
+    const glm::vec3 leafHalf(HOUSE_DOOR_HALF_WIDTH * 0.5f - 0.03f, HOUSE_DOOR_HEIGHT * 0.5f - 0.05f, 0.03f);
+    const glm::vec3 crateHalf(0.25f);
+    buildPropBox(doorLeaf, leafHalf, 6.5f / HOUSE_WALLS_PERIMETER);
+    buildPropBox(crate, crateHalf, 20.0f / HOUSE_WALLS_PERIMETER);
+    doorLeaf.create();
+    crate.create();
+
+    physics.setLevel(&collisionWorld);
+    auto addProp = [](const SurfaceMesh& mesh, const RigidBodyDesc& desc) {
+        props.push_back({physics.addBody(desc), &mesh, desc.shape.halfExtents});
+        sceneTransforms.push(desc.position, desc.orientation, glm::vec3(1.0f));
+        return props.back().body;
+    };
+
+    const float doorZ = HOUSE_NEAR_Z - HOUSE_WALL_THICKNESS * 0.5f;
+    for (float side : {-1.0f, 1.0f}) {
+        RigidBodyDesc leaf;
+        leaf.shape = CollisionShape::box(leafHalf);
+        leaf.position = glm::vec3(side * (HOUSE_DOOR_HALF_WIDTH * 0.5f - 0.01f), floorHeight + 0.05f + leafHalf.y, doorZ);
+        leaf.mass = 15.0f;
+        BodyId body = addProp(doorLeaf, leaf);
+        glm::vec3 hinge(leaf.position.x + side * leafHalf.x, leaf.position.y, doorZ);
+        physics.addHinge(PHYSICS_WORLD, body, hinge, glm::vec3(0.0f, 1.0f, 0.0f), -1.5f, 1.5f, 3.0f);
+    }
+
+    const glm::vec3 crateSpots[] = {glm::vec3(5.0f, 0.0f, 6.0f), glm::vec3(5.05f, 1.0f, 6.0f), glm::vec3(-4.5f, 0.0f, 2.5f)};
+    for (const glm::vec3& spot : crateSpots) {
+        RigidBodyDesc box;
+        box.shape = CollisionShape::box(crateHalf);
+        box.position = glm::vec3(spot.x, floorHeight + crateHalf.y + spot.y * (2.0f * crateHalf.y + 0.01f), spot.z);
+        box.mass = 8.0f;
+        addProp(crate, box);
+    }
+
+    RigidBodyDesc player;
+    player.shape = CollisionShape::sphere(0.35f);
+    player.position = cameraPos;
+    player.mass = 0.0f;
+    playerBody = physics.addBody(player);
+}
+
+/**
+ * @brief Reserve a scene object for every pooled monster, after the props
+ *
+ * Scene arrays, combat targets and ragdoll slots are all sized here, so
+ * monsters spawn and despawn later without allocating.
+ */
+void setupMonsterPool() {
+    monsterPool.create(MONSTER_POOL_SIZE);
+    monsters.assign(MONSTER_POOL_SIZE, Monster());
+    firstMonster = sceneTransforms.size();
+    glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < MONSTER_POOL_SIZE; i++) sceneTransforms.push(glm::vec3(0.0f), identity, glm::vec3(1.0f));
+    combat.reserveTargets(MONSTER_POOL_SIZE);
+    ragdolls.reserve(monsterRagdoll);
+    navMesh.reservePaths(MONSTER_POOL_SIZE);
+
+    SpawnDirectorSettings settings;
+    settings.ground = monsterTemplate.position.y;
+    settings.maxMonsters = MONSTER_POOL_SIZE;
+    director.create(settings, MONSTER_POOL_SIZE, 1);
+    directedMonsters.reserve(MONSTER_POOL_SIZE);
+    monsterFootprint = monsterBounds(monsterTemplate);
+    monsterFootprint.min -= monsterTemplate.position;
+    monsterFootprint.max -= monsterTemplate.position;
+}
+
+/**
+ * @brief Where the player stands, on the ground the monsters walk
+ */
+glm::vec3 playerOnGround() {
+    return glm::vec3(cameraPos.x, monsterTemplate.position.y, cameraPos.z);
+}
+
+/**
+ * @brief Bring a monster out of the pool
+ *
+ * @param position Where it stands, on the floor
+ * @param yaw Its heading in radians
+ * @param collider Its box in collisionWorld if the level placed it there; such a monster holds its spot
+ * @return Its handle, or one that is not alive if every monster is out
+ */
+EntityHandle spawnMonster(const glm::vec3& position, float yaw, uint32_t collider = LEVEL_NO_COLLIDER) {
+    EntityHandle entity = monsterPool.spawn();
+    if (!monsterPool.alive(entity)) return entity;
+    size_t index = firstMonster + entity.index;
+    sceneTransforms.set(index, position, glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f)), monsterTemplate.scale);
+    buildInstanceMatrices(sceneTransforms, index, index + 1, sceneMatrices.data() + index);
+    AABB box = modelLoader1.bounds.transformed(sceneMatrices[index].model);
+    objectBounds[index] = {box.center(), glm::length(box.extent()) * 0.5f};
+    objectCells[index] = levelVisibility.objectCell(box);
+
+    Monster& monster = monsters[entity.index];
+    monster.target = combat.addTarget(&monsterHitboxes, sceneMatrices[index].model);
+    monster.hits = 0;
+    monster.corpse = NO_RAGDOLL;
+    monster.collider = collider;
+    monster.goal = playerOnGround();
+    monster.path = collider == LEVEL_NO_COLLIDER ? navMesh.requestPath(position, monster.goal) : NO_NAV_PATH;
+    monster.pathRevision = navMesh.revision(monster.path);
+    monster.waypoint = 0;
+    return entity;
+}
+
+/**
+ * @brief Stop a level monster's box blocking anything: bodies, casts, spawns and the navmesh
+ */
+void disableMonsterCollider(Monster& monster) {
+    if (monster.collider == LEVEL_NO_COLLIDER) return;
+    collisionWorld.setEnabled(monster.collider, false);
+    navMesh.markDirty(collisionWorld.collider(monster.collider));
+    monster.collider = LEVEL_NO_COLLIDER;
+}
+
+/**
+ * @brief Return a monster, alive or dead, to the pool; stale handles are ignored
+ */
+void despawnMonster(EntityHandle entity) {
+    if (!monsterPool.alive(entity)) return;
+    Monster& monster = monsters[entity.index];
+    if (monster.corpse != NO_RAGDOLL) ragdolls.release(monster.corpse);
+    else combat.removeTarget(monster.target);
+    disableMonsterCollider(monster);
+    if (monster.path != NO_NAV_PATH) navMesh.releasePath(monster.path);
+    monster.path = NO_NAV_PATH;
+    monsterPool.despawn(entity);
+}
+
+/**
+ * @brief Whether the camera may see an object: in the view cone and not in a cell the PVS hides
+ *
+ * @param bounds Bounding sphere of the object
+ * @param cell Its PVS cell
+ */
+bool cameraSees(const BoundingSphere& bounds, int cell) {
+    glm::vec3 toCenter = bounds.center - cameraSystem.position();
+    float distance = glm::length(toCenter);
+    if (distance <= bounds.radius) return true;
+    // Half the diagonal field of view, widened by the sphere's angular radius
+    float halfAngle = std::atan(std::tan(CAMERA_FOV * 0.5f) * std::sqrt(1.0f + CAMERA_ASPECT * CAMERA_ASPECT));
+    float angle = halfAngle + std::asin(bounds.radius / distance);
+    if (angle < 3.14159265f && glm::dot(toCenter, cameraSystem.front()) < distance * std::cos(angle)) return false;
+    return levelVisibility.visible(cameraCell, cell);
+}
+
+/**
+ * @brief Whether a monster may appear on a spot: on the woods ground, clear of the level and out of sight
+ */
+bool monsterCanAppear(const glm::vec3& spot) {
+    AABB box = monsterFootprint;
+    box.min += spot;
+    box.max += spot;
+    box.min.y += 0.1f;  // Clear of the floor it stands on
+    const AABB& ground = woodsGround.bounds();
+    if (box.min.x < ground.min.x || box.max.x > ground.max.x || box.min.z < ground.min.z || box.max.z > ground.max.z) {
+        return false;
+    }
+    spotOverlaps.clear();
+    collisionWorld.overlapAABB(box, spotOverlaps);
+    if (!spotOverlaps.empty()) return false;
+    return !cameraSees({box.center(), glm::length(box.extent()) * 0.5f}, levelVisibility.objectCell(box));
+}
+
+/**
+ * @brief Let the spawn director bring monsters out around the player and put away those left behind
+ *
+ * @param deltaTime Frame time in seconds
+ */
+void updateDirector(float deltaTime) {
+    if (!directorEnabled) return;
+    directedMonsters.clear();
+    for (uint32_t i = 0; i < monsterPool.size(); i++) {
+        uint32_t slot = monsterPool.live()[i];
+        if (monsters[slot].collider != LEVEL_NO_COLLIDER) continue;  // The level's, until killed
+        size_t index = firstMonster + slot;
+        bool dead = monsters[slot].corpse != NO_RAGDOLL;
+        directedMonsters.push_back({monsterPool.handle(slot), objectBounds[index].center,
+                                    cameraSees(objectBounds[index], objectCells[index]), dead});
+    }
+    director.update(deltaTime, profiler.workMs(), cameraPos, cameraSystem.front(), directedMonsters, monsterCanAppear);
+
+    for (EntityHandle entity : director.despawns()) despawnMonster(entity);
+    for (const glm::vec3& spot : director.spawns()) {
+        glm::vec3 toPlayer = cameraPos - spot;
+        spawnMonster(spot, std::atan2(toPlayer.x, toPlayer.z));
+    }
+}
+
+/**
+ * @brief Swap a monster for its ragdoll, knocked the way the killing blow went
+ *
+ * @param slot Its pool slot
+ * @param blow Direction of the blow
+ */
+void killMonster(uint32_t slot, const glm::vec3& blow) {
+    Monster& monster = monsters[slot];
+    monster.corpse = ragdolls.spawn(monsterRagdoll, sceneMatrices[firstMonster + slot].model, blow * 2.5f);
+    // With every ragdoll slot taken the body simply vanishes
+    if (monster.corpse == NO_RAGDOLL) {
+        despawnMonster(monsterPool.handle(slot));
+        return;
+    }
+    combat.removeTarget(monster.target);
+    disableMonsterCollider(monster);
+    if (monster.path != NO_NAV_PATH) navMesh.releasePath(monster.path);
+    monster.path = NO_NAV_PATH;
+}
+
+/**
+ * @brief Count a sword hit against the monster it struck, which falls as a ragdoll on the last
+ */
+void strikeMonster(const MeleeHit& hit) {
+    for (uint32_t i = 0; i < monsterPool.size(); i++) {
+        uint32_t slot = monsterPool.live()[i];
+        Monster& monster = monsters[slot];
+        if (monster.corpse != NO_RAGDOLL || monster.target != hit.target) continue;
+        if (++monster.hits == MONSTER_HEALTH) killMonster(slot, -hit.normal);
+        return;
+    }
+}
+
+/**
+ * @brief Move the sword through its swing and splatter blood where it strikes
+ *
+ * @param deltaTime Frame time in seconds
+ *
+ * The blade turns about the camera from the right of the view to the
+ * left; the combat system sweeps it between frames, so a fast swing hits at
+ * any frame rate.
+ */
+void updateMelee(float deltaTime) {
+    if (swingTime >= 0.0f) {
+        float angle = SWING_ARC * (0.5f - swingTime / SWING_DURATION);
+        // The camera rig's pose, as the push and cameraSees() use; it has no up vector, so one is derived
+        const glm::vec3& eye = cameraSystem.position();
+        const glm::vec3& front = cameraSystem.front();
+        glm::vec3 right = glm::normalize(glm::cross(front, cameraUp));
+        glm::vec3 up = glm::cross(right, front);
+        glm::vec3 blade = front * std::cos(angle) + right * std::sin(angle);
+        glm::vec3 hilt = eye + blade * 0.3f - up * 0.15f;
+        combat.sweep(swordSwing, hilt, hilt + blade * BLADE_LENGTH);
+        if (swingTime >= SWING_DURATION) {
+            combat.endSwing(swordSwing);
+            swingTime = -1.0f;
+        } else {
+            swingTime = std::min(swingTime + deltaTime, SWING_DURATION);
+        }
+    }
+
+    // Resolved every tick, swinging or not, so walking monsters are swept from last tick's pose
+    float now = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
+    for (const MeleeHit& hit : combat.resolve(&jobSystem)) {
+        decalSystem.spawn(DecalType::Blood, hit.point, hit.normal, 0.4f, now);
+        strikeMonster(hit);
+    }
+}
+
+/**
+ * @brief Walk the living monsters towards the player along their paths
+ *
+ * @param deltaTime Frame time in seconds
+ *
+ * A monster asks for a new path once the player has moved away from the
+ * end of its current one. While a path is being planned, or replanned
+ * because a door or crate moved across it, the monster waits.
+ */
+void updateMonsters(float deltaTime) {
+    glm::vec3 player = playerOnGround();
+    for (uint32_t i = 0; i < monsterPool.size(); i++) {
+        uint32_t slot = monsterPool.live()[i];
+        Monster& monster = monsters[slot];
+        if (monster.corpse != NO_RAGDOLL || monster.path == NO_NAV_PATH) continue;
+        size_t index = firstMonster + slot;
+        const TransformSoA& t = sceneTransforms;
+        glm::vec3 position(t.px[index], t.py[index], t.pz[index]);
+        if (glm::length(player - monster.goal) > MONSTER_REPLAN_DISTANCE) {
+            monster.goal = player;
+            navMesh.movePath(monster.path, position, player);
+        }
+        if (navMesh.revision(monster.path) != monster.pathRevision) {
+            monster.pathRevision = navMesh.revision(monster.path);
+            monster.waypoint = 0;
+        }
+        const std::vector<glm::vec3>& waypoints = navMesh.waypoints(monster.path);
+        if (navMesh.pathState(monster.path) != NavPathState::Ready || glm::length(player - position) < MONSTER_REACH) {
+            continue;
+        }
+
+        // Walk through as many waypoints as this frame's stride reaches
+        float stride = MONSTER_SPEED * deltaTime;
+        glm::vec3 heading(0.0f);
+        while (stride > 0.0f && monster.waypoint < waypoints.size()) {
+            glm::vec3 toWaypoint(waypoints[monster.waypoint].x - position.x, 0.0f, waypoints[monster.waypoint].z - position.z);
+            float distance = glm::length(toWaypoint);
+            if (distance <= stride) {
+                position += toWaypoint;
+                stride -= distance;
+                monster.waypoint++;
+            } else {
+                heading = toWaypoint / distance;
+                position += heading * stride;
+                stride = 0.0f;
+            }
+        }
+        if (heading == glm::vec3(0.0f)) heading = glm::normalize(glm::vec3(player.x - position.x, 0.0f, player.z - position.z));
+
+        glm::vec3 scale(t.sx[index], t.sy[index], t.sz[index]);
+        sceneTransforms.set(index, position, glm::angleAxis(std::atan2(heading.x, heading.z), glm::vec3(0.0f, 1.0f, 0.0f)), scale);
+        buildInstanceMatrices(sceneTransforms, index, index + 1, sceneMatrices.data() + index);
+        AABB box = modelLoader1.bounds.transformed(sceneMatrices[index].model);
+        objectBounds[index] = {box.center(), glm::length(box.extent()) * 0.5f};
+        objectCells[index] = levelVisibility.objectCell(box);
+        combat.moveTarget(monster.target, sceneMatrices[index].model);
+    }
+}
+
+/**
+ * @brief Draw a dead monster where its ragdoll lies
+ *
+ * @param index Index of the monster in objectBounds
+ * @param corpse Its ragdoll; the model rides the ragdoll's root
+ */
+void followCorpse(size_t index, RagdollId corpse) {
+    sceneMatrices[index].model = ragdolls.carried(corpse, 0);
+    const AABB& box = ragdolls.bounds(corpse);
+    objectBounds[index] = {box.center(), glm::length(box.extent()) * 0.5f};
+    objectCells[index] = levelVisibility.objectCell(box);
+}
+
+/**
+ * @brief Step the physics and copy the props' placement into the scene arrays
+ *
+ * @param deltaTime Frame time in seconds
+ */
+void updateProps(float deltaTime) {
+    physics.moveKinematic(playerBody, cameraPos);
+    physics.update(deltaTime, &jobSystem);
+
+    ragdolls.update(deltaTime);
+    for (uint32_t i = 0; i < monsterPool.size(); i++) {
+        uint32_t slot = monsterPool.live()[i];
+        if (monsters[slot].corpse != NO_RAGDOLL) followCorpse(firstMonster + slot, monsters[slot].corpse);
+    }
+
+    for (size_t i = 0; i < props.size(); i++) {
+        size_t index = firstProp + i;
+        BodyId body = props[i].body;
+        sceneTransforms.set(index, physics.position(body), physics.orientation(body), glm::vec3(1.0f));
+        const AABB& box = physics.bounds(body);
+        objectBounds[index] = {box.center(), glm::length(box.extent()) * 0.5f};
+        objectCells[index] = levelVisibility.objectCell(box);
+        navMesh.moveObstacle(static_cast<uint32_t>(i), {physics.position(body), physics.orientation(body), props[i].halfExtents});
+    }
+    navMesh.update(NAV_PLANS_PER_FRAME);
+    buildInstanceMatrices(sceneTransforms, firstProp, firstProp + props.size(), sceneMatrices.data() + firstProp);
+}
+
 /**
  * @brief Setup OpenGL context and load models
  *
@@ -107,12 +779,194 @@ GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
  * creates the shader program, and loads 3D models using the ModelLoader.
  */
 void setupOpenGL() {
-    glEnable(GL_DEPTH_TEST); // Enable depth test for 3D rendering
-    shaderProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl");
+    glState().enable(GL_DEPTH_TEST); // Enable depth test for 3D rendering
+    const std::string modelInputs = ModelVertex::glslInputs();
+    const std::string moon = moonShadows ? "#define MOONLIGHT\n#define MOONLIGHT_SHADOWS\n" : "#define MOONLIGHT\n";
+    shaderProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl", moon, modelInputs);
+
+    flashlightProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl",
+                                            moon + (flashlightShadows ? "#define FLASHLIGHT\n#define FLASHLIGHT_SHADOWS\n" : "#define FLASHLIGHT\n"),
+                                            modelInputs);
+    shadowProgram = createShaderProgram("../src/shaders/shadow_vertex.glsl", "../src/shaders/shadow_fragment.glsl", "", modelInputs);
+    flashlight.create(flashlightShadows);
+    if (moonShadows) moonlight.create();
+
+    // Virtually textured surfaces: shaded permutations, and the feedback pass that drives their streaming
+    virtualProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl",
+                                         moon + "#define VIRTUAL_TEXTURE\n", modelInputs);
+    virtualFlashlightProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl",
+                                                   moon + (flashlightShadows ? "#define VIRTUAL_TEXTURE\n#define FLASHLIGHT\n#define FLASHLIGHT_SHADOWS\n"
+                                                                             : "#define VIRTUAL_TEXTURE\n#define FLASHLIGHT\n"),
+                                                   modelInputs);
+    feedbackProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/fragment_shader.glsl",
+                                          "#define VIRTUAL_TEXTURE\n#define VIRTUAL_FEEDBACK\n", modelInputs);
+    virtualFeedback.resize(WIDTH, HEIGHT);
+
+    frameUniforms.create();
+    lightCuller.create();
+    decalSystem.create();
+    for (GLuint program : {shaderProgram, flashlightProgram, virtualProgram, virtualFlashlightProgram, feedbackProgram}) {
+        frameUniforms.attach(program);
+        lightCuller.attach(program);
+        glState().useProgram(program);
+        glUniform1i(glGetUniformLocation(program, "decalData"), DECAL_TEXTURE_UNIT);
+    }
+
+    // Transparency: fog cards accumulated order-independently over the opaque scene
+    oitProgram = createShaderProgram("../src/shaders/vertex_shader.glsl", "../src/shaders/oit_fragment.glsl", "#define INSTANCED\n",
+                                     TransparentQuads::Vertex::glslInputs());
+    compositeProgram = createShaderProgram("../src/shaders/fullscreen_vertex.glsl", "../src/shaders/oit_composite_fragment.glsl");
+    frameUniforms.attach(oitProgram);
+    sceneTarget.resize(WIDTH, HEIGHT);
+    oitPass.resize(sceneTarget);
+    if (!OitPass::supported()) {
+        std::cerr << "Per-target blending unavailable, transparent surfaces are disabled" << std::endl;
+    }
+    oitTimer.create();
+    oitSection = profiler.section("transparency");
+    profiler.attachGpuTimer(oitSection, &oitTimer);
+    frameTimer.create();
+    profiler.attachFrameTimer(&frameTimer);
+
+    fogCards.create();
+    for (int i = 0; i < 6; i++) {
+        fogCards.add(glm::vec3(-5.0f + 2.0f * i, 0.5f, -3.0f - 1.5f * (i % 3)), glm::vec2(4.0f, 2.0f), 0.3f * i, glm::vec4(0.6f, 0.65f, 0.7f, 0.5f));
+    }
+    if (oitStress) {
+        // Deep overlapping stack in front of the start position to measure the pass
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+        for (int i = 0; i < 2000; i++) {
+            glm::vec3 center(spread(rng) * 6.0f, spread(rng) * 3.0f, -2.0f - 20.0f * (spread(rng) * 0.5f + 0.5f));
+            fogCards.add(center, glm::vec2(3.0f, 3.0f), spread(rng) * 0.5f, glm::vec4(0.5f + 0.5f * spread(rng), 0.6f, 0.7f, 0.3f));
+        }
+    }
+
+    // The level file supplies the entities, their model bindings, collision and visibility; without
+    // one the built-in layout is used, and --export-level saves the scene as loaded as the level
+    std::string levelError;
+    if (!currentLevel.open(LEVEL_PATH, levelError)) {
+        std::cerr << "Level not loaded (" << levelError << "); run with --export-level to build it" << std::endl;
+    }
+    // Monster entities are not scene objects: each comes out of the monster pool where it stands
+    for (SceneEntity& entity : currentLevel.loaded() ? levelEntities() : builtInEntities()) {
+        if (!bindEntity(entity)) {
+            std::cerr << "ERROR::LEVEL:: entity " << entity.name << " has unknown material " << entity.material << std::endl;
+        } else if (entity.model == &modelLoader1) {
+            monsterSpawns.push_back(entity);
+        } else {
+            sceneEntities.push_back(entity);
+        }
+    }
+    std::vector<SceneEntity> templates = monsterSpawns.empty() ? builtInEntities() : monsterSpawns;
+    monsterTemplate = *std::find_if(templates.begin(), templates.end(),
+                                    [](const SceneEntity& entity) { return entity.material == "monster"; });
+    firstProp = sceneEntities.size();
+    for (size_t i = 0; i < firstProp; i++) {
+        if (sceneEntities[i].flags & LEVEL_ENTITY_CASTS_SHADOW) shadowCasters.push_back(i);
+        if (sceneEntities[i].flags & LEVEL_ENTITY_STATIC) staticEntities.push_back(i);
+    }
+    entityCasters = shadowCasters.size();
 
     // Load models
-    modelLoader1.loadModel("monster");
-    modelLoader2.loadModel("spider_man");
+    if (megaBuffer) {
+        sceneGeometry.create<ModelVertex>(64 * 1024 * 1024, 16 * 1024 * 1024);
+        modelLoader1.sharedGeometry = &sceneGeometry;
+        modelLoader2.sharedGeometry = &sceneGeometry;
+    }
+    modelLoader1.loadModel(materialSource("monster", "monster"));
+    modelLoader2.loadModel(materialSource("spider_man", "spider_man"));
+
+    for (const SceneEntity& entity : sceneEntities) sceneTransforms.push(entity.position, entity.rotation, entity.scale);
+    sceneMatrices.resize(sceneTransforms.size());
+    buildInstanceMatrices(sceneTransforms, sceneMatrices.data());
+
+    // The ground and walls are built in world space, on the floor the models stand on
+    float floorHeight = monsterBounds(monsterTemplate).min.y;
+    for (const SceneEntity& spawn : monsterSpawns) floorHeight = std::min(floorHeight, monsterBounds(spawn).min.y);
+    for (size_t i = 0; i < firstProp; i++) {
+        if (sceneEntities[i].model) floorHeight = std::min(floorHeight, entityBounds(i).min.y);
+    }
+    buildWoodsGround(woodsGround, floorHeight);
+    buildHouseWalls(houseWalls, floorHeight);
+    woodsGround.create();
+    houseWalls.create();
+
+    // Static colliders for the camera boom, copied from the level when it has them
+    std::string collisionError;
+    if (!currentLevel.loaded() || !currentLevel.loadCollision(collisionWorld, collisionError)) {
+        if (currentLevel.loaded()) std::cerr << "ERROR::LEVEL:: " << collisionError << std::endl;
+        for (size_t i = 0; i < firstProp; i++) {
+            SceneEntity& entity = sceneEntities[i];
+            entity.collider = entity.surface ? LEVEL_NO_COLLIDER : collisionWorld.addBox(entityBounds(i));
+            if (entity.surface) {
+                for (const AABB& box : entity.surface->collisionBoxes()) collisionWorld.addBox(box);
+            }
+        }
+        for (SceneEntity& spawn : monsterSpawns) spawn.collider = collisionWorld.addBox(monsterBounds(spawn));
+        collisionWorld.build();
+    }
+    for (size_t i = 0; i < firstProp; i++) {
+        AABB box = entityBounds(i);
+        objectBounds.push_back({box.center(), glm::length(box.extent()) * 0.5f});
+    }
+    setupProps(floorHeight);
+
+    // The monster's hitboxes and ragdoll hang on its skeleton; a model without one gets head, torso and legs boxes
+    if (!modelLoader1.skins.empty()) {
+        monsterHitboxes.fromSkeleton(modelLoader1.nodes, modelLoader1.skins[0]);
+        monsterRagdoll.fromSkeleton(modelLoader1.nodes, modelLoader1.skins[0], MONSTER_MASS);
+    } else {
+        monsterHitboxes.fromBounds(modelLoader1.bounds);
+        monsterRagdoll.fromBounds(modelLoader1.bounds, MONSTER_MASS);
+    }
+    ragdolls.create(&physics, RAGDOLL_BODY_BUDGET, RAGDOLL_BODY_BUDGET, MAX_RAGDOLLS);
+    setupMonsterPool();
+
+    // Monsters walk the woods ground; the door leaves and crates are obstacles, indexed like props
+    navMesh.create(woodsGround.bounds(), floorHeight, &collisionWorld, &jobSystem);
+    for (const Prop& prop : props) {
+        navMesh.addObstacle({physics.position(prop.body), physics.orientation(prop.body), prop.halfExtents});
+    }
+
+    if (exportLevel) {
+        std::string error;
+        currentLevel.close();   // The file is rewritten under its mapping
+        if (!writeLevel(LEVEL_PATH, error)) std::cerr << "ERROR::LEVEL:: " << error << std::endl;
+        else if (!currentLevel.open(LEVEL_PATH, error)) std::cerr << "ERROR::LEVEL:: " << error << std::endl;
+    }
+    std::string pvsError;
+    if (currentLevel.loaded() && !currentLevel.loadVisibility(levelVisibility, pvsError)) {
+        std::cerr << "Level visibility not loaded (" << pvsError << ")" << std::endl;
+    }
+    for (size_t i = 0; i < firstProp; i++) objectCells.push_back(levelVisibility.objectCell(entityBounds(i)));
+    objectBounds.resize(sceneTransforms.size());
+    objectCells.resize(sceneTransforms.size());
+    sceneMatrices.resize(sceneTransforms.size());
+
+    // The level's monsters come out of the pool first, from slot 0, standing where it put them
+    for (const SceneEntity& spawn : monsterSpawns) {
+        glm::vec3 facing = spawn.rotation * glm::vec3(0.0f, 0.0f, 1.0f);
+        spawnMonster(spawn.position, std::atan2(facing.x, facing.z), spawn.collider);
+    }
+    updateProps(0.0f);
+
+    // Feedback ids start at 1; 0 marks pixels without a virtual texture
+    if (!groundTexture.create(materialSource("woods_ground", WOODS_GROUND_TEXTURE), assetIo, 1) ||
+        !wallTexture.create(materialSource("house_walls", HOUSE_WALLS_TEXTURE), assetIo, 2)) {
+        std::cerr << "Surface textures are missing; run with --cook-surfaces to build them" << std::endl;
+    }
+
+    // Scene lights: the room light, and a torch out in the woods that the room never pays for
+    std::vector<Light> lights(2);
+    lights[0].position = glm::vec3(0.0f, 5.0f, 5.0f);
+    lights[0].range = 50.0f;
+    lights[1].position = glm::vec3(0.0f, 1.5f, -40.0f);
+    lights[1].color = glm::vec3(1.0f, 0.6f, 0.3f);
+    lights[1].range = 8.0f;
+    lightCuller.setLights(lights);
+
+    lastFrameTime = glutGet(GLUT_ELAPSED_TIME);
 }
 
 /**
@@ -126,6 +980,9 @@ void setupOpenGL() {
  */
 void reshape(int width, int height) {
     glViewport(0, 0, width, height); // Set the viewport size
+    sceneTarget.resize(width, height);
+    oitPass.resize(sceneTarget);
+    virtualFeedback.resize(width, height);
     projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f); // Adjust projection
 }
 
@@ -137,9 +994,28 @@ void reshape(int width, int height) {
  * @param y The y-coordinate of the mouse pointer
  *
  * This function updates the state of the keyboard when a key is pressed.
+ * C toggles between the first- and third-person camera. E shoves the door
+ * leaf or crate the player is looking at, if no wall is in the way. M
+ * brings a monster out of the pool ahead of the player.
  */
 void keyboardDown(unsigned char key, int x, int y) {
     keys[key] = true;
+    if (key == 'c' || key == 'C') cameraSystem.toggleMode();
+    if (key == 'e' || key == 'E') {
+        BodyId body;
+        float distance;
+        CastHit wall;
+        glm::vec3 eye = cameraSystem.position(), front = cameraSystem.front();
+        if (physics.raycast(eye, front, PUSH_REACH, body, distance) && !collisionWorld.raycast(eye, front, distance, wall)) {
+            physics.applyImpulse(body, front * PUSH_IMPULSE, eye + front * distance);
+        }
+    }
+    if (key == 'm' || key == 'M') {
+        glm::vec3 ahead = glm::normalize(glm::vec3(cameraSystem.front().x, 0.0f, cameraSystem.front().z));
+        glm::vec3 position = cameraPos + ahead * MONSTER_SUMMON_DISTANCE;
+        position.y = monsterTemplate.position.y;
+        spawnMonster(position, std::atan2(-ahead.x, -ahead.z));
+    }
 }
 
 /**
@@ -158,14 +1034,18 @@ void keyboardUp(unsigned char key, int x, int y) {
 /**
  * @brief Process continuous key press for camera movement
  *
+ * @param deltaTime Frame time in seconds
+ *
  * This function updates the camera position based on the currently pressed keys.
  */
-void processKeyboard() {
+void processKeyboard(float deltaTime) {
+    float velocity = cameraSpeed * deltaTime;
+
     // Movement along camera's front and right vectors
-    if (keys['w']) cameraPos += cameraSpeed * cameraFront;
-    if (keys['s']) cameraPos -= cameraSpeed * cameraFront;
-    if (keys['a']) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    if (keys['d']) cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+    if (keys['w']) cameraPos += velocity * cameraFront;
+    if (keys['s']) cameraPos -= velocity * cameraFront;
+    if (keys['a']) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * velocity;
+    if (keys['d']) cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * velocity;
 }
 
 /**
@@ -207,6 +1087,143 @@ void mouseMotion(int x, int y) {
     cameraFront = glm::normalize(front);
 }
 
+/**
+ * @brief Mouse button callback
+ *
+ * @param button The mouse button that changed state
+ * @param state GLUT_DOWN or GLUT_UP
+ * @param x The x-coordinate of the mouse pointer
+ * @param y The y-coordinate of the mouse pointer
+ *
+ * Left click switches the flashlight on and off. Right click swings the
+ * sword, unless a swing is already under way.
+ */
+void mouseButton(int button, int state, int x, int y) {
+    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
+        flashlight.enabled = !flashlight.enabled;
+    }
+    if (button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN && swingTime < 0.0f) {
+        swordSwing = combat.beginSwing(BLADE_RADIUS);
+        swingTime = 0.0f;
+    }
+}
+
+/**
+ * @brief Gather this frame's shadow casters: the flagged entities, then every monster out of the pool
+ *
+ * Monsters cast when the level flags them to. The moon cascades are only
+ * redrawn early when monsters come or go.
+ */
+void updateShadowCasters() {
+    shadowCasters.resize(entityCasters);
+    casterBounds.resize(entityCasters);
+    for (size_t caster = 0; caster < entityCasters; caster++) casterBounds[caster] = entityBounds(shadowCasters[caster]);
+    if (monsterTemplate.flags & LEVEL_ENTITY_CASTS_SHADOW) {
+        for (uint32_t i = 0; i < monsterPool.size(); i++) {
+            uint32_t slot = monsterPool.live()[i];
+            size_t index = firstMonster + slot;
+            shadowCasters.push_back(index);
+            if (monsters[slot].corpse != NO_RAGDOLL) casterBounds.push_back(ragdolls.bounds(monsters[slot].corpse));
+            else casterBounds.push_back(modelLoader1.bounds.transformed(sceneMatrices[index].model));
+        }
+    }
+    if (!moonlight.created()) return;
+    if (casterBounds.size() == moonlight.casterCount()) moonlight.moveCasters(casterBounds);
+    else moonlight.setCasters(casterBounds);
+}
+
+/**
+ * @brief Draw a shadow caster's geometry only, for a depth pass
+ *
+ * @param caster Index into shadowCasters
+ * @param modelLoc Location of the depth program's model matrix
+ */
+void drawCaster(uint32_t caster, GLint modelLoc) {
+    size_t index = shadowCasters[caster];
+    if (index >= firstMonster) {
+        modelLoader1.draw(modelLoc, sceneMatrices[index].model);
+        return;
+    }
+    const SceneEntity& entity = sceneEntities[index];
+    if (entity.model) entity.model->draw(modelLoc, sceneMatrices[index].model);
+    else entity.surface->draw(modelLoc, sceneMatrices[index].model);
+}
+
+/**
+ * @brief Draw one scene object with the cheapest shader permutation that lights it
+ *
+ * @param index Index of the object in objectBounds
+ * @param model Loaded model to draw
+ * @param transform Model matrix
+ *
+ * Objects in cells the baked visibility says cannot be seen from the
+ * camera's cell are skipped. Objects outside the flashlight cone use the
+ * base permutation, so they do not pay for the cookie and shadow lookups.
+ */
+void drawObject(size_t index, ModelLoader& model, const glm::mat4& transform) {
+    if (!levelVisibility.visible(cameraCell, objectCells[index])) return;
+    bool lit = flashlight.affects(objectBounds[index]);
+    GLuint program = lit ? flashlightProgram : shaderProgram;
+    glState().useProgram(program);
+    if (lit) flashlight.apply(program);
+    moonlight.apply(program);
+
+    GLint modelLoc = glGetUniformLocation(program, "model");
+    lightCuller.apply(program, index);
+    decalSystem.apply(program, index);
+    model.draw(modelLoc, transform);
+}
+
+/**
+ * @brief Draw a virtually textured surface
+ *
+ * @param index Index of the surface in objectBounds
+ * @param mesh Surface geometry
+ * @param texture Its virtual texture; the surface is skipped if that was not cooked
+ */
+void drawSurface(size_t index, const SurfaceMesh& mesh, const VirtualTexture& texture) {
+    if (!texture.created() || !levelVisibility.visible(cameraCell, objectCells[index])) return;
+    bool lit = flashlight.affects(objectBounds[index]);
+    GLuint program = lit ? virtualFlashlightProgram : virtualProgram;
+    glState().useProgram(program);
+    if (lit) flashlight.apply(program);
+    moonlight.apply(program);
+
+    lightCuller.apply(program, index);
+    decalSystem.apply(program, index);
+    texture.apply(program);
+    mesh.draw(glGetUniformLocation(program, "model"), sceneMatrices[index].model);
+}
+
+/**
+ * @brief Stream the virtual textures
+ *
+ * Turns the feedback read back from an earlier frame into tile requests,
+ * uploads tiles that finished loading, then draws this frame's feedback at
+ * low resolution for a later frame to read.
+ */
+void updateVirtualTextures() {
+    assetIo.poll();
+    virtualFeedback.collect({&groundTexture, &wallTexture});
+    groundTexture.update();
+    wallTexture.update();
+
+    virtualFeedback.begin();
+    glState().useProgram(feedbackProgram);
+    GLint modelLoc = glGetUniformLocation(feedbackProgram, "model");
+    for (size_t i = 0; i < firstProp; i++) {
+        const SceneEntity& entity = sceneEntities[i];
+        if (!entity.surface || !entity.texture->created()) continue;
+        entity.texture->apply(feedbackProgram, virtualFeedback.lodBias());
+        entity.surface->draw(modelLoc, sceneMatrices[i].model);
+    }
+    if (wallTexture.created()) {
+        wallTexture.apply(feedbackProgram, virtualFeedback.lodBias());
+        for (size_t p = 0; p < props.size(); p++) props[p].mesh->draw(modelLoc, sceneMatrices[firstProp + p].model);
+    }
+    virtualFeedback.end();
+}
+
 /**
  * @brief Render the scene
  *
@@ -214,57 +1231,128 @@ void mouseMotion(int x, int y) {
  * and draws the loaded 3D models.
  */
 void renderScene() {
+    // Frame time, clamped so a stall does not teleport the player or the springs
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    float deltaTime = std::min((now - lastFrameTime) / 1000.0f, 0.1f);
+    lastFrameTime = now;
+
+    profiler.beginFrame();
+    frameTimer.begin();
+
     // Process continuous keyboard input
-    processKeyboard();
+    processKeyboard(deltaTime);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(shaderProgram);
+    // Doors and crates, pushed by the player's new position
+    updateProps(deltaTime);
 
     // Adjust projection with wider aspect ratio
-    projection = glm::perspective(glm::radians(45.0f), 2400.0f / 1800.0f, 0.1f, 100.0f);
+    projection = glm::perspective(CAMERA_FOV, CAMERA_ASPECT, CAMERA_NEAR, 100.0f);
+
+    // Update the active camera rig; this is the only place the view matrix is built
+    cameraSystem.update(cameraPos, cameraFront, deltaTime, collisionWorld);
+    view = cameraSystem.view();
+    cameraCell = levelVisibility.cellAt(cameraSystem.position());
 
-    // Update view matrix with camera movement
-    view = glm::lookAt(
-            cameraPos,            // Camera position
-            cameraPos + cameraFront,  // Look at point (camera position + front vector)
-            cameraUp              // Up vector
-    );
+    // Monsters close in, then the sword swings with the player's view
+    updateMonsters(deltaTime);
+    updateMelee(deltaTime);
 
-    // Position Spiderman on the left
-    glm::mat4 spidermanModel = glm::mat4(1.0f);
-    spidermanModel = glm::translate(spidermanModel, glm::vec3(-2.0f, 0.0f, 0.0f)); // Move left
-    spidermanModel = glm::rotate(spidermanModel, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate to face right
-    spidermanModel = glm::scale(spidermanModel, glm::vec3(1.5f, 1.5f, 1.5f));
+    // Monsters come out behind the player and are put away once left behind
+    updateDirector(deltaTime);
 
-    // Position Monster on the right
-    glm::mat4 monsterModel = glm::mat4(1.0f);
-    monsterModel = glm::translate(monsterModel, glm::vec3(2.0f, 0.0f, 0.0f)); // Move right
-    monsterModel = glm::rotate(monsterModel, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate to face left
-    monsterModel = glm::scale(monsterModel, glm::vec3(1.5f, 1.5f, 1.5f));
+    // Share the camera with every shader through the per-frame uniform block
+    FrameData frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.viewProjection = projection * view;
+    frame.cameraPos = glm::vec4(cameraSystem.position(), 1.0f);
+    frame.time = glm::vec4(now / 1000.0f, deltaTime, 0.0f, 0.0f);
+    frameUniforms.update(frame);
 
-    // Set shader uniform variables
-    GLuint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
+    // Flashlight follows the player's eye; its shadow map is redrawn every frame
+    updateShadowCasters();
+    flashlight.update(cameraPos, cameraFront, cameraUp);
+    flashlight.renderShadowMap(shadowProgram, [](GLint modelLoc) {
+        for (uint32_t caster = 0; caster < shadowCasters.size(); caster++) drawCaster(caster, modelLoc);
+    });
+
+    // Moon cascades: the near ones every frame, the far ones in turn
+    moonlight.update(view, CAMERA_FOV, CAMERA_ASPECT, CAMERA_NEAR);
+    moonlight.render(shadowProgram, drawCaster);
+
+    updateVirtualTextures();
+
+    sceneTarget.bind();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Set projection and view matrices
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    // Pick the lights each draw evaluates
+    lightCuller.cull(objectBounds, jobSystem);
+    lightCuller.upload();
+    decalSystem.cull(objectBounds, jobSystem);
+    decalSystem.upload();
+    decalSystem.bind();
 
-    // Draw Spiderman
-    {
-        GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(spidermanModel));
-        modelLoader2.draw(); // Spiderman model
+    // Draw the level's models and surfaces: Spiderman, the woods ground and the house walls
+    for (size_t i = 0; i < firstProp; i++) {
+        const SceneEntity& entity = sceneEntities[i];
+        if (entity.model) drawObject(i, *entity.model, sceneMatrices[i].model);
+        else drawSurface(i, *entity.surface, *entity.texture);
     }
 
-    // Draw Monster
-    {
-        GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(monsterModel));
-        modelLoader1.draw(); // Monster model
+    // Draw the monsters, the level's and those that came out since
+    for (uint32_t i = 0; i < monsterPool.size(); i++) {
+        size_t index = firstMonster + monsterPool.live()[i];
+        drawObject(index, modelLoader1, sceneMatrices[index].model);
     }
 
+    // The door leaves and crates, built of the same planks as the walls
+    for (size_t i = 0; i < props.size(); i++) drawSurface(firstProp + i, *props[i].mesh, wallTexture);
+
+    // Transparent surfaces, in any order
+    if (OitPass::supported() && fogCards.size() > 0) {
+        ScopedCpuTimer timer(profiler, oitSection);
+        oitTimer.begin();
+        oitPass.begin();
+        glState().useProgram(oitProgram);
+        fogCards.draw();
+        oitPass.end();
+        oitPass.composite(sceneTarget, compositeProgram);
+        oitTimer.end();
+    }
+
+    sceneTarget.blitToScreen();
+    frameTimer.end();
+    profiler.endWork();
     glutSwapBuffers();
+    profiler.endFrame();
+
+    // Close holes left by unloaded meshes a little at a time
+    if (sceneGeometry.created()) sceneGeometry.compact(GEOMETRY_COMPACTION_BUDGET);
+
+    if (glState().validating()) glState().validate("end of frame");
+
+    if ((oitStress || glStats) && now - lastReportTime > 2000) {
+        if (oitStress) {
+            std::cout << fogCards.size() << " transparent cards: ";
+            profiler.report(std::cout);
+        }
+        if (glStats) {
+            glState().report(std::cout);
+            glState().resetCounters();
+            if (sceneGeometry.created()) sceneGeometry.report(std::cout);
+            if (moonlight.created()) moonlight.report(std::cout);
+            physics.report(std::cout);
+            combat.report(std::cout);
+            ragdolls.report(std::cout);
+            monsterPool.report(std::cout, "Monsters");
+            if (directorEnabled) director.report(std::cout);
+            navMesh.report(std::cout);
+            for (const VirtualTexture* texture : {&groundTexture, &wallTexture}) {
+                if (texture->created()) texture->report(std::cout);
+            }
+        }
+        lastReportTime = now;
+    }
 }
 
 /**
@@ -292,6 +1380,32 @@ void update(int value) {
  */
 int main(int argc, char** argv) {
     glutInit(&argc, argv);
+
+    std::string benchmark;
+    std::vector<std::string> cookModels;
+    bool cookSurfaces = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc) benchmark = argv[++i];
+        if (std::strcmp(argv[i], "--cook") == 0 && i + 1 < argc) cookModels.push_back(argv[++i]);
+        if (std::strcmp(argv[i], "--cook-surfaces") == 0) cookSurfaces = true;
+        if (std::strcmp(argv[i], "--export-level") == 0) exportLevel = true;
+        if (std::strcmp(argv[i], "--oit-stress") == 0) oitStress = true;
+        if (std::strcmp(argv[i], "--no-flashlight-shadows") == 0) flashlightShadows = false;
+        if (std::strcmp(argv[i], "--no-moon-shadows") == 0) moonShadows = false;
+        if (std::strcmp(argv[i], "--no-dsa") == 0) ModelLoader::preferDirectStateAccess = false;
+        if (std::strcmp(argv[i], "--gl-stats") == 0) glStats = true;
+        if (std::strcmp(argv[i], "--mega-buffer") == 0) megaBuffer = true;
+        if (std::strcmp(argv[i], "--gl-validate") == 0) glState().setValidation(true);
+        if (std::strcmp(argv[i], "--no-director") == 0) directorEnabled = false;
+    }
+
+    // Offline asset cooking needs no window
+    if (!cookModels.empty() || cookSurfaces) {
+        bool cooked = !cookSurfaces || cookSurfaceTextures(&jobSystem);
+        for (const std::string& model : cookModels) cooked = ModelLoader::cookModel(model, &jobSystem) && cooked;
+        return cooked ? 0 : 1;
+    }
+
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 
     // Increase window size to 3x
@@ -305,6 +1419,11 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    // Developer benchmarks run instead of the game
+    if (!benchmark.empty()) {
+        return runBenchmark(benchmark);
+    }
+
     setupOpenGL(); // Set up OpenGL and load the model
 
     // Register callbacks
@@ -318,6 +1437,10 @@ int main(int argc, char** argv) {
 
     // Mouse callbacks
     glutPassiveMotionFunc(mouseMotion);
+    glutMouseFunc(mouseButton);
+
+    // Report key presses once so toggles do not repeat while held
+    glutIgnoreKeyRepeat(1);
 
     // Hide cursor and capture it
     glutSetCursor(GLUT_CURSOR_NONE);
@@ -0,0 +1,658 @@
+#include "mesh_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "mapped_file.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2 1
+#endif
+
+namespace mesh_codec {
+
+const uint32_t FILE_MAGIC = 0x48534D45;  // "EMSH"
+const uint32_t FILE_VERSION = 1;
+
+const uint8_t FLAG_NORMALS = 1;
+const uint8_t FLAG_TEXCOORDS = 2;
+
+// Upper bound on vertices or indices per mesh, so corrupt headers cannot request huge allocations
+const uint64_t MAX_MESH_ELEMENTS = 1ull << 26;
+
+const uint8_t PLANE_RAW = 0;
+const uint8_t PLANE_RANS = 1;
+
+// rANS with 32-bit state, byte-wise renormalization and 12-bit probabilities
+const uint32_t RANS_SCALE_BITS = 12;
+const uint32_t RANS_SCALE = 1u << RANS_SCALE_BITS;
+const uint32_t RANS_LOW = 1u << 23;
+const size_t RANS_LANES = 4;
+
+// ---------------------------------------------------------------------------
+// Byte helpers
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static void putFloat(std::vector<uint8_t>& out, float value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+static bool getFloat(const uint8_t*& cursor, const uint8_t* end, float& value) {
+    if (end - cursor < 4) return false;
+    std::memcpy(&value, cursor, 4);
+    cursor += 4;
+    return true;
+}
+
+static uint16_t quantize(float value, float minimum, float range) {
+    if (range <= 0.0f) return 0;
+    float t = std::min(std::max((value - minimum) / range, 0.0f), 1.0f);
+    return static_cast<uint16_t>(std::lround(t * 65535.0f));
+}
+
+// ---------------------------------------------------------------------------
+// Entropy stage
+
+/**
+ * @brief Scale byte counts to frequencies summing to RANS_SCALE
+ *
+ * Every byte that occurs keeps a frequency of at least one.
+ */
+static void normalizeFrequencies(const uint32_t counts[256], size_t total, uint32_t freqs[256]) {
+    uint32_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        freqs[s] = counts[s] ? std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(counts[s]) * RANS_SCALE / total)) : 0;
+        sum += freqs[s];
+        if (counts[s] > counts[largest]) largest = s;
+    }
+    if (sum < RANS_SCALE) {
+        freqs[largest] += RANS_SCALE - sum;
+        return;
+    }
+    while (sum > RANS_SCALE) {
+        int victim = -1;
+        for (int s = 0; s < 256; s++) {
+            if (freqs[s] > 1 && (victim < 0 || freqs[s] > freqs[victim])) victim = s;
+        }
+        freqs[victim]--;
+        sum--;
+    }
+}
+
+/**
+ * @brief Append one entropy-coded byte plane
+ *
+ * @param data Bytes to code
+ * @param length Number of bytes
+ * @param out Receives the plane header and payload
+ * @return size_t Bytes appended
+ *
+ * Falls back to storing the bytes when the frequency table and payload
+ * would be larger than the input.
+ */
+size_t ransEncode(const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    uint32_t counts[256] = {};
+    for (size_t i = 0; i < length; i++) counts[data[i]]++;
+
+    std::vector<uint8_t> coded;
+    if (length > 0) {
+        uint32_t freqs[256], starts[256];
+        normalizeFrequencies(counts, length, freqs);
+        uint32_t cumulative = 0;
+        int symbols = 0;
+        for (int s = 0; s < 256; s++) {
+            starts[s] = cumulative;
+            cumulative += freqs[s];
+            if (freqs[s]) symbols++;
+        }
+
+        // Symbols are coded back to front so the decoder reads forwards.
+        // Symbol i belongs to state i % RANS_LANES; independent states let
+        // the decoder overlap their dependency chains.
+        std::vector<uint8_t> buffer(length * 2 + 4 * RANS_LANES);
+        uint8_t* end = buffer.data() + buffer.size();
+        uint8_t* cursor = end;
+        uint32_t states[RANS_LANES];
+        std::fill(states, states + RANS_LANES, RANS_LOW);
+        for (size_t i = length; i-- > 0;) {
+            uint32_t& state = states[i % RANS_LANES];
+            uint32_t freq = freqs[data[i]];
+            uint32_t limit = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * freq;
+            while (state >= limit) {
+                *--cursor = static_cast<uint8_t>(state);
+                state >>= 8;
+            }
+            state = ((state / freq) << RANS_SCALE_BITS) + (state % freq) + starts[data[i]];
+        }
+        for (size_t lane = RANS_LANES; lane-- > 0;) {
+            cursor -= 4;
+            std::memcpy(cursor, &states[lane], 4);
+        }
+
+        putVarint(coded, symbols);
+        for (int s = 0; s < 256; s++) {
+            if (!freqs[s]) continue;
+            coded.push_back(static_cast<uint8_t>(s));
+            putVarint(coded, freqs[s]);
+        }
+        putVarint(coded, end - cursor);
+        coded.insert(coded.end(), cursor, end);
+    }
+
+    if (length > 0 && coded.size() < length) {
+        out.push_back(PLANE_RANS);
+        putVarint(out, length);
+        out.insert(out.end(), coded.begin(), coded.end());
+    } else {
+        out.push_back(PLANE_RAW);
+        putVarint(out, length);
+        out.insert(out.end(), data, data + length);
+    }
+    return out.size() - start;
+}
+
+/**
+ * @brief Decode one symbol and renormalize, without bounds checks
+ *
+ * The state never drops below 2^11, so renormalization reads zero, one or
+ * two bytes; doing it without a loop keeps the branch predictor out of it.
+ * Two bytes must be readable at the cursor.
+ */
+static inline uint8_t ransStep(uint32_t& state, const uint8_t*& cursor, const uint8_t* slots,
+                               const uint32_t* freqs, const uint32_t* starts) {
+    uint32_t slot = state & (RANS_SCALE - 1);
+    uint8_t symbol = slots[slot];
+    state = freqs[symbol] * (state >> RANS_SCALE_BITS) + slot - starts[symbol];
+    uint32_t bytes = (state < RANS_LOW) + (state < (RANS_LOW >> 8));
+    uint32_t shift = bytes * 8;
+    uint32_t next = (uint32_t(cursor[0]) << 8) | cursor[1];
+    state = (state << shift) | (next >> (16 - shift));
+    cursor += bytes;
+    return symbol;
+}
+
+/**
+ * @brief Decode one byte plane written by ransEncode
+ *
+ * @param data Start of the plane
+ * @param length Bytes available
+ * @param out Receives outLength bytes
+ * @param outLength Expected decoded length
+ * @param consumed Receives the number of input bytes read
+ * @return bool False if the plane is malformed or has a different length
+ */
+bool ransDecode(const uint8_t* data, size_t length, uint8_t* out, size_t outLength, size_t& consumed) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + length;
+    uint64_t decodedLength;
+    if (cursor >= end) return false;
+    uint8_t mode = *cursor++;
+    if (!getVarint(cursor, end, decodedLength) || decodedLength != outLength) return false;
+
+    if (mode == PLANE_RAW) {
+        if (static_cast<size_t>(end - cursor) < outLength) return false;
+        std::memcpy(out, cursor, outLength);
+        consumed = cursor + outLength - data;
+        return true;
+    }
+    if (mode != PLANE_RANS) return false;
+
+    uint64_t symbols, payloadLength;
+    uint32_t freqs[256] = {}, starts[256] = {};
+    if (!getVarint(cursor, end, symbols) || symbols == 0 || symbols > 256) return false;
+    for (uint64_t i = 0; i < symbols; i++) {
+        uint64_t freq;
+        if (cursor >= end) return false;
+        uint8_t symbol = *cursor++;
+        if (!getVarint(cursor, end, freq) || freq == 0 || freq > RANS_SCALE) return false;
+        freqs[symbol] = static_cast<uint32_t>(freq);
+    }
+
+    // Slot-to-symbol table: one lookup per decoded byte
+    uint8_t slots[RANS_SCALE];
+    uint32_t cumulative = 0;
+    for (int s = 0; s < 256; s++) {
+        starts[s] = cumulative;
+        if (cumulative + freqs[s] > RANS_SCALE) return false;
+        std::memset(slots + cumulative, s, freqs[s]);
+        cumulative += freqs[s];
+    }
+    if (cumulative != RANS_SCALE) return false;
+
+    if (!getVarint(cursor, end, payloadLength) || payloadLength < 4 * RANS_LANES ||
+        payloadLength > static_cast<uint64_t>(end - cursor)) {
+        return false;
+    }
+    const uint8_t* payloadEnd = cursor + payloadLength;
+    uint32_t states[RANS_LANES];
+    std::memcpy(states, cursor, sizeof(states));
+    cursor += sizeof(states);
+
+    // A symbol consumes at most two bytes, so whole groups can skip the
+    // bounds check while that many bytes remain
+    uint32_t s0 = states[0], s1 = states[1], s2 = states[2], s3 = states[3];
+    size_t i = 0;
+    for (; i + RANS_LANES <= outLength && payloadEnd - cursor >= static_cast<ptrdiff_t>(2 * RANS_LANES); i += RANS_LANES) {
+        out[i] = ransStep(s0, cursor, slots, freqs, starts);
+        out[i + 1] = ransStep(s1, cursor, slots, freqs, starts);
+        out[i + 2] = ransStep(s2, cursor, slots, freqs, starts);
+        out[i + 3] = ransStep(s3, cursor, slots, freqs, starts);
+    }
+    states[0] = s0; states[1] = s1; states[2] = s2; states[3] = s3;
+    for (; i < outLength; i++) {
+        uint32_t& state = states[i % RANS_LANES];
+        uint32_t slot = state & (RANS_SCALE - 1);
+        out[i] = slots[slot];
+        state = freqs[out[i]] * (state >> RANS_SCALE_BITS) + slot - starts[out[i]];
+        while (state < RANS_LOW) {
+            if (cursor >= payloadEnd) return false;
+            state = (state << 8) | *cursor++;
+        }
+    }
+    consumed = payloadEnd - data;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Attribute transforms
+
+/**
+ * @brief Delta code component arrays and split them into byte planes
+ *
+ * @param values Components, `components` arrays of `count` values back to back
+ * @param out Receives the low plane and high plane entropy coded
+ */
+static void encodeComponents(const std::vector<uint16_t>& values, size_t count, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> low(values.size()), high(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        uint16_t previous = i % count ? values[i - 1] : 0;
+        int16_t delta = static_cast<int16_t>(values[i] - previous);
+        uint16_t zigzag = static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+        low[i] = static_cast<uint8_t>(zigzag);
+        high[i] = static_cast<uint8_t>(zigzag >> 8);
+    }
+    ransEncode(low.data(), low.size(), out);
+    ransEncode(high.data(), high.size(), out);
+}
+
+/**
+ * @brief Rebuild one delta-coded component and dequantize it
+ *
+ * @param low Low byte plane
+ * @param high High byte plane
+ * @param count Number of values
+ * @param scale Multiplier applied to the 16-bit value
+ * @param bias Added after scaling
+ * @param out Receives count floats
+ *
+ * The SSE2 path undoes the zigzag and runs the prefix sum eight values at a
+ * time in 16-bit lanes, which wrap exactly like the encoder's deltas.
+ */
+static void decodeComponent(const uint8_t* low, const uint8_t* high, size_t count, float scale, float bias, float* out) {
+    size_t i = 0;
+    uint16_t previous = 0;
+#ifdef MESH_CODEC_SSE2
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 bias4 = _mm_set1_ps(bias);
+    __m128i carry = zero;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(low + i));
+        __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(high + i));
+        __m128i zigzag = _mm_unpacklo_epi8(lo, hi);
+        __m128i delta = _mm_xor_si128(_mm_srli_epi16(zigzag, 1), _mm_sub_epi16(zero, _mm_and_si128(zigzag, one)));
+
+        // Inclusive prefix sum across the eight lanes, plus the running total
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 2));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 4));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 8));
+        __m128i value = _mm_add_epi16(delta, carry);
+        __m128i last = _mm_shufflehi_epi16(value, 0xFF);
+        carry = _mm_unpackhi_epi64(last, last);
+
+        __m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(value, zero));
+        __m128 b = _mm_cvtepi32_ps(_mm_unpackhi_epi16(value, zero));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(a, scale4), bias4));
+        _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_mul_ps(b, scale4), bias4));
+    }
+    previous = static_cast<uint16_t>(_mm_cvtsi128_si32(carry));
+#endif
+    for (; i < count; i++) {
+        uint16_t zigzag = static_cast<uint16_t>(low[i] | (high[i] << 8));
+        uint16_t delta = static_cast<uint16_t>((zigzag >> 1) ^ (0u - (zigzag & 1u)));
+        previous = static_cast<uint16_t>(previous + delta);
+        out[i] = previous * scale + bias;
+    }
+}
+
+/**
+ * @brief Map a unit vector onto the octahedron, unfolded into [-1, 1]^2
+ */
+static glm::vec2 octEncode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z) + 1e-20f;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return p;
+}
+
+/**
+ * @brief Unfold octahedral normals back to unit vectors
+ */
+static void octDecode(const float* u, const float* v, size_t count, glm::vec3* out) {
+    size_t i = 0;
+#ifdef MESH_CODEC_SSE2
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(u + i);
+        __m128 y = _mm_loadu_ps(v + i);
+        __m128 ax = _mm_andnot_ps(signBit, x);
+        __m128 ay = _mm_andnot_ps(signBit, y);
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, ax), ay);
+
+        // Lower hemisphere: fold x and y back over the diagonals
+        __m128 folded = _mm_cmplt_ps(z, zero);
+        __m128 fx = _mm_or_ps(_mm_sub_ps(one, ay), _mm_and_ps(signBit, x));
+        __m128 fy = _mm_or_ps(_mm_sub_ps(one, ax), _mm_and_ps(signBit, y));
+        x = _mm_or_ps(_mm_and_ps(folded, fx), _mm_andnot_ps(folded, x));
+        y = _mm_or_ps(_mm_and_ps(folded, fy), _mm_andnot_ps(folded, y));
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 inverse = _mm_div_ps(one, length);
+        alignas(16) float nx[4], ny[4], nz[4];
+        _mm_store_ps(nx, _mm_mul_ps(x, inverse));
+        _mm_store_ps(ny, _mm_mul_ps(y, inverse));
+        _mm_store_ps(nz, _mm_mul_ps(z, inverse));
+        for (int k = 0; k < 4; k++) out[i + k] = glm::vec3(nx[k], ny[k], nz[k]);
+    }
+#endif
+    for (; i < count; i++) {
+        glm::vec3 n(u[i], v[i], 1.0f - std::abs(u[i]) - std::abs(v[i]));
+        if (n.z < 0.0f) {
+            float x = n.x;
+            n.x = (1.0f - std::abs(n.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            n.y = (1.0f - std::abs(x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        out[i] = glm::normalize(n);
+    }
+}
+
+const char* decodeKernel() {
+#ifdef MESH_CODEC_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Mesh records
+
+/**
+ * @brief Append one compressed mesh record
+ */
+void encode(const MeshStreams& mesh, std::vector<uint8_t>& out) {
+    size_t count = mesh.positions.size();
+    bool hasNormals = mesh.normals.size() == count && count > 0;
+    bool hasTexCoords = mesh.texCoords.size() == count && count > 0;
+
+    AABB bounds;
+    for (const glm::vec3& p : mesh.positions) bounds.expand(p);
+    if (!count) bounds.expand(glm::vec3(0.0f));
+    glm::vec2 uvMin(0.0f), uvMax(0.0f);
+    if (hasTexCoords) {
+        uvMin = uvMax = mesh.texCoords[0];
+        for (const glm::vec2& uv : mesh.texCoords) {
+            uvMin = glm::min(uvMin, uv);
+            uvMax = glm::max(uvMax, uv);
+        }
+    }
+
+    putVarint(out, count);
+    putVarint(out, mesh.indices.size());
+    out.push_back((hasNormals ? FLAG_NORMALS : 0) | (hasTexCoords ? FLAG_TEXCOORDS : 0));
+    for (int c = 0; c < 3; c++) putFloat(out, bounds.min[c]);
+    for (int c = 0; c < 3; c++) putFloat(out, bounds.max[c]);
+    if (hasTexCoords) {
+        for (int c = 0; c < 2; c++) putFloat(out, uvMin[c]);
+        for (int c = 0; c < 2; c++) putFloat(out, uvMax[c]);
+    }
+    putVarint(out, mesh.texture.size());
+    out.insert(out.end(), mesh.texture.begin(), mesh.texture.end());
+
+    glm::vec3 extent = bounds.extent();
+    std::vector<uint16_t> values(count * 3);
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) values[c * count + i] = quantize(mesh.positions[i][c], bounds.min[c], extent[c]);
+    }
+    encodeComponents(values, count, out);
+
+    if (hasNormals) {
+        values.assign(count * 2, 0);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec2 oct = octEncode(mesh.normals[i]);
+            values[i] = quantize(oct.x, -1.0f, 2.0f);
+            values[count + i] = quantize(oct.y, -1.0f, 2.0f);
+        }
+        encodeComponents(values, count, out);
+    }
+    if (hasTexCoords) {
+        values.assign(count * 2, 0);
+        glm::vec2 range = uvMax - uvMin;
+        for (size_t i = 0; i < count; i++) {
+            values[i] = quantize(mesh.texCoords[i].x, uvMin.x, range.x);
+            values[count + i] = quantize(mesh.texCoords[i].y, uvMin.y, range.y);
+        }
+        encodeComponents(values, count, out);
+    }
+
+    // Neighbouring triangles reuse nearby vertices, so index deltas are small
+    std::vector<uint8_t> indexBytes;
+    uint32_t previous = 0;
+    for (uint32_t index : mesh.indices) {
+        int32_t delta = static_cast<int32_t>(index - previous);
+        putVarint(indexBytes, static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+        previous = index;
+    }
+    ransEncode(indexBytes.data(), indexBytes.size(), out);
+}
+
+/**
+ * @brief Decode one mesh record written by encode()
+ *
+ * @param data Start of the record
+ * @param length Bytes available
+ * @param out Receives the mesh
+ * @param consumed Receives the record's length
+ * @param error Receives the reason on failure
+ * @return bool Whether the record was valid
+ */
+bool decode(const uint8_t* data, size_t length, MeshStreams& out, size_t& consumed, std::string& error) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + length;
+    auto fail = [&](const char* message) {
+        error = message;
+        return false;
+    };
+
+    uint64_t count, indexCount, textureLength;
+    if (!getVarint(cursor, end, count) || !getVarint(cursor, end, indexCount) || cursor >= end) return fail("truncated mesh header");
+    if (count > MAX_MESH_ELEMENTS || indexCount > MAX_MESH_ELEMENTS) return fail("mesh is too large");
+    uint8_t flags = *cursor++;
+    glm::vec3 boundsMin, boundsMax;
+    glm::vec2 uvMin(0.0f), uvMax(0.0f);
+    bool ok = true;
+    for (int c = 0; c < 3; c++) ok = ok && getFloat(cursor, end, boundsMin[c]);
+    for (int c = 0; c < 3; c++) ok = ok && getFloat(cursor, end, boundsMax[c]);
+    if (flags & FLAG_TEXCOORDS) {
+        for (int c = 0; c < 2; c++) ok = ok && getFloat(cursor, end, uvMin[c]);
+        for (int c = 0; c < 2; c++) ok = ok && getFloat(cursor, end, uvMax[c]);
+    }
+    if (!ok || !getVarint(cursor, end, textureLength) || textureLength > static_cast<uint64_t>(end - cursor)) {
+        return fail("truncated mesh header");
+    }
+    out.texture.assign(reinterpret_cast<const char*>(cursor), textureLength);
+    cursor += textureLength;
+    out.bounds = AABB();
+    out.bounds.expand(boundsMin);
+    out.bounds.expand(boundsMax);
+
+    std::vector<uint8_t> low(count * 3), high(count * 3);
+    std::vector<float> components(count * 3);
+    auto planes = [&](size_t values) {
+        size_t used;
+        if (!ransDecode(cursor, end - cursor, low.data(), values, used)) return false;
+        cursor += used;
+        if (!ransDecode(cursor, end - cursor, high.data(), values, used)) return false;
+        cursor += used;
+        return true;
+    };
+
+    if (!planes(count * 3)) return fail("corrupt position planes");
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (int c = 0; c < 3; c++) {
+        decodeComponent(low.data() + c * count, high.data() + c * count, count, extent[c] / 65535.0f, boundsMin[c],
+                        components.data() + c * count);
+    }
+    out.positions.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        out.positions[i] = glm::vec3(components[i], components[count + i], components[2 * count + i]);
+    }
+
+    out.normals.clear();
+    if (flags & FLAG_NORMALS) {
+        if (!planes(count * 2)) return fail("corrupt normal planes");
+        for (int c = 0; c < 2; c++) {
+            decodeComponent(low.data() + c * count, high.data() + c * count, count, 2.0f / 65535.0f, -1.0f,
+                            components.data() + c * count);
+        }
+        out.normals.resize(count);
+        octDecode(components.data(), components.data() + count, count, out.normals.data());
+    }
+
+    out.texCoords.clear();
+    if (flags & FLAG_TEXCOORDS) {
+        if (!planes(count * 2)) return fail("corrupt texture coordinate planes");
+        glm::vec2 range = uvMax - uvMin;
+        for (int c = 0; c < 2; c++) {
+            decodeComponent(low.data() + c * count, high.data() + c * count, count, range[c] / 65535.0f, uvMin[c],
+                            components.data() + c * count);
+        }
+        out.texCoords.resize(count);
+        for (size_t i = 0; i < count; i++) out.texCoords[i] = glm::vec2(components[i], components[count + i]);
+    }
+
+    // Index plane: its decoded length is stored in the plane header
+    const uint8_t* planeCursor = cursor + 1;
+    uint64_t indexBytes;
+    if (cursor >= end || !getVarint(planeCursor, end, indexBytes) || indexBytes > indexCount * 5) return fail("corrupt index plane");
+    std::vector<uint8_t> varints(indexBytes);
+    size_t used;
+    if (!ransDecode(cursor, end - cursor, varints.data(), indexBytes, used)) return fail("corrupt index plane");
+    cursor += used;
+
+    out.indices.resize(indexCount);
+    const uint8_t* varint = varints.data();
+    const uint8_t* varintEnd = varint + varints.size();
+    uint32_t previous = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint64_t zigzag;
+        if (!getVarint(varint, varintEnd, zigzag)) return fail("truncated index plane");
+        uint32_t value = static_cast<uint32_t>(zigzag);
+        previous += (value >> 1) ^ (0u - (value & 1u));
+        if (previous >= count) return fail("index out of range");
+        out.indices[i] = previous;
+    }
+
+    consumed = cursor - data;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Files
+
+/**
+ * @brief Write meshes to a compressed .mesh file
+ */
+bool writeFile(const std::string& path, const std::vector<MeshStreams>& meshes, std::string& error) {
+    std::vector<uint8_t> bytes(8);
+    std::memcpy(bytes.data(), &FILE_MAGIC, 4);
+    std::memcpy(bytes.data() + 4, &FILE_VERSION, 4);
+    putVarint(bytes, meshes.size());
+    for (const MeshStreams& mesh : meshes) encode(mesh, bytes);
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Map and decode a .mesh file
+ */
+bool readFile(const std::string& path, std::vector<MeshStreams>& meshes, std::string& error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const uint8_t* cursor = file.data();
+    const uint8_t* end = cursor + file.size();
+    uint32_t magic, version;
+    if (file.size() < 8) {
+        error = "not a mesh file";
+        return false;
+    }
+    std::memcpy(&magic, cursor, 4);
+    std::memcpy(&version, cursor + 4, 4);
+    cursor += 8;
+    if (magic != FILE_MAGIC || version != FILE_VERSION) {
+        error = "not a version " + std::to_string(FILE_VERSION) + " mesh file";
+        return false;
+    }
+
+    uint64_t count;
+    if (!getVarint(cursor, end, count) || count > file.size()) {
+        error = "truncated mesh file";
+        return false;
+    }
+    meshes.resize(count);
+    for (MeshStreams& mesh : meshes) {
+        size_t consumed;
+        if (!decode(cursor, end - cursor, mesh, consumed, error)) return false;
+        cursor += consumed;
+    }
+    return true;
+}
+
+} // namespace mesh_codec
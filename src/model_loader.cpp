@@ -1,11 +1,16 @@
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 #include "model_loader.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <glm/gtc/type_ptr.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <GL/glew.h>
 #include <assimp/postprocess.h>
+#include "gl_state.h"
+#include "image_decoder.h"
+#include "mapped_file.h"
+#include "texture_cook.h"
 
 /**
  * @brief Constant prefix for relative path to model assets
@@ -14,6 +19,18 @@
  */
 const std::string PREFIX_RELATIVE_PATH = "../assets/models/";
 
+bool ModelLoader::preferDirectStateAccess = true;
+
+/**
+ * @brief Whether the GL 4.5 upload path can be used
+ *
+ * Needs direct state access and immutable buffer storage, either from a
+ * 4.5 context or from the two ARB extensions on older drivers.
+ */
+bool ModelLoader::directStateAccessSupported() {
+    return GLEW_VERSION_4_5 || (GLEW_ARB_direct_state_access && GLEW_ARB_buffer_storage);
+}
+
 /**
  * @brief Default constructor for ModelLoader
  *
@@ -32,27 +49,68 @@ ModelLoader::ModelLoader() {
 ModelLoader::~ModelLoader() {
     // Clean up OpenGL resources
     for (auto& mesh : meshes) {
-        glDeleteVertexArrays(1, &mesh.VAO);
+        for (auto& texture : mesh.textures) glState().forgetTexture(texture.id);
+        if (mesh.range.valid()) {
+            sharedGeometry->remove(mesh.range);
+            continue;
+        }
+        glState().forgetBuffer(mesh.VBO);
+        if (!directStateAccess) {
+            glState().forgetVertexArray(mesh.VAO);
+            glDeleteVertexArrays(1, &mesh.VAO);
+        }
         glDeleteBuffers(1, &mesh.VBO);
         glDeleteBuffers(1, &mesh.EBO);
     }
+    if (unpackBuffer) {
+        glState().forgetBuffer(unpackBuffer);
+        glDeleteBuffers(1, &unpackBuffer);
+    }
 }
 
 /**
  * @brief Load a 3D model from a file
  *
- * @param model_name Name of the model to load (corresponds to directory and .obj file)
+ * @param model_name Name of the model to load (corresponds to directory and file name)
  *
- * This method clears any previously loaded meshes and uses Assimp to import
- * the 3D model with specified processing flags:
- * - Triangulate: Convert all faces to triangles
- * - FlipUVs: Flip texture coordinates on the y-axis
- * - GenNormals: Generate normals if not present in the model
+ * Cooked files next to the OBJ are preferred: a compressed `<model_name>.mesh`
+ * first, then a `<model_name>.glb`. Both are mapped and decoded without
+ * going through Assimp.
  */
 void ModelLoader::loadModel(const std::string& model_name) {
+    std::string base = PREFIX_RELATIVE_PATH + "/" + model_name + "/" + model_name;
+    if (std::ifstream(base + ".mesh").good() && loadCooked(model_name)) return;
+    if (std::ifstream(base + ".glb").good() && loadGlb(base + ".glb")) return;
+    loadObj(model_name);
+}
+
+/**
+ * @brief Reset state shared by both loaders before a new model is read
+ */
+void ModelLoader::beginLoad() {
     // Clear any existing meshes
     meshes.clear();
+    nodes.clear();
+    skins.clear();
+    bounds = AABB();
+    nodeTransforms = false;
+    zeroCopyMeshes = 0;
+    directStateAccess = preferDirectStateAccess && directStateAccessSupported();
+}
 
+/**
+ * @brief Import a model's OBJ file through Assimp
+ *
+ * @param model_name Name of the model to import
+ * @param streams Receives the meshes in scene graph order
+ * @return bool Whether the file was imported
+ *
+ * Uses Assimp with the following processing flags:
+ * - Triangulate: Convert all faces to triangles
+ * - FlipUVs: Flip texture coordinates on the y-axis
+ * - GenNormals: Generate normals if not present in the model
+ */
+bool ModelLoader::importObj(const std::string& model_name, std::vector<MeshStreams>& streams) {
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(PREFIX_RELATIVE_PATH + "/" + model_name + "/" + model_name + ".obj",
                                              aiProcess_Triangulate |
@@ -62,11 +120,83 @@ void ModelLoader::loadModel(const std::string& model_name) {
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cerr << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-        return;
+        return false;
     }
 
     // Process the root node recursively
-    processNode(scene->mRootNode, scene, model_name);
+    processNode(scene->mRootNode, scene, streams);
+    return true;
+}
+
+/**
+ * @brief Load a model's OBJ file through Assimp
+ *
+ * @param model_name Name of the model to load
+ * @return bool Whether the file was imported
+ */
+bool ModelLoader::loadObj(const std::string& model_name) {
+    beginLoad();
+    std::vector<MeshStreams> streams;
+    if (!importObj(model_name, streams)) return false;
+    for (const MeshStreams& mesh : streams) meshes.push_back(buildMesh(mesh, model_name));
+    return true;
+}
+
+/**
+ * @brief Load a model's compressed `.mesh` file
+ *
+ * @param model_name Name of the model to load
+ * @return bool Whether the file was valid; nothing is loaded otherwise
+ */
+bool ModelLoader::loadCooked(const std::string& model_name) {
+    beginLoad();
+    std::string path = PREFIX_RELATIVE_PATH + "/" + model_name + "/" + model_name + ".mesh";
+    std::vector<MeshStreams> streams;
+    std::string error;
+    if (!mesh_codec::readFile(path, streams, error)) {
+        std::cerr << "ERROR::MESH:: " << path << ": " << error << std::endl;
+        return false;
+    }
+    for (const MeshStreams& mesh : streams) meshes.push_back(buildMesh(mesh, model_name));
+    return true;
+}
+
+/**
+ * @brief Import a model's OBJ and write it as a compressed `.mesh` file
+ *
+ * @param model_name Name of the model to cook
+ * @param jobs Job system the model's textures are cooked on, or nullptr
+ * @return bool Whether the mesh and all its textures were written
+ *
+ * The diffuse textures are cooked too, into `.tex` mip chains next to the
+ * images. Runs without a GL context; used by `--cook`.
+ */
+bool ModelLoader::cookModel(const std::string& model_name, JobSystem* jobs) {
+    std::vector<MeshStreams> streams;
+    if (!importObj(model_name, streams)) return false;
+
+    std::string path = PREFIX_RELATIVE_PATH + "/" + model_name + "/" + model_name + ".mesh";
+    std::string error;
+    if (!mesh_codec::writeFile(path, streams, error)) {
+        std::cerr << "ERROR::MESH:: " << error << std::endl;
+        return false;
+    }
+
+    size_t rawBytes = 0;
+    for (const MeshStreams& mesh : streams) {
+        rawBytes += mesh.positions.size() * ModelVertex::stride + mesh.indices.size() * sizeof(GLuint);
+    }
+    std::ifstream cooked(path, std::ios::binary | std::ios::ate);
+    size_t cookedBytes = static_cast<size_t>(cooked.tellg());
+    std::cout << "Cooked " << path << ": " << streams.size() << " meshes, " << rawBytes / 1024 << " KB -> "
+              << cookedBytes / 1024 << " KB (" << static_cast<double>(rawBytes) / std::max<size_t>(cookedBytes, 1)
+              << "x)" << std::endl;
+
+    std::vector<std::string> textures;
+    for (const MeshStreams& mesh : streams) {
+        if (!mesh.texture.empty()) textures.push_back(PREFIX_RELATIVE_PATH + "/" + model_name + "/" + mesh.texture);
+    }
+    return texture_cook::cookFiles(textures, MipOptions(), jobs);
 }
 
 /**
@@ -74,21 +204,21 @@ void ModelLoader::loadModel(const std::string& model_name) {
  *
  * @param node Current node being processed
  * @param scene Pointer to the entire scene
- * @param model_name Name of the model being loaded
+ * @param streams Receives the node's meshes
  *
  * This method traverses the scene graph, processing meshes at the current node
  * and then recursively processing child nodes.
  */
-void ModelLoader::processNode(aiNode* node, const aiScene* scene, const std::string& model_name) {
+void ModelLoader::processNode(aiNode* node, const aiScene* scene, std::vector<MeshStreams>& streams) {
     // Process all the node's meshes
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene, model_name));
+        streams.push_back(processMesh(mesh, scene));
     }
 
     // Recursively process child nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene, model_name);
+        processNode(node->mChildren[i], scene, streams);
     }
 }
 
@@ -97,41 +227,30 @@ void ModelLoader::processNode(aiNode* node, const aiScene* scene, const std::str
  *
  * @param mesh Pointer to the mesh to process
  * @param scene Pointer to the entire scene
- * @param model_name Name of the model being loaded
- * @return Mesh Processed mesh with vertex data, indices, and textures
+ * @return MeshStreams Vertex streams, indices and diffuse texture name
  *
  * This method extracts vertex positions, normals, texture coordinates,
- * indices, and textures from a mesh. It also sets up OpenGL buffers
- * and vertex attribute pointers.
+ * indices, and the diffuse texture from a mesh.
  */
-Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene, const std::string& model_name) {
-    Mesh newMesh;
+MeshStreams ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
+    MeshStreams streams;
 
-    // Vertex data
+    // Vertex data: gather the streams Assimp provides
+    streams.positions.resize(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        // Positions
-        newMesh.vertices.push_back(mesh->mVertices[i].x);
-        newMesh.vertices.push_back(mesh->mVertices[i].y);
-        newMesh.vertices.push_back(mesh->mVertices[i].z);
-
-        // Normals
-        if (mesh->HasNormals()) {
-            newMesh.vertices.push_back(mesh->mNormals[i].x);
-            newMesh.vertices.push_back(mesh->mNormals[i].y);
-            newMesh.vertices.push_back(mesh->mNormals[i].z);
-        } else {
-            newMesh.vertices.push_back(0.0f);
-            newMesh.vertices.push_back(0.0f);
-            newMesh.vertices.push_back(0.0f);
+        streams.positions[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        streams.bounds.expand(streams.positions[i]);
+    }
+    if (mesh->HasNormals()) {
+        streams.normals.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            streams.normals[i] = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
         }
-
-        // Texture coordinates
-        if (mesh->mTextureCoords[0]) {
-            newMesh.vertices.push_back(mesh->mTextureCoords[0][i].x);
-            newMesh.vertices.push_back(mesh->mTextureCoords[0][i].y);
-        } else {
-            newMesh.vertices.push_back(0.0f);
-            newMesh.vertices.push_back(0.0f);
+    }
+    if (mesh->mTextureCoords[0]) {
+        streams.texCoords.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            streams.texCoords[i] = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
         }
     }
 
@@ -139,96 +258,340 @@ Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene, const std::str
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            newMesh.indices.push_back(face.mIndices[j]);
+            streams.indices.push_back(face.mIndices[j]);
         }
     }
 
-    // Textures
-    if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    // Diffuse texture, relative to the model directory
+    aiString texturePath;
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS) {
+        streams.texture = texturePath.C_Str();
+    }
+    return streams;
+}
 
-        // Diffuse texture
-        GLuint diffuseTexture = loadTexture(material, aiTextureType_DIFFUSE, model_name);
+/**
+ * @brief Pack, texture and upload one mesh
+ *
+ * @param streams Vertex streams and indices
+ * @param model_name Name of the model, for resolving the texture
+ * @return Mesh Mesh with GPU buffers
+ *
+ * Vertices are packed and described to the VAO by ModelVertex, so the
+ * layout lives in one declaration. On the DSA path buffers get immutable
+ * storage and no per-mesh VAO is created.
+ */
+Mesh ModelLoader::buildMesh(const MeshStreams& streams, const std::string& model_name) {
+    Mesh newMesh;
+    bounds.expand(streams.bounds);
+
+    VertexSource source;
+    source.count = streams.positions.size();
+    source.positions = streams.positions.data();
+    source.normals = streams.normals.empty() ? nullptr : streams.normals.data();
+    source.texCoords = streams.texCoords.empty() ? nullptr : streams.texCoords.data();
+    source.bounds = streams.bounds;
+    ModelVertex::pack(source, newMesh.vertices);
+    newMesh.indices = streams.indices;
+
+    if (!streams.texture.empty()) {
+        std::string texturePath = PREFIX_RELATIVE_PATH + "/" + model_name + "/" + streams.texture;
+        GLuint diffuseTexture = loadTextureFromFile(texturePath);
         if (diffuseTexture) {
-            newMesh.textures.push_back({diffuseTexture, "texture_diffuse", "diffuse"});
+            newMesh.textures.push_back({diffuseTexture, "texture_diffuse", texturePath});
+        }
+    }
+
+    newMesh.indexCount = static_cast<GLsizei>(newMesh.indices.size());
+    uploadMesh(newMesh, newMesh.vertices.data(), source.count, newMesh.indices.data());
+    return newMesh;
+}
+
+/**
+ * @brief Create a mesh's GPU buffers on whichever path this load uses
+ *
+ * @param mesh Mesh with indexCount and indexType set
+ * @param vertexData vertexCount interleaved ModelVertex vertices
+ * @param vertexCount Number of vertices
+ * @param indexData indexCount indices of mesh.indexType
+ *
+ * The data is only read during the call, so it may point into a mapped file.
+ */
+void ModelLoader::uploadMesh(Mesh& mesh, const void* vertexData, size_t vertexCount, const void* indexData) {
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_BYTE ? 1 : mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    size_t vertexBytes = vertexCount * ModelVertex::stride;
+    size_t indexBytes = mesh.indexCount * indexSize;
+
+    if (sharedGeometry) {
+        // Suballocated from the mega-buffer; drawn with a base vertex from its VAO.
+        // The mega-buffer holds 32-bit indices only, so narrower ones are widened.
+        const GLuint* indices = static_cast<const GLuint*>(indexData);
+        std::vector<GLuint> widened;
+        if (mesh.indexType != GL_UNSIGNED_INT) {
+            widened.resize(mesh.indexCount);
+            for (GLsizei i = 0; i < mesh.indexCount; i++) {
+                widened[i] = mesh.indexType == GL_UNSIGNED_BYTE ? static_cast<const uint8_t*>(indexData)[i] :
+                                                                  static_cast<const uint16_t*>(indexData)[i];
+            }
+            indices = widened.data();
         }
+        mesh.range = sharedGeometry->add(vertexData, vertexCount, indices, mesh.indexCount);
+        return;
+    }
+
+    if (directStateAccess) {
+        // Immutable storage, written once at creation; the format's shared VAO reads it.
+        // Zero-sized storage is an error, so an empty mesh keeps buffer 0 and is never drawn.
+        if (vertexBytes > 0) {
+            glCreateBuffers(1, &mesh.VBO);
+            glNamedBufferStorage(mesh.VBO, vertexBytes, vertexData, 0);
+        }
+        if (indexBytes > 0) {
+            glCreateBuffers(1, &mesh.EBO);
+            glNamedBufferStorage(mesh.EBO, indexBytes, indexData, 0);
+        }
+        mesh.VAO = ModelVertex::sharedVertexArray();
+        return;
     }
 
     // Create OpenGL buffers
-    glGenVertexArrays(1, &newMesh.VAO);
-    glGenBuffers(1, &newMesh.VBO);
-    glGenBuffers(1, &newMesh.EBO);
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
 
-    glBindVertexArray(newMesh.VAO);
+    glState().bindVertexArray(mesh.VAO);
 
     // Vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, newMesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 newMesh.vertices.size() * sizeof(GLfloat),
-                 &newMesh.vertices[0],
-                 GL_STATIC_DRAW
-    );
+    glState().bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
 
     // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 newMesh.indices.size() * sizeof(GLuint),
-                 &newMesh.indices[0],
-                 GL_STATIC_DRAW
-    );
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
 
     // Vertex attributes
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
-    glEnableVertexAttribArray(0);
+    ModelVertex::setupAttributes();
+
+    // Unbind VAO
+    glState().bindVertexArray(0);
+}
+
+/**
+ * @brief Load a binary glTF 2.0 model
+ *
+ * @param path Path to the .glb file
+ * @return bool Whether the file was valid; nothing is loaded otherwise
+ *
+ * The file is memory-mapped and validated up front. Triangle primitives of
+ * every node are loaded with the node's world transform, in their bind pose:
+ * JOINTS_0 and WEIGHTS_0 are not read. Skins and the node hierarchy are kept
+ * on the loader for the hitboxes and ragdoll.
+ */
+bool ModelLoader::loadGlb(const std::string& path) {
+    beginLoad();
+
+    GltfAsset asset;
+    std::string error;
+    if (!asset.load(path, error)) {
+        std::cerr << "ERROR::GLTF:: " << path << ": " << error << std::endl;
+        return false;
+    }
 
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+    const JsonValue& gltfMeshes = asset.json()["meshes"];
+    for (const SceneNode& node : asset.nodes) {
+        if (node.mesh < 0) continue;
+        const JsonValue& primitives = gltfMeshes[static_cast<size_t>(node.mesh)]["primitives"];
+        for (size_t p = 0; p < primitives.size(); p++) {
+            Mesh mesh;
+            if (processPrimitive(asset, primitives[p], node, mesh)) meshes.push_back(std::move(mesh));
+        }
+    }
 
-    // Texture coordinate attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
+    nodes = std::move(asset.nodes);
+    skins = std::move(asset.skins);
+    return true;
+}
 
-    // Unbind VAO
-    glBindVertexArray(0);
+/**
+ * @brief Load one glTF primitive into a mesh
+ *
+ * When POSITION, NORMAL and TEXCOORD_0 already sit interleaved in one
+ * bufferView exactly as ModelVertex lays them out, the view is uploaded
+ * straight from the mapped file. Otherwise the streams are packed like an
+ * OBJ mesh, reading tightly packed float streams in place.
+ */
+bool ModelLoader::processPrimitive(const GltfAsset& asset, const JsonValue& primitive, const SceneNode& node, Mesh& out) {
+    if (primitive["mode"].integer(GL_TRIANGLES) != GL_TRIANGLES) {
+        std::cerr << "GLTF: skipping non-triangle primitive in node " << node.name << std::endl;
+        return false;
+    }
 
-    return newMesh;
+    const JsonValue& attributes = primitive["attributes"];
+    const GltfAccessor* position = asset.accessor(attributes["POSITION"].integer());
+    const GltfAccessor* normal = asset.accessor(attributes["NORMAL"].integer());
+    const GltfAccessor* texCoord = asset.accessor(attributes["TEXCOORD_0"].integer());
+    if (!position || position->components != 3 || position->componentType != GL_FLOAT) {
+        std::cerr << "GLTF: primitive in node " << node.name << " has no float POSITION" << std::endl;
+        return false;
+    }
+    size_t vertexCount = position->count;
+    if ((normal && normal->count != vertexCount) || (texCoord && texCoord->count != vertexCount)) {
+        std::cerr << "GLTF: attribute counts differ in node " << node.name << std::endl;
+        return false;
+    }
+
+    // Bounds come from the accessor's required min/max when present
+    AABB meshBounds;
+    const JsonValue& accessorJson = asset.json()["accessors"][static_cast<size_t>(attributes["POSITION"].integer())];
+    if (accessorJson["min"].size() == 3 && accessorJson["max"].size() == 3) {
+        meshBounds.expand(glm::vec3(accessorJson["min"][0].number(), accessorJson["min"][1].number(), accessorJson["min"][2].number()));
+        meshBounds.expand(glm::vec3(accessorJson["max"][0].number(), accessorJson["max"][1].number(), accessorJson["max"][2].number()));
+    } else {
+        for (size_t i = 0; i < vertexCount; i++) {
+            meshBounds.expand(glm::vec3(position->readFloat(i, 0), position->readFloat(i, 1), position->readFloat(i, 2)));
+        }
+    }
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 1) ? meshBounds.max.x : meshBounds.min.x,
+                    (corner & 2) ? meshBounds.max.y : meshBounds.min.y,
+                    (corner & 4) ? meshBounds.max.z : meshBounds.min.z);
+        bounds.expand(glm::vec3(node.world * glm::vec4(p, 1.0f)));
+    }
+
+    // Indices keep their stored width; unindexed primitives get a generated list
+    const GltfAccessor* indices = asset.accessor(primitive["indices"].integer());
+    const void* indexData = nullptr;
+    if (indices) {
+        if (indices->components != 1 || !indices->tightlyPacked() ||
+            (indices->componentType != GL_UNSIGNED_BYTE && indices->componentType != GL_UNSIGNED_SHORT &&
+             indices->componentType != GL_UNSIGNED_INT)) {
+            std::cerr << "GLTF: invalid index accessor in node " << node.name << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < indices->count; i++) {
+            if (indices->readIndex(i) >= vertexCount) {
+                std::cerr << "GLTF: index out of range in node " << node.name << std::endl;
+                return false;
+            }
+        }
+        out.indexType = indices->componentType;
+        out.indexCount = static_cast<GLsizei>(indices->count);
+        indexData = indices->data;
+    } else {
+        out.indices.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) out.indices[i] = static_cast<GLuint>(i);
+        out.indexCount = static_cast<GLsizei>(vertexCount);
+        indexData = out.indices.data();
+    }
+
+    out.transform = node.world;
+    out.skin = node.skin;
+    if (node.world != glm::mat4(1.0f)) nodeTransforms = true;
+
+    std::string texturePath;
+    GLuint diffuseTexture = loadGltfTexture(asset, primitive["material"].integer(), texturePath);
+    if (diffuseTexture) out.textures.push_back({diffuseTexture, "texture_diffuse", texturePath});
+
+    // Zero-copy: the file's vertex view already is a ModelVertex buffer
+    const unsigned char* viewData;
+    size_t viewLength;
+    bool interleaved = normal && texCoord &&
+        ModelVertex::attributeCount == 3 &&
+        ModelVertex::attributeMatches(0, position->componentType, position->components, position->normalized) &&
+        ModelVertex::attributeMatches(1, normal->componentType, normal->components, normal->normalized) &&
+        ModelVertex::attributeMatches(2, texCoord->componentType, texCoord->components, texCoord->normalized) &&
+        position->bufferView == normal->bufferView && position->bufferView == texCoord->bufferView &&
+        position->stride == ModelVertex::stride &&
+        normal->data - position->data == static_cast<ptrdiff_t>(ModelVertex::offset(1)) &&
+        texCoord->data - position->data == static_cast<ptrdiff_t>(ModelVertex::offset(2)) &&
+        asset.bufferView(position->bufferView, viewData, viewLength) &&
+        position->viewOffset + vertexCount * ModelVertex::stride <= viewLength;
+    if (interleaved) {
+        uploadMesh(out, position->data, vertexCount, indexData);
+        zeroCopyMeshes++;
+        return true;
+    }
+
+    // Repack; float streams without padding are read in place
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    auto stream3 = [&](const GltfAccessor* accessor, std::vector<glm::vec3>& copy) -> const glm::vec3* {
+        if (!accessor || accessor->components != 3) return nullptr;
+        if (accessor->componentType == GL_FLOAT && accessor->tightlyPacked()) {
+            return reinterpret_cast<const glm::vec3*>(accessor->data);
+        }
+        copy.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            copy[i] = glm::vec3(accessor->readFloat(i, 0), accessor->readFloat(i, 1), accessor->readFloat(i, 2));
+        }
+        return copy.data();
+    };
+
+    VertexSource source;
+    source.count = vertexCount;
+    source.positions = stream3(position, positions);
+    source.normals = stream3(normal, normals);
+    if (texCoord && texCoord->components == 2) {
+        if (texCoord->componentType == GL_FLOAT && texCoord->tightlyPacked()) {
+            source.texCoords = reinterpret_cast<const glm::vec2*>(texCoord->data);
+        } else {
+            texCoords.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++) texCoords[i] = glm::vec2(texCoord->readFloat(i, 0), texCoord->readFloat(i, 1));
+            source.texCoords = texCoords.data();
+        }
+    }
+    source.bounds = meshBounds;
+    ModelVertex::pack(source, out.vertices);
+
+    uploadMesh(out, out.vertices.data(), vertexCount, indexData);
+    return true;
 }
 
 /**
- * @brief Load texture from material
+ * @brief Load a glTF material's base color texture
  *
- * @param material Pointer to the material containing the texture
- * @param type Type of texture to load (e.g., diffuse, specular)
- * @param model_name Name of the model
- * @return GLuint Texture ID or 0 if texture loading fails
+ * @param asset Loaded asset
+ * @param material Material index, or -1
+ * @param path Receives the image's file path; left empty for embedded images
+ * @return GLuint Texture ID or 0 if the material has no usable texture
  *
- * This method extracts the texture path from the material and loads it using
- * loadTextureFromFile().
+ * Images embedded in a bufferView are decoded from the mapped file; URIs are
+ * resolved next to the .glb.
  */
-GLuint ModelLoader::loadTexture(aiMaterial* material, aiTextureType type, const std::string& model_name) {
-    aiString texturePath;
-    if (material->GetTexture(type, 0, &texturePath) == AI_SUCCESS) {
-        std::string path = PREFIX_RELATIVE_PATH + "/" + model_name + "/" + texturePath.C_Str();
-        return loadTextureFromFile(path);
+GLuint ModelLoader::loadGltfTexture(const GltfAsset& asset, int material, std::string& path) {
+    if (material < 0) return 0;
+    const JsonValue& document = asset.json();
+    int texture = document["materials"][static_cast<size_t>(material)]["pbrMetallicRoughness"]["baseColorTexture"]["index"].integer();
+    if (texture < 0) return 0;
+    int source = document["textures"][static_cast<size_t>(texture)]["source"].integer();
+    if (source < 0) return 0;
+
+    const JsonValue& image = document["images"][static_cast<size_t>(source)];
+    if (image.has("bufferView")) {
+        const unsigned char* bytes;
+        size_t length;
+        if (!asset.bufferView(image["bufferView"].integer(), bytes, length)) return 0;
+        return loadTextureFromMemory(bytes, length, "image " + std::to_string(source));
     }
-    return 0;
+    const std::string& uri = image["uri"].string();
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) return 0;
+    path = asset.directory() + "/" + uri;
+    return loadTextureFromFile(path);
 }
 
 /**
- * @brief Load texture from file
+ * @brief Create a mipmapped 2D texture from decoded pixels
  *
- * @param texturePath Path to the texture file
+ * @param image Layout of the pixels, or nullptr to create an empty texture
+ * @param pixels Pixels, or an offset into the bound pixel unpack buffer
+ * @param levels Levels stored back to back in `pixels`; with 1, the rest are generated by the driver
  * @return GLuint Texture ID
- *
- * This method loads a texture file using stb_image, creates an OpenGL texture,
- * sets texture parameters, and generates mipmaps. It supports 1, 3, and 4 channel images.
  */
-GLuint ModelLoader::loadTextureFromFile(const std::string& texturePath) {
+GLuint ModelLoader::uploadTexture(const ImageInfo* image, const void* pixels, int levels) {
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState().bindTexture(0, GL_TEXTURE_2D, textureID);
 
     // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -236,40 +599,171 @@ GLuint ModelLoader::loadTextureFromFile(const std::string& texturePath) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Load image
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(texturePath.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = nrChannels == 1 ? GL_RED :
-                        nrChannels == 3 ? GL_RGB : GL_RGBA;
+    if (image) {
+        GLenum internalFormat = image->channels == 1 ? GL_RED :
+                                image->channels == 3 ? GL_RGB : GL_RGBA;
+        GLenum format = image->channels == 1 ? GL_RED :
+                        image->channels == 3 ? (image->bgr ? GL_BGR : GL_RGB) :
+                                               (image->bgr ? GL_BGRA : GL_RGBA);
+
+        // Decoded rows are tightly packed
+        bool packed = levels > 1 || image->rowBytes() % 4 != 0;
+        if (packed) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const unsigned char* level = static_cast<const unsigned char*>(pixels);
+        for (int i = 0; i < levels; i++) {
+            ImageInfo info = texture_cook::levelInfo(*image, i);
+            glTexImage2D(GL_TEXTURE_2D, i, internalFormat, info.width, info.height, 0, format, GL_UNSIGNED_BYTE, level);
+            level += info.byteSize();
+        }
+        if (packed) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (levels > 1) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        else glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glState().bindTexture(0, GL_TEXTURE_2D, 0);
+    return textureID;
+}
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
+/**
+ * @brief Load texture from file
+ *
+ * @param texturePath Path to the texture file
+ * @return GLuint Texture ID
+ *
+ * A cooked `.tex` mip chain next to the image is uploaded as is, with no
+ * decoding or mip generation. Otherwise the image is mapped and decoded by
+ * loadTextureFromMemory().
+ */
+GLuint ModelLoader::loadTextureFromFile(const std::string& texturePath) {
+    std::string cookedPath = texture_cook::cookedPath(texturePath);
+    if (std::ifstream(cookedPath).good()) {
+        CookedTexture cooked;
+        std::string error;
+        if (texture_cook::readFile(cookedPath, cooked, error)) return uploadTexture(&cooked.info, cooked.pixels, cooked.levels);
+        std::cerr << "ERROR::TEXTURE:: " << error << std::endl;
+    }
+
+    MappedFile file;
+    if (!file.open(texturePath)) {
         std::cerr << "Texture failed to load at path: " << texturePath << std::endl;
+        return uploadTexture(nullptr, nullptr);
     }
-    stbi_image_free(data);
+    return loadTextureFromMemory(file.data(), file.size(), texturePath);
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return textureID;
+/**
+ * @brief Load texture from an encoded image in memory
+ *
+ * @param bytes Encoded image data
+ * @param length Length of the data in bytes
+ * @param name Name used in error messages
+ * @return GLuint Texture ID
+ *
+ * The first image decoder that takes the data writes its pixels straight
+ * into a mapped pixel unpack buffer, and the texture is specified from
+ * there, so the pixels are never copied on the CPU side. If the buffer
+ * cannot be mapped, the image is decoded into client memory instead.
+ */
+GLuint ModelLoader::loadTextureFromMemory(const unsigned char* bytes, size_t length, const std::string& name) {
+    ImageInfo info;
+    const ImageDecoder* decoder = image_decode::find(bytes, length, info);
+    if (!decoder) {
+        std::cerr << "Texture failed to decode: " << name << ": unrecognized image format" << std::endl;
+        return uploadTexture(nullptr, nullptr);
+    }
+
+    if (!unpackBuffer) glGenBuffers(1, &unpackBuffer);
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+    // Orphan the previous image's storage instead of waiting for its upload
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(info.byteSize()), nullptr, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(info.byteSize()),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    std::string error;
+    if (mapped) {
+        bool decoded = decoder->decode(bytes, length, info, static_cast<unsigned char*>(mapped), error);
+        // A failed unmap means the buffer contents were lost
+        if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) && decoded) {
+            decoded = false;
+            error = "pixel unpack buffer was lost";
+        }
+        GLuint textureID = uploadTexture(decoded ? &info : nullptr, nullptr);
+        glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!decoded) std::cerr << "Texture failed to decode: " << name << ": " << error << std::endl;
+        return textureID;
+    }
+
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    std::vector<unsigned char> pixels(info.byteSize());
+    if (!decoder->decode(bytes, length, info, pixels.data(), error)) {
+        std::cerr << "Texture failed to decode: " << name << ": " << error << std::endl;
+        return uploadTexture(nullptr, nullptr);
+    }
+    return uploadTexture(&info, pixels.data());
 }
 
 /**
  * @brief Draw all loaded meshes
  *
  * Iterates through all loaded meshes, binds their textures (if any),
- * and renders them using OpenGL draw calls.
+ * and renders them using OpenGL draw calls. The caller sets the model matrix.
  */
 void ModelLoader::draw() {
-    for (auto& mesh : meshes) {
-        // Bind textures if any
+    draw(-1, glm::mat4(1.0f));
+}
+
+/**
+ * @brief Draw all loaded meshes with a model matrix
+ *
+ * @param modelLocation Location of the program's model matrix, or -1 to leave it alone
+ * @param transform Model matrix of the whole model
+ *
+ * Meshes from GLB nodes are drawn with the transform times their node's
+ * world matrix; models without node transforms upload the matrix once.
+ */
+void ModelLoader::draw(GLint modelLocation, const glm::mat4& transform) {
+    if (modelLocation >= 0 && !nodeTransforms) {
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(transform));
+    }
+    auto prepare = [&](const Mesh& mesh) {
         if (!mesh.textures.empty()) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, mesh.textures[0].id);
+            glState().bindTexture(0, GL_TEXTURE_2D, mesh.textures[0].id);
+        }
+        if (modelLocation >= 0 && nodeTransforms) {
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(transform * mesh.transform));
         }
+    };
+
+    if (sharedGeometry) {
+        sharedGeometry->bind();
+        for (auto& mesh : meshes) {
+            if (!mesh.range.valid()) continue;
+            prepare(mesh);
+            sharedGeometry->draw(mesh.range);
+        }
+        return;
+    }
+
+    if (directStateAccess) {
+        // One VAO for every mesh: rebinding its vertex and element buffers is
+        // all that changes between draws
+        GLuint vao = ModelVertex::sharedVertexArray();
+        glState().bindVertexArray(vao);
+        for (auto& mesh : meshes) {
+            if (mesh.indexCount == 0) continue;
+            prepare(mesh);
+            glVertexArrayVertexBuffer(vao, 0, mesh.VBO, 0, ModelVertex::stride);
+            glVertexArrayElementBuffer(vao, mesh.EBO);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
+        }
+        return;
+    }
 
-        glBindVertexArray(mesh.VAO);
-        glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    for (auto& mesh : meshes) {
+        // Bind textures and node transform
+        prepare(mesh);
+
+        glState().bindVertexArray(mesh.VAO);
+        glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,576 @@
+#include "navmesh.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include "collision.h"
+#include "job_system.h"
+
+/**
+ * @brief Farthest, in cells, a blocked start or goal is moved to the nearest free cell
+ */
+const int NAV_SNAP_CELLS = 6;
+
+/**
+ * @brief Most cells one plan expands before giving up, which bounds the cost of a path with no way through
+ */
+const int NAV_MAX_EXPANSIONS = 20000;
+
+/**
+ * @brief Cover an area with tiles and build all of them
+ *
+ * @param area Walkable area; only its horizontal extent is used
+ * @param floor Height agents stand on
+ * @param level Static colliders; must outlive the mesh
+ * @param jobs Workers for the builds
+ *
+ * The first build runs in parallel and waits for every tile.
+ */
+void NavMesh::create(const AABB& area, float floor, const CollisionWorld* level, JobSystem* jobs) {
+    this->level = level;
+    this->jobs = jobs;
+    this->floor = floor;
+    origin = glm::vec3(area.min.x, floor, area.min.z);
+    float tileSize = NAV_TILE_CELLS * NAV_CELL_SIZE;
+    glm::vec3 extent = area.extent();
+    tilesX = std::max(1, static_cast<int>(std::ceil(extent.x / tileSize)));
+    tilesZ = std::max(1, static_cast<int>(std::ceil(extent.z / tileSize)));
+    tiles = std::vector<TileSlot>(static_cast<size_t>(tilesX) * tilesZ);
+
+    size_t cells = tiles.size() * NAV_TILE_CELLS * NAV_TILE_CELLS;
+    cost.assign(cells, 0.0f);
+    cameFrom.assign(cells, -1);
+    visited.assign(cells, 0);
+    regions.assign(cells, 0);
+    flood.reserve(cells);
+    planTiles.assign(tiles.size(), nullptr);
+
+    jobs->parallelFor(tiles.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            int tile = static_cast<int>(t);
+            std::shared_ptr<const Tile> built =
+                buildTile(tile % tilesX, tile / tilesX, origin, floor, level, obstacles, 0);
+            std::atomic_store(&tiles[t].tile, built);
+        }
+    });
+    currentStats.tiles = tiles.size();
+    snapshotTiles();
+    labelRegions();
+}
+
+/**
+ * @brief Add a moving obstacle; the tiles under it are rebuilt
+ *
+ * @return uint32_t Obstacle id for moveObstacle()
+ */
+uint32_t NavMesh::addObstacle(const NavObstacle& obstacle) {
+    obstacles.push_back(obstacle);
+    markDirty(footprint(obstacle));
+    return static_cast<uint32_t>(obstacles.size() - 1);
+}
+
+/**
+ * @brief Tell the mesh where an obstacle is now
+ *
+ * Movements under NAV_OBSTACLE_TOLERANCE, at the obstacle's farthest
+ * corner, are ignored, so a crate settling does not rebuild tiles every frame.
+ */
+void NavMesh::moveObstacle(uint32_t id, const NavObstacle& placement) {
+    NavObstacle& obstacle = obstacles[id];
+    float reach = glm::length(obstacle.halfExtents);
+    float turn = 2.0f * std::acos(std::min(1.0f, std::abs(glm::dot(obstacle.rotation, placement.rotation))));
+    if (glm::length(placement.center - obstacle.center) + turn * reach < NAV_OBSTACLE_TOLERANCE) return;
+
+    AABB changed = footprint(obstacle);
+    changed.expand(footprint(placement));
+    obstacle = placement;
+    markDirty(changed);
+}
+
+/**
+ * @brief Make room for this many paths, so requesting and releasing them never allocates
+ */
+void NavMesh::reservePaths(size_t count) {
+    paths.reserve(count);
+    freePaths.reserve(count);
+    planQueue.reserve(count);
+}
+
+/**
+ * @brief Ask for a path; it is planned by a later update()
+ */
+NavPathId NavMesh::requestPath(const glm::vec3& from, const glm::vec3& to) {
+    NavPathId id;
+    if (!freePaths.empty()) {
+        id = freePaths.back();
+        freePaths.pop_back();
+    } else {
+        id = static_cast<NavPathId>(paths.size());
+        paths.emplace_back();
+    }
+    Path& path = paths[id];
+    path.used = true;
+    path.state = NavPathState::Pending;
+    path.from = from;
+    path.to = to;
+    path.waypoints.clear();
+    path.tiles.clear();
+    path.revision++;
+    planQueue.push_back(id);
+    return id;
+}
+
+/**
+ * @brief Plan a path again between new ends, such as when its agent's target moved
+ *
+ * The old waypoints stay usable until the new plan is ready.
+ */
+void NavMesh::movePath(NavPathId id, const glm::vec3& from, const glm::vec3& to) {
+    Path& path = paths[id];
+    path.from = from;
+    path.to = to;
+    if (std::find(planQueue.begin(), planQueue.end(), id) == planQueue.end()) planQueue.push_back(id);
+}
+
+/**
+ * @brief Drop a path; its id is reused
+ */
+void NavMesh::releasePath(NavPathId id) {
+    paths[id].used = false;
+    planQueue.erase(std::remove(planQueue.begin(), planQueue.end(), id), planQueue.end());
+    freePaths.push_back(id);
+}
+
+/**
+ * @brief Swap in rebuilt tiles, start rebuilding changed ones and plan waiting paths
+ *
+ * @param maxPlans Most paths planned in this call; replans of invalidated paths go first
+ */
+void NavMesh::update(size_t maxPlans) {
+    {
+        std::lock_guard<std::mutex> lock(completions->mutex);
+        finished.swap(completions->tiles);
+    }
+    for (Built& built : finished) publish(built);
+    snapshotTiles();
+    if (!finished.empty()) labelRegions();
+    finished.clear();
+
+    currentStats.rebuilding = 0;
+    for (size_t t = 0; t < tiles.size(); t++) {
+        if (tiles[t].dirty && !tiles[t].building) startRebuild(static_cast<int>(t));
+        if (tiles[t].building) currentStats.rebuilding++;
+    }
+
+    size_t count = std::min(maxPlans, planQueue.size());
+    for (size_t i = 0; i < count; i++) plan(paths[planQueue[i]]);
+    planQueue.erase(planQueue.begin(), planQueue.begin() + count);
+    currentStats.pendingPaths = planQueue.size();
+}
+
+/**
+ * @brief Whether an agent may stand at a position, as of the tiles published now; safe from any thread
+ */
+bool NavMesh::walkable(const glm::vec3& position) const {
+    glm::ivec2 cell = cellOf(position);
+    if (cell.x < 0 || cell.y < 0 || cell.x >= tilesX * NAV_TILE_CELLS || cell.y >= tilesZ * NAV_TILE_CELLS) return false;
+    int tile = (cell.y / NAV_TILE_CELLS) * tilesX + cell.x / NAV_TILE_CELLS;
+    std::shared_ptr<const Tile> cells = std::atomic_load(&tiles[tile].tile);
+    return !cells->blocked[(cell.y % NAV_TILE_CELLS) * NAV_TILE_CELLS + cell.x % NAV_TILE_CELLS];
+}
+
+/**
+ * @brief Rasterize level colliders and obstacles into one tile's cells
+ *
+ * Runs on a worker; everything it reads is either immutable or its own copy.
+ */
+std::shared_ptr<const NavMesh::Tile> NavMesh::buildTile(int tileX, int tileZ, const glm::vec3& origin, float floor,
+                                                        const CollisionWorld* level,
+                                                        const std::vector<NavObstacle>& obstacles, uint32_t version) {
+    auto tile = std::make_shared<Tile>();
+    tile->version = version;
+    tile->blocked.assign(NAV_TILE_CELLS * NAV_TILE_CELLS, 0);
+
+    float tileSize = NAV_TILE_CELLS * NAV_CELL_SIZE;
+    glm::vec3 corner = origin + glm::vec3(tileX * tileSize, 0.0f, tileZ * tileSize);
+    float low = floor + NAV_STEP_HEIGHT, high = floor + NAV_AGENT_HEIGHT;
+
+    // Cells whose centres lie in [minX, maxX] x [minZ, maxZ]
+    auto cellRange = [&](float minX, float maxX, float minZ, float maxZ, glm::ivec2& first, glm::ivec2& last) {
+        first.x = std::max(0, static_cast<int>(std::ceil((minX - corner.x) / NAV_CELL_SIZE - 0.5f)));
+        first.y = std::max(0, static_cast<int>(std::ceil((minZ - corner.z) / NAV_CELL_SIZE - 0.5f)));
+        last.x = std::min(NAV_TILE_CELLS - 1, static_cast<int>(std::floor((maxX - corner.x) / NAV_CELL_SIZE - 0.5f)));
+        last.y = std::min(NAV_TILE_CELLS - 1, static_cast<int>(std::floor((maxZ - corner.z) / NAV_CELL_SIZE - 0.5f)));
+    };
+
+    // Level colliders between the step height and the agent's head, grown by its radius
+    AABB query;
+    query.min = glm::vec3(corner.x - NAV_AGENT_RADIUS, low, corner.z - NAV_AGENT_RADIUS);
+    query.max = glm::vec3(corner.x + tileSize + NAV_AGENT_RADIUS, high, corner.z + tileSize + NAV_AGENT_RADIUS);
+    std::vector<uint32_t> colliders;
+    if (level) level->overlapAABB(query, colliders);
+    for (uint32_t collider : colliders) {
+        const AABB& box = level->collider(collider);
+        glm::ivec2 first, last;
+        cellRange(box.min.x - NAV_AGENT_RADIUS, box.max.x + NAV_AGENT_RADIUS, box.min.z - NAV_AGENT_RADIUS,
+                  box.max.z + NAV_AGENT_RADIUS, first, last);
+        for (int z = first.y; z <= last.y; z++) {
+            for (int x = first.x; x <= last.x; x++) tile->blocked[z * NAV_TILE_CELLS + x] = 1;
+        }
+    }
+
+    // Obstacles are oriented boxes: test each cell centre, at the box's height, in the box's frame
+    for (const NavObstacle& obstacle : obstacles) {
+        glm::mat3 axes = glm::mat3_cast(obstacle.rotation);
+        glm::vec3 reach(0.0f);
+        for (int i = 0; i < 3; i++) reach += glm::abs(axes[i]) * obstacle.halfExtents[i];
+        if (obstacle.center.y + reach.y <= low || obstacle.center.y - reach.y >= high) continue;
+
+        glm::ivec2 first, last;
+        cellRange(obstacle.center.x - reach.x - NAV_AGENT_RADIUS, obstacle.center.x + reach.x + NAV_AGENT_RADIUS,
+                  obstacle.center.z - reach.z - NAV_AGENT_RADIUS, obstacle.center.z + reach.z + NAV_AGENT_RADIUS,
+                  first, last);
+        glm::quat toLocal = glm::conjugate(obstacle.rotation);
+        glm::vec3 grown = obstacle.halfExtents + glm::vec3(NAV_AGENT_RADIUS);
+        for (int z = first.y; z <= last.y; z++) {
+            for (int x = first.x; x <= last.x; x++) {
+                glm::vec3 center(corner.x + (x + 0.5f) * NAV_CELL_SIZE, obstacle.center.y,
+                                 corner.z + (z + 0.5f) * NAV_CELL_SIZE);
+                glm::vec3 local = glm::abs(toLocal * (center - obstacle.center));
+                if (local.x <= grown.x && local.y <= grown.y && local.z <= grown.z) tile->blocked[z * NAV_TILE_CELLS + x] = 1;
+            }
+        }
+    }
+    return tile;
+}
+
+/**
+ * @brief World-space bounds of one tile, from the floor up to the agent's height
+ */
+AABB NavMesh::tileBounds(int tile) const {
+    float tileSize = NAV_TILE_CELLS * NAV_CELL_SIZE;
+    AABB box;
+    box.min = origin + glm::vec3((tile % tilesX) * tileSize, 0.0f, (tile / tilesX) * tileSize);
+    box.max = box.min + glm::vec3(tileSize, NAV_AGENT_HEIGHT, tileSize);
+    return box;
+}
+
+/**
+ * @brief Bounds of the cells an obstacle can block
+ */
+AABB NavMesh::footprint(const NavObstacle& obstacle) const {
+    glm::mat3 axes = glm::mat3_cast(obstacle.rotation);
+    glm::vec3 reach(NAV_AGENT_RADIUS);
+    for (int i = 0; i < 3; i++) reach += glm::abs(axes[i]) * obstacle.halfExtents[i];
+    AABB box;
+    box.min = obstacle.center - reach;
+    box.max = obstacle.center + reach;
+    return box;
+}
+
+/**
+ * @brief Flag the tiles under a box for rebuilding in the next update()
+ *
+ * Obstacles do this themselves; the caller does it after switching a level
+ * collider on or off.
+ */
+void NavMesh::markDirty(const AABB& box) {
+    float tileSize = NAV_TILE_CELLS * NAV_CELL_SIZE;
+    int x0 = std::max(0, static_cast<int>(std::floor((box.min.x - origin.x) / tileSize)));
+    int z0 = std::max(0, static_cast<int>(std::floor((box.min.z - origin.z) / tileSize)));
+    int x1 = std::min(tilesX - 1, static_cast<int>(std::floor((box.max.x - origin.x) / tileSize)));
+    int z1 = std::min(tilesZ - 1, static_cast<int>(std::floor((box.max.z - origin.z) / tileSize)));
+    auto now = std::chrono::steady_clock::now();
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            TileSlot& slot = tiles[z * tilesX + x];
+            if (!slot.dirty) slot.dirtySince = now;
+            slot.dirty = true;
+        }
+    }
+}
+
+/**
+ * @brief Rebuild a tile on a worker from a copy of the obstacles over it
+ */
+void NavMesh::startRebuild(int tile) {
+    TileSlot& slot = tiles[tile];
+    slot.dirty = false;
+    slot.building = true;
+
+    AABB bounds = tileBounds(tile);
+    std::vector<NavObstacle> over;
+    for (const NavObstacle& obstacle : obstacles) {
+        if (footprint(obstacle).overlaps(bounds)) over.push_back(obstacle);
+    }
+
+    std::shared_ptr<Completions> done = completions;
+    int tileX = tile % tilesX, tileZ = tile / tilesX;
+    glm::vec3 corner = origin;
+    float height = floor;
+    const CollisionWorld* colliders = level;
+    uint32_t version = slot.version + 1;
+    auto since = slot.dirtySince;
+    jobs->submit([done, tile, tileX, tileZ, corner, height, colliders, over, version, since]() {
+        std::shared_ptr<const Tile> cells = buildTile(tileX, tileZ, corner, height, colliders, over, version);
+        std::lock_guard<std::mutex> lock(done->mutex);
+        done->tiles.push_back({tile, std::move(cells), since});
+    });
+}
+
+/**
+ * @brief Swap a rebuilt tile in and send the paths over it back to planning
+ */
+void NavMesh::publish(Built& built) {
+    TileSlot& slot = tiles[built.tile];
+    std::atomic_store(&slot.tile, built.cells);
+    slot.version = built.cells->version;
+    slot.building = false;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - built.dirtySince).count();
+    latencySamples++;
+    currentStats.rebuilt++;
+    currentStats.lastLatencyMs = ms;
+    currentStats.averageLatencyMs += (ms - currentStats.averageLatencyMs) / latencySamples;
+    currentStats.worstLatencyMs = std::max(currentStats.worstLatencyMs, ms);
+
+    for (size_t id = 0; id < paths.size(); id++) {
+        Path& path = paths[id];
+        if (!path.used || path.state == NavPathState::Pending) continue;
+        bool crosses = std::binary_search(path.tiles.begin(), path.tiles.end(), built.tile);
+        if (!crosses && path.state != NavPathState::Failed) continue;
+        if (crosses) {
+            path.waypoints.clear();
+            path.revision++;
+            currentStats.replanned++;
+        }
+        path.state = NavPathState::Pending;
+        if (std::find(planQueue.begin(), planQueue.end(), static_cast<NavPathId>(id)) == planQueue.end()) {
+            planQueue.insert(planQueue.begin(), static_cast<NavPathId>(id));
+        }
+    }
+}
+
+/**
+ * @brief Move a blocked cell to the nearest free one within NAV_SNAP_CELLS
+ */
+bool NavMesh::nearestFree(glm::ivec2& cell) const {
+    if (!blockedCell(cell.x, cell.y)) return true;
+    for (int ring = 1; ring <= NAV_SNAP_CELLS; ring++) {
+        for (int dz = -ring; dz <= ring; dz++) {
+            for (int dx = -ring; dx <= ring; dx++) {
+                if (std::max(std::abs(dx), std::abs(dz)) != ring) continue;
+                if (!blockedCell(cell.x + dx, cell.y + dz)) {
+                    cell += glm::ivec2(dx, dz);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Take the tiles planning and region labelling read until the next update()
+ */
+void NavMesh::snapshotTiles() {
+    for (size_t t = 0; t < tiles.size(); t++) planTiles[t] = tiles[t].tile.get();
+}
+
+/**
+ * @brief Flood fill the free cells into connected regions
+ *
+ * Four-connected, which joins the same cells as eight-connected moves that
+ * may not cut corners.
+ */
+void NavMesh::labelRegions() {
+    const int width = tilesX * NAV_TILE_CELLS, depth = tilesZ * NAV_TILE_CELLS;
+    std::fill(regions.begin(), regions.end(), 0);
+    uint32_t region = 0;
+    for (int seed = 0; seed < width * depth; seed++) {
+        if (regions[seed] || blockedCell(seed % width, seed / width)) continue;
+        regions[seed] = ++region;
+        flood.clear();
+        flood.push_back(seed);
+        while (!flood.empty()) {
+            int cell = flood.back();
+            flood.pop_back();
+            int x = cell % width, z = cell / width;
+            const int dx[] = {1, -1, 0, 0}, dz[] = {0, 0, 1, -1};
+            for (int n = 0; n < 4; n++) {
+                int nx = x + dx[n], nz = z + dz[n];
+                if (blockedCell(nx, nz)) continue;
+                int next = nz * width + nx;
+                if (regions[next]) continue;
+                regions[next] = region;
+                flood.push_back(next);
+            }
+        }
+    }
+}
+
+/**
+ * @brief A* over the cells, 8-connected without cutting corners, then shortened by line of sight
+ */
+void NavMesh::plan(Path& path) {
+    currentStats.planned++;
+    path.waypoints.clear();
+    path.tiles.clear();
+    path.revision++;
+
+    glm::ivec2 start = cellOf(path.from), goal = cellOf(path.to);
+    glm::ivec2 asked = goal;
+    if (!nearestFree(start) || !nearestFree(goal)) {
+        path.state = NavPathState::Failed;
+        currentStats.failed++;
+        return;
+    }
+
+    const int width = tilesX * NAV_TILE_CELLS;
+    if (regions[start.y * width + start.x] != regions[goal.y * width + goal.x]) {
+        path.state = NavPathState::Failed;
+        currentStats.failed++;
+        return;
+    }
+    auto heuristic = [&](int cell) {
+        float dx = std::abs(cell % width - goal.x), dz = std::abs(cell / width - goal.y);
+        return std::max(dx, dz) + 0.41421356f * std::min(dx, dz);
+    };
+    if (++stamp == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        stamp = 1;
+    }
+    int startCell = start.y * width + start.x, goalCell = goal.y * width + goal.x;
+    open.clear();
+    visited[startCell] = stamp;
+    cost[startCell] = 0.0f;
+    cameFrom[startCell] = -1;
+    open.emplace_back(heuristic(startCell), startCell);
+
+    bool found = false;
+    int expansions = 0;
+    auto later = std::greater<std::pair<float, int>>();
+    while (!open.empty() && expansions < NAV_MAX_EXPANSIONS) {
+        std::pop_heap(open.begin(), open.end(), later);
+        auto [priority, cell] = open.back();
+        open.pop_back();
+        if (cell == goalCell) {
+            found = true;
+            break;
+        }
+        if (priority > cost[cell] + heuristic(cell) + 1e-4f) continue; // Stale entry
+        expansions++;
+        int x = cell % width, z = cell / width;
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if ((dx == 0 && dz == 0) || blockedCell(x + dx, z + dz)) continue;
+                if (dx != 0 && dz != 0 && (blockedCell(x + dx, z) || blockedCell(x, z + dz))) continue;
+                int next = (z + dz) * width + x + dx;
+                float step = cost[cell] + (dx != 0 && dz != 0 ? 1.41421356f : 1.0f);
+                if (visited[next] == stamp && cost[next] <= step) continue;
+                visited[next] = stamp;
+                cost[next] = step;
+                cameFrom[next] = cell;
+                open.emplace_back(step + heuristic(next), next);
+                std::push_heap(open.begin(), open.end(), later);
+            }
+        }
+    }
+    if (!found) {
+        path.state = NavPathState::Failed;
+        currentStats.failed++;
+        return;
+    }
+
+    rawPath.clear();
+    for (int cell = goalCell; cell != -1; cell = cameFrom[cell]) rawPath.push_back(cell);
+    std::reverse(rawPath.begin(), rawPath.end());
+    for (int cell : rawPath) {
+        path.tiles.push_back((cell / width / NAV_TILE_CELLS) * tilesX + (cell % width) / NAV_TILE_CELLS);
+    }
+    std::sort(path.tiles.begin(), path.tiles.end());
+    path.tiles.erase(std::unique(path.tiles.begin(), path.tiles.end()), path.tiles.end());
+
+    // Keep only the cells where the straight line to the next one would be blocked
+    size_t anchor = 0;
+    while (anchor + 1 < rawPath.size()) {
+        size_t reach = anchor + 1;
+        int ax = rawPath[anchor] % width, az = rawPath[anchor] / width;
+        while (reach + 1 < rawPath.size() &&
+               lineOfSight(ax, az, rawPath[reach + 1] % width, rawPath[reach + 1] / width)) {
+            reach++;
+        }
+        if (reach + 1 < rawPath.size()) path.waypoints.push_back(cellCenter(rawPath[reach] % width, rawPath[reach] / width));
+        anchor = reach;
+    }
+    bool snapped = goal.x != asked.x || goal.y != asked.y;
+    path.waypoints.push_back(snapped ? cellCenter(goal.x, goal.y) : glm::vec3(path.to.x, floor, path.to.z));
+    path.state = NavPathState::Ready;
+}
+
+/**
+ * @brief Whether a cell is blocked, in the tiles of the last snapshot; outside the mesh is blocked
+ */
+bool NavMesh::blockedCell(int x, int z) const {
+    if (x < 0 || z < 0 || x >= tilesX * NAV_TILE_CELLS || z >= tilesZ * NAV_TILE_CELLS) return true;
+    const Tile* tile = planTiles[(z / NAV_TILE_CELLS) * tilesX + x / NAV_TILE_CELLS];
+    return tile->blocked[(z % NAV_TILE_CELLS) * NAV_TILE_CELLS + x % NAV_TILE_CELLS];
+}
+
+/**
+ * @brief Whether the straight line between two cell centres crosses only free cells
+ *
+ * Walks every cell the segment touches; where it passes exactly through a
+ * corner, both cells beside the corner must be free.
+ */
+bool NavMesh::lineOfSight(int x0, int z0, int x1, int z1) const {
+    int dx = std::abs(x1 - x0), dz = std::abs(z1 - z0);
+    int stepX = x1 > x0 ? 1 : -1, stepZ = z1 > z0 ? 1 : -1;
+    int x = x0, z = z0;
+    int error = dx - dz;
+    dx *= 2;
+    dz *= 2;
+    for (int n = (dx + dz) / 2; n > 0; n--) {
+        if (error > 0) {
+            x += stepX;
+            error -= dz;
+        } else if (error < 0) {
+            z += stepZ;
+            error += dx;
+        } else {
+            if (blockedCell(x + stepX, z) || blockedCell(x, z + stepZ)) return false;
+            x += stepX;
+            z += stepZ;
+            error += dx - dz;
+            n--;
+        }
+        if (blockedCell(x, z)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Cell under a position, which may lie outside the mesh
+ */
+glm::ivec2 NavMesh::cellOf(const glm::vec3& position) const {
+    return glm::ivec2(static_cast<int>(std::floor((position.x - origin.x) / NAV_CELL_SIZE)),
+                      static_cast<int>(std::floor((position.z - origin.z) / NAV_CELL_SIZE)));
+}
+
+/**
+ * @brief Centre of a cell, on the floor
+ */
+glm::vec3 NavMesh::cellCenter(int x, int z) const {
+    return glm::vec3(origin.x + (x + 0.5f) * NAV_CELL_SIZE, floor, origin.z + (z + 0.5f) * NAV_CELL_SIZE);
+}
+
+/**
+ * @brief Print one line of counters
+ */
+void NavMesh::report(std::ostream& out) const {
+    out << "Navmesh: " << currentStats.tiles << " tiles, " << currentStats.rebuilding << " rebuilding, "
+        << currentStats.rebuilt << " rebuilt in " << currentStats.averageLatencyMs << " ms avg, "
+        << currentStats.worstLatencyMs << " ms worst; " << currentStats.planned << " plans, " << currentStats.failed
+        << " failed, " << currentStats.replanned << " replanned, " << currentStats.pendingPaths << " waiting"
+        << std::endl;
+}
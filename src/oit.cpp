@@ -0,0 +1,250 @@
+#include "oit.h"
+#include <cstddef>
+#include <iostream>
+#include <glm/gtc/quaternion.hpp>
+#include "gl_state.h"
+
+static_assert(TransparentQuads::Vertex::attributeCount <= 3, "Quad vertex attributes would overlap the instance attributes");
+
+/**
+ * @brief Destructor for OitPass
+ */
+OitPass::~OitPass() {
+    release();
+}
+
+/**
+ * @brief Whether the driver can blend the two targets with different functions
+ *
+ * Per-target blend functions are core in GL 4.0 and widely exposed on 3.3
+ * drivers through ARB_draw_buffers_blend.
+ */
+bool OitPass::supported() {
+    return GLEW_VERSION_4_0 || GLEW_ARB_draw_buffers_blend;
+}
+
+/**
+ * @brief Delete the framebuffer and accumulation textures
+ */
+void OitPass::release() {
+    glState().forgetFramebuffer(fbo);
+    glState().forgetTexture(accum);
+    glState().forgetTexture(revealage);
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (accum) glDeleteTextures(1, &accum);
+    if (revealage) glDeleteTextures(1, &revealage);
+    fbo = accum = revealage = 0;
+}
+
+/**
+ * @brief Match the accumulation targets to the scene target
+ *
+ * @param scene Scene target whose depth buffer is shared
+ */
+void OitPass::resize(const SceneTarget& scene) {
+    if (scene.width() == width && scene.height() == height && fbo) return;
+    release();
+    width = scene.width();
+    height = scene.height();
+
+    glGenTextures(1, &accum);
+    glState().bindTexture(0, GL_TEXTURE_2D, accum);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &revealage);
+    glState().bindTexture(0, GL_TEXTURE_2D, revealage);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accum, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealage, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, scene.depthTexture(), 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "OIT framebuffer is incomplete" << std::endl;
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Clear the accumulation targets and set up blending for transparent draws
+ *
+ * Accumulation adds up; revealage multiplies by (1 - alpha). Depth testing
+ * stays on against the opaque depth, but transparent surfaces never write it.
+ */
+void OitPass::begin() const {
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+
+    const GLfloat zero[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const GLfloat one[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, one);
+
+    glState().depthMask(GL_FALSE);
+    glState().enable(GL_BLEND);
+    glState().blendFunci(0, GL_ONE, GL_ONE);
+    glState().blendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+/**
+ * @brief Restore the state changed by begin()
+ */
+void OitPass::end() const {
+    glState().disable(GL_BLEND);
+    glState().depthMask(GL_TRUE);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Resolve the accumulated transparency over the scene color
+ *
+ * @param scene Scene target to composite into
+ * @param compositeProgram Full-screen resolve program
+ */
+void OitPass::composite(const SceneTarget& scene, GLuint compositeProgram) const {
+    scene.bind();
+    glState().disable(GL_DEPTH_TEST);
+    glState().enable(GL_BLEND);
+    glState().blendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+    glState().useProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "accumTexture"), 0);
+    glUniform1i(glGetUniformLocation(compositeProgram, "revealageTexture"), 1);
+    glState().bindTexture(0, GL_TEXTURE_2D, accum);
+    glState().bindTexture(1, GL_TEXTURE_2D, revealage);
+
+    drawFullscreenTriangle();
+
+    glState().disable(GL_BLEND);
+    glState().enable(GL_DEPTH_TEST);
+}
+
+/**
+ * @brief Destructor for TransparentQuads
+ */
+TransparentQuads::~TransparentQuads() {
+    glState().forgetVertexArray(VAO);
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+    if (tintVBO) glDeleteBuffers(1, &tintVBO);
+}
+
+/**
+ * @brief Create the shared unit quad and the per-instance attribute streams
+ *
+ * Per-vertex: the Vertex format (locations 0-2).
+ * Per-instance: model matrix (3-6), normal matrix (7-9), tint (10).
+ */
+void TransparentQuads::create() {
+    const glm::vec3 positions[] = {{-0.5f, -0.5f, 0.0f}, {0.5f, -0.5f, 0.0f}, {-0.5f, 0.5f, 0.0f}, {0.5f, 0.5f, 0.0f}};
+    const glm::vec3 normals[] = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
+    const glm::vec2 texCoords[] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}};
+
+    VertexSource source;
+    source.count = 4;
+    source.positions = positions;
+    source.normals = normals;
+    source.texCoords = texCoords;
+    source.bounds.expand(positions[0]);
+    source.bounds.expand(positions[3]);
+    std::vector<unsigned char> quad;
+    Vertex::pack(source, quad);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glState().bindVertexArray(VAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, quad.size(), quad.data(), GL_STATIC_DRAW);
+    Vertex::setupAttributes();
+
+    glGenBuffers(1, &instanceVBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int col = 0; col < 4; col++) {
+        size_t offset = offsetof(InstanceMatrices, model) + col * sizeof(glm::vec4);
+        glVertexAttribPointer(3 + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceMatrices), (void*)offset);
+        glEnableVertexAttribArray(3 + col);
+        glVertexAttribDivisor(3 + col, 1);
+    }
+    for (int col = 0; col < 3; col++) {
+        size_t offset = offsetof(InstanceMatrices, normal) + col * sizeof(glm::vec3);
+        glVertexAttribPointer(7 + col, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceMatrices), (void*)offset);
+        glEnableVertexAttribArray(7 + col);
+        glVertexAttribDivisor(7 + col, 1);
+    }
+
+    glGenBuffers(1, &tintVBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, tintVBO);
+    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glEnableVertexAttribArray(10);
+    glVertexAttribDivisor(10, 1);
+
+    glState().bindVertexArray(0);
+}
+
+/**
+ * @brief Place a vertical quad
+ *
+ * @param center World-space centre
+ * @param size Width and height
+ * @param yaw Rotation around the vertical axis, in radians
+ * @param tint Color and peak opacity
+ */
+void TransparentQuads::add(const glm::vec3& center, const glm::vec2& size, float yaw, const glm::vec4& tint) {
+    transforms.push(center, glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(size.x, size.y, 1.0f));
+    tints.push_back(tint);
+    dirty = true;
+}
+
+/**
+ * @brief Remove every quad
+ */
+void TransparentQuads::clear() {
+    transforms.clear();
+    tints.clear();
+    dirty = true;
+}
+
+/**
+ * @brief Rebuild the instance buffers after quads were added or removed
+ *
+ * The matrices are written by the batch transform kernel directly into the
+ * mapped buffer, with no intermediate copy.
+ */
+void TransparentQuads::upload() {
+    dirty = false;
+    if (transforms.size() == 0) return;
+
+    glState().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    GLsizeiptr bytes = transforms.size() * sizeof(InstanceMatrices);
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+    void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        buildInstanceMatrices(transforms, static_cast<InstanceMatrices*>(mapped));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    glState().bindBuffer(GL_ARRAY_BUFFER, tintVBO);
+    glBufferData(GL_ARRAY_BUFFER, tints.size() * sizeof(glm::vec4), tints.data(), GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Draw every quad with one instanced call
+ *
+ * Expects the INSTANCED permutation of the transparency program to be bound.
+ */
+void TransparentQuads::draw() {
+    if (dirty) upload();
+    if (transforms.size() == 0) return;
+
+    glState().bindVertexArray(VAO);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(transforms.size()));
+}
@@ -0,0 +1,1356 @@
+#include "physics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "collision.h"
+#include "job_system.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PHYSICS_X86 1
+#endif
+
+const BodyId PHYSICS_LEVEL_COLLIDER = 0x80000000u; // Set in a manifold's second body for level boxes
+
+const float PHYSICS_CONTACT_MARGIN = 0.04f;        // Contacts are created this far before shapes touch
+const float PHYSICS_PENETRATION_SLOP = 0.01f;      // Penetration left alone, so resting contacts stay warm
+const float PHYSICS_BAUMGARTE = 0.2f;              // Fraction of the position error fed back per step
+const int PHYSICS_ITERATIONS = 10;
+const float PHYSICS_BOUNCE_SPEED = 1.0f;           // Slower impacts do not bounce
+const float PHYSICS_LINEAR_DAMPING = 0.05f;
+const float PHYSICS_ANGULAR_DAMPING = 0.1f;
+const float PHYSICS_SLEEP_SPEED = 0.08f;           // m/s, and rad/s for spin
+const float PHYSICS_SLEEP_TIME = 0.5f;             // An island this still for this long falls asleep
+const float PHYSICS_GRID_CELL_SIZE = 2.0f;
+const float PHYSICS_TELEPORT_DISTANCE = 1.0f;      // Kinematic moves longer than this jump instead of sweeping
+const float PHYSICS_LEVEL_FRICTION = 0.6f;
+
+bool PhysicsWorld::simdContacts = true;
+
+namespace {
+
+/**
+ * @brief A shape placed in the world, or a level box
+ */
+struct ShapeFrame {
+    ShapeType type;
+    glm::vec3 center;
+    glm::mat3 axes;                     // Local axes in world space
+    glm::vec3 half;                     // Box half extents
+    float radius;
+    glm::vec3 p0, p1;                   // Capsule cap centres
+    bool aligned;                       // Axes are the world axes
+};
+
+ShapeFrame frameOf(const CollisionShape& shape, const glm::vec3& position, const glm::quat& orientation) {
+    ShapeFrame frame;
+    frame.type = shape.type;
+    frame.center = position;
+    frame.axes = glm::mat3_cast(orientation);
+    frame.half = shape.halfExtents;
+    frame.radius = shape.radius;
+    frame.p0 = position - frame.axes[1] * shape.halfHeight;
+    frame.p1 = position + frame.axes[1] * shape.halfHeight;
+    frame.aligned = false;
+    return frame;
+}
+
+ShapeFrame frameOf(const AABB& box) {
+    ShapeFrame frame;
+    frame.type = ShapeType::Box;
+    frame.center = box.center();
+    frame.axes = glm::mat3(1.0f);
+    frame.half = box.extent() * 0.5f;
+    frame.radius = 0.0f;
+    frame.p0 = frame.p1 = frame.center;
+    frame.aligned = true;
+    return frame;
+}
+
+glm::vec3 toLocal(const ShapeFrame& box, const glm::vec3& p) {
+    glm::vec3 d = p - box.center;
+    if (box.aligned) return d;
+    return glm::vec3(glm::dot(box.axes[0], d), glm::dot(box.axes[1], d), glm::dot(box.axes[2], d));
+}
+
+glm::vec3 toWorldDirection(const ShapeFrame& box, const glm::vec3& v) {
+    return box.aligned ? v : box.axes * v;
+}
+
+/**
+ * @brief Four points against a box in the box's space: depth, outward normal and nearest box point per lane
+ */
+struct PointHits {
+    float depth[4];
+    float nx[4], ny[4], nz[4];
+    float qx[4], qy[4], qz[4];
+};
+
+/**
+ * @brief Reference kernel for pointsVsBox
+ *
+ * A point outside the box is pushed out along the line to its nearest box
+ * point. A point inside is pushed out through the nearest face.
+ */
+void pointsVsBoxScalar(const float* x, const float* y, const float* z, float radius, const glm::vec3& half, PointHits& out) {
+    for (int i = 0; i < 4; i++) {
+        glm::vec3 p(x[i], y[i], z[i]);
+        glm::vec3 q = glm::clamp(p, -half, half);
+        glm::vec3 d = p - q;
+        float d2 = glm::dot(d, d);
+        glm::vec3 n;
+        float depth;
+        if (d2 > 0.0f) {
+            float dist = std::sqrt(d2);
+            n = d / dist;
+            depth = radius - dist;
+        } else {
+            glm::vec3 face = half - glm::abs(p);
+            glm::vec3 sign(p.x < 0.0f ? -1.0f : 1.0f, p.y < 0.0f ? -1.0f : 1.0f, p.z < 0.0f ? -1.0f : 1.0f);
+            int axis = face.x <= face.y && face.x <= face.z ? 0 : (face.y <= face.z ? 1 : 2);
+            n = glm::vec3(0.0f);
+            n[axis] = sign[axis];
+            q[axis] = sign[axis] * half[axis];
+            depth = radius + face[axis];
+        }
+        out.depth[i] = depth;
+        out.nx[i] = n.x; out.ny[i] = n.y; out.nz[i] = n.z;
+        out.qx[i] = q.x; out.qy[i] = q.y; out.qz[i] = q.z;
+    }
+}
+
+#ifdef PHYSICS_X86
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/**
+ * @brief SSE kernel for pointsVsBox: both cases are computed for all four lanes, then blended
+ */
+void pointsVsBoxSSE(const float* x, const float* y, const float* z, float radius, const glm::vec3& half, PointHits& out) {
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 r = _mm_set1_ps(radius);
+    __m128 p[3] = {_mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z)};
+    __m128 h[3] = {_mm_set1_ps(half.x), _mm_set1_ps(half.y), _mm_set1_ps(half.z)};
+
+    // Outside: nearest point on the box and the direction to it
+    __m128 q[3], d[3];
+    for (int k = 0; k < 3; k++) {
+        q[k] = _mm_min_ps(_mm_max_ps(p[k], _mm_xor_ps(h[k], signBit)), h[k]);
+        d[k] = _mm_sub_ps(p[k], q[k]);
+    }
+    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+    __m128 outside = _mm_cmpgt_ps(d2, _mm_setzero_ps());
+    __m128 dist = _mm_sqrt_ps(d2);
+    __m128 inv = _mm_div_ps(one, select(outside, dist, one));
+
+    // Inside: the face with the least room to it
+    __m128 face[3], sign[3];
+    for (int k = 0; k < 3; k++) {
+        face[k] = _mm_sub_ps(h[k], _mm_andnot_ps(signBit, p[k]));
+        sign[k] = _mm_or_ps(_mm_and_ps(p[k], signBit), one);
+    }
+    __m128 least = _mm_min_ps(face[0], _mm_min_ps(face[1], face[2]));
+    __m128 pick[3];
+    pick[0] = _mm_cmpeq_ps(face[0], least);
+    pick[1] = _mm_andnot_ps(pick[0], _mm_cmpeq_ps(face[1], least));
+    pick[2] = _mm_andnot_ps(_mm_or_ps(pick[0], pick[1]), _mm_cmpeq_ps(least, least));
+
+    __m128 depth = select(outside, _mm_sub_ps(r, dist), _mm_add_ps(r, least));
+    _mm_storeu_ps(out.depth, depth);
+    float* normals[3] = {out.nx, out.ny, out.nz};
+    float* points[3] = {out.qx, out.qy, out.qz};
+    for (int k = 0; k < 3; k++) {
+        __m128 nIn = _mm_and_ps(pick[k], sign[k]);
+        __m128 qIn = select(pick[k], _mm_mul_ps(sign[k], h[k]), p[k]);
+        _mm_storeu_ps(normals[k], select(outside, _mm_mul_ps(d[k], inv), nIn));
+        _mm_storeu_ps(points[k], select(outside, q[k], qIn));
+    }
+}
+
+#endif
+
+void pointsVsBox(const float* x, const float* y, const float* z, float radius, const glm::vec3& half, PointHits& out) {
+#ifdef PHYSICS_X86
+    if (PhysicsWorld::simdContacts) {
+        pointsVsBoxSSE(x, y, z, radius, half, out);
+        return;
+    }
+#endif
+    pointsVsBoxScalar(x, y, z, radius, half, out);
+}
+
+using Contact = PhysicsWorld::Contact;
+
+Contact makeContact(const glm::vec3& point, const glm::vec3& normal, float depth, uint32_t feature) {
+    Contact contact = {};
+    contact.point = point;
+    contact.normal = normal;
+    contact.depth = depth;
+    contact.feature = feature;
+    return contact;
+}
+
+/**
+ * @brief Points with a radius, belonging to one shape, against a box
+ *
+ * @param pointsFirst Whether the points' shape is the pair's first shape, which decides the normal's direction
+ * @return int Contacts written
+ */
+int pointsAgainstBox(const glm::vec3* points, const uint32_t* features, int count, float radius, const ShapeFrame& box,
+                     bool pointsFirst, Contact* out) {
+    int written = 0;
+    for (int base = 0; base < count; base += 4) {
+        alignas(16) float x[4], y[4], z[4];
+        int lanes = std::min(4, count - base);
+        for (int i = 0; i < 4; i++) {
+            glm::vec3 local = toLocal(box, points[base + std::min(i, lanes - 1)]);
+            x[i] = local.x; y[i] = local.y; z[i] = local.z;
+        }
+        PointHits hits;
+        pointsVsBox(x, y, z, radius, box.half, hits);
+        for (int i = 0; i < lanes; i++) {
+            if (hits.depth[i] <= -PHYSICS_CONTACT_MARGIN) continue;
+            glm::vec3 outward = toWorldDirection(box, glm::vec3(hits.nx[i], hits.ny[i], hits.nz[i]));
+            glm::vec3 onBox = box.center + toWorldDirection(box, glm::vec3(hits.qx[i], hits.qy[i], hits.qz[i]));
+            glm::vec3 onShape = points[base + i] - outward * radius;
+            out[written++] = makeContact((onBox + onShape) * 0.5f, pointsFirst ? -outward : outward, hits.depth[i],
+                                         features[base + i]);
+        }
+    }
+    return written;
+}
+
+int sphereAgainstSphere(const glm::vec3& a, float ra, const glm::vec3& b, float rb, uint32_t feature, Contact* out) {
+    glm::vec3 d = b - a;
+    float d2 = glm::dot(d, d);
+    float reach = ra + rb + PHYSICS_CONTACT_MARGIN;
+    if (d2 >= reach * reach) return 0;
+    float dist = std::sqrt(d2);
+    glm::vec3 n = dist > 1e-6f ? d / dist : glm::vec3(0.0f, 1.0f, 0.0f);
+    float depth = ra + rb - dist;
+    out[0] = makeContact(a + n * (ra - depth * 0.5f), n, depth, feature);
+    return 1;
+}
+
+float closestOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 ab = b - a;
+    float length2 = glm::dot(ab, ab);
+    return length2 > 1e-12f ? glm::clamp(glm::dot(p - a, ab) / length2, 0.0f, 1.0f) : 0.0f;
+}
+
+/**
+ * @brief Parameters of the closest points of two segments (Ericson, Real-Time Collision Detection 5.1.9)
+ */
+void closestBetweenSegments(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2,
+                            float& s, float& t) {
+    glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    if (a <= 1e-12f && e <= 1e-12f) {
+        s = t = 0.0f;
+        return;
+    }
+    if (a <= 1e-12f) {
+        s = 0.0f;
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+        return;
+    }
+    float c = glm::dot(d1, r);
+    if (e <= 1e-12f) {
+        t = 0.0f;
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+        return;
+    }
+    float b = glm::dot(d1, d2);
+    float denom = a * e - b * b;
+    s = denom > 1e-12f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+    t = (b * s + f) / e;
+    if (t < 0.0f) {
+        t = 0.0f;
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+    } else if (t > 1.0f) {
+        t = 1.0f;
+        s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+    }
+}
+
+/**
+ * @brief Parameter of the point of a segment nearest to a box
+ *
+ * Alternates between the nearest box point and the nearest segment point;
+ * both sets are convex, so this converges, and a few rounds are plenty.
+ */
+float segmentNearestBox(const ShapeFrame& box, const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 la = toLocal(box, a), lb = toLocal(box, b);
+    float t = 0.5f;
+    for (int round = 0; round < 4; round++) {
+        glm::vec3 p = la + (lb - la) * t;
+        t = closestOnSegment(glm::clamp(p, -box.half, box.half), la, lb);
+    }
+    return t;
+}
+
+/**
+ * @brief Corners of a box face, in order around it
+ *
+ * @param axis Face axis of the box
+ * @param sign Which of the two faces along it
+ */
+void boxFace(const ShapeFrame& box, int axis, float sign, glm::vec3* corners) {
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    glm::vec3 center = box.center + box.axes[axis] * (box.half[axis] * sign);
+    glm::vec3 du = box.axes[u] * box.half[u], dv = box.axes[v] * (box.half[v] * sign);
+    corners[0] = center - du - dv;
+    corners[1] = center + du - dv;
+    corners[2] = center + du + dv;
+    corners[3] = center - du + dv;
+}
+
+/**
+ * @brief Keep the part of a polygon where dot(normal, p) <= offset
+ *
+ * @return int Points written, at most count + 1
+ */
+int clipPolygon(const glm::vec3* in, int count, const glm::vec3& normal, float offset, glm::vec3* out) {
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec3& p = in[i];
+        const glm::vec3& q = in[(i + 1) % count];
+        float dp = glm::dot(normal, p) - offset, dq = glm::dot(normal, q) - offset;
+        if (dp <= 0.0f) out[written++] = p;
+        if ((dp < 0.0f && dq > 0.0f) || (dp > 0.0f && dq < 0.0f)) out[written++] = p + (q - p) * (dp / (dp - dq));
+    }
+    return written;
+}
+
+/**
+ * @brief Contacts of an incident box lying on a face of a reference box
+ *
+ * The incident box's face most opposed to the normal is clipped against the
+ * side planes of the reference face, and what is left below the reference
+ * face, or within the margin above it, becomes the contacts.
+ *
+ * @param normal Outward normal of the reference face
+ * @param referenceFirst Whether the reference box is the pair's first shape
+ */
+int faceContacts(const ShapeFrame& reference, const ShapeFrame& incident, int axis, const glm::vec3& normal,
+                 bool referenceFirst, uint32_t featureBase, Contact* out) {
+    int incidentAxis = 0;
+    float best = -1.0f;
+    for (int k = 0; k < 3; k++) {
+        float d = std::abs(glm::dot(incident.axes[k], normal));
+        if (d > best) {
+            best = d;
+            incidentAxis = k;
+        }
+    }
+    float incidentSign = glm::dot(incident.axes[incidentAxis], normal) > 0.0f ? -1.0f : 1.0f;
+
+    glm::vec3 polygon[8], clipped[8];
+    boxFace(incident, incidentAxis, incidentSign, polygon);
+    int count = 4;
+    for (int side = 1; side <= 2 && count > 0; side++) {
+        int k = (axis + side) % 3;
+        const glm::vec3& sideNormal = reference.axes[k];
+        float centre = glm::dot(sideNormal, reference.center);
+        count = clipPolygon(polygon, count, sideNormal, centre + reference.half[k], clipped);
+        count = clipPolygon(clipped, count, -sideNormal, -centre + reference.half[k], polygon);
+    }
+
+    float surface = glm::dot(normal, reference.center) + reference.half[axis];
+    uint32_t feature = featureBase + (incidentAxis * 2 + (incidentSign > 0.0f ? 1 : 0)) * 8;
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        float depth = surface - glm::dot(normal, polygon[i]);
+        if (depth <= -PHYSICS_CONTACT_MARGIN) continue;
+        out[written++] = makeContact(polygon[i] + normal * (depth * 0.5f), referenceFirst ? normal : -normal, depth,
+                                     feature + i);
+    }
+    return written;
+}
+
+/**
+ * @brief Two boxes by separating axes
+ *
+ * The axis of least overlap among the 6 face normals and 9 edge cross
+ * products gives one normal for the whole manifold. Face axes clip the
+ * boxes' faces against each other, which keeps a box resting flat on another
+ * at four steady contacts; edge axes give the single point where the edges
+ * cross. Edge axes, and the second box's faces, have to be clearly better
+ * to win, so the reference face does not flicker between two nearly equal
+ * ones while a box rests, which would lose the warm start.
+ */
+int boxAgainstBox(const ShapeFrame& a, const ShapeFrame& b, Contact* out) {
+    glm::vec3 d = b.center - a.center;
+    float rotation[3][3], absRotation[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            rotation[i][j] = glm::dot(a.axes[i], b.axes[j]);
+            absRotation[i][j] = std::abs(rotation[i][j]) + 1e-6f;
+        }
+    }
+
+    float faceOverlap = 1e30f, edgeOverlap = 1e30f;
+    int faceAxis = -1, edgeAxis = -1;
+    glm::vec3 edgeNormal(0.0f);
+    for (int i = 0; i < 3; i++) {
+        float ra = a.half[i];
+        float rb = b.half[0] * absRotation[i][0] + b.half[1] * absRotation[i][1] + b.half[2] * absRotation[i][2];
+        float overlap = ra + rb - std::abs(glm::dot(d, a.axes[i]));
+        if (overlap <= -PHYSICS_CONTACT_MARGIN) return 0;
+        if (overlap < faceOverlap) {
+            faceOverlap = overlap;
+            faceAxis = i;
+        }
+    }
+    for (int j = 0; j < 3; j++) {
+        float ra = a.half[0] * absRotation[0][j] + a.half[1] * absRotation[1][j] + a.half[2] * absRotation[2][j];
+        float overlap = ra + b.half[j] - std::abs(glm::dot(d, b.axes[j]));
+        if (overlap <= -PHYSICS_CONTACT_MARGIN) return 0;
+        if (overlap < faceOverlap * 0.95f - 0.01f) {
+            faceOverlap = overlap;
+            faceAxis = 3 + j;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            glm::vec3 axis = glm::cross(a.axes[i], b.axes[j]);
+            float length = glm::length(axis);
+            if (length < 1e-3f) continue;
+            axis /= length;
+            float ra = 0.0f, rb = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                ra += a.half[k] * std::abs(glm::dot(a.axes[k], axis));
+                rb += b.half[k] * std::abs(glm::dot(b.axes[k], axis));
+            }
+            float overlap = ra + rb - std::abs(glm::dot(d, axis));
+            if (overlap <= -PHYSICS_CONTACT_MARGIN) return 0;
+            if (overlap < edgeOverlap) {
+                edgeOverlap = overlap;
+                edgeAxis = i * 3 + j;
+                edgeNormal = axis;
+            }
+        }
+    }
+
+    if (edgeAxis < 0 || edgeOverlap > faceOverlap * 0.95f - 0.01f) {
+        if (faceAxis < 3) {
+            glm::vec3 normal = a.axes[faceAxis] * (glm::dot(d, a.axes[faceAxis]) < 0.0f ? -1.0f : 1.0f);
+            return faceContacts(a, b, faceAxis, normal, true, 0, out);
+        }
+        glm::vec3 normal = b.axes[faceAxis - 3] * (glm::dot(d, b.axes[faceAxis - 3]) > 0.0f ? -1.0f : 1.0f);
+        return faceContacts(b, a, faceAxis - 3, normal, false, 64, out);
+    }
+
+    // The edge of each box that is furthest along the normal towards the other
+    if (glm::dot(edgeNormal, d) < 0.0f) edgeNormal = -edgeNormal;
+    int i = edgeAxis / 3, j = edgeAxis % 3;
+    glm::vec3 onA = a.center, onB = b.center;
+    for (int k = 0; k < 3; k++) {
+        if (k != i) onA += a.axes[k] * (a.half[k] * (glm::dot(a.axes[k], edgeNormal) > 0.0f ? 1.0f : -1.0f));
+        if (k != j) onB += b.axes[k] * (b.half[k] * (glm::dot(b.axes[k], edgeNormal) > 0.0f ? -1.0f : 1.0f));
+    }
+    float s, t;
+    glm::vec3 edgeA = a.axes[i] * a.half[i], edgeB = b.axes[j] * b.half[j];
+    closestBetweenSegments(onA - edgeA, onA + edgeA, onB - edgeB, onB + edgeB, s, t);
+    glm::vec3 pointA = onA - edgeA + edgeA * (2.0f * s), pointB = onB - edgeB + edgeB * (2.0f * t);
+    out[0] = makeContact((pointA + pointB) * 0.5f, edgeNormal, edgeOverlap, 128 + edgeAxis);
+    return 1;
+}
+
+/**
+ * @brief Contacts between two shapes, normals from a towards b
+ *
+ * @param out Room for 8 contacts, the most any pair of shapes makes
+ */
+int collideShapes(const ShapeFrame& a, const ShapeFrame& b, Contact* out) {
+    if (a.type > b.type) {
+        int count = collideShapes(b, a, out);
+        for (int i = 0; i < count; i++) out[i].normal = -out[i].normal;
+        return count;
+    }
+    if (a.type == ShapeType::Sphere) {
+        if (b.type == ShapeType::Sphere) return sphereAgainstSphere(a.center, a.radius, b.center, b.radius, 0, out);
+        if (b.type == ShapeType::Capsule) {
+            glm::vec3 nearest = b.p0 + (b.p1 - b.p0) * closestOnSegment(a.center, b.p0, b.p1);
+            return sphereAgainstSphere(a.center, a.radius, nearest, b.radius, 0, out);
+        }
+        uint32_t feature = 0;
+        return pointsAgainstBox(&a.center, &feature, 1, a.radius, b, true, out);
+    }
+    if (a.type == ShapeType::Capsule) {
+        if (b.type == ShapeType::Capsule) {
+            glm::vec3 axisA = a.p1 - a.p0, axisB = b.p1 - b.p0;
+            float lengths = glm::length(axisA) * glm::length(axisB);
+            if (lengths > 1e-6f && std::abs(glm::dot(axisA, axisB)) > 0.98f * lengths) {
+                // Nearly parallel: the ends of each against the other, so the pair can lie side by side
+                int count = 0;
+                const glm::vec3 endsA[2] = {a.p0, a.p1}, endsB[2] = {b.p0, b.p1};
+                for (int i = 0; i < 2; i++) {
+                    glm::vec3 onB = b.p0 + axisB * closestOnSegment(endsA[i], b.p0, b.p1);
+                    count += sphereAgainstSphere(endsA[i], a.radius, onB, b.radius, 1 + i, out + count);
+                    glm::vec3 onA = a.p0 + axisA * closestOnSegment(endsB[i], a.p0, a.p1);
+                    count += sphereAgainstSphere(onA, a.radius, endsB[i], b.radius, 3 + i, out + count);
+                }
+                return count;
+            }
+            float s, t;
+            closestBetweenSegments(a.p0, a.p1, b.p0, b.p1, s, t);
+            return sphereAgainstSphere(a.p0 + axisA * s, a.radius, b.p0 + axisB * t, b.radius, 0, out);
+        }
+        // Both caps, and the point nearest the box if that is along the body
+        glm::vec3 points[3] = {a.p0, a.p1, a.p0};
+        uint32_t features[3] = {0, 1, 2};
+        int count = 2;
+        float t = segmentNearestBox(b, a.p0, a.p1);
+        if (t > 0.05f && t < 0.95f) points[count++] = a.p0 + (a.p1 - a.p0) * t;
+        return pointsAgainstBox(points, features, count, a.radius, b, true, out);
+    }
+    return boxAgainstBox(a, b, out);
+}
+
+glm::vec3 anyPerpendicular(const glm::vec3& n) {
+    glm::vec3 t = std::abs(n.x) > 0.57f ? glm::vec3(n.y, -n.x, 0.0f) : glm::vec3(0.0f, n.z, -n.y);
+    return glm::normalize(t);
+}
+
+} // namespace
+
+CollisionShape CollisionShape::sphere(float radius) {
+    CollisionShape shape;
+    shape.type = ShapeType::Sphere;
+    shape.radius = radius;
+    return shape;
+}
+
+CollisionShape CollisionShape::capsule(float radius, float halfHeight) {
+    CollisionShape shape;
+    shape.type = ShapeType::Capsule;
+    shape.radius = radius;
+    shape.halfHeight = halfHeight;
+    return shape;
+}
+
+CollisionShape CollisionShape::box(const glm::vec3& halfExtents) {
+    CollisionShape shape;
+    shape.type = ShapeType::Box;
+    shape.halfExtents = halfExtents;
+    return shape;
+}
+
+/**
+ * @brief Add a body
+ *
+ * @param desc Shape, placement and material; a mass of zero makes the body kinematic
+ * @return BodyId Handle to the body
+ */
+BodyId PhysicsWorld::addBody(const RigidBodyDesc& desc) {
+    bodies.emplace_back();
+    initBody(bodies.back(), desc);
+    return static_cast<BodyId>(bodies.size() - 1);
+}
+
+/**
+ * @brief Set a body up again from scratch, keeping its id; a pooled body is enabled by it
+ *
+ * Contacts it made as the body it was are dropped, so they do not warm
+ * start the new one.
+ */
+void PhysicsWorld::resetBody(BodyId id, const RigidBodyDesc& desc) {
+    initBody(bodies[id], desc);
+    for (Manifold& m : previousManifolds) {
+        if (m.a == id || m.b == id) m.count = 0;
+    }
+}
+
+/**
+ * @brief Fill in a body from its description, at rest and awake
+ *
+ * Inertia is that of a solid sphere or box. Capsules use a solid cylinder
+ * half a radius longer at each end, which is close enough for tumbling.
+ */
+void PhysicsWorld::initBody(Body& body, const RigidBodyDesc& desc) {
+    body = Body();
+    body.shape = desc.shape;
+    body.position = desc.position;
+    body.orientation = glm::normalize(desc.orientation);
+    body.friction = desc.friction;
+    body.restitution = desc.restitution;
+    body.group = desc.group;
+    body.kinematic = desc.mass <= 0.0f;
+    body.invMass = body.kinematic ? 0.0f : 1.0f / desc.mass;
+
+    glm::vec3 inertia(0.0f);
+    float m = desc.mass;
+    const CollisionShape& s = desc.shape;
+    if (s.type == ShapeType::Sphere) {
+        inertia = glm::vec3(0.4f * m * s.radius * s.radius);
+    } else if (s.type == ShapeType::Box) {
+        glm::vec3 h2 = s.halfExtents * s.halfExtents;
+        inertia = glm::vec3(h2.y + h2.z, h2.x + h2.z, h2.x + h2.y) * (m / 3.0f);
+    } else {
+        float length = 2.0f * s.halfHeight + s.radius;
+        float across = m * (3.0f * s.radius * s.radius + length * length) / 12.0f;
+        inertia = glm::vec3(across, 0.5f * m * s.radius * s.radius, across);
+    }
+    body.invInertiaLocal = body.kinematic ? glm::vec3(0.0f) : 1.0f / glm::max(inertia, glm::vec3(1e-6f));
+    refreshBody(body);
+}
+
+/**
+ * @brief Switch a body off, or back on where it was left
+ *
+ * A disabled body keeps its place but is not simulated, collided with or
+ * hit by rays. Joints on it should be disabled with it.
+ */
+void PhysicsWorld::setBodyEnabled(BodyId id, bool enabled) {
+    Body& body = bodies[id];
+    if (body.enabled == enabled) return;
+    body.enabled = enabled;
+    body.linearVelocity = glm::vec3(0.0f);
+    body.angularVelocity = glm::vec3(0.0f);
+    body.hasTarget = false;
+    body.sleepTime = 0.0f;
+    body.island = 0;
+    body.awake = enabled;
+    refreshBody(body);
+}
+
+/**
+ * @brief Hinge two bodies together, or one body to the world
+ *
+ * @param a, b Bodies, either of which may be PHYSICS_WORLD
+ * @param pivot World-space point the hinge turns about
+ * @param axis World-space hinge axis
+ * @param minAngle, maxAngle Limits in radians of b's rotation relative to a about the axis, from the current pose
+ * @param friction Torque, in N·m, that resists turning; keeps doors from swinging forever
+ * @return uint32_t Joint index
+ */
+uint32_t PhysicsWorld::addHinge(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis, float minAngle,
+                                float maxAngle, float friction) {
+    auto place = [&](BodyId id, glm::vec3& localPivot, glm::vec3& localAxis, glm::vec3& localReference,
+                     const glm::vec3& reference) {
+        glm::vec3 position = id == PHYSICS_WORLD ? glm::vec3(0.0f) : bodies[id].position;
+        glm::quat toLocal = id == PHYSICS_WORLD ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : glm::inverse(bodies[id].orientation);
+        localPivot = toLocal * (pivot - position);
+        localAxis = toLocal * axis;
+        localReference = toLocal * reference;
+    };
+    Joint hinge = {};
+    hinge.type = JointType::Hinge;
+    hinge.enabled = true;
+    hinge.a = a;
+    hinge.b = b;
+    glm::vec3 unitAxis = glm::normalize(axis);
+    glm::vec3 reference = anyPerpendicular(unitAxis);
+    place(a, hinge.localPivotA, hinge.localAxisA, hinge.localReferenceA, reference);
+    place(b, hinge.localPivotB, hinge.localAxisB, hinge.localReferenceB, reference);
+    hinge.localAxisA = glm::normalize(hinge.localAxisA);
+    hinge.localAxisB = glm::normalize(hinge.localAxisB);
+    hinge.minAngle = minAngle;
+    hinge.maxAngle = maxAngle;
+    hinge.friction = friction;
+    joints.push_back(hinge);
+    if (a != PHYSICS_WORLD && b != PHYSICS_WORLD) {
+        jointed.insert(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+    }
+    return static_cast<uint32_t>(joints.size() - 1);
+}
+
+/**
+ * @brief Join two bodies at a point, letting b turn any way within a cone about a's axis
+ *
+ * @param a, b Bodies, either of which may be PHYSICS_WORLD
+ * @param pivot World-space point they turn about
+ * @param axis World-space axis, in the current pose, of the cone b's axis must stay in
+ * @param coneAngle Half-angle of the cone in radians
+ * @param friction Torque, in N·m, that resists turning either way
+ * @return uint32_t Joint index
+ *
+ * Twisting about the axis is free but for friction. The bodies still
+ * collide; give them a collision group to keep them apart.
+ */
+uint32_t PhysicsWorld::addConeJoint(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis, float coneAngle,
+                                    float friction) {
+    joints.push_back(coneJoint(a, b, pivot, axis, coneAngle, friction));
+    return static_cast<uint32_t>(joints.size() - 1);
+}
+
+/**
+ * @brief Set a cone joint up again between other bodies, keeping its index; a pooled joint is enabled by it
+ */
+void PhysicsWorld::resetConeJoint(uint32_t joint, BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis,
+                                  float coneAngle, float friction) {
+    joints[joint] = coneJoint(a, b, pivot, axis, coneAngle, friction);
+}
+
+PhysicsWorld::Joint PhysicsWorld::coneJoint(BodyId a, BodyId b, const glm::vec3& pivot, const glm::vec3& axis,
+                                            float coneAngle, float friction) const {
+    auto place = [&](BodyId id, glm::vec3& localPivot, glm::vec3& localAxis) {
+        glm::vec3 position = id == PHYSICS_WORLD ? glm::vec3(0.0f) : bodies[id].position;
+        glm::quat toLocal = id == PHYSICS_WORLD ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : glm::inverse(bodies[id].orientation);
+        localPivot = toLocal * (pivot - position);
+        localAxis = glm::normalize(toLocal * axis);
+    };
+    Joint cone = {};
+    cone.type = JointType::Cone;
+    cone.enabled = true;
+    cone.a = a;
+    cone.b = b;
+    place(a, cone.localPivotA, cone.localAxisA);
+    place(b, cone.localPivotB, cone.localAxisB);
+    cone.minAngle = 0.0f;
+    cone.maxAngle = coneAngle;
+    cone.friction = friction;
+    return cone;
+}
+
+/**
+ * @brief Switch a joint off, or back on
+ */
+void PhysicsWorld::setJointEnabled(uint32_t joint, bool enabled) {
+    joints[joint].enabled = enabled;
+}
+
+/**
+ * @brief Advance by whole fixed steps
+ *
+ * @param elapsed Seconds since the last update
+ * @param jobs Job system for contacts and islands, or nullptr
+ *
+ * Time left over is carried to the next update. After a stall, at most
+ * PHYSICS_MAX_STEPS are taken and the rest of the time is dropped.
+ */
+void PhysicsWorld::update(float elapsed, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    accumulator += elapsed;
+    int steps = std::min(static_cast<int>(accumulator / PHYSICS_TIMESTEP), PHYSICS_MAX_STEPS);
+    accumulator = steps == PHYSICS_MAX_STEPS ? 0.0f : accumulator - steps * PHYSICS_TIMESTEP;
+
+    // Kinematic bodies sweep to their targets over the steps, so what they hit is pushed, not teleported past
+    for (Body& body : bodies) {
+        if (!body.kinematic || !body.enabled) continue;
+        body.linearVelocity = glm::vec3(0.0f);
+        if (body.hasTarget && steps > 0) {
+            glm::vec3 move = body.target - body.position;
+            if (glm::length(move) > PHYSICS_TELEPORT_DISTANCE) {
+                body.position = body.target;
+                refreshBody(body);
+            } else {
+                body.linearVelocity = move / (steps * PHYSICS_TIMESTEP);
+            }
+        }
+        body.hasTarget = body.hasTarget && steps == 0;
+    }
+
+    for (int i = 0; i < steps; i++) step(PHYSICS_TIMESTEP, jobs);
+    if (steps > 0) lastStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Advance the simulation by one step
+ */
+void PhysicsWorld::step(float dt, JobSystem* jobs) {
+    findPairs();
+    collidePairs(jobs);
+    // Bodies hit while asleep wake with their islands, and their own contacts may touch further sleepers: repeat
+    // until nothing new wakes, so no island pushes a body that is still asleep or shared with another island
+    while (wakeTouched()) {
+        findPairs();
+        collidePairs(jobs);
+    }
+    buildIslands();
+
+    auto solve = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) solveIsland(islands[i], dt);
+    };
+    if (jobs) jobs->parallelFor(islandCount, 1, solve);
+    else solve(0, islandCount);
+
+    for (Body& body : bodies) {
+        if (!body.kinematic || body.linearVelocity == glm::vec3(0.0f)) continue;
+        body.position += body.linearVelocity * dt;
+        refreshBody(body);
+    }
+
+    // Keep this step's impulses for warm starting the next
+    previous.clear();
+    previousManifolds.swap(manifolds);
+    for (size_t i = 0; i < previousManifolds.size(); i++) {
+        const Manifold& m = previousManifolds[i];
+        if (m.count > 0) previous[uint64_t(m.a) << 32 | m.b] = static_cast<uint32_t>(i);
+    }
+
+    lastStats.bodies = lastStats.awake = 0;
+    for (const Body& body : bodies) {
+        lastStats.bodies += body.enabled;
+        lastStats.awake += body.enabled && body.awake && !body.kinematic;
+    }
+    lastStats.pairs = pairs.size();
+    lastStats.contacts = 0;
+    for (const Manifold& m : previousManifolds) lastStats.contacts += m.count;
+    lastStats.islands = islandCount;
+    lastStats.largestIsland = islandCount == 0 ? 0 : islands.front().bodies.size();
+}
+
+/**
+ * @brief Recompute a body's world inertia and its bounds, grown by the contact margin
+ */
+void PhysicsWorld::refreshBody(Body& body) {
+    glm::mat3 rotation = glm::mat3_cast(body.orientation);
+    glm::mat3 scaled(rotation[0] * body.invInertiaLocal.x, rotation[1] * body.invInertiaLocal.y,
+                     rotation[2] * body.invInertiaLocal.z);
+    body.invInertia = scaled * glm::transpose(rotation);
+
+    glm::vec3 reach;
+    const CollisionShape& s = body.shape;
+    if (s.type == ShapeType::Sphere) {
+        reach = glm::vec3(s.radius);
+    } else if (s.type == ShapeType::Capsule) {
+        reach = glm::abs(rotation[1]) * s.halfHeight + glm::vec3(s.radius);
+    } else {
+        reach = glm::abs(rotation[0]) * s.halfExtents.x + glm::abs(rotation[1]) * s.halfExtents.y +
+                glm::abs(rotation[2]) * s.halfExtents.z;
+    }
+    reach += glm::vec3(PHYSICS_CONTACT_MARGIN);
+    body.bounds.min = body.position - reach;
+    body.bounds.max = body.position + reach;
+    // Bounds that overlap nothing keep a disabled body out of the grid's queries
+    if (!body.enabled) body.bounds = AABB();
+}
+
+/**
+ * @brief Broad phase: overlapping bounds of bodies, and of bodies and level boxes
+ *
+ * Only pairs with something moving are kept: an awake dynamic body, or a
+ * kinematic body that is being moved. Each pair of two such bodies is kept
+ * once, from its lower id. Bodies of the same group are not paired.
+ */
+void PhysicsWorld::findPairs() {
+    auto moving = [&](const Body& body) {
+        return body.enabled && (body.kinematic ? body.linearVelocity != glm::vec3(0.0f) : body.awake);
+    };
+    bodyBounds.resize(bodies.size());
+    for (size_t i = 0; i < bodies.size(); i++) bodyBounds[i] = bodies[i].bounds;
+    bodyGrid.build(bodyBounds, PHYSICS_GRID_CELL_SIZE);
+
+    pairs.clear();
+    for (BodyId i = 0; i < bodies.size(); i++) {
+        const Body& body = bodies[i];
+        if (!moving(body)) continue;
+        bodyGrid.query(body.bounds, [&](uint32_t j) {
+            if (j == i) return;
+            const Body& other = bodies[j];
+            if (body.kinematic && other.kinematic) return;
+            if (body.group != 0 && body.group == other.group) return;
+            if (moving(other) && j < i) return;
+            uint64_t key = uint64_t(std::min(i, j)) << 32 | std::max(i, j);
+            if (!jointed.empty() && jointed.count(key)) return;
+            pairs.emplace_back(i, j);
+        });
+        if (level && !body.kinematic) {
+            level->grid().query(body.bounds, [&](uint32_t collider) {
+                if (!level->enabled(collider)) return;
+                pairs.emplace_back(i, PHYSICS_LEVEL_COLLIDER | collider);
+            });
+        }
+    }
+}
+
+/**
+ * @brief Narrow phase over all pairs, spread over the job system
+ *
+ * Each contact takes the impulses of the previous step's contact with the
+ * same feature, if the pair touched then.
+ */
+void PhysicsWorld::collidePairs(JobSystem* jobs) {
+    manifolds.resize(pairs.size());
+    auto collide = [&](size_t begin, size_t end) {
+        Contact found[MAX_MANIFOLD_CONTACTS];
+        for (size_t i = begin; i < end; i++) {
+            BodyId a = pairs[i].first, b = pairs[i].second;
+            const Body& first = bodies[a];
+            ShapeFrame frameA = frameOf(first.shape, first.position, first.orientation);
+            ShapeFrame frameB;
+            Manifold& m = manifolds[i];
+            m.a = a;
+            m.b = b;
+            if (b & PHYSICS_LEVEL_COLLIDER) {
+                frameB = frameOf(level->collider(b & ~PHYSICS_LEVEL_COLLIDER));
+                m.friction = std::sqrt(first.friction * PHYSICS_LEVEL_FRICTION);
+                m.restitution = first.restitution;
+            } else {
+                const Body& second = bodies[b];
+                frameB = frameOf(second.shape, second.position, second.orientation);
+                m.friction = std::sqrt(first.friction * second.friction);
+                m.restitution = std::max(first.restitution, second.restitution);
+            }
+
+            int count = collideShapes(frameA, frameB, found);
+            m.count = count;
+
+            auto last = previous.find(uint64_t(a) << 32 | b);
+            const Manifold* before = last == previous.end() ? nullptr : &previousManifolds[last->second];
+            for (int c = 0; c < count; c++) {
+                Contact& contact = m.contacts[c] = found[c];
+                if (!before) continue;
+                for (int k = 0; k < before->count; k++) {
+                    if (before->contacts[k].feature != contact.feature) continue;
+                    contact.normalImpulse = before->contacts[k].normalImpulse;
+                    contact.tangentImpulse[0] = before->contacts[k].tangentImpulse[0];
+                    contact.tangentImpulse[1] = before->contacts[k].tangentImpulse[1];
+                    break;
+                }
+            }
+        }
+    };
+    if (jobs) jobs->parallelFor(pairs.size(), 16, collide);
+    else collide(0, pairs.size());
+}
+
+/**
+ * @brief Wake sleeping islands touched by something moving, or joined to an awake body
+ *
+ * @return bool Whether any island woke
+ */
+bool PhysicsWorld::wakeTouched() {
+    bool woke = false;
+    auto sleeping = [&](BodyId id) {
+        return id != PHYSICS_WORLD && !(id & PHYSICS_LEVEL_COLLIDER) && bodies[id].enabled && !bodies[id].kinematic &&
+               !bodies[id].awake;
+    };
+    auto rouse = [&](BodyId sleeper) {
+        bodies[sleeper].awake = true;
+        bodies[sleeper].sleepTime = 0.0f;
+        wakeIsland(bodies[sleeper].island);
+        woke = true;
+    };
+    for (const Manifold& m : manifolds) {
+        if (m.count == 0) continue;
+        if (sleeping(m.a)) rouse(m.a);
+        if (sleeping(m.b)) rouse(m.b);
+    }
+    for (const Joint& joint : joints) {
+        if (!joint.enabled) continue;
+        bool awakeA = joint.a != PHYSICS_WORLD && bodies[joint.a].awake && !bodies[joint.a].kinematic;
+        bool awakeB = joint.b != PHYSICS_WORLD && bodies[joint.b].awake && !bodies[joint.b].kinematic;
+        if (awakeA && sleeping(joint.b)) rouse(joint.b);
+        if (awakeB && sleeping(joint.a)) rouse(joint.a);
+    }
+    return woke;
+}
+
+/**
+ * @brief Wake every body that fell asleep as part of an island
+ */
+void PhysicsWorld::wakeIsland(uint32_t island) {
+    if (island == 0) return;
+    for (Body& body : bodies) {
+        if (body.island == island && !body.awake) {
+            body.awake = true;
+            body.sleepTime = 0.0f;
+        }
+    }
+}
+
+/**
+ * @brief Group awake dynamic bodies joined by contacts or joints
+ *
+ * Level boxes, kinematic bodies and the world do not join islands: they are
+ * only read while solving, so two islands may touch the same one.
+ */
+void PhysicsWorld::buildIslands() {
+    auto dynamic = [&](BodyId id) {
+        return id != PHYSICS_WORLD && !(id & PHYSICS_LEVEL_COLLIDER) && bodies[id].enabled && !bodies[id].kinematic &&
+               bodies[id].awake;
+    };
+    islandParent.resize(bodies.size());
+    for (uint32_t i = 0; i < bodies.size(); i++) islandParent[i] = i;
+    auto find = [&](uint32_t x) {
+        while (islandParent[x] != x) x = islandParent[x] = islandParent[islandParent[x]];
+        return x;
+    };
+    auto unite = [&](BodyId a, BodyId b) {
+        if (dynamic(a) && dynamic(b)) islandParent[find(a)] = find(b);
+    };
+    for (const Manifold& m : manifolds) {
+        if (m.count > 0) unite(m.a, m.b);
+    }
+    for (const Joint& joint : joints) {
+        if (joint.enabled) unite(joint.a, joint.b);
+    }
+
+    // Islands are reused with their vectors' capacity, so a steady scene allocates nothing here
+    islandCount = 0;
+    islandSlot.assign(bodies.size(), UINT32_MAX);
+    for (BodyId i = 0; i < bodies.size(); i++) {
+        if (!dynamic(i)) continue;
+        uint32_t root = find(i);
+        if (islandSlot[root] == UINT32_MAX) {
+            islandSlot[root] = static_cast<uint32_t>(islandCount);
+            if (islandCount == islands.size()) islands.emplace_back();
+            Island& island = islands[islandCount++];
+            island.bodies.clear();
+            island.manifolds.clear();
+            island.joints.clear();
+        }
+        islands[islandSlot[root]].bodies.push_back(i);
+    }
+    auto islandOf = [&](BodyId a, BodyId b) {
+        return dynamic(a) ? islandSlot[find(a)] : (dynamic(b) ? islandSlot[find(b)] : UINT32_MAX);
+    };
+    for (uint32_t i = 0; i < manifolds.size(); i++) {
+        uint32_t island = manifolds[i].count > 0 ? islandOf(manifolds[i].a, manifolds[i].b) : UINT32_MAX;
+        if (island != UINT32_MAX) islands[island].manifolds.push_back(i);
+    }
+    for (uint32_t i = 0; i < joints.size(); i++) {
+        uint32_t island = joints[i].enabled ? islandOf(joints[i].a, joints[i].b) : UINT32_MAX;
+        if (island != UINT32_MAX) islands[island].joints.push_back(i);
+    }
+
+    // Biggest first, so the job system does not end on a long island
+    std::sort(islands.begin(), islands.begin() + islandCount,
+              [](const Island& x, const Island& y) { return x.bodies.size() > y.bodies.size(); });
+    for (size_t i = 0; i < islandCount; i++) {
+        uint32_t id = nextIsland++;
+        if (nextIsland == 0) nextIsland = 1;
+        for (BodyId body : islands[i].bodies) bodies[body].island = id;
+    }
+}
+
+/**
+ * @brief Integrate, solve and move one island, and put it to sleep if it has settled
+ *
+ * Only this island's dynamic bodies are written, so islands can be solved
+ * at the same time.
+ */
+void PhysicsWorld::solveIsland(Island& island, float dt) {
+    auto solverBody = [&](BodyId id) -> Body* {
+        return id == PHYSICS_WORLD || (id & PHYSICS_LEVEL_COLLIDER) ? nullptr : &bodies[id];
+    };
+    auto velocityAt = [](const Body* body, const glm::vec3& r) {
+        return body ? body->linearVelocity + glm::cross(body->angularVelocity, r) : glm::vec3(0.0f);
+    };
+    auto angularVelocity = [](const Body* body) { return body ? body->angularVelocity : glm::vec3(0.0f); };
+    auto massAlong = [](const Body* body, const glm::vec3& r, const glm::vec3& n) {
+        if (!body || body->invMass == 0.0f) return 0.0f;
+        glm::vec3 rn = glm::cross(r, n);
+        return body->invMass + glm::dot(rn, body->invInertia * rn);
+    };
+    auto turnAlong = [](const Body* body, const glm::vec3& n) {
+        return body && body->invMass != 0.0f ? glm::dot(n, body->invInertia * n) : 0.0f;
+    };
+    auto push = [](Body* body, const glm::vec3& impulse, const glm::vec3& r) {
+        if (!body || body->invMass == 0.0f) return;
+        body->linearVelocity += impulse * body->invMass;
+        body->angularVelocity += body->invInertia * glm::cross(r, impulse);
+    };
+    auto twist = [](Body* body, const glm::vec3& impulse) {
+        if (!body || body->invMass == 0.0f) return;
+        body->angularVelocity += body->invInertia * impulse;
+    };
+    auto inverse = [](float k) { return k > 0.0f ? 1.0f / k : 0.0f; };
+
+    for (BodyId id : island.bodies) {
+        Body& body = bodies[id];
+        body.linearVelocity += gravity * dt;
+        body.linearVelocity *= 1.0f / (1.0f + dt * PHYSICS_LINEAR_DAMPING);
+        body.angularVelocity *= 1.0f / (1.0f + dt * PHYSICS_ANGULAR_DAMPING);
+    }
+
+    // Contacts: effective masses, target velocities, warm start
+    for (uint32_t index : island.manifolds) {
+        Manifold& m = manifolds[index];
+        Body* a = solverBody(m.a);
+        Body* b = solverBody(m.b);
+        for (int i = 0; i < m.count; i++) {
+            Contact& c = m.contacts[i];
+            c.rA = a ? c.point - a->position : glm::vec3(0.0f);
+            c.rB = b ? c.point - b->position : glm::vec3(0.0f);
+            c.tangent[0] = anyPerpendicular(c.normal);
+            c.tangent[1] = glm::cross(c.normal, c.tangent[0]);
+            c.normalMass = inverse(massAlong(a, c.rA, c.normal) + massAlong(b, c.rB, c.normal));
+            for (int t = 0; t < 2; t++) {
+                c.tangentMass[t] = inverse(massAlong(a, c.rA, c.tangent[t]) + massAlong(b, c.rB, c.tangent[t]));
+            }
+            float approach = glm::dot(c.normal, velocityAt(b, c.rB) - velocityAt(a, c.rA));
+            c.bias = c.depth > 0.0f ? PHYSICS_BAUMGARTE * std::max(c.depth - PHYSICS_PENETRATION_SLOP, 0.0f) / dt
+                                    : c.depth / dt;
+            if (approach < -PHYSICS_BOUNCE_SPEED) c.bias = std::max(c.bias, -m.restitution * approach);
+        }
+    }
+    // Only after every bounce is measured, or the load on a stack would read as an impact
+    for (uint32_t index : island.manifolds) {
+        Manifold& m = manifolds[index];
+        Body* a = solverBody(m.a);
+        Body* b = solverBody(m.b);
+        for (int i = 0; i < m.count; i++) {
+            const Contact& c = m.contacts[i];
+            glm::vec3 impulse = c.normal * c.normalImpulse + c.tangent[0] * c.tangentImpulse[0] +
+                                c.tangent[1] * c.tangentImpulse[1];
+            push(a, -impulse, c.rA);
+            push(b, impulse, c.rB);
+        }
+    }
+
+    // Joints
+    const glm::vec3 worldAxes[3] = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
+    for (uint32_t index : island.joints) {
+        Joint& h = joints[index];
+        Body* a = solverBody(h.a);
+        Body* b = solverBody(h.b);
+        glm::vec3 positionA = a ? a->position : glm::vec3(0.0f), positionB = b ? b->position : glm::vec3(0.0f);
+        glm::quat rotationA = a ? a->orientation : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::quat rotationB = b ? b->orientation : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        h.rA = rotationA * h.localPivotA;
+        h.rB = rotationB * h.localPivotB;
+        h.error = (positionB + h.rB) - (positionA + h.rA);
+        for (int k = 0; k < 3; k++) {
+            h.pointMass[k] = inverse(massAlong(a, h.rA, worldAxes[k]) + massAlong(b, h.rB, worldAxes[k]));
+        }
+
+        glm::vec3 angular;
+        if (h.type == JointType::Cone) {
+            // The limit acts about the axis the two axes bend apart on; friction acts every way
+            glm::vec3 axisA = glm::normalize(rotationA * h.localAxisA), axisB = glm::normalize(rotationB * h.localAxisB);
+            glm::vec3 bend = glm::cross(axisA, axisB);
+            float bent = glm::length(bend);
+            h.angle = std::atan2(bent, glm::dot(axisA, axisB));
+            h.axis = bent > 1e-6f ? bend / bent : anyPerpendicular(axisA);
+            h.axialMass = inverse(turnAlong(a, h.axis) + turnAlong(b, h.axis));
+            h.limitSign = -1.0f;
+            for (int k = 0; k < 3; k++) {
+                h.frictionMass[k] = inverse(turnAlong(a, worldAxes[k]) + turnAlong(b, worldAxes[k]));
+            }
+            angular = h.axis * (h.limitSign * h.limitImpulse) + worldAxes[0] * h.frictionImpulse[0] +
+                      worldAxes[1] * h.frictionImpulse[1] + worldAxes[2] * h.frictionImpulse[2];
+        } else {
+            h.axis = glm::normalize(rotationA * h.localAxisA);
+            glm::vec3 axisB = glm::normalize(rotationB * h.localAxisB);
+            h.swing[0] = anyPerpendicular(h.axis);
+            h.swing[1] = glm::cross(h.axis, h.swing[0]);
+            for (int k = 0; k < 2; k++) h.swingMass[k] = inverse(turnAlong(a, h.swing[k]) + turnAlong(b, h.swing[k]));
+            h.axialMass = inverse(turnAlong(a, h.axis) + turnAlong(b, h.axis));
+            h.frictionMass[0] = h.axialMass;
+            h.swingError = glm::cross(h.axis, axisB);
+            glm::vec3 referenceA = rotationA * h.localReferenceA, referenceB = rotationB * h.localReferenceB;
+            h.angle = std::atan2(glm::dot(glm::cross(referenceA, referenceB), h.axis), glm::dot(referenceA, referenceB));
+
+            // The nearer limit is the one that can act this step
+            float limitSign = h.angle - h.minAngle < h.maxAngle - h.angle ? 1.0f : -1.0f;
+            if (limitSign != h.limitSign) h.limitImpulse = 0.0f;
+            h.limitSign = limitSign;
+            angular = h.swing[0] * h.swingImpulse[0] + h.swing[1] * h.swingImpulse[1] +
+                      h.axis * (h.limitSign * h.limitImpulse + h.frictionImpulse[0]);
+        }
+
+        glm::vec3 point = worldAxes[0] * h.pointImpulse[0] + worldAxes[1] * h.pointImpulse[1] +
+                          worldAxes[2] * h.pointImpulse[2];
+        push(a, -point, h.rA);
+        push(b, point, h.rB);
+        twist(a, -angular);
+        twist(b, angular);
+    }
+
+    for (int iteration = 0; iteration < PHYSICS_ITERATIONS; iteration++) {
+        for (uint32_t index : island.joints) {
+            Joint& h = joints[index];
+            Body* a = solverBody(h.a);
+            Body* b = solverBody(h.b);
+
+            // Friction about the hinge's axis, or about every axis for a cone
+            float maxFriction = h.friction * dt;
+            int frictionAxes = h.type == JointType::Cone ? 3 : 1;
+            for (int k = 0; k < frictionAxes; k++) {
+                glm::vec3 axis = h.type == JointType::Cone ? worldAxes[k] : h.axis;
+                float spin = glm::dot(axis, angularVelocity(b) - angularVelocity(a));
+                float old = h.frictionImpulse[k];
+                h.frictionImpulse[k] = glm::clamp(old - spin * h.frictionMass[k], -maxFriction, maxFriction);
+                twist(a, -axis * (h.frictionImpulse[k] - old));
+                twist(b, axis * (h.frictionImpulse[k] - old));
+            }
+
+            // Angle limit, speculative like contacts
+            if (h.minAngle < h.maxAngle) {
+                float gap = h.limitSign > 0.0f ? h.angle - h.minAngle : h.maxAngle - h.angle;
+                float bias = gap < 0.0f ? PHYSICS_BAUMGARTE * gap / dt : gap / dt;
+                float spin = h.limitSign * glm::dot(h.axis, angularVelocity(b) - angularVelocity(a));
+                float old = h.limitImpulse;
+                h.limitImpulse = std::max(old - (spin + bias) * h.axialMass, 0.0f);
+                glm::vec3 impulse = h.axis * (h.limitSign * (h.limitImpulse - old));
+                twist(a, -impulse);
+                twist(b, impulse);
+            }
+
+            // Keep a hinge's axes aligned
+            for (int k = 0; h.type == JointType::Hinge && k < 2; k++) {
+                float rate = glm::dot(h.swing[k], angularVelocity(b) - angularVelocity(a));
+                float lambda = -(rate + PHYSICS_BAUMGARTE * glm::dot(h.swing[k], h.swingError) / dt) * h.swingMass[k];
+                h.swingImpulse[k] += lambda;
+                twist(a, -h.swing[k] * lambda);
+                twist(b, h.swing[k] * lambda);
+            }
+
+            // Keep the pivots together
+            for (int k = 0; k < 3; k++) {
+                float rate = glm::dot(worldAxes[k], velocityAt(b, h.rB) - velocityAt(a, h.rA));
+                float lambda = -(rate + PHYSICS_BAUMGARTE * h.error[k] / dt) * h.pointMass[k];
+                h.pointImpulse[k] += lambda;
+                push(a, -worldAxes[k] * lambda, h.rA);
+                push(b, worldAxes[k] * lambda, h.rB);
+            }
+        }
+
+        for (uint32_t index : island.manifolds) {
+            Manifold& m = manifolds[index];
+            Body* a = solverBody(m.a);
+            Body* b = solverBody(m.b);
+            for (int i = 0; i < m.count; i++) {
+                Contact& c = m.contacts[i];
+                for (int t = 0; t < 2; t++) {
+                    float slide = glm::dot(c.tangent[t], velocityAt(b, c.rB) - velocityAt(a, c.rA));
+                    float limit = m.friction * c.normalImpulse;
+                    float old = c.tangentImpulse[t];
+                    c.tangentImpulse[t] = glm::clamp(old - slide * c.tangentMass[t], -limit, limit);
+                    glm::vec3 impulse = c.tangent[t] * (c.tangentImpulse[t] - old);
+                    push(a, -impulse, c.rA);
+                    push(b, impulse, c.rB);
+                }
+                float approach = glm::dot(c.normal, velocityAt(b, c.rB) - velocityAt(a, c.rA));
+                float old = c.normalImpulse;
+                c.normalImpulse = std::max(old - (approach - c.bias) * c.normalMass, 0.0f);
+                glm::vec3 impulse = c.normal * (c.normalImpulse - old);
+                push(a, -impulse, c.rA);
+                push(b, impulse, c.rB);
+            }
+        }
+    }
+
+    // Move, then sleep if every body has been still long enough
+    float stillFor = PHYSICS_SLEEP_TIME;
+    const float sleepSpeed2 = PHYSICS_SLEEP_SPEED * PHYSICS_SLEEP_SPEED;
+    for (BodyId id : island.bodies) {
+        Body& body = bodies[id];
+        body.position += body.linearVelocity * dt;
+        glm::vec3 w = body.angularVelocity;
+        body.orientation = glm::normalize(body.orientation + glm::quat(0.0f, w.x, w.y, w.z) * body.orientation * (0.5f * dt));
+        refreshBody(body);
+
+        bool still = glm::dot(body.linearVelocity, body.linearVelocity) < sleepSpeed2 &&
+                     glm::dot(w, w) < sleepSpeed2;
+        body.sleepTime = still ? body.sleepTime + dt : 0.0f;
+        stillFor = std::min(stillFor, body.sleepTime);
+    }
+    if (stillFor >= PHYSICS_SLEEP_TIME) {
+        for (BodyId id : island.bodies) {
+            Body& body = bodies[id];
+            body.awake = false;
+            body.linearVelocity = glm::vec3(0.0f);
+            body.angularVelocity = glm::vec3(0.0f);
+        }
+    }
+}
+
+/**
+ * @brief Push a body, waking it and its island
+ *
+ * @param impulse World-space impulse in N·s
+ * @param point World-space point it is applied at
+ */
+void PhysicsWorld::applyImpulse(BodyId id, const glm::vec3& impulse, const glm::vec3& point) {
+    Body& body = bodies[id];
+    if (body.kinematic || !body.enabled) return;
+    wake(id);
+    body.linearVelocity += impulse * body.invMass;
+    body.angularVelocity += body.invInertia * glm::cross(point - body.position, impulse);
+}
+
+/**
+ * @brief Set a body's velocity outright, waking it and its island
+ */
+void PhysicsWorld::setVelocity(BodyId id, const glm::vec3& linear, const glm::vec3& angular) {
+    Body& body = bodies[id];
+    if (body.kinematic || !body.enabled) return;
+    wake(id);
+    body.linearVelocity = linear;
+    body.angularVelocity = angular;
+}
+
+/**
+ * @brief Move a kinematic body to a position over the next update
+ */
+void PhysicsWorld::moveKinematic(BodyId id, const glm::vec3& target) {
+    bodies[id].target = target;
+    bodies[id].hasTarget = true;
+}
+
+/**
+ * @brief Wake a body and the island it fell asleep in
+ */
+void PhysicsWorld::wake(BodyId id) {
+    Body& body = bodies[id];
+    if (body.kinematic || !body.enabled) return;
+    wakeIsland(body.island);
+    body.awake = true;
+    body.sleepTime = 0.0f;
+}
+
+/**
+ * @brief Nearest dynamic body hit by a ray
+ *
+ * @param dir Normalized direction
+ * @param body Set to the body hit
+ * @param distance Set to the distance along the ray
+ *
+ * Capsules are tested as their bounding box in their own frame, which is
+ * close enough for picking.
+ */
+bool PhysicsWorld::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, BodyId& body,
+                           float& distance) const {
+    bool found = false;
+    distance = maxDist;
+    for (BodyId id = 0; id < bodies.size(); id++) {
+        const Body& candidate = bodies[id];
+        if (candidate.kinematic || !candidate.enabled) continue;
+        const CollisionShape& s = candidate.shape;
+        float hit = -1.0f;
+        if (s.type == ShapeType::Sphere) {
+            glm::vec3 m = origin - candidate.position;
+            float b = glm::dot(m, dir);
+            float c = glm::dot(m, m) - s.radius * s.radius;
+            float discriminant = b * b - c;
+            // Outside and pointing away, or the line only passes the sphere behind the origin
+            if (discriminant >= 0.0f && !(c > 0.0f && b > 0.0f) && -b + std::sqrt(discriminant) >= 0.0f) {
+                hit = c > 0.0f ? -b - std::sqrt(discriminant) : 0.0f;  // 0 from inside
+            }
+        } else {
+            glm::vec3 half = s.type == ShapeType::Box ? s.halfExtents
+                                                      : glm::vec3(s.radius, s.halfHeight + s.radius, s.radius);
+            glm::quat toLocal = glm::inverse(candidate.orientation);
+            glm::vec3 localOrigin = toLocal * (origin - candidate.position);
+            glm::vec3 invDir = 1.0f / (toLocal * dir);
+            glm::vec3 t0 = (-half - localOrigin) * invDir, t1 = (half - localOrigin) * invDir;
+            glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+            float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+            float exit = std::min(std::min(far.x, far.y), far.z);
+            if (enter <= exit) hit = enter;
+        }
+        if (hit >= 0.0f && hit < distance) {
+            distance = hit;
+            body = id;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Print the last step's counters
+ */
+void PhysicsWorld::report(std::ostream& out) const {
+    out << "Physics: " << lastStats.awake << "/" << lastStats.bodies << " bodies awake, " << lastStats.pairs
+        << " pairs, " << lastStats.contacts << " contacts, " << lastStats.islands << " islands (largest "
+        << lastStats.largestIsland << "), " << lastStats.seconds * 1e3 << " ms" << std::endl;
+}
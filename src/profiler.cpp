@@ -0,0 +1,127 @@
+#include "profiler.h"
+#include <algorithm>
+#include <iomanip>
+
+/**
+ * @brief Weight of the newest sample in the exponential averages
+ */
+const float PROFILER_SMOOTHING = 0.05f;
+
+/**
+ * @brief Destructor for GpuTimer
+ */
+GpuTimer::~GpuTimer() {
+    if (queries[0]) glDeleteQueries(QUERY_COUNT * 2, queries);
+}
+
+/**
+ * @brief Create the query objects
+ */
+void GpuTimer::create() {
+    glGenQueries(QUERY_COUNT * 2, queries);
+}
+
+/**
+ * @brief Start timing the following GL commands
+ *
+ * Collects the result of the query about to be reused first. If the GPU is
+ * still more than QUERY_COUNT frames behind, that sample is dropped rather
+ * than waited for.
+ */
+void GpuTimer::begin() {
+    if (pending[current]) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[current * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(queries[current * 2], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries[current * 2 + 1], GL_QUERY_RESULT, &end);
+            averageMs += ((end - start) / 1.0e6f - averageMs) * PROFILER_SMOOTHING;
+        }
+        pending[current] = false;
+    }
+    glQueryCounter(queries[current * 2], GL_TIMESTAMP);
+}
+
+/**
+ * @brief Stop timing and advance to the next query in the ring
+ */
+void GpuTimer::end() {
+    glQueryCounter(queries[current * 2 + 1], GL_TIMESTAMP);
+    pending[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
+
+/**
+ * @brief Mark the start of a frame
+ */
+void FrameProfiler::beginFrame() {
+    frameStart = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Mark the end of the frame's CPU work, before the swap
+ */
+void FrameProfiler::endWork() {
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+    averageWorkMs += (elapsed.count() - averageWorkMs) * PROFILER_SMOOTHING;
+}
+
+/**
+ * @brief Mark the end of a frame and update the frame time average
+ */
+void FrameProfiler::endFrame() {
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+    latestFrameMs = elapsed.count();
+    averageFrameMs += (latestFrameMs - averageFrameMs) * PROFILER_SMOOTHING;
+}
+
+/**
+ * @brief Recent average cost of a frame without the swap wait
+ *
+ * @return float The CPU work time or the frame timer's GPU time, whichever is longer
+ */
+float FrameProfiler::workMs() const {
+    float gpuMs = frameGpu ? frameGpu->milliseconds() : 0.0f;
+    return std::max(averageWorkMs, gpuMs);
+}
+
+/**
+ * @brief Find or create a named section
+ *
+ * @param name Section name shown in reports
+ * @return int Handle used with addCpuSample() and attachGpuTimer()
+ */
+int FrameProfiler::section(const std::string& name) {
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (sections[i].name == name) return static_cast<int>(i);
+    }
+    sections.push_back({name});
+    return static_cast<int>(sections.size() - 1);
+}
+
+/**
+ * @brief Add a CPU time sample to a section
+ */
+void FrameProfiler::addCpuSample(int section, float ms) {
+    sections[section].cpuMs += (ms - sections[section].cpuMs) * PROFILER_SMOOTHING;
+}
+
+/**
+ * @brief Report a GPU timer's result under a section
+ */
+void FrameProfiler::attachGpuTimer(int section, GpuTimer* timer) {
+    sections[section].gpu = timer;
+}
+
+/**
+ * @brief Print the averaged frame and section timings
+ */
+void FrameProfiler::report(std::ostream& out) const {
+    out << std::fixed << std::setprecision(2) << "frame " << averageFrameMs << " ms, work " << workMs() << " ms";
+    for (const Section& s : sections) {
+        out << " | " << s.name << " cpu " << s.cpuMs;
+        if (s.gpu) out << " gpu " << s.gpu->milliseconds();
+    }
+    out << std::endl;
+}
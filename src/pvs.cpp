@@ -0,0 +1,268 @@
+#include "pvs.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "collision.h"
+#include "job_system.h"
+
+const uint32_t PVS_FILE_MAGIC = 0x56504D45;    // "EMPV"
+const uint32_t PVS_FILE_VERSION = 1;
+const size_t PVS_HEADER_BYTES = 48;             // Six uint32 (magic, version, cells x/z, row words, rows), six floats
+
+const int PVS_MAX_CELLS = 1 << 16;
+
+namespace {
+
+struct PvsHeader {
+    uint32_t magic, version;
+    uint32_t cellsX, cellsZ;
+    uint32_t rowWords, rowCount;
+    float origin[3];
+    float cellSize;
+    float margin;
+    float reserved;
+};
+static_assert(sizeof(PvsHeader) == PVS_HEADER_BYTES, "PVS header layout");
+
+size_t rowIndexBytes(size_t cells) {
+    return (cells * sizeof(uint32_t) + 7) & ~static_cast<size_t>(7);  // Rows start 8-byte aligned
+}
+
+/**
+ * @brief Small, fast generator for sample points; one per cell pair keeps the bake deterministic
+ */
+struct SampleRng {
+    uint64_t state;
+    float next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<float>(state >> 40) / 16777216.0f;
+    }
+};
+
+} // namespace
+
+/**
+ * @brief Bake cell-to-cell visibility into the bytes of a ".pvs" file
+ *
+ * @param world Static occluders; dynamic objects must not be in it
+ * @param options Grid and sampling parameters
+ * @param jobs Job system to spread source cells over, or nullptr
+ * @param out Receives the file contents
+ * @param error Set on failure
+ * @return bool Whether the options were usable
+ */
+bool PotentiallyVisibleSet::bake(const CollisionWorld& world, const PvsBakeOptions& options, JobSystem* jobs,
+                                 std::vector<unsigned char>& out, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    glm::vec3 extent = options.bounds.extent();
+    if (!options.bounds.valid() || options.cellSize <= 0.0f) {
+        error = "invalid bounds or cell size";
+        return false;
+    }
+    int cellsX = std::max(1, static_cast<int>(std::ceil(extent.x / options.cellSize)));
+    int cellsZ = std::max(1, static_cast<int>(std::ceil(extent.z / options.cellSize)));
+    int cells = cellsX * cellsZ;
+    if (cells > PVS_MAX_CELLS) {
+        error = std::to_string(cells) + " cells; at most " + std::to_string(PVS_MAX_CELLS) + " are supported";
+        return false;
+    }
+    size_t rowWords = (static_cast<size_t>(cells) + 63) / 64;
+    std::vector<uint64_t> matrix(static_cast<size_t>(cells) * rowWords, 0);
+    auto set = [&](int from, int to) { matrix[from * rowWords + (to >> 6)] |= uint64_t(1) << (to & 63); };
+
+    const glm::vec3 origin = options.bounds.min;
+    auto pairVisible = [&](int a, int b) {
+        glm::vec2 cornerA(origin.x + (a % cellsX) * options.cellSize - options.margin,
+                          origin.z + (a / cellsX) * options.cellSize - options.margin);
+        glm::vec2 cornerB(origin.x + (b % cellsX) * options.cellSize - options.margin,
+                          origin.z + (b / cellsX) * options.cellSize - options.margin);
+        float grownSize = options.cellSize + 2.0f * options.margin;
+        float low = origin.y + options.sampleLow;
+        float band = options.sampleHigh - options.sampleLow;
+
+        SampleRng rng{(static_cast<uint64_t>(a) << 32 | static_cast<uint64_t>(b)) * 0x9E3779B97F4A7C15ull + 1};
+        for (int sample = 0; sample < options.samplesPerPair; sample++) {
+            glm::vec3 from(cornerA.x + rng.next() * grownSize, low + rng.next() * band,
+                           cornerA.y + rng.next() * grownSize);
+            glm::vec3 to(cornerB.x + rng.next() * grownSize, low + rng.next() * band,
+                         cornerB.y + rng.next() * grownSize);
+            glm::vec3 ray = to - from;
+            float distance = glm::length(ray);
+            CastHit hit;
+            if (distance < 1e-4f || !world.raycast(from, ray / distance, distance, hit)) return true;
+        }
+        return false;
+    };
+
+    // Both cells are grown, so a pair's result holds in either direction and is mirrored below.
+    // Each job fills the upper triangle of its own rows, so no two jobs write the same word
+    auto bakeRows = [&](size_t begin, size_t end) {
+        for (size_t from = begin; from < end; from++) {
+            int a = static_cast<int>(from);
+            set(a, a);
+            for (int b = a + 1; b < cells; b++) {
+                if (pairVisible(a, b)) set(a, b);
+            }
+        }
+    };
+    if (jobs) jobs->parallelFor(cells, 1, bakeRows);
+    else bakeRows(0, cells);
+
+    size_t visiblePairs = 0;
+    for (int a = 0; a < cells; a++) {
+        for (int b = a + 1; b < cells; b++) {
+            if ((matrix[a * rowWords + (b >> 6)] >> (b & 63)) & 1u) {
+                set(b, a);
+                visiblePairs++;
+            }
+        }
+    }
+
+    // Store each distinct row once
+    std::map<std::vector<uint64_t>, uint32_t> distinct;
+    std::vector<uint32_t> index(cells);
+    std::vector<uint64_t> rowData;
+    for (int cell = 0; cell < cells; cell++) {
+        std::vector<uint64_t> row(matrix.begin() + cell * rowWords, matrix.begin() + (cell + 1) * rowWords);
+        auto found = distinct.find(row);
+        if (found == distinct.end()) {
+            found = distinct.emplace(row, static_cast<uint32_t>(distinct.size())).first;
+            rowData.insert(rowData.end(), row.begin(), row.end());
+        }
+        index[cell] = found->second;
+    }
+
+    PvsHeader header = {PVS_FILE_MAGIC, PVS_FILE_VERSION, static_cast<uint32_t>(cellsX), static_cast<uint32_t>(cellsZ),
+                        static_cast<uint32_t>(rowWords), static_cast<uint32_t>(distinct.size()),
+                        {origin.x, origin.y, origin.z}, options.cellSize, options.margin, 0.0f};
+    std::vector<unsigned char> indexBytes(rowIndexBytes(cells), 0);
+    std::memcpy(indexBytes.data(), index.data(), index.size() * sizeof(uint32_t));
+
+    const unsigned char* headerBytes = reinterpret_cast<const unsigned char*>(&header);
+    const unsigned char* rowBytes = reinterpret_cast<const unsigned char*>(rowData.data());
+    out.assign(headerBytes, headerBytes + sizeof(header));
+    out.insert(out.end(), indexBytes.begin(), indexBytes.end());
+    out.insert(out.end(), rowBytes, rowBytes + rowData.size() * sizeof(uint64_t));
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t pairs = static_cast<size_t>(cells) * (cells - 1) / 2;
+    std::cout << "Baked visibility: " << cellsX << "x" << cellsZ << " cells, "
+              << (pairs ? 100.0 * visiblePairs / pairs : 100.0) << "% of pairs visible, " << distinct.size()
+              << " distinct rows, " << out.size() << " bytes, " << seconds << " s" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Bake cell-to-cell visibility and write it to a file
+ *
+ * @param path File to write
+ */
+bool PotentiallyVisibleSet::bake(const CollisionWorld& world, const PvsBakeOptions& options, JobSystem* jobs,
+                                 const std::string& path, std::string& error) {
+    std::vector<unsigned char> bytes;
+    if (!bake(world, options, jobs, bytes, error)) return false;
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Map a baked file and check its header
+ */
+bool PotentiallyVisibleSet::open(const std::string& path, std::string& error) {
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!attach(file.data(), file.size(), error)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Use baked data already in memory, such as a section of a mapped level file
+ *
+ * @param data Start of the data; must be 8-byte aligned and outlive this object
+ * @param size Length of the data
+ */
+bool PotentiallyVisibleSet::attach(const unsigned char* data, size_t size, std::string& error) {
+    rowIndex = nullptr;
+    rows = nullptr;
+    PvsHeader header;
+    if (size < sizeof(header) || reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+        error = "not a visibility file";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != PVS_FILE_MAGIC || header.version != PVS_FILE_VERSION) {
+        error = "not a version " + std::to_string(PVS_FILE_VERSION) + " visibility file";
+        return false;
+    }
+    size_t cells = static_cast<size_t>(header.cellsX) * header.cellsZ;
+    size_t expected = sizeof(header) + rowIndexBytes(cells) + static_cast<size_t>(header.rowCount) * header.rowWords * 8;
+    if (cells == 0 || cells > PVS_MAX_CELLS || header.rowWords != (cells + 63) / 64 || size != expected) {
+        error = "corrupt visibility file";
+        return false;
+    }
+
+    cellsX = static_cast<int>(header.cellsX);
+    cellsZ = static_cast<int>(header.cellsZ);
+    rowWords = header.rowWords;
+    rowCount = header.rowCount;
+    origin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+    cellSize = header.cellSize;
+    margin = header.margin;
+    const uint32_t* index = reinterpret_cast<const uint32_t*>(data + sizeof(header));
+    for (size_t cell = 0; cell < cells; cell++) {
+        if (index[cell] >= rowCount) {
+            error = "corrupt visibility file";
+            return false;
+        }
+    }
+    rowIndex = index;
+    rows = reinterpret_cast<const uint64_t*>(data + sizeof(header) + rowIndexBytes(cells));
+    return true;
+}
+
+/**
+ * @brief Cell containing a point, by its horizontal position
+ *
+ * @return int Cell index, or -1 outside the grid or if nothing is loaded
+ */
+int PotentiallyVisibleSet::cellAt(const glm::vec3& position) const {
+    if (!loaded()) return -1;
+    float x = (position.x - origin.x) / cellSize;
+    float z = (position.z - origin.z) / cellSize;
+    if (x < 0.0f || z < 0.0f || x >= cellsX || z >= cellsZ) return -1;
+    return static_cast<int>(z) * cellsX + static_cast<int>(x);
+}
+
+/**
+ * @brief Cell to look an object up in
+ *
+ * @param bounds World-space bounds of the object
+ * @return int The cell of its centre, or PVS_ALWAYS_VISIBLE if it reaches past that cell's baked margin
+ */
+int PotentiallyVisibleSet::objectCell(const AABB& bounds) const {
+    int cell = cellAt(bounds.center());
+    if (cell < 0) return PVS_ALWAYS_VISIBLE;
+    float minX = origin.x + (cell % cellsX) * cellSize - margin;
+    float minZ = origin.z + (cell / cellsX) * cellSize - margin;
+    float size = cellSize + 2.0f * margin;
+    if (bounds.min.x < minX || bounds.min.z < minZ || bounds.max.x > minX + size || bounds.max.z > minZ + size) {
+        return PVS_ALWAYS_VISIBLE;
+    }
+    return cell;
+}
@@ -0,0 +1,450 @@
+#include "ragdoll.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+/**
+ * @brief Shortest rotation taking the unit vector `from` onto the unit vector `to`
+ */
+glm::quat rotationBetween(const glm::vec3& from, const glm::vec3& to) {
+    float cosine = glm::dot(from, to);
+    if (cosine < -0.9999f) {
+        glm::vec3 side = std::abs(from.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 axis = glm::normalize(glm::cross(from, side));
+        return glm::quat(0.0f, axis.x, axis.y, axis.z);
+    }
+    glm::vec3 axis = glm::cross(from, to);
+    return glm::normalize(glm::quat(1.0f + cosine, axis.x, axis.y, axis.z));
+}
+
+/**
+ * @brief Rotation of a matrix that may carry uniform scale
+ */
+glm::quat rotationOf(const glm::mat4& m) {
+    glm::mat3 axes(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])), glm::normalize(glm::vec3(m[2])));
+    return glm::normalize(glm::quat_cast(axes));
+}
+
+glm::mat4 rigid(const glm::vec3& position, const glm::quat& orientation) {
+    glm::mat4 m = glm::mat4_cast(orientation);
+    m[3] = glm::vec4(position, 1.0f);
+    return m;
+}
+
+float volume(const CollisionShape& shape) {
+    const float pi = 3.14159265f;
+    float r3 = shape.radius * shape.radius * shape.radius;
+    if (shape.type == ShapeType::Box) return 8.0f * shape.halfExtents.x * shape.halfExtents.y * shape.halfExtents.z;
+    if (shape.type == ShapeType::Sphere) return 4.0f / 3.0f * pi * r3;
+    return 2.0f * pi * shape.radius * shape.radius * shape.halfHeight + 4.0f / 3.0f * pi * r3;
+}
+
+} // namespace
+
+/**
+ * @brief Build bodies from a skin's joints
+ *
+ * @param nodes Scene graph of the model, with world matrices
+ * @param skin Skin whose joints become the bones
+ * @param mass Total mass in kg, shared by volume
+ *
+ * A bone with one child becomes a capsule reaching to it; one that
+ * branches, such as the hips or the chest, a box around the joints it
+ * branches to. Bones shorter than 8% of the skeleton's size, and end
+ * bones, get no body. Each body hangs from its parent's by a cone joint at
+ * its bone's origin.
+ */
+void RagdollTemplate::fromSkeleton(const std::vector<SceneNode>& nodes, const Skin& skin, float mass) {
+    bones.clear();
+    bodies.clear();
+    std::vector<int> boneOf(nodes.size(), -1);
+    for (int joint : skin.joints) boneOf[joint] = -2;
+
+    // Parents first, from every joint whose parent is not one
+    std::vector<int> stack;
+    for (auto it = skin.joints.rbegin(); it != skin.joints.rend(); ++it) {
+        int parent = nodes[*it].parent;
+        if (parent < 0 || boneOf[parent] == -1) stack.push_back(*it);
+    }
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        int parent = nodes[node].parent;
+        boneOf[node] = static_cast<int>(bones.size());
+        bones.push_back({nodes[node].name, parent >= 0 ? boneOf[parent] : -1, nodes[node].world, -1});
+        for (auto it = nodes[node].children.rbegin(); it != nodes[node].children.rend(); ++it) {
+            if (boneOf[*it] == -2) stack.push_back(*it);
+        }
+    }
+    if (bones.empty()) return;
+
+    AABB skeleton;
+    for (const RagdollBone& bone : bones) skeleton.expand(glm::vec3(bone.bind[3]));
+    glm::vec3 extent = skeleton.extent();
+    float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 0.01f));
+    float pad = size * 0.03f;
+
+    std::vector<std::vector<int>> children(bones.size());
+    for (size_t b = 0; b < bones.size(); b++) {
+        if (bones[b].parent >= 0) children[bones[b].parent].push_back(static_cast<int>(b));
+    }
+    float totalVolume = 0.0f;
+    for (size_t b = 0; b < bones.size(); b++) {
+        RagdollBone& bone = bones[b];
+        glm::vec3 origin(bone.bind[3]);
+        RagdollBody body = {};
+        body.bone = static_cast<int>(b);
+        body.parent = bone.parent >= 0 ? bones[bone.parent].body : -1;
+        body.pivot = origin;
+
+        float reach = 0.0f;
+        for (int child : children[b]) reach = std::max(reach, glm::length(glm::vec3(bones[child].bind[3]) - origin));
+        if (bone.parent >= 0 && reach < size * 0.08f) {
+            bone.body = bones[bone.parent].body;
+            continue;
+        }
+
+        // A root sitting on its only child, common in exported armatures, has no direction to lie along
+        if (children[b].size() == 1 && reach > 1e-4f) {
+            glm::vec3 toChild = glm::vec3(bones[children[b][0]].bind[3]) - origin;
+            body.axis = toChild / reach;
+            body.shape = CollisionShape::capsule(reach * 0.18f, std::max(reach * 0.5f - reach * 0.18f, 0.0f));
+            body.center = origin + toChild * 0.5f;
+            body.rotation = rotationBetween(glm::vec3(0.0f, 1.0f, 0.0f), body.axis);
+        } else if (children[b].size() <= 1) {
+            body.axis = glm::vec3(0.0f, 1.0f, 0.0f);
+            body.shape = CollisionShape::sphere(size * 0.05f);
+            body.center = origin;
+            body.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        } else {
+            // Boxed in the bone's own frame, around the joints it branches to
+            body.rotation = rotationOf(bone.bind);
+            glm::quat toBone = glm::inverse(body.rotation);
+            AABB span;
+            span.expand(glm::vec3(0.0f));
+            glm::vec3 mean(0.0f);
+            for (int child : children[b]) {
+                glm::vec3 toChild = glm::vec3(bones[child].bind[3]) - origin;
+                span.expand(toBone * toChild);
+                mean += toChild;
+            }
+            body.axis = glm::length(mean) > 1e-4f ? glm::normalize(mean) : glm::vec3(0.0f, 1.0f, 0.0f);
+            body.shape = CollisionShape::box(span.extent() * 0.5f + glm::vec3(pad));
+            body.center = origin + body.rotation * span.center();
+        }
+        bone.body = static_cast<int>(bodies.size());
+        totalVolume += volume(body.shape);
+        bodies.push_back(body);
+    }
+    for (RagdollBody& body : bodies) body.mass = mass * volume(body.shape) / totalVolume;
+}
+
+/**
+ * @brief Torso, head and legs boxes over a model without a skeleton
+ *
+ * @param modelBounds Model-space bounds of a standing figure, Y up
+ * @param mass Total mass in kg
+ *
+ * The torso is the root; the head hangs from it at the neck and the legs
+ * at the hips, each able to bend its cone's angle from upright.
+ */
+void RagdollTemplate::fromBounds(const AABB& modelBounds, float mass) {
+    struct Part {
+        const char* name;
+        float y0, y1;                       // Fractions of the height
+        float width;                        // Fraction of the width and depth
+        float share;                        // Of the mass
+        float joint;                        // Height of the joint to the torso
+    };
+    static const Part parts[] = {
+        {"torso", 0.5f, 0.85f, 0.7f, 0.55f, 0.5f},
+        {"head", 0.85f, 1.0f, 0.4f, 0.1f, 0.85f},
+        {"legs", 0.0f, 0.5f, 0.6f, 0.35f, 0.5f},
+    };
+    bones.clear();
+    bodies.clear();
+    glm::vec3 size = modelBounds.extent();
+    glm::vec3 middle = modelBounds.center();
+    for (const Part& part : parts) {
+        int index = static_cast<int>(bones.size());
+        glm::vec3 joint(middle.x, modelBounds.min.y + size.y * part.joint, middle.z);
+        bones.push_back({part.name, index == 0 ? -1 : 0, glm::translate(glm::mat4(1.0f), joint), index});
+
+        RagdollBody body = {};
+        body.bone = index;
+        body.parent = index == 0 ? -1 : 0;
+        glm::vec3 half(size.x * part.width * 0.5f, size.y * (part.y1 - part.y0) * 0.5f, size.z * part.width * 0.5f);
+        body.shape = CollisionShape::box(half);
+        body.center = glm::vec3(middle.x, modelBounds.min.y + size.y * (part.y0 + part.y1) * 0.5f, middle.z);
+        body.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        body.mass = mass * part.share;
+        body.pivot = joint;
+        body.axis = glm::normalize(body.center - joint);
+        bodies.push_back(body);
+    }
+}
+
+/**
+ * @brief Add the pool to a physics world, every body and joint disabled
+ *
+ * @param physics World the ragdolls fall in
+ * @param bodyBudget, jointBudget Most bodies and joints simulated at once
+ * @param maxRagdolls Most ragdolls, active or frozen, kept at once
+ */
+void RagdollSystem::create(PhysicsWorld* physics, size_t bodyBudget, size_t jointBudget, size_t maxRagdolls) {
+    world = physics;
+    RigidBodyDesc parked;
+    parked.shape = CollisionShape::sphere(0.1f);
+    for (size_t i = 0; i < bodyBudget; i++) {
+        BodyId body = world->addBody(parked);
+        world->setBodyEnabled(body, false);
+        freeBodies.push_back(body);
+    }
+    for (size_t i = 0; i < jointBudget; i++) {
+        uint32_t joint = world->addConeJoint(PHYSICS_WORLD, PHYSICS_WORLD, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                                             0.0f, 0.0f);
+        world->setJointEnabled(joint, false);
+        freeJoints.push_back(joint);
+    }
+    ragdolls.resize(maxRagdolls);
+    for (size_t i = maxRagdolls; i-- > 0;) freeRagdolls.push_back(static_cast<RagdollId>(i));
+    queue.reserve(maxRagdolls);
+    currentStats.bodyBudget = bodyBudget;
+    currentStats.jointBudget = jointBudget;
+}
+
+/**
+ * @brief Size every slot for a template, so spawning that kind never allocates
+ */
+void RagdollSystem::reserve(const RagdollTemplate& ragdoll) {
+    for (Ragdoll& r : ragdolls) {
+        r.bodies.reserve(ragdoll.bodies.size());
+        r.joints.reserve(ragdoll.bodies.size());
+        r.boneFromBody.reserve(ragdoll.bones.size());
+        r.pose.reserve(ragdoll.bones.size());
+    }
+}
+
+/**
+ * @brief Turn a dead monster into a ragdoll, in the pose it stood in
+ *
+ * @param ragdoll Template of its kind; must outlive the ragdoll
+ * @param transform Model matrix, rotation and uniform scale
+ * @param velocity Initial velocity of every body, such as from the killing blow
+ * @return RagdollId Handle, or NO_RAGDOLL if every slot is taken or the template has no bodies
+ *
+ * Makes room in the pool by freezing older ragdolls if needed, or waits
+ * for it. A template bigger than the whole budget spawns frozen in its
+ * bind pose.
+ */
+RagdollId RagdollSystem::spawn(const RagdollTemplate& ragdoll, const glm::mat4& transform, const glm::vec3& velocity) {
+    if (freeRagdolls.empty() || ragdoll.bones.empty() || ragdoll.bodies.empty()) return NO_RAGDOLL;
+    RagdollId id = freeRagdolls.back();
+    freeRagdolls.pop_back();
+    Ragdoll& r = ragdolls[id];
+    r.ragdoll = &ragdoll;
+    r.born = spawned++;
+    r.age = 0.0f;
+    r.transform = transform;
+    r.velocity = velocity;
+    r.pose.resize(ragdoll.bones.size());
+    for (size_t b = 0; b < ragdoll.bones.size(); b++) r.pose[b] = transform * ragdoll.bones[b].bind;
+    r.bounds = AABB();
+    for (const glm::mat4& bone : r.pose) r.bounds.expand(glm::vec3(bone[3]));
+
+    size_t jointCount = ragdoll.bodies.size() - 1;
+    r.frozen = ragdoll.bodies.size() > currentStats.bodyBudget || jointCount > currentStats.jointBudget;
+    r.waiting = false;
+    if (r.frozen) {
+        currentStats.frozen++;
+    } else if (!queue.empty() || !activate(r, id)) {
+        r.waiting = true;
+        queue.push_back(id);
+        currentStats.waiting++;
+    }
+    return id;
+}
+
+/**
+ * @brief Take bodies and joints from the pool for a ragdoll and place them in its pose
+ *
+ * @return bool False, with nothing taken, if no room could be made
+ */
+bool RagdollSystem::activate(Ragdoll& r, RagdollId id) {
+    const RagdollTemplate& ragdoll = *r.ragdoll;
+    size_t jointCount = ragdoll.bodies.empty() ? 0 : ragdoll.bodies.size() - 1;
+    if (!makeRoom(ragdoll.bodies.size(), jointCount)) return false;
+
+    const glm::mat4& transform = r.transform;
+    glm::quat rotation = rotationOf(transform);
+    float scale = glm::length(glm::vec3(transform[0]));
+    r.bodies.clear();
+    r.joints.clear();
+    for (const RagdollBody& part : ragdoll.bodies) {
+        RigidBodyDesc desc;
+        desc.shape = part.shape;
+        desc.shape.halfExtents *= scale;
+        desc.shape.radius *= scale;
+        desc.shape.halfHeight *= scale;
+        desc.position = glm::vec3(transform * glm::vec4(part.center, 1.0f));
+        desc.orientation = rotation * part.rotation;
+        desc.mass = part.mass;
+        desc.friction = 0.8f;
+        desc.restitution = 0.0f;
+        desc.group = RAGDOLL_GROUP_BASE + id;
+        BodyId body = freeBodies.back();
+        freeBodies.pop_back();
+        world->resetBody(body, desc);
+        world->setVelocity(body, r.velocity, glm::vec3(0.0f));
+        r.bodies.push_back(body);
+
+        if (part.parent < 0) continue;
+        uint32_t joint = freeJoints.back();
+        freeJoints.pop_back();
+        world->resetConeJoint(joint, r.bodies[part.parent], body, glm::vec3(transform * glm::vec4(part.pivot, 1.0f)),
+                              rotation * part.axis, ragdoll.coneAngle, ragdoll.jointFriction);
+        r.joints.push_back(joint);
+    }
+
+    r.boneFromBody.resize(ragdoll.bones.size());
+    for (size_t b = 0; b < ragdoll.bones.size(); b++) {
+        BodyId body = r.bodies[ragdoll.bones[b].body];
+        r.boneFromBody[b] = glm::inverse(rigid(world->position(body), world->orientation(body))) * r.pose[b];
+    }
+    readPose(r);
+    currentStats.active++;
+    currentStats.bodies += r.bodies.size();
+    currentStats.joints += r.joints.size();
+    return true;
+}
+
+/**
+ * @brief Freeze ragdolls until the pool has this much free: asleep ones first, then the oldest that are old enough
+ *
+ * @return bool False, with none frozen, if those are not enough
+ */
+bool RagdollSystem::makeRoom(size_t bodyCount, size_t jointCount) {
+    auto mayFreeze = [&](const Ragdoll& r) {
+        return !r.bodies.empty() && (r.age >= RAGDOLL_MIN_AGE || !world->awake(r.bodies[0]));
+    };
+    size_t bodiesFree = freeBodies.size(), jointsFree = freeJoints.size();
+    for (const Ragdoll& r : ragdolls) {
+        if (!mayFreeze(r)) continue;
+        bodiesFree += r.bodies.size();
+        jointsFree += r.joints.size();
+    }
+    if (bodiesFree < bodyCount || jointsFree < jointCount) return false;
+
+    while (freeBodies.size() < bodyCount || freeJoints.size() < jointCount) {
+        Ragdoll* victim = nullptr;
+        bool victimAsleep = false;
+        for (Ragdoll& r : ragdolls) {
+            if (!mayFreeze(r)) continue;
+            bool asleep = !world->awake(r.bodies[0]);
+            if (!victim || (asleep && !victimAsleep) || (asleep == victimAsleep && r.born < victim->born)) {
+                victim = &r;
+                victimAsleep = asleep;
+            }
+        }
+        freeze(*victim);
+    }
+    return true;
+}
+
+/**
+ * @brief Remove a ragdoll, such as a corpse out of sight, returning its slot and anything it holds
+ */
+void RagdollSystem::release(RagdollId id) {
+    Ragdoll& r = ragdolls[id];
+    if (!r.ragdoll) return;
+    if (r.frozen) {
+        currentStats.frozen--;
+    } else if (r.waiting) {
+        queue.erase(std::find(queue.begin(), queue.end(), id));
+        currentStats.waiting--;
+    } else {
+        giveBack(r);
+    }
+    r.ragdoll = nullptr;
+    freeRagdolls.push_back(id);
+}
+
+/**
+ * @brief Read the active ragdolls' bodies back into bone poses, and start waiting ones that now fit
+ *
+ * @param elapsed Seconds since the last update; call after the physics update
+ */
+void RagdollSystem::update(float elapsed) {
+    for (Ragdoll& r : ragdolls) {
+        if (r.ragdoll && !r.frozen && !r.waiting) {
+            r.age += elapsed;
+            readPose(r);
+        }
+    }
+    // In order, so a big ragdoll is not passed over for ever by small ones
+    size_t started = 0;
+    while (started < queue.size() && activate(ragdolls[queue[started]], queue[started])) {
+        ragdolls[queue[started]].waiting = false;
+        started++;
+    }
+    queue.erase(queue.begin(), queue.begin() + started);
+    currentStats.waiting -= started;
+}
+
+/**
+ * @brief Model matrix that moves a model rigidly with one of its bones
+ *
+ * For models drawn without skinning: the whole mesh follows that bone.
+ */
+glm::mat4 RagdollSystem::carried(RagdollId id, int bone) const {
+    const Ragdoll& r = ragdolls[id];
+    return r.pose[bone] * glm::inverse(r.ragdoll->bones[bone].bind);
+}
+
+void RagdollSystem::readPose(Ragdoll& r) {
+    const RagdollTemplate& ragdoll = *r.ragdoll;
+    for (size_t b = 0; b < ragdoll.bones.size(); b++) {
+        BodyId body = r.bodies[ragdoll.bones[b].body];
+        r.pose[b] = rigid(world->position(body), world->orientation(body)) * r.boneFromBody[b];
+    }
+    r.bounds = AABB();
+    for (BodyId body : r.bodies) r.bounds.expand(world->bounds(body));
+}
+
+/**
+ * @brief Keep a ragdoll's current pose as a static one and give its bodies and joints back
+ */
+void RagdollSystem::freeze(Ragdoll& r) {
+    readPose(r);
+    giveBack(r);
+    r.frozen = true;
+    currentStats.frozen++;
+    currentStats.frozenForBudget++;
+}
+
+void RagdollSystem::giveBack(Ragdoll& r) {
+    for (BodyId body : r.bodies) {
+        world->setBodyEnabled(body, false);
+        freeBodies.push_back(body);
+    }
+    for (uint32_t joint : r.joints) {
+        world->setJointEnabled(joint, false);
+        freeJoints.push_back(joint);
+    }
+    currentStats.active--;
+    currentStats.bodies -= r.bodies.size();
+    currentStats.joints -= r.joints.size();
+    r.bodies.clear();
+    r.joints.clear();
+}
+
+/**
+ * @brief Print the pool's use
+ */
+void RagdollSystem::report(std::ostream& out) const {
+    out << "Ragdolls: " << currentStats.active << " active, " << currentStats.frozen << " frozen, "
+        << currentStats.waiting << " waiting, " << currentStats.bodies << "/" << currentStats.bodyBudget << " bodies, " << currentStats.joints << "/"
+        << currentStats.jointBudget << " joints, " << currentStats.frozenForBudget << " frozen for room" << std::endl;
+}
@@ -0,0 +1,89 @@
+#include "render_target.h"
+#include <iostream>
+#include "gl_state.h"
+
+/**
+ * @brief Destructor for SceneTarget
+ */
+SceneTarget::~SceneTarget() {
+    release();
+}
+
+/**
+ * @brief Delete the framebuffer and its textures
+ */
+void SceneTarget::release() {
+    glState().forgetFramebuffer(fbo);
+    glState().forgetTexture(color);
+    glState().forgetTexture(depth);
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (color) glDeleteTextures(1, &color);
+    if (depth) glDeleteTextures(1, &depth);
+    fbo = color = depth = 0;
+}
+
+/**
+ * @brief (Re)create the attachments for a new window size
+ *
+ * @param width Width in pixels
+ * @param height Height in pixels
+ */
+void SceneTarget::resize(int width, int height) {
+    if (width == targetWidth && height == targetHeight && fbo) return;
+    release();
+    targetWidth = width;
+    targetHeight = height;
+
+    glGenTextures(1, &color);
+    glState().bindTexture(0, GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenTextures(1, &depth);
+    glState().bindTexture(0, GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Scene framebuffer is incomplete" << std::endl;
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Render into the scene target
+ */
+void SceneTarget::bind() const {
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, targetWidth, targetHeight);
+}
+
+/**
+ * @brief Copy the scene color to the window's back buffer
+ */
+void SceneTarget::blitToScreen() const {
+    glState().bindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glState().bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, targetWidth, targetHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Draw one triangle covering the viewport
+ *
+ * The vertex shader derives positions from gl_VertexID, so the only state
+ * needed is an empty VAO (required by core profiles).
+ */
+void drawFullscreenTriangle() {
+    static GLuint emptyVAO = 0;
+    if (!emptyVAO) glGenVertexArrays(1, &emptyVAO);
+    glState().bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
@@ -5,28 +5,254 @@ in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoord;
 
+const int MAX_SCENE_LIGHTS = 64;
+
+struct Light {
+    vec4 positionRange;   // xyz: position, w: range
+    vec4 directionCos;    // xyz: spot direction, w: cos(outer angle), -1 for point lights
+    vec4 colorIntensity;  // rgb: color, a: intensity
+};
+
+layout (std140) uniform LightData {
+    Light lights[MAX_SCENE_LIGHTS];
+};
+
+// Lights assigned to this draw by the CPU light culling, strongest first
+uniform int lightCount;
+uniform ivec4 lightIndices;
+
+// Decals assigned to this draw, newest first; 4 texels each in decalData
+const int MAX_DECALS_PER_DRAW = 8;
+uniform samplerBuffer decalData;
+uniform int decalCount;
+uniform int decalIndices[MAX_DECALS_PER_DRAW];
+
 uniform sampler2D texture_diffuse1;
 
+#ifdef VIRTUAL_TEXTURE
+// Sparse virtual texture: the page table maps each tile of each level to a slot of the tile cache
+uniform sampler2D virtualPageTable;     // Per texel: slot x, slot y, resident level, 1
+uniform sampler2D virtualCache;
+uniform vec4 virtualSize;               // xy: level 0 size in texels, z: coarsest level, w: texture id
+uniform vec4 virtualTile;               // x: tile size, y: border, z: cache size in texels
+uniform float virtualLodBias;
+
+// Mip level from the screen-space footprint, taken before wrapping so seams don't spike it
+float virtualLevel(vec2 uv)
+{
+    vec2 texel = uv * virtualSize.xy;
+    float footprint = max(length(dFdx(texel)), length(dFdy(texel)));
+    return clamp(floor(log2(max(footprint, 1e-6)) + virtualLodBias + 0.5), 0.0, virtualSize.z);
+}
+
+ivec2 virtualPage(vec2 wrapped, int level)
+{
+    ivec2 tiles = textureSize(virtualPageTable, level);
+    return min(ivec2(wrapped * vec2(tiles)), tiles - 1);
+}
+
+vec4 sampleVirtual(vec2 uv)
+{
+    vec2 wrapped = fract(uv);
+    int level = int(virtualLevel(uv));
+    vec4 entry = texelFetch(virtualPageTable, virtualPage(wrapped, level), level) * 255.0;
+
+    // The entry may belong to a coarser ancestor; locate the texel within that level's tile
+    vec2 residentTiles = vec2(textureSize(virtualPageTable, int(entry.b + 0.5)));
+    vec2 inTile = fract(wrapped * residentTiles);
+    vec2 cacheTexel = floor(entry.xy + 0.5) * (virtualTile.x + 2.0 * virtualTile.y) + virtualTile.y + inTile * virtualTile.x;
+    return textureLod(virtualCache, cacheTexel / virtualTile.z, 0.0);
+}
+#endif
+
+#ifdef FLASHLIGHT
+// Fast path for the player's flashlight, compiled only into the FLASHLIGHT permutation
+uniform mat4 flashlightViewProjection;
+uniform vec4 flashlightPositionRange;   // xyz: position, w: range
+uniform vec4 flashlightDirectionCos;    // xyz: direction, w: cos(outer angle)
+uniform vec3 flashlightColor;
+uniform sampler2D flashlightCookie;
+#ifdef FLASHLIGHT_SHADOWS
+uniform sampler2DShadow flashlightShadow;
+#endif
+
+vec3 evaluateFlashlight(vec3 norm)
+{
+    vec3 toLight = flashlightPositionRange.xyz - FragPos;
+    float dist = length(toLight);
+    vec3 lightDir = toLight / dist;
+
+    // Outside the cone or out of range: skip the texture fetches entirely
+    if (dot(-lightDir, flashlightDirectionCos.xyz) < flashlightDirectionCos.w || dist > flashlightPositionRange.w) {
+        return vec3(0.0);
+    }
+    float diff = max(dot(norm, lightDir), 0.0);
+    if (diff <= 0.0) return vec3(0.0);
+
+    vec4 projected = flashlightViewProjection * vec4(FragPos, 1.0);
+    vec3 coords = projected.xyz / projected.w * 0.5 + 0.5;
+    float beam = texture(flashlightCookie, coords.xy).r;
+
+#ifdef FLASHLIGHT_SHADOWS
+    beam *= texture(flashlightShadow, coords);
+#endif
+
+    float falloff = 1.0 - dist / flashlightPositionRange.w;
+    return diff * beam * falloff * falloff * flashlightColor;
+}
+#endif
+
+#ifdef MOONLIGHT
+// Directional moonlight over the woods, shadowed by cascades that hold their own light-space matrices
+uniform vec3 moonDirection;             // Towards the moon
+uniform vec3 moonColor;
+#ifdef MOONLIGHT_SHADOWS
+const int SHADOW_CASCADE_COUNT = 4;
+uniform sampler2DArrayShadow moonShadow;
+uniform mat4 moonCascades[SHADOW_CASCADE_COUNT];
+uniform vec4 moonTexelSize;             // World size of one shadow texel, per cascade
+
+float moonVisibility(vec3 norm, float facing)
+{
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        // Look up from slightly off the surface, further at grazing angles, to avoid acne
+        vec3 offsetPos = FragPos + norm * moonTexelSize[i] * (1.0 + 2.0 * (1.0 - facing));
+        vec4 projected = moonCascades[i] * vec4(offsetPos, 1.0);
+        vec3 coords = projected.xyz * 0.5 + 0.5;
+        if (any(lessThan(coords.xy, vec2(0.01))) || any(greaterThan(coords.xy, vec2(0.99))) || coords.z > 1.0) continue;
+
+        // Four bilinear comparisons, half a texel apart
+        float texel = 1.0 / float(textureSize(moonShadow, 0).x);
+        float lit = 0.0;
+        lit += texture(moonShadow, vec4(coords.xy + vec2(-0.5, -0.5) * texel, float(i), coords.z));
+        lit += texture(moonShadow, vec4(coords.xy + vec2( 0.5, -0.5) * texel, float(i), coords.z));
+        lit += texture(moonShadow, vec4(coords.xy + vec2(-0.5,  0.5) * texel, float(i), coords.z));
+        lit += texture(moonShadow, vec4(coords.xy + vec2( 0.5,  0.5) * texel, float(i), coords.z));
+        return lit * 0.25;
+    }
+    return 1.0;     // Beyond the shadow distance
+}
+#endif
+
+vec3 evaluateMoon(vec3 norm)
+{
+    float facing = dot(norm, moonDirection);
+    if (facing <= 0.0) return vec3(0.0);
+#ifdef MOONLIGHT_SHADOWS
+    facing *= moonVisibility(norm, facing);
+#endif
+    return facing * moonColor;
+}
+#endif
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float valueNoise(vec2 p)
+{
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1.0, 0.0)), f.x),
+               mix(hash(i + vec2(0.0, 1.0)), hash(i + vec2(1.0, 1.0)), f.x), f.y);
+}
+
+// Irregular splat shape in [-1, 1] decal space
+float splatMask(vec2 p, float seed)
+{
+    float edge = 0.55 + 0.35 * valueNoise(p * 3.0 + seed * 17.0);
+    float blob = 1.0 - smoothstep(edge - 0.1, edge, length(p));
+    float drops = step(0.93, valueNoise(p * 9.0 + seed * 31.0)) * step(length(p), 0.95);
+    return max(blob, drops);
+}
+
+vec3 applyDecals(vec3 albedo, vec3 norm)
+{
+    for (int i = 0; i < decalCount; i++) {
+        int base = decalIndices[i] * 4;
+        vec4 row0 = texelFetch(decalData, base);
+        vec4 row1 = texelFetch(decalData, base + 1);
+        vec4 row2 = texelFetch(decalData, base + 2);
+        vec4 params = texelFetch(decalData, base + 3);
+
+        // Project this fragment into the decal box
+        vec4 world = vec4(FragPos, 1.0);
+        vec3 local = vec3(dot(row0, world), dot(row1, world), dot(row2, world));
+        if (any(greaterThan(abs(local), vec3(1.0)))) continue;
+
+        // Fade on surfaces facing away from the projection axis and towards the box ends
+        float facing = smoothstep(0.2, 0.5, dot(norm, normalize(row2.xyz)));
+        float mask = splatMask(local.xy, params.y) * facing * (1.0 - local.z * local.z) * params.w;
+
+        if (params.x < 0.5) {
+            albedo = mix(albedo, vec3(0.25, 0.01, 0.01), mask * 0.85);  // Blood
+        } else {
+            albedo *= mix(1.0, 0.15, mask);                               // Scorch
+        }
+    }
+    return albedo;
+}
+
+vec3 evaluateLight(Light light, vec3 norm)
+{
+    vec3 toLight = light.positionRange.xyz - FragPos;
+    float dist = length(toLight);
+    vec3 lightDir = toLight / dist;
+
+    // Smooth window that reaches zero at the light's range
+    float ratio = dist / light.positionRange.w;
+    float fade = max(1.0 - ratio * ratio * ratio * ratio, 0.0);
+    float attenuation = fade * fade;
+
+    // Spot cone with a short soft edge; point lights have cos = -1
+    float cosOuter = light.directionCos.w;
+    if (cosOuter > -1.0) {
+        float cosAngle = dot(-lightDir, light.directionCos.xyz);
+        attenuation *= smoothstep(cosOuter, mix(cosOuter, 1.0, 0.1), cosAngle);
+    }
+
+    float diff = max(dot(norm, lightDir), 0.0);
+    return diff * attenuation * light.colorIntensity.rgb * light.colorIntensity.a;
+}
+
 void main()
 {
-    // Basic lighting
-    vec3 lightPos = vec3(0.0, 5.0, 5.0);
-    vec3 lightColor = vec3(1.0, 1.0, 1.0);
+#ifdef VIRTUAL_FEEDBACK
+    // Record the tile this pixel needs instead of shading it
+    int feedbackLevel = int(virtualLevel(TexCoord));
+    FragColor = vec4(vec2(virtualPage(fract(TexCoord), feedbackLevel)), float(feedbackLevel), virtualSize.w) / 255.0;
+    return;
+#endif
+
     vec3 objectColor = vec3(1.0, 1.0, 1.0);
 
     // Ambient
     float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * vec3(1.0, 1.0, 1.0);
 
-    // Diffuse
+    // Diffuse from the lights assigned to this draw only
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = vec3(0.0);
+    for (int i = 0; i < lightCount; i++) {
+        diffuse += evaluateLight(lights[lightIndices[i]], norm);
+    }
+#ifdef FLASHLIGHT
+    diffuse += evaluateFlashlight(norm);
+#endif
+#ifdef MOONLIGHT
+    diffuse += evaluateMoon(norm);
+#endif
 
     vec3 result = (ambient + diffuse) * objectColor;
 
-    // Sample texture
+    // Sample texture and stamp the decals onto it
+#ifdef VIRTUAL_TEXTURE
+    vec4 texColor = sampleVirtual(TexCoord);
+#else
     vec4 texColor = texture(texture_diffuse1, TexCoord);
+#endif
+    texColor.rgb = applyDecals(texColor.rgb, norm);
     FragColor = vec4(result, 1.0) * texColor;
 }
\ No newline at end of file
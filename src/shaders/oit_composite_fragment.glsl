@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D accumTexture;
+uniform sampler2D revealageTexture;
+
+void main()
+{
+    float revealage = texture(revealageTexture, TexCoord).r;
+    if (revealage >= 1.0) discard; // Nothing transparent here
+
+    vec4 accum = texture(accumTexture, TexCoord);
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+
+    // Blended with (1 - alpha, alpha): the scene shows through by the revealage
+    FragColor = vec4(average, revealage);
+}
\ No newline at end of file
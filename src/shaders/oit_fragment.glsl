@@ -0,0 +1,47 @@
+#version 330 core
+layout (location = 0) out vec4 accum;
+layout (location = 1) out float revealage;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+in vec4 Tint;
+
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 time;
+};
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float valueNoise(vec2 p)
+{
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1.0, 0.0)), f.x),
+               mix(hash(i + vec2(0.0, 1.0)), hash(i + vec2(1.0, 1.0)), f.x), f.y);
+}
+
+void main()
+{
+    // Drifting wisps, faded out towards the card edges so the quad never shows
+    vec2 drift = TexCoord * 3.0 + vec2(time.x * 0.05, 0.0);
+    float wisps = 0.6 * valueNoise(drift) + 0.4 * valueNoise(drift * 2.3);
+    vec2 edge = smoothstep(vec2(0.0), vec2(0.25), TexCoord) * smoothstep(vec2(0.0), vec2(0.25), 1.0 - TexCoord);
+    float alpha = clamp(Tint.a * wisps * edge.x * edge.y, 0.0, 1.0);
+    vec3 color = Tint.rgb;
+
+    // Weight from McGuire & Bavoil, eq. 10: favour near, opaque surfaces
+    float z = gl_FragCoord.z;
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - z * 0.9, 3.0), 1e-2, 3e3);
+
+    accum = vec4(color * alpha, alpha) * weight;
+    revealage = alpha;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+// Per-vertex inputs are generated from the C++ vertex format (vertex_format.h)
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;
+
+#ifdef VERTEX_QUANTIZED_POSITION
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+vec3 vertexPosition() { return aPosQuantized.xyz * positionScale + positionBias; }
+#else
+vec3 vertexPosition() { return aPos; }
+#endif
+
+void main()
+{
+    gl_Position = lightViewProjection * model * vec4(vertexPosition(), 1.0);
+}
\ No newline at end of file
@@ -1,21 +1,55 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoord;
+// Per-vertex inputs are generated from the C++ vertex format (vertex_format.h)
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord;
 
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 time;
+};
+
+#ifdef INSTANCED
+// Built on the CPU by the batch transform kernel, one set per instance
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in mat3 aNormalMatrix;
+layout (location = 10) in vec4 aTint;
+out vec4 Tint;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+#ifdef VERTEX_QUANTIZED_POSITION
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+vec3 vertexPosition() { return aPosQuantized.xyz * positionScale + positionBias; }
+#else
+vec3 vertexPosition() { return aPos; }
+#endif
+
+#ifdef VERTEX_PACKED_NORMAL
+vec3 vertexNormal() { return aNormalPacked.xyz; }
+#else
+vec3 vertexNormal() { return aNormal; }
+#endif
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+#ifdef INSTANCED
+    mat4 model = aModel;
+    mat3 normalMatrix = aNormalMatrix;
+    Tint = aTint;
+#else
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+#endif
+
+    FragPos = vec3(model * vec4(vertexPosition(), 1.0));
+    Normal = normalMatrix * vertexNormal();
     TexCoord = aTexCoord;
 
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "shadow_cascades.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "gl_state.h"
+
+/**
+ * @brief Blend between logarithmic and uniform splits; 1 is fully logarithmic
+ */
+const float SHADOW_SPLIT_LAMBDA = 0.75f;
+
+/**
+ * @brief Redraw interval of each cascade in frames, and the frame in that interval it is drawn on
+ */
+const int SHADOW_CASCADE_INTERVAL[SHADOW_CASCADE_COUNT] = {1, 1, 2, 4};
+const int SHADOW_CASCADE_PHASE[SHADOW_CASCADE_COUNT] = {0, 0, 0, 1};
+
+/**
+ * @brief Extra radius given to cascades that are not redrawn every frame
+ *
+ * The view can move this fraction of the radius before the cascade has to
+ * be redrawn early.
+ */
+const float SHADOW_CASCADE_SLACK = 0.1f;
+
+/**
+ * @brief Destructor for ShadowCascades
+ */
+ShadowCascades::~ShadowCascades() {
+    glState().forgetTexture(shadowMap);
+    for (GLuint framebuffer : framebuffers) glState().forgetFramebuffer(framebuffer);
+    if (shadowMap) glDeleteTextures(1, &shadowMap);
+    if (framebuffers[0]) glDeleteFramebuffers(SHADOW_CASCADE_COUNT, framebuffers);
+}
+
+/**
+ * @brief Allocate the depth texture array and one framebuffer per layer
+ */
+void ShadowCascades::create() {
+    glGenTextures(1, &shadowMap);
+    glState().bindTexture(MOON_SHADOW_UNIT, GL_TEXTURE_2D_ARRAY, shadowMap);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE,
+                 SHADOW_CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(SHADOW_CASCADE_COUNT, framebuffers);
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR::SHADOW_CASCADES:: Cascade " << i << " framebuffer is incomplete" << std::endl;
+        }
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Set the world-space bounds of every shadow caster
+ *
+ * @param bounds Caster bounds; the index is the caster id passed back to render()
+ *
+ * Rebuilds the caster BVH and redraws every cascade on the next frame.
+ */
+void ShadowCascades::setCasters(const std::vector<AABB>& bounds) {
+    casterBounds = bounds;
+    casterHierarchy.build(casterBounds);
+    for (Cascade& cascade : cascades) cascade.valid = false;
+}
+
+/**
+ * @brief Update the bounds of casters that moved, keeping the same caster ids
+ *
+ * Unlike setCasters(), cascades are not redrawn early; a far cascade shows
+ * the move when its turn comes.
+ */
+void ShadowCascades::moveCasters(const std::vector<AABB>& bounds) {
+    casterBounds = bounds;
+    casterHierarchy.build(casterBounds);
+}
+
+/**
+ * @brief Split the view and decide which cascades to redraw this frame
+ *
+ * @param view Camera view matrix
+ * @param fovY Vertical field of view, in radians
+ * @param aspect Width over height of the view
+ * @param nearPlane Camera near plane distance
+ */
+void ShadowCascades::update(const glm::mat4& view, float fovY, float aspect, float nearPlane) {
+    frame++;
+    framesCounted++;
+
+    // Light space has a fixed orientation, so snapping in it is stable; +z points at the moon
+    glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 newLightView = glm::lookAt(glm::vec3(0.0f), -direction, up);
+    bool lightMoved = newLightView != lightView;
+    lightView = newLightView;
+
+    glm::mat4 cameraWorld = glm::inverse(view);
+    glm::vec3 eye(cameraWorld[3]);
+    glm::vec3 forward = -glm::normalize(glm::vec3(cameraWorld[2]));
+
+    // Ratio of a slice corner's distance from the view axis to its depth, squared
+    float tanHalf = std::tan(fovY * 0.5f);
+    float k2 = (1.0f + aspect * aspect) * tanHalf * tanHalf;
+
+    float splitNear = nearPlane;
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        Cascade& cascade = cascades[i];
+        float t = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+        float logarithmic = nearPlane * std::pow(SHADOW_DISTANCE / nearPlane, t);
+        float uniform = nearPlane + (SHADOW_DISTANCE - nearPlane) * t;
+        float splitFar = SHADOW_SPLIT_LAMBDA * logarithmic + (1.0f - SHADOW_SPLIT_LAMBDA) * uniform;
+
+        // Smallest sphere around the slice; it depends only on the projection, so turning keeps its size
+        float n = splitNear, f = splitFar;
+        float centerDepth, radius;
+        if (k2 >= (f - n) / (f + n)) {
+            centerDepth = f;
+            radius = f * std::sqrt(k2);
+        } else {
+            centerDepth = 0.5f * (f + n) * (1.0f + k2);
+            radius = 0.5f * std::sqrt((f - n) * (f - n) + 2.0f * (f * f + n * n) * k2 + (f + n) * (f + n) * k2 * k2);
+        }
+        glm::vec3 center = eye + forward * centerDepth;
+        cascade.splitNear = n;
+        cascade.splitFar = f;
+        cascade.interval = SHADOW_CASCADE_INTERVAL[i];
+        splitNear = splitFar;
+
+        bool scheduled = static_cast<int>(frame % cascade.interval) == SHADOW_CASCADE_PHASE[i];
+        bool escaped = glm::length(center - cascade.center) + radius > cascade.radius;
+        cascade.due = !cascade.valid || lightMoved || scheduled || escaped;
+        if (!cascade.due) continue;
+        if (!scheduled && cascade.valid && !lightMoved) earlyRedraws++;
+
+        cascade.radius = cascade.interval > 1 ? radius * (1.0f + SHADOW_CASCADE_SLACK) : radius;
+        fit(cascade, center);
+    }
+}
+
+/**
+ * @brief Place a cascade around a sphere and cull its casters
+ *
+ * The sphere's centre is snapped to whole texels in light space. Casters
+ * are kept if their light-space bounds overlap the cascade's square and are
+ * not entirely below the sphere, and the depth range is stretched up to the
+ * highest of them so nothing between the moon and the receivers is clipped.
+ */
+void ShadowCascades::fit(Cascade& cascade, const glm::vec3& center) {
+    float r = cascade.radius;
+    float texel = 2.0f * r / SHADOW_CASCADE_SIZE;
+    glm::vec3 lightCenter(lightView * glm::vec4(center, 1.0f));
+    lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+    lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+    float left = lightCenter.x - r, right = lightCenter.x + r;
+    float bottom = lightCenter.y - r, top = lightCenter.y + r;
+    float lowest = lightCenter.z - r;
+    float highest = lightCenter.z + r;
+    auto overlaps = [&](const AABB& box) {
+        AABB inLight = box.transformed(lightView);
+        return inLight.max.x >= left && inLight.min.x <= right && inLight.max.y >= bottom && inLight.min.y <= top &&
+               inLight.max.z >= lowest;
+    };
+
+    cascade.casters.clear();
+    casterHierarchy.query(overlaps, [&](uint32_t caster) {
+        if (!overlaps(casterBounds[caster])) return;
+        cascade.casters.push_back(caster);
+        highest = std::max(highest, casterBounds[caster].transformed(lightView).max.z);
+    });
+
+    // View space looks down -z, so the planes are the negated heights
+    glm::mat4 projection = glm::ortho(left, right, bottom, top, -highest, -lowest);
+    cascade.viewProjection = projection * lightView;
+    cascade.center = center;
+    cascade.texelWorldSize = texel;
+    cascade.valid = true;
+}
+
+/**
+ * @brief Draw the casters of each cascade due this frame into its layer
+ *
+ * @param depthProgram Depth-only program with `model` and `lightViewProjection` uniforms
+ * @param drawCaster Draws one caster by id; receives the model matrix location
+ *
+ * The caller must restore its own framebuffer and viewport afterwards.
+ */
+void ShadowCascades::render(GLuint depthProgram, const std::function<void(uint32_t, GLint)>& drawCaster) {
+    if (!created()) return;
+
+    glState().useProgram(depthProgram);
+    GLint viewProjectionLoc = glGetUniformLocation(depthProgram, "lightViewProjection");
+    GLint modelLoc = glGetUniformLocation(depthProgram, "model");
+    glState().enable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.5f, 2.0f);
+    glViewport(0, 0, SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE);
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        const Cascade& cascade = cascades[i];
+        if (!cascade.due) continue;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glUniformMatrix4fv(viewProjectionLoc, 1, GL_FALSE, glm::value_ptr(cascade.viewProjection));
+        for (uint32_t caster : cascade.casters) drawCaster(caster, modelLoc);
+        cascadesDrawn++;
+        castersDrawn += cascade.casters.size();
+    }
+    glState().disable(GL_POLYGON_OFFSET_FILL);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief Set the moonlight uniforms, and the cascades if shadows are enabled
+ *
+ * @param program Currently bound MOONLIGHT permutation
+ */
+void ShadowCascades::apply(GLuint program) const {
+    glUniform3fv(glGetUniformLocation(program, "moonDirection"), 1, glm::value_ptr(direction));
+    glUniform3fv(glGetUniformLocation(program, "moonColor"), 1, glm::value_ptr(color * intensity));
+    if (!created()) return;
+
+    glm::mat4 matrices[SHADOW_CASCADE_COUNT];
+    glm::vec4 texelSizes;
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        matrices[i] = cascades[i].viewProjection;
+        texelSizes[i] = cascades[i].texelWorldSize;
+    }
+    glUniformMatrix4fv(glGetUniformLocation(program, "moonCascades"), SHADOW_CASCADE_COUNT, GL_FALSE,
+                       glm::value_ptr(matrices[0]));
+    glUniform4fv(glGetUniformLocation(program, "moonTexelSize"), 1, glm::value_ptr(texelSizes));
+    glUniform1i(glGetUniformLocation(program, "moonShadow"), MOON_SHADOW_UNIT);
+    glState().bindTexture(MOON_SHADOW_UNIT, GL_TEXTURE_2D_ARRAY, shadowMap);
+}
+
+/**
+ * @brief Print the split distances and the average shadow work per frame
+ */
+void ShadowCascades::report(std::ostream& out) const {
+    out << "Shadow cascades:";
+    for (const Cascade& cascade : cascades) {
+        out << " [" << cascade.splitNear << ", " << cascade.splitFar << "] m " << cascade.casters.size() << " casters;";
+    }
+    double frames = static_cast<double>(std::max<uint64_t>(framesCounted, 1));
+    out << " " << cascadesDrawn / frames << " cascades and " << castersDrawn / frames << " caster draws per frame, "
+        << earlyRedraws << " early redraws" << std::endl;
+}
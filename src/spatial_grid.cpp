@@ -0,0 +1,68 @@
+#include "spatial_grid.h"
+
+/**
+ * @brief Maximum cells per side; larger levels get bigger cells instead
+ */
+const int SPATIAL_GRID_MAX_CELLS = 1024;
+
+/**
+ * @brief Bucket boxes into a grid that covers all of them
+ *
+ * @param boxes Item bounds; the index is the item id
+ * @param cellSize Requested cell size, grown if the grid would be too large
+ */
+void SpatialGrid::build(const std::vector<AABB>& boxes, float cellSize) {
+    bounds = boxes;
+    items.clear();
+    if (boxes.empty()) {
+        cellsX = cellsZ = 0;
+        cellStart.assign(1, 0);
+        return;
+    }
+
+    AABB all;
+    for (const AABB& box : boxes) all.expand(box);
+    glm::vec3 extent = all.extent();
+    this->cellSize = std::max(cellSize, std::max(extent.x, extent.z) / SPATIAL_GRID_MAX_CELLS);
+    origin = all.min;
+    cellsX = std::max(1, static_cast<int>(std::ceil(extent.x / this->cellSize)));
+    cellsZ = std::max(1, static_cast<int>(std::ceil(extent.z / this->cellSize)));
+
+    // Counting sort: count per cell, prefix sum, then scatter
+    cellStart.assign(static_cast<size_t>(cellsX) * cellsZ + 1, 0);
+    for (const AABB& box : boxes) {
+        for (int z = cellZ(box.min.z); z <= cellZ(box.max.z); z++) {
+            for (int x = cellX(box.min.x); x <= cellX(box.max.x); x++) cellStart[z * cellsX + x + 1]++;
+        }
+    }
+    for (size_t cell = 1; cell < cellStart.size(); cell++) cellStart[cell] += cellStart[cell - 1];
+    items.resize(cellStart.back());
+    fill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t item = 0; item < boxes.size(); item++) {
+        const AABB& box = boxes[item];
+        for (int z = cellZ(box.min.z); z <= cellZ(box.max.z); z++) {
+            for (int x = cellX(box.min.x); x <= cellX(box.max.x); x++) items[fill[z * cellsX + x]++] = item;
+        }
+    }
+}
+
+/**
+ * @brief Take a grid built earlier, such as one stored in a level file
+ */
+void SpatialGrid::assign(const glm::vec3& origin, float cellSize, int cellsX, int cellsZ, const uint32_t* cellStart,
+                         const uint32_t* items, size_t itemCount, const AABB* boxes, size_t boxCount) {
+    this->origin = origin;
+    this->cellSize = cellSize;
+    this->cellsX = cellsX;
+    this->cellsZ = cellsZ;
+    this->cellStart.assign(cellStart, cellStart + static_cast<size_t>(cellsX) * cellsZ + 1);
+    this->items.assign(items, items + itemCount);
+    bounds.assign(boxes, boxes + boxCount);
+}
+
+/**
+ * @brief Remove all items
+ */
+void SpatialGrid::clear() {
+    build({}, cellSize);
+}
@@ -0,0 +1,163 @@
+#include "spawn_director.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Fraction of the frame budget under which the cap may grow again
+ */
+const float SPAWN_DIRECTOR_GROW_BELOW = 0.9f;
+
+/**
+ * @brief Start with the cap at its maximum and nothing tracked
+ *
+ * @param capacity Slots in the monster pool
+ * @param seed Seed for the spawn spots
+ */
+void SpawnDirector::create(const SpawnDirectorSettings& settings, uint32_t capacity, uint32_t seed) {
+    this->settings = settings;
+    unseenTime.assign(capacity, 0.0f);
+    unseenGeneration.assign(capacity, 0);
+    candidates.reserve(capacity);
+    despawnList.reserve(capacity);
+    spawnList.reserve(1);
+    rng.seed(seed);
+    currentCap = std::min(settings.maxMonsters, capacity);
+    cooldown = 0.0f;
+    sinceAdjust = 0.0f;
+    currentStats = SpawnDirectorStats();
+    currentStats.cap = currentCap;
+}
+
+/**
+ * @brief Decide which monsters to remove and where to add one
+ *
+ * @param elapsed Seconds since the last update
+ * @param workMs Recent average CPU or GPU work per frame, from the profiler
+ * @param player, front Player's position and view direction
+ * @param monsters Every live monster in the pool
+ * @param canSpawn Whether a monster may appear at a spot
+ *
+ * Results are in despawns() and spawns() until the next update.
+ */
+void SpawnDirector::update(float elapsed, float workMs, const glm::vec3& player, const glm::vec3& front,
+                           const std::vector<DirectedMonster>& monsters, const SpotTest& canSpawn) {
+    despawnList.clear();
+    spawnList.clear();
+    candidates.clear();
+    uint32_t living = 0, corpses = 0, near = 0;
+
+    // Remove monsters that have been out of sight too long; the rest that are unseen may go to make room
+    for (size_t i = 0; i < monsters.size(); i++) {
+        const DirectedMonster& monster = monsters[i];
+        uint32_t slot = monster.entity.index;
+        if (unseenGeneration[slot] != monster.entity.generation || monster.seen) {
+            unseenGeneration[slot] = monster.entity.generation;
+            unseenTime[slot] = 0.0f;
+        }
+        if (!monster.seen) unseenTime[slot] += elapsed;
+
+        float distance = glm::length(glm::vec2(monster.position.x - player.x, monster.position.z - player.z));
+        if (!monster.seen && distance > settings.despawnRadius) {
+            despawnList.push_back(monster.entity);
+            currentStats.despawnedFar++;
+            continue;
+        }
+        if (unseenTime[slot] > settings.unseenSeconds && (monster.dead || distance > settings.nearRadius)) {
+            despawnList.push_back(monster.entity);
+            currentStats.despawnedUnseen++;
+            continue;
+        }
+
+        if (monster.dead) corpses++;
+        else living++;
+        if (!monster.dead && distance <= settings.nearRadius) near++;
+        // Corpses sort ahead of every living monster
+        if (!monster.seen) candidates.emplace_back(monster.dead ? distance + 1e6f : distance, static_cast<uint32_t>(i));
+    }
+
+    uint32_t total = living + corpses;
+    throttle(elapsed, workMs, total);
+    if (total > currentCap) {
+        std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<float, uint32_t>>());
+        for (const auto& candidate : candidates) {
+            if (total <= currentCap) break;
+            const DirectedMonster& monster = monsters[candidate.second];
+            despawnList.push_back(monster.entity);
+            currentStats.despawnedBudget++;
+            total--;
+            if (monster.dead) {
+                corpses--;
+            } else {
+                living--;
+                float distance = glm::length(glm::vec2(monster.position.x - player.x, monster.position.z - player.z));
+                if (distance <= settings.nearRadius) near--;
+            }
+        }
+    }
+
+    cooldown = std::max(0.0f, cooldown - elapsed);
+    if (cooldown == 0.0f && near < settings.intensity && total < currentCap) spawnNear(player, front, canSpawn);
+
+    currentStats.living = living + static_cast<uint32_t>(spawnList.size());
+    currentStats.corpses = corpses;
+    currentStats.near = near + static_cast<uint32_t>(spawnList.size());
+    currentStats.cap = currentCap;
+}
+
+/**
+ * @brief Move the cap towards what the frame budget allows
+ *
+ * @param total Monsters alive or dead now
+ */
+void SpawnDirector::throttle(float elapsed, float workMs, uint32_t total) {
+    currentStats.workMs = workMs;
+    sinceAdjust += elapsed;
+    if (sinceAdjust < settings.adjustInterval) return;
+    sinceAdjust = 0.0f;
+
+    if (workMs > settings.frameBudgetMs) {
+        uint32_t drop = std::min(currentCap, std::max(1u, currentCap / 4));
+        currentCap = std::max(settings.minMonsters, currentCap - drop);
+    } else if (workMs < settings.frameBudgetMs * SPAWN_DIRECTOR_GROW_BELOW && total >= currentCap) {
+        currentCap = std::min({settings.maxMonsters, static_cast<uint32_t>(unseenTime.size()), currentCap + 1});
+    }
+}
+
+/**
+ * @brief Pick a spot on the ring around the player for one new monster
+ *
+ * The first half of the attempts stay behind the player, the rest may be
+ * anywhere; the caller's test rejects spots the camera can see.
+ */
+void SpawnDirector::spawnNear(const glm::vec3& player, const glm::vec3& front, const SpotTest& canSpawn) {
+    const float pi = 3.14159265f;
+    float behind = std::atan2(-front.z, -front.x);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ring(settings.spawnRadiusMin, settings.spawnRadiusMax);
+    for (int attempt = 0; attempt < settings.spawnAttempts; attempt++) {
+        float spread = attempt < settings.spawnAttempts / 2 ? pi * 0.5f : pi;
+        float angle = behind + unit(rng) * spread;
+        float radius = ring(rng);
+        glm::vec3 spot(player.x + std::cos(angle) * radius, settings.ground, player.z + std::sin(angle) * radius);
+        if (canSpawn(spot)) {
+            spawnList.push_back(spot);
+            currentStats.spawned++;
+            cooldown = settings.spawnInterval;
+            return;
+        }
+    }
+    // Try again soon; the player may turn away or walk somewhere more open
+    currentStats.blocked++;
+    cooldown = settings.spawnInterval * 0.25f;
+}
+
+/**
+ * @brief Print one line of counters
+ */
+void SpawnDirector::report(std::ostream& out) const {
+    out << "Spawn director: " << currentStats.near << " near / " << settings.intensity << " wanted, "
+        << currentStats.living << " living, " << currentStats.corpses << " corpses, cap " << currentStats.cap << " at "
+        << currentStats.workMs << " ms work; " << currentStats.spawned << " spawned, " << currentStats.blocked
+        << " blocked; despawned " << currentStats.despawnedFar << " far, " << currentStats.despawnedUnseen
+        << " unseen, " << currentStats.despawnedBudget << " for budget" << std::endl;
+}
@@ -0,0 +1,397 @@
+#include "surfaces.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <glm/gtc/type_ptr.hpp>
+#include "gl_state.h"
+#include "virtual_texture.h"
+
+// Woods ground: 64 m square at 128 texels per metre
+const int WOODS_GROUND_TEXELS = 8192;
+
+// House walls: 64 m of wall around a 16 m square room, 4 m of texture height
+const int HOUSE_WALLS_TEXELS_U = 8192;
+const int HOUSE_WALLS_TEXELS_V = 512;
+const float HOUSE_HALF_WIDTH = 8.0f;
+const float HOUSE_WALL_HEIGHT = 3.0f;
+
+/**
+ * @brief Destructor for SurfaceMesh
+ */
+SurfaceMesh::~SurfaceMesh() {
+    glState().forgetVertexArray(VAO);
+    glState().forgetBuffer(VBO);
+    glState().forgetBuffer(EBO);
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+}
+
+/**
+ * @brief Add a parallelogram
+ *
+ * @param origin First corner
+ * @param edgeU Edge along which the first texture coordinate runs
+ * @param edgeV Edge along which the second texture coordinate runs
+ * @param uvOrigin Texture coordinates at the origin
+ * @param uvExtent Change of the texture coordinates along the edges
+ *
+ * The normal is edgeU x edgeV.
+ */
+void SurfaceMesh::addQuad(const glm::vec3& origin, const glm::vec3& edgeU, const glm::vec3& edgeV,
+                          const glm::vec2& uvOrigin, const glm::vec2& uvExtent) {
+    GLuint base = static_cast<GLuint>(positions.size());
+    glm::vec3 normal = glm::normalize(glm::cross(edgeU, edgeV));
+    for (int corner = 0; corner < 4; corner++) {
+        float s = static_cast<float>(corner & 1);
+        float t = static_cast<float>(corner >> 1);
+        glm::vec3 position = origin + edgeU * s + edgeV * t;
+        positions.push_back(position);
+        normals.push_back(normal);
+        texCoords.push_back(uvOrigin + uvExtent * glm::vec2(s, t));
+        box.expand(position);
+    }
+    for (GLuint index : {0u, 1u, 3u, 0u, 3u, 2u}) indices.push_back(base + index);
+}
+
+/**
+ * @brief Upload the quads
+ */
+void SurfaceMesh::create() {
+    VertexSource source;
+    source.count = positions.size();
+    source.positions = positions.data();
+    source.normals = normals.data();
+    source.texCoords = texCoords.data();
+    source.bounds = box;
+    std::vector<unsigned char> vertices;
+    ModelVertex::pack(source, vertices);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glState().bindVertexArray(VAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    ModelVertex::setupAttributes();
+    glState().bindVertexArray(0);
+}
+
+/**
+ * @brief Draw all quads with the bound program
+ *
+ * @param modelLoc Location of the model matrix uniform, or -1
+ * @param transform Model matrix
+ */
+void SurfaceMesh::draw(GLint modelLoc, const glm::mat4& transform) const {
+    if (!VAO) return;
+    if (modelLoc >= 0) glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transform));
+    glState().bindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr);
+}
+
+/**
+ * @brief The forest floor, centred on the house and reaching deep into the woods
+ *
+ * @param floorHeight Height the models stand on
+ */
+void buildWoodsGround(SurfaceMesh& mesh, float floorHeight) {
+    glm::vec3 corner(-WOODS_GROUND_SIZE * 0.5f, floorHeight, -48.0f);
+    mesh.addQuad(corner, glm::vec3(0.0f, 0.0f, WOODS_GROUND_SIZE), glm::vec3(WOODS_GROUND_SIZE, 0.0f, 0.0f),
+                 glm::vec2(0.0f), glm::vec2(1.0f));
+
+    AABB below;
+    below.expand(corner - glm::vec3(0.0f, 1.0f, 0.0f));
+    below.expand(corner + glm::vec3(WOODS_GROUND_SIZE, 0.0f, WOODS_GROUND_SIZE));
+    mesh.addCollider(below);
+}
+
+/**
+ * @brief One straight stretch of wall between two heights, with both faces
+ *
+ * @param a Start of the inside face, at floor height
+ * @param b End of the inside face
+ * @param distance Distance along the perimeter at a, which the texture's u follows
+ * @param bottom Height of the stretch's lower edge above the floor
+ * @param top Height of its upper edge
+ *
+ * Walking from a to b keeps the room on the left, so the inside normal is
+ * (b - a) x up and the outside face sits one wall thickness the other way.
+ */
+static void addWall(SurfaceMesh& mesh, const glm::vec3& a, const glm::vec3& b, float distance, float bottom, float top) {
+    glm::vec3 along = b - a;
+    float length = glm::length(along);
+    glm::vec3 up(0.0f, top - bottom, 0.0f);
+    glm::vec3 outward = -glm::normalize(glm::cross(along, glm::vec3(0.0f, 1.0f, 0.0f))) * HOUSE_WALL_THICKNESS;
+    glm::vec3 lift(0.0f, bottom, 0.0f);
+    glm::vec2 uvExtent(length / HOUSE_WALLS_PERIMETER, (top - bottom) / HOUSE_WALLS_TEXTURE_HEIGHT);
+    float u0 = distance / HOUSE_WALLS_PERIMETER;
+    float v0 = bottom / HOUSE_WALLS_TEXTURE_HEIGHT;
+
+    mesh.addQuad(a + lift, along, up, glm::vec2(u0, v0), uvExtent);
+    mesh.addQuad(b + lift + outward, -along, up, glm::vec2(u0 + uvExtent.x, v0), glm::vec2(-uvExtent.x, uvExtent.y));
+
+    AABB solid;
+    solid.expand(a + lift);
+    solid.expand(b + lift + up + outward);
+    mesh.addCollider(solid);
+}
+
+/**
+ * @brief Four walls around the starting room, with a doorway out to the woods
+ *
+ * @param floorHeight Height the models stand on
+ *
+ * The walls' u runs once around the 64 m perimeter, and v is height over
+ * the 4 m the texture covers.
+ */
+void buildHouseWalls(SurfaceMesh& mesh, float floorHeight) {
+    const float w = HOUSE_HALF_WIDTH;
+    const float nearZ = HOUSE_NEAR_Z;
+    const float farZ = HOUSE_NEAR_Z + 2.0f * w;
+    const float door = HOUSE_DOOR_HALF_WIDTH;
+    auto at = [floorHeight](float x, float z) { return glm::vec3(x, floorHeight, z); };
+
+    // Door wall, in three pieces: left, lintel, right
+    addWall(mesh, at(-w, nearZ), at(-door, nearZ), 0.0f, 0.0f, HOUSE_WALL_HEIGHT);
+    addWall(mesh, at(-door, nearZ), at(door, nearZ), w - door, HOUSE_DOOR_HEIGHT, HOUSE_WALL_HEIGHT);
+    addWall(mesh, at(door, nearZ), at(w, nearZ), w + door, 0.0f, HOUSE_WALL_HEIGHT);
+
+    // Door jambs close the gap between the two faces
+    glm::vec3 depth(0.0f, 0.0f, -HOUSE_WALL_THICKNESS);
+    glm::vec3 jamb(0.0f, HOUSE_DOOR_HEIGHT, 0.0f);
+    glm::vec2 jambExtent(HOUSE_WALL_THICKNESS / HOUSE_WALLS_PERIMETER, HOUSE_DOOR_HEIGHT / HOUSE_WALLS_TEXTURE_HEIGHT);
+    mesh.addQuad(at(-door, nearZ), depth, jamb, glm::vec2((w - door) / HOUSE_WALLS_PERIMETER, 0.0f), jambExtent);
+    mesh.addQuad(at(door, nearZ) + depth, -depth, jamb, glm::vec2((w + door) / HOUSE_WALLS_PERIMETER, 0.0f), jambExtent);
+
+    addWall(mesh, at(w, nearZ), at(w, farZ), 2.0f * w, 0.0f, HOUSE_WALL_HEIGHT);
+    addWall(mesh, at(w, farZ), at(-w, farZ), 4.0f * w, 0.0f, HOUSE_WALL_HEIGHT);
+    addWall(mesh, at(-w, farZ), at(-w, nearZ), 6.0f * w, 0.0f, HOUSE_WALL_HEIGHT);
+}
+
+/**
+ * @brief A box centred on the origin, for a physics prop
+ *
+ * @param halfExtents Half the box's size along each axis
+ * @param u Where along the house walls' texture the box's faces start
+ *
+ * The faces are laid side by side along a strip of the walls' texture at
+ * the walls' texel density, so props built of the same planks need no
+ * texture of their own. Props move, so no collider is added.
+ */
+void buildPropBox(SurfaceMesh& mesh, const glm::vec3& halfExtents, float u) {
+    const glm::vec3 h = halfExtents;
+    const glm::vec3 faces[6][3] = {
+        {glm::vec3(h.x, -h.y, h.z), glm::vec3(0.0f, 0.0f, -2.0f * h.z), glm::vec3(0.0f, 2.0f * h.y, 0.0f)},
+        {glm::vec3(-h.x, -h.y, -h.z), glm::vec3(0.0f, 0.0f, 2.0f * h.z), glm::vec3(0.0f, 2.0f * h.y, 0.0f)},
+        {glm::vec3(-h.x, -h.y, h.z), glm::vec3(2.0f * h.x, 0.0f, 0.0f), glm::vec3(0.0f, 2.0f * h.y, 0.0f)},
+        {glm::vec3(h.x, -h.y, -h.z), glm::vec3(-2.0f * h.x, 0.0f, 0.0f), glm::vec3(0.0f, 2.0f * h.y, 0.0f)},
+        {glm::vec3(-h.x, h.y, h.z), glm::vec3(2.0f * h.x, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -2.0f * h.z)},
+        {glm::vec3(-h.x, -h.y, -h.z), glm::vec3(2.0f * h.x, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 2.0f * h.z)},
+    };
+    for (const auto& face : faces) {
+        glm::vec2 extent(glm::length(face[1]) / HOUSE_WALLS_PERIMETER, glm::length(face[2]) / HOUSE_WALLS_TEXTURE_HEIGHT);
+        mesh.addQuad(face[0], face[1], face[2], glm::vec2(u, 0.0f), extent);
+        u += extent.x;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Procedural content
+//
+// Both textures are evaluated per level rather than downsampled: each
+// feature fades out as its size approaches two texels of the level being
+// cooked, which is the prefiltering a mip chain would have done.
+
+namespace {
+
+float hash(int x, int y, int seed) {
+    uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u +
+                 static_cast<uint32_t>(seed) * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return static_cast<float>(h & 0xFFFFFF) / 16777216.0f;
+}
+
+float valueNoise(float x, float y, int seed) {
+    float fx = std::floor(x), fy = std::floor(y);
+    int ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+    float tx = x - fx, ty = y - fy;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    ty = ty * ty * (3.0f - 2.0f * ty);
+    float top = hash(ix, iy, seed) + (hash(ix + 1, iy, seed) - hash(ix, iy, seed)) * tx;
+    float bottom = hash(ix, iy + 1, seed) + (hash(ix + 1, iy + 1, seed) - hash(ix, iy + 1, seed)) * tx;
+    return top + (bottom - top) * ty;
+}
+
+/**
+ * @brief Weight of a feature of the given size at a texel footprint; 0 once it is under two texels
+ */
+float detailWeight(float size, float footprint) {
+    return std::min(1.0f, std::max(0.0f, size / footprint * 0.5f - 1.0f));
+}
+
+/**
+ * @brief Band-limited fractal noise in [0, 1]
+ *
+ * @param wavelength Wavelength of the first octave, in metres
+ * @param footprint Texel size of the level, in metres
+ *
+ * Octaves too fine for the level are replaced by their mean.
+ */
+float fbm(float x, float y, float wavelength, float footprint, int octaves, int seed) {
+    float sum = 0.0f, amplitude = 0.5f;
+    for (int i = 0; i < octaves; i++) {
+        float weight = detailWeight(wavelength, footprint);
+        sum += amplitude * (0.5f + (valueNoise(x / wavelength, y / wavelength, seed + i) - 0.5f) * weight);
+        wavelength *= 0.5f;
+        amplitude *= 0.5f;
+    }
+    return sum / (1.0f - amplitude * 2.0f);
+}
+
+/**
+ * @brief Box-filtered coverage of a line of some width at a signed distance
+ */
+float lineCoverage(float distance, float width, float footprint) {
+    float edge = std::min(1.0f, std::max(0.0f, (width * 0.5f + footprint * 0.5f - std::fabs(distance)) / footprint));
+    return edge * std::min(1.0f, width / footprint);
+}
+
+glm::vec3 mix(const glm::vec3& a, const glm::vec3& b, float t) {
+    return a + (b - a) * t;
+}
+
+void store(const glm::vec3& color, unsigned char* rgb) {
+    for (int c = 0; c < 3; c++) {
+        rgb[c] = static_cast<unsigned char>(std::lround(std::min(1.0f, std::max(0.0f, color[c])) * 255.0f));
+    }
+}
+
+/**
+ * @brief Soil, moss patches and fallen leaves
+ */
+glm::vec3 woodsGround(float x, float y, float footprint) {
+    glm::vec3 soil = mix(glm::vec3(0.13f, 0.09f, 0.06f), glm::vec3(0.24f, 0.17f, 0.10f),
+                         fbm(x, y, 0.6f, footprint, 6, 11));
+
+    float patches = fbm(x, y, 4.0f, footprint, 3, 23);
+    float moss = std::min(1.0f, std::max(0.0f, (patches - 0.52f) * 6.0f));
+    glm::vec3 mossColor = glm::vec3(0.10f, 0.17f, 0.06f) * (0.7f + 0.6f * fbm(x, y, 0.15f, footprint, 3, 31));
+    glm::vec3 color = mix(soil, mossColor, moss);
+
+    // Leaves: at most one per 8 cm cell, fewer on the moss; below their size only their average tint remains
+    const float cell = 0.08f;
+    const float radius = 0.03f;
+    const glm::vec3 leafAverage(0.33f, 0.17f, 0.07f);
+    float density = 0.45f * (1.0f - moss);
+    float detail = detailWeight(radius * 2.0f, footprint);
+    float cover = 0.0f;
+    glm::vec3 leafColor = leafAverage;
+    if (detail > 0.0f) {
+        int cx = static_cast<int>(std::floor(x / cell));
+        int cy = static_cast<int>(std::floor(y / cell));
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = cx + dx, ny = cy + dy;
+                if (hash(nx, ny, 41) > density) continue;
+                float centreX = (nx + 0.2f + 0.6f * hash(nx, ny, 43)) * cell;
+                float centreY = (ny + 0.2f + 0.6f * hash(nx, ny, 47)) * cell;
+                float distance = std::hypot(x - centreX, (y - centreY) * 1.6f);
+                float leaf = lineCoverage(distance, radius * 2.0f, footprint);
+                if (leaf > cover) {
+                    cover = leaf;
+                    float hue = hash(nx, ny, 53);
+                    leafColor = mix(glm::vec3(0.45f, 0.22f, 0.06f), glm::vec3(0.25f, 0.12f, 0.06f), hue);
+                }
+            }
+        }
+    }
+    float averageCover = density * 3.14159f * radius * radius / (cell * cell) / 1.6f;
+    color = mix(color, leafColor, cover * detail);
+    return mix(color, leafAverage, averageCover * (1.0f - detail));
+}
+
+/**
+ * @brief Weathered horizontal planks, darker where they meet the ground
+ *
+ * @param x Distance along the perimeter, in metres
+ * @param y Height, in metres
+ */
+glm::vec3 houseWalls(float x, float y, float footprint) {
+    const float boardHeight = 0.2f;
+    const float boardLength = 3.0f;
+    const float gap = 0.008f;
+
+    int board = static_cast<int>(std::floor(y / boardHeight));
+    float within = y - board * boardHeight;
+    float shift = hash(board, 0, 61) * boardLength;
+    int piece = static_cast<int>(std::floor((x + shift) / boardLength));
+    float along = x + shift - piece * boardLength;
+
+    float tint = 0.8f + 0.4f * hash(board, piece, 67);
+    float grain = fbm(x * 0.05f, y, 0.01f, footprint, 3, 71);
+    float knots = fbm(x, y, 0.3f, footprint, 2, 73);
+    glm::vec3 wood = mix(glm::vec3(0.22f, 0.15f, 0.09f), glm::vec3(0.36f, 0.26f, 0.16f), grain) * tint;
+    wood *= 0.85f + 0.3f * knots;
+
+    // Dark seams between boards and at their ends
+    float seams = std::max(lineCoverage(std::min(within, boardHeight - within), gap, footprint),
+                           lineCoverage(std::min(along, boardLength - along), gap, footprint));
+    glm::vec3 color = mix(wood, glm::vec3(0.04f, 0.03f, 0.02f), seams);
+
+    // Damp and dirt near the floor
+    float damp = std::max(0.0f, 1.0f - y / 0.5f) * (0.6f + 0.4f * fbm(x, y, 0.25f, footprint, 3, 79));
+    return color * (1.0f - 0.5f * damp);
+}
+
+/**
+ * @brief Texel source sampling a surface function at texel centres
+ *
+ * @param width Extent of the texture in metres along u
+ * @param height Extent along v
+ */
+VirtualTexelSource surfaceSource(glm::vec3 (*surface)(float, float, float), float width, float height) {
+    return [surface, width, height](const VirtualTexelRect& rect, unsigned char* rgb) {
+        float stepX = width / rect.levelWidth;
+        float stepY = height / rect.levelHeight;
+        float footprint = std::max(stepX, stepY);
+        for (int y = 0; y < rect.height; y++) {
+            for (int x = 0; x < rect.width; x++) {
+                glm::vec3 color = surface((rect.x + x + 0.5f) * stepX, (rect.y + y + 0.5f) * stepY, footprint);
+                store(color, rgb + (static_cast<size_t>(y) * rect.width + x) * 3);
+            }
+        }
+    };
+}
+
+} // namespace
+
+/**
+ * @brief Cook the virtual textures of the woods ground and the house walls
+ *
+ * @param jobs Job system to generate and encode tiles on, or nullptr
+ * @return bool Whether both were written
+ */
+bool cookSurfaceTextures(JobSystem* jobs) {
+    mkdir("../assets/virtual", 0755);
+
+    bool cooked = true;
+    std::string error;
+    if (!cookVirtualTexture(WOODS_GROUND_TEXTURE, WOODS_GROUND_TEXELS, WOODS_GROUND_TEXELS,
+                            surfaceSource(woodsGround, WOODS_GROUND_SIZE, WOODS_GROUND_SIZE), jobs, error)) {
+        std::cerr << "ERROR::SURFACES:: " << WOODS_GROUND_TEXTURE << ": " << error << std::endl;
+        cooked = false;
+    }
+    if (!cookVirtualTexture(HOUSE_WALLS_TEXTURE, HOUSE_WALLS_TEXELS_U, HOUSE_WALLS_TEXELS_V,
+                            surfaceSource(houseWalls, HOUSE_WALLS_PERIMETER, HOUSE_WALLS_TEXTURE_HEIGHT), jobs, error)) {
+        std::cerr << "ERROR::SURFACES:: " << HOUSE_WALLS_TEXTURE << ": " << error << std::endl;
+        cooked = false;
+    }
+    return cooked;
+}
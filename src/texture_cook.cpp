@@ -0,0 +1,470 @@
+#include "texture_cook.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include "job_system.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTURE_COOK_SSE2 1
+#endif
+
+namespace texture_cook {
+
+const uint32_t FILE_MAGIC = 0x58544D45;  // "EMTX"
+const uint32_t FILE_VERSION = 1;
+const size_t HEADER_BYTES = 24;         // Magic, version, width, height, channels, levels
+
+const int MAX_DIMENSION = 1 << 15;
+
+// Kaiser-windowed sinc: lobes on each side, in destination texels, and window shape
+const float KAISER_WIDTH = 3.0f;
+const float KAISER_ALPHA = 4.0f;
+
+// Entries of the linear to sRGB table; fine enough that neighbours differ by under a quarter code
+const int SRGB_TABLE_SIZE = 16384;
+
+// ---------------------------------------------------------------------------
+// Levels
+
+/**
+ * @brief Levels of a full chain down to 1x1
+ */
+int levelCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+/**
+ * @brief Layout of one level of a chain
+ */
+ImageInfo levelInfo(const ImageInfo& base, int level) {
+    ImageInfo info = base;
+    info.width = std::max(1, base.width >> level);
+    info.height = std::max(1, base.height >> level);
+    return info;
+}
+
+/**
+ * @brief Bytes of the first `levels` levels
+ */
+size_t chainSize(const ImageInfo& base, int levels) {
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++) bytes += levelInfo(base, level).byteSize();
+    return bytes;
+}
+
+// ---------------------------------------------------------------------------
+// Filtering
+
+/**
+ * @brief Image being filtered: four floats per texel whatever the channel count
+ */
+struct FloatImage {
+    int width = 0, height = 0;
+    std::vector<float> texels;
+
+    FloatImage(int w, int h) : width(w), height(h), texels(static_cast<size_t>(w) * h * 4, 0.0f) {}
+    float* row(int y) { return &texels[static_cast<size_t>(y) * width * 4]; }
+    const float* row(int y) const { return &texels[static_cast<size_t>(y) * width * 4]; }
+};
+
+/**
+ * @brief Source texels and weights for each destination texel along one axis
+ *
+ * Every destination texel has `taps` entries; unused ones have weight 0.
+ */
+struct Kernel {
+    int taps = 0;
+    std::vector<int> indices;
+    std::vector<float> weights;
+};
+
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static double kaiser(double t) {
+    if (std::abs(t) >= KAISER_WIDTH) return 0.0;
+    double sinc = t == 0.0 ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+    double window = t / KAISER_WIDTH;
+    return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0 - window * window)) / besselI0(KAISER_ALPHA);
+}
+
+/**
+ * @brief Weights for shrinking `source` texels to `destination`, wrapping at the edges
+ *
+ * Textures are sampled with GL_REPEAT, so texels past one edge are the
+ * other edge's.
+ */
+static Kernel buildKernel(int source, int destination, MipFilter filter) {
+    Kernel kernel;
+    if (source == destination) {
+        kernel.taps = 1;
+        for (int i = 0; i < destination; i++) {
+            kernel.indices.push_back(i);
+            kernel.weights.push_back(1.0f);
+        }
+        return kernel;
+    }
+
+    double scale = static_cast<double>(source) / destination;
+    double radius = filter == MipFilter::Box ? 0.5 * scale : KAISER_WIDTH * scale;
+    std::vector<std::vector<std::pair<int, float>>> perTexel(destination);
+    for (int d = 0; d < destination; d++) {
+        double center = (d + 0.5) * scale;
+        int first = static_cast<int>(std::floor(center - radius));
+        int last = static_cast<int>(std::ceil(center + radius));
+        double sum = 0.0;
+        std::vector<std::pair<int, double>> raw;
+        for (int i = first; i <= last; i++) {
+            double weight;
+            if (filter == MipFilter::Box) {
+                weight = std::max(0.0, std::min(i + 1.0, center + radius) - std::max(static_cast<double>(i), center - radius));
+            } else {
+                weight = kaiser((i + 0.5 - center) / scale);
+            }
+            if (weight == 0.0) continue;
+            raw.push_back({((i % source) + source) % source, weight});
+            sum += weight;
+        }
+        for (const auto& tap : raw) perTexel[d].push_back({tap.first, static_cast<float>(tap.second / sum)});
+        kernel.taps = std::max(kernel.taps, static_cast<int>(perTexel[d].size()));
+    }
+
+    kernel.indices.assign(static_cast<size_t>(destination) * kernel.taps, 0);
+    kernel.weights.assign(static_cast<size_t>(destination) * kernel.taps, 0.0f);
+    for (int d = 0; d < destination; d++) {
+        for (size_t k = 0; k < perTexel[d].size(); k++) {
+            kernel.indices[d * kernel.taps + k] = perTexel[d][k].first;
+            kernel.weights[d * kernel.taps + k] = perTexel[d][k].second;
+        }
+    }
+    return kernel;
+}
+
+/**
+ * @brief Filter one level down to the given size; horizontal pass, then vertical
+ */
+static FloatImage downsample(const FloatImage& source, int width, int height, MipFilter filter) {
+    Kernel horizontal = buildKernel(source.width, width, filter);
+    Kernel vertical = buildKernel(source.height, height, filter);
+
+    FloatImage rows(width, source.height);
+    for (int y = 0; y < source.height; y++) {
+        const float* in = source.row(y);
+        float* out = rows.row(y);
+        for (int x = 0; x < width; x++) {
+            const int* indices = &horizontal.indices[x * horizontal.taps];
+            const float* weights = &horizontal.weights[x * horizontal.taps];
+#ifdef TEXTURE_COOK_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < horizontal.taps; k++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + indices[k] * 4), _mm_set1_ps(weights[k])));
+            }
+            _mm_storeu_ps(out + x * 4, sum);
+#else
+            for (int k = 0; k < horizontal.taps; k++) {
+                for (int c = 0; c < 4; c++) out[x * 4 + c] += in[indices[k] * 4 + c] * weights[k];
+            }
+#endif
+        }
+    }
+
+    FloatImage result(width, height);
+    size_t rowFloats = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < height; y++) {
+        float* out = result.row(y);
+        for (int k = 0; k < vertical.taps; k++) {
+            float weight = vertical.weights[y * vertical.taps + k];
+            if (weight == 0.0f) continue;
+            const float* in = rows.row(vertical.indices[y * vertical.taps + k]);
+            size_t i = 0;
+#ifdef TEXTURE_COOK_SSE2
+            __m128 w = _mm_set1_ps(weight);
+            for (; i < rowFloats; i += 4) {
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+            }
+#endif
+            for (; i < rowFloats; i++) out[i] += in[i] * weight;
+        }
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Conversion
+
+/**
+ * @brief sRGB transfer tables, built once
+ */
+struct SrgbTables {
+    float toLinear[256];
+    unsigned char fromLinear[SRGB_TABLE_SIZE];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            double c = i / 255.0;
+            toLinear[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+        }
+        for (int i = 0; i < SRGB_TABLE_SIZE; i++) {
+            double l = static_cast<double>(i) / (SRGB_TABLE_SIZE - 1);
+            double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            fromLinear[i] = static_cast<unsigned char>(std::lround(c * 255.0));
+        }
+    }
+};
+
+static const SrgbTables& srgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+static bool isColor(int channel, int channels) {
+    return channels != 4 || channel < 3;
+}
+
+static FloatImage toFloat(const ImageInfo& info, const unsigned char* pixels, bool gammaCorrect) {
+    const SrgbTables& srgb = srgbTables();
+    FloatImage image(info.width, info.height);
+    size_t count = static_cast<size_t>(info.width) * info.height;
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* texel = pixels + i * info.channels;
+        float* out = &image.texels[i * 4];
+        for (int c = 0; c < info.channels; c++) {
+            int source = info.bgr && c < 3 ? 2 - c : c;
+            out[c] = gammaCorrect && isColor(c, info.channels) ? srgb.toLinear[texel[source]] : texel[source] / 255.0f;
+        }
+    }
+    return image;
+}
+
+static unsigned char quantize(float value, bool srgb) {
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    if (srgb) return srgbTables().fromLinear[static_cast<int>(value * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+    return static_cast<unsigned char>(value * 255.0f + 0.5f);
+}
+
+static void fromFloat(const FloatImage& image, const ImageInfo& info, bool gammaCorrect, float alphaScale,
+                      unsigned char* pixels) {
+    size_t count = static_cast<size_t>(info.width) * info.height;
+    for (size_t i = 0; i < count; i++) {
+        const float* texel = &image.texels[i * 4];
+        unsigned char* out = pixels + i * info.channels;
+        for (int c = 0; c < info.channels; c++) {
+            bool color = isColor(c, info.channels);
+            out[c] = quantize(color ? texel[c] : texel[c] * alphaScale, gammaCorrect && color);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Alpha coverage
+
+static float coverage(const FloatImage& image, float reference) {
+    size_t passing = 0;
+    size_t count = static_cast<size_t>(image.width) * image.height;
+    for (size_t i = 0; i < count; i++) passing += image.texels[i * 4 + 3] > reference;
+    return static_cast<float>(passing) / count;
+}
+
+/**
+ * @brief Alpha scale that makes `target` of the level pass an alpha test at `cutoff`
+ *
+ * Finds the reference at which the level's coverage matches, by bisection,
+ * and scales alpha so that reference lands on the cutoff.
+ */
+static float coverageScale(const FloatImage& image, float cutoff, float target) {
+    float low = 0.0f, high = 1.0f;
+    for (int i = 0; i < 16; i++) {
+        float middle = 0.5f * (low + high);
+        if (coverage(image, middle) > target) low = middle;
+        else high = middle;
+    }
+    // Coverage moves in steps; take whichever side of the step is closer
+    float reference = std::abs(coverage(image, low) - target) <= std::abs(coverage(image, high) - target) ? low : high;
+    return reference > 0.0f ? cutoff / reference : 1.0f;
+}
+
+/**
+ * @brief Build the mip chain of an image
+ *
+ * @param info Layout of the source pixels
+ * @param outInfo Receives level 0's layout, in RGB(A) order
+ * @param chain Receives every level, largest first; level 0 is the source
+ */
+void generateMips(const ImageInfo& info, const unsigned char* pixels, const MipOptions& options,
+                  ImageInfo& outInfo, std::vector<unsigned char>& chain) {
+    outInfo = info;
+    outInfo.bgr = false;
+    int levels = levelCount(info.width, info.height);
+    chain.resize(chainSize(outInfo, levels));
+
+    size_t count = static_cast<size_t>(info.width) * info.height;
+    if (info.bgr) {
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* texel = pixels + i * info.channels;
+            unsigned char* out = &chain[i * info.channels];
+            out[0] = texel[2];
+            out[1] = texel[1];
+            out[2] = texel[0];
+            if (info.channels == 4) out[3] = texel[3];
+        }
+    } else {
+        std::memcpy(chain.data(), pixels, info.byteSize());
+    }
+
+    FloatImage current = toFloat(info, pixels, options.gammaCorrect);
+    float target = info.channels == 4 && options.alphaCutoff > 0.0f ? coverage(current, options.alphaCutoff) : 1.0f;
+    // Fully opaque or fully cut out textures have nothing to preserve
+    bool keepCoverage = target > 0.0f && target < 1.0f;
+
+    size_t offset = info.byteSize();
+    for (int level = 1; level < levels; level++) {
+        ImageInfo next = levelInfo(outInfo, level);
+        current = downsample(current, next.width, next.height, options.filter);
+        float alphaScale = keepCoverage ? coverageScale(current, options.alphaCutoff, target) : 1.0f;
+        fromFloat(current, next, options.gammaCorrect, alphaScale, &chain[offset]);
+        offset += next.byteSize();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Files
+
+/**
+ * @brief Write a mip chain to a .tex file
+ */
+bool writeFile(const std::string& path, const ImageInfo& info, int levels, const std::vector<unsigned char>& chain,
+               std::string& error) {
+    uint32_t header[6] = {FILE_MAGIC, FILE_VERSION, static_cast<uint32_t>(info.width), static_cast<uint32_t>(info.height),
+                          static_cast<uint32_t>(info.channels), static_cast<uint32_t>(levels)};
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(chain.data()), chainSize(info, levels));
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Map a .tex file and check its header
+ */
+bool readFile(const std::string& path, CookedTexture& texture, std::string& error) {
+    if (!texture.file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    uint32_t header[6];
+    if (texture.file.size() < HEADER_BYTES) {
+        error = "not a texture file";
+        return false;
+    }
+    std::memcpy(header, texture.file.data(), HEADER_BYTES);
+    if (header[0] != FILE_MAGIC || header[1] != FILE_VERSION) {
+        error = "not a version " + std::to_string(FILE_VERSION) + " texture file";
+        return false;
+    }
+
+    ImageInfo info;
+    info.width = static_cast<int>(header[2]);
+    info.height = static_cast<int>(header[3]);
+    info.channels = static_cast<int>(header[4]);
+    int levels = static_cast<int>(header[5]);
+    if (header[2] == 0 || header[3] == 0 || header[2] > MAX_DIMENSION || header[3] > MAX_DIMENSION ||
+        (info.channels != 1 && info.channels != 3 && info.channels != 4) ||
+        levels < 1 || levels > levelCount(info.width, info.height)) {
+        error = "invalid texture header";
+        return false;
+    }
+    if (texture.file.size() - HEADER_BYTES < chainSize(info, levels)) {
+        error = "truncated texture file";
+        return false;
+    }
+
+    texture.info = info;
+    texture.levels = levels;
+    texture.pixels = texture.file.data() + HEADER_BYTES;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Cooking
+
+/**
+ * @brief Where the cooked form of an image lives: same name, ".tex" extension
+ */
+std::string cookedPath(const std::string& imagePath) {
+    size_t dot = imagePath.find_last_of('.');
+    size_t slash = imagePath.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return imagePath + ".tex";
+    return imagePath.substr(0, dot) + ".tex";
+}
+
+/**
+ * @brief Decode an image, build its mip chain and write it next to the image
+ */
+bool cookFile(const std::string& imagePath, const MipOptions& options, std::string& error) {
+    MappedFile file;
+    if (!file.open(imagePath)) {
+        error = "cannot open " + imagePath;
+        return false;
+    }
+    ImageInfo info;
+    std::vector<unsigned char> pixels;
+    if (!image_decode::decode(file.data(), file.size(), info, pixels, error)) return false;
+
+    ImageInfo cookedInfo;
+    std::vector<unsigned char> chain;
+    generateMips(info, pixels.data(), options, cookedInfo, chain);
+    return writeFile(cookedPath(imagePath), cookedInfo, levelCount(info.width, info.height), chain, error);
+}
+
+/**
+ * @brief Cook several images, one job per image
+ *
+ * @param jobs Job system to spread the images over, or nullptr to cook them in turn
+ * @return bool Whether every image was cooked
+ */
+bool cookFiles(const std::vector<std::string>& imagePaths, const MipOptions& options, JobSystem* jobs) {
+    std::vector<std::string> paths = imagePaths;
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    std::mutex outputMutex;
+    bool allCooked = true;
+    auto cookRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            std::string error;
+            bool cooked = cookFile(paths[i], options, error);
+            std::lock_guard<std::mutex> lock(outputMutex);
+            if (cooked) {
+                std::cout << "Cooked " << cookedPath(paths[i]) << std::endl;
+            } else {
+                std::cerr << "ERROR::TEXTURE:: " << paths[i] << ": " << error << std::endl;
+                allCooked = false;
+            }
+        }
+    };
+    if (jobs) jobs->parallelFor(paths.size(), 1, cookRange);
+    else cookRange(0, paths.size());
+    return allCooked;
+}
+
+} // namespace texture_cook
@@ -0,0 +1,665 @@
+#include "virtual_texture.h"
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "gl_state.h"
+
+const uint32_t VIRTUAL_FILE_MAGIC = 0x54564D45;  // "EMVT"
+const uint32_t VIRTUAL_FILE_VERSION = 1;
+const size_t VIRTUAL_HEADER_WORDS = 7;          // Magic, version, width, height, tile size, border, levels
+const size_t VIRTUAL_TABLE_ENTRY_BYTES = 16;    // 64-bit offset, 32-bit length, 32 bits reserved
+
+const int VIRTUAL_JPEG_QUALITY = 90;
+const int VIRTUAL_MAX_TILES_PER_SIDE = 256;     // Page coordinates must fit the 8-bit feedback channels
+const size_t VIRTUAL_COOK_BATCH = 256;          // Tiles encoded before they are written out
+
+const size_t VIRTUAL_MAX_LOADS = 32;            // Tile reads in flight per texture
+const int VIRTUAL_UPLOADS_PER_FRAME = 16;
+const uint64_t VIRTUAL_CANCEL_FRAMES = 30;      // Loads not requested for this long are cancelled
+
+namespace {
+
+bool isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+int tilesAlong(int size, int tileSize, int level) {
+    return std::max(1, (size / tileSize) >> level);
+}
+
+int virtualLevelCount(int width, int height, int tileSize) {
+    int levels = 1;
+    while (tilesAlong(width, tileSize, levels - 1) > 1 || tilesAlong(height, tileSize, levels - 1) > 1) levels++;
+    return levels;
+}
+
+GLenum pixelFormat(const ImageInfo& info) {
+    if (info.channels == 1) return GL_RED;
+    if (info.channels == 3) return info.bgr ? GL_BGR : GL_RGB;
+    return info.bgr ? GL_BGRA : GL_RGBA;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Cooking
+
+/**
+ * @brief Write a ".vt" archive of every tile of every level
+ *
+ * @param path Archive to write
+ * @param width Level 0 width; a power of two and a multiple of the tile size
+ * @param height Level 0 height; likewise
+ * @param source Produces the texels of each tile, border included
+ * @param jobs Job system to encode tiles on, or nullptr to encode in turn
+ * @param error Set when the archive cannot be written
+ * @return bool Whether the archive was written
+ *
+ * Tiles are JPEG when libjpeg was found at build time and BMP otherwise,
+ * and are stored level by level, rows top to bottom, after a table of
+ * their offsets and lengths.
+ */
+bool cookVirtualTexture(const std::string& path, int width, int height, const VirtualTexelSource& source,
+                        JobSystem* jobs, std::string& error) {
+    const int tileSize = VIRTUAL_TILE_SIZE;
+    const int border = VIRTUAL_TILE_BORDER;
+    const int stored = tileSize + 2 * border;
+    if (!isPowerOfTwo(width) || !isPowerOfTwo(height) || width < tileSize || height < tileSize ||
+        width / tileSize > VIRTUAL_MAX_TILES_PER_SIDE || height / tileSize > VIRTUAL_MAX_TILES_PER_SIDE) {
+        error = "size must be a power of two between one tile and " + std::to_string(VIRTUAL_MAX_TILES_PER_SIDE) +
+                " tiles per side";
+        return false;
+    }
+
+    int levels = virtualLevelCount(width, height, tileSize);
+    struct TileRef { int level, x, y; };
+    std::vector<TileRef> order;
+    for (int level = 0; level < levels; level++) {
+        for (int y = 0; y < tilesAlong(height, tileSize, level); y++) {
+            for (int x = 0; x < tilesAlong(width, tileSize, level); x++) order.push_back({level, x, y});
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    uint32_t header[VIRTUAL_HEADER_WORDS] = {VIRTUAL_FILE_MAGIC, VIRTUAL_FILE_VERSION,
+                                             static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                             static_cast<uint32_t>(tileSize), static_cast<uint32_t>(border),
+                                             static_cast<uint32_t>(levels)};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    std::vector<unsigned char> table(order.size() * VIRTUAL_TABLE_ENTRY_BYTES, 0);
+    std::streamoff tableStart = out.tellp();
+    out.write(reinterpret_cast<const char*>(table.data()), table.size());
+
+    bool jpeg = image_encode::jpegAvailable();
+    ImageInfo info;
+    info.width = stored;
+    info.height = stored;
+    info.channels = 3;
+
+    std::vector<std::vector<unsigned char>> blobs;
+    std::mutex errorMutex;
+    std::string encodeError;
+    uint64_t offset = static_cast<uint64_t>(tableStart) + table.size();
+    uint64_t totalBytes = 0;
+    for (size_t batch = 0; batch < order.size() && out; batch += VIRTUAL_COOK_BATCH) {
+        size_t count = std::min(VIRTUAL_COOK_BATCH, order.size() - batch);
+        blobs.assign(count, std::vector<unsigned char>());
+
+        auto encodeRange = [&](size_t begin, size_t end) {
+            std::vector<unsigned char> rgb(info.byteSize());
+            for (size_t i = begin; i < end; i++) {
+                const TileRef& tile = order[batch + i];
+                VirtualTexelRect rect;
+                rect.level = tile.level;
+                rect.levelWidth = tilesAlong(width, tileSize, tile.level) * tileSize;
+                rect.levelHeight = tilesAlong(height, tileSize, tile.level) * tileSize;
+                rect.x = tile.x * tileSize - border;
+                rect.y = tile.y * tileSize - border;
+                rect.width = stored;
+                rect.height = stored;
+                source(rect, rgb.data());
+
+                std::string tileError;
+                if (!jpeg) image_encode::bmp(info, rgb.data(), blobs[i]);
+                else if (!image_encode::jpeg(info, rgb.data(), VIRTUAL_JPEG_QUALITY, blobs[i], tileError)) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    encodeError = tileError;
+                }
+            }
+        };
+        if (jobs) jobs->parallelFor(count, 8, encodeRange);
+        else encodeRange(0, count);
+        if (!encodeError.empty()) {
+            error = encodeError;
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            unsigned char* entry = &table[(batch + i) * VIRTUAL_TABLE_ENTRY_BYTES];
+            uint32_t length = static_cast<uint32_t>(blobs[i].size());
+            std::memcpy(entry, &offset, sizeof(offset));
+            std::memcpy(entry + 8, &length, sizeof(length));
+            out.write(reinterpret_cast<const char*>(blobs[i].data()), blobs[i].size());
+            offset += length;
+            totalBytes += length;
+        }
+    }
+
+    out.seekp(tableStart);
+    out.write(reinterpret_cast<const char*>(table.data()), table.size());
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    std::cout << "Cooked " << path << ": " << width << "x" << height << ", " << levels << " levels, "
+              << order.size() << " " << (jpeg ? "JPEG" : "BMP") << " tiles, "
+              << totalBytes / (1024 * 1024) << " MB" << std::endl;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// VirtualTexture
+
+/**
+ * @brief Destructor for VirtualTexture
+ *
+ * Reads still in flight are cancelled; their callbacks only touch the
+ * shared completion list, which outlives the texture.
+ */
+VirtualTexture::~VirtualTexture() {
+    if (io) {
+        for (int index : loading) {
+            if (tiles[index].ioId) io->cancel(tiles[index].ioId);
+        }
+    }
+    glState().forgetTexture(pageTable);
+    glState().forgetTexture(cache);
+    if (pageTable) glDeleteTextures(1, &pageTable);
+    if (cache) glDeleteTextures(1, &cache);
+}
+
+/**
+ * @brief Open a ".vt" archive and allocate the cache and page table
+ *
+ * @param path Archive written by cookVirtualTexture()
+ * @param io Reader for tile loads; must outlive the texture
+ * @param id Value the feedback pass writes for this texture; 1 to 255
+ * @return bool Whether the archive was opened
+ *
+ * The single tile of the coarsest level is read and uploaded before
+ * returning, so the texture can be drawn at once.
+ */
+bool VirtualTexture::create(const std::string& path, AsyncIo& io, int id) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    uint32_t header[VIRTUAL_HEADER_WORDS];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || header[0] != VIRTUAL_FILE_MAGIC || header[1] != VIRTUAL_FILE_VERSION) {
+        std::cerr << "ERROR::VIRTUAL_TEXTURE:: " << path << " is not a version " << VIRTUAL_FILE_VERSION
+                  << " virtual texture" << std::endl;
+        return false;
+    }
+    int fileWidth = static_cast<int>(header[2]);
+    int fileHeight = static_cast<int>(header[3]);
+    int fileTileSize = static_cast<int>(header[4]);
+    int fileBorder = static_cast<int>(header[5]);
+    int fileLevels = static_cast<int>(header[6]);
+    if (!isPowerOfTwo(fileWidth) || !isPowerOfTwo(fileHeight) || !isPowerOfTwo(fileTileSize) ||
+        fileWidth < fileTileSize || fileHeight < fileTileSize ||
+        fileWidth / fileTileSize > VIRTUAL_MAX_TILES_PER_SIDE || fileHeight / fileTileSize > VIRTUAL_MAX_TILES_PER_SIDE ||
+        fileBorder < 0 || fileBorder > fileTileSize / 2 ||
+        fileLevels != virtualLevelCount(fileWidth, fileHeight, fileTileSize)) {
+        std::cerr << "ERROR::VIRTUAL_TEXTURE:: " << path << " has a bad header" << std::endl;
+        return false;
+    }
+
+    this->path = path;
+    this->io = &io;
+    textureId = id;
+    width = fileWidth;
+    height = fileHeight;
+    tileSize = fileTileSize;
+    border = fileBorder;
+    levelCount = fileLevels;
+
+    levelOffsets.clear();
+    tiles.clear();
+    for (int level = 0; level < levelCount; level++) {
+        levelOffsets.push_back(static_cast<int>(tiles.size()));
+        for (int y = 0; y < tilesY(level); y++) {
+            for (int x = 0; x < tilesX(level); x++) {
+                Tile tile;
+                tile.level = level;
+                tile.x = x;
+                tile.y = y;
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    std::vector<unsigned char> table(tiles.size() * VIRTUAL_TABLE_ENTRY_BYTES);
+    in.read(reinterpret_cast<char*>(table.data()), table.size());
+    if (!in) {
+        std::cerr << "ERROR::VIRTUAL_TEXTURE:: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < tiles.size(); i++) {
+        std::memcpy(&tiles[i].offset, &table[i * VIRTUAL_TABLE_ENTRY_BYTES], sizeof(uint64_t));
+        std::memcpy(&tiles[i].length, &table[i * VIRTUAL_TABLE_ENTRY_BYTES + 8], sizeof(uint32_t));
+    }
+
+    // Physical cache: a grid of bordered tiles, filtered bilinearly without mips
+    int stored = tileSize + 2 * border;
+    slotTiles.assign(VIRTUAL_CACHE_TILES * VIRTUAL_CACHE_TILES, -1);
+    glGenTextures(1, &cache);
+    glState().bindTexture(VIRTUAL_CACHE_UNIT, GL_TEXTURE_2D, cache);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VIRTUAL_CACHE_TILES * stored, VIRTUAL_CACHE_TILES * stored, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Page table: one texel per tile, one mip level per virtual level, read with texelFetch
+    glGenTextures(1, &pageTable);
+    glState().bindTexture(VIRTUAL_PAGE_TABLE_UNIT, GL_TEXTURE_2D, pageTable);
+    for (int level = 0; level < levelCount; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, tilesX(level), tilesY(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    // The root tile is the fallback for everything else, so it is loaded now and never evicted
+    int root = tileIndex(levelCount - 1, 0, 0);
+    DecodedTile decoded;
+    decoded.tile = root;
+    decoded.error = 0;
+    std::vector<unsigned char> bytes(tiles[root].length);
+    in.seekg(static_cast<std::streamoff>(tiles[root].offset));
+    in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    std::string error;
+    if (!in || !image_decode::decode(bytes.data(), bytes.size(), decoded.info, decoded.pixels, error) ||
+        !upload(decoded)) {
+        std::cerr << "ERROR::VIRTUAL_TEXTURE:: " << path << ": cannot load the root tile " << error << std::endl;
+        return false;
+    }
+    rebuildPageTable();
+    return true;
+}
+
+int VirtualTexture::tileIndex(int level, int x, int y) const {
+    return levelOffsets[level] + y * tilesX(level) + x;
+}
+
+/**
+ * @brief Ask for a tile, as seen by the feedback pass this frame
+ *
+ * Its ancestors are requested too, so a tile that cannot be loaded in
+ * time still falls back to the finest level available.
+ */
+void VirtualTexture::request(int level, int x, int y) {
+    if (level < 0) level = 0;
+    for (; level < levelCount; level++, x >>= 1, y >>= 1) {
+        if (x >= tilesX(level) || y >= tilesY(level)) return;
+        Tile& tile = tiles[tileIndex(level, x, y)];
+        if (tile.requested == frame) return;    // And so were its ancestors
+        tile.requested = frame;
+        if (tile.slot >= 0) tile.lastUsed = frame;
+        else if (!tile.pending) wanted.push_back(tileIndex(level, x, y));
+    }
+}
+
+/**
+ * @brief Upload finished tiles, cancel stale loads and start new ones
+ *
+ * Called once per frame after the requests. Coarse tiles go first
+ * everywhere: they cover more of the screen and are what finer tiles fall
+ * back to.
+ */
+void VirtualTexture::update() {
+    if (!created()) return;
+    {
+        std::lock_guard<std::mutex> lock(completions->mutex);
+        for (DecodedTile& decoded : completions->tiles) ready.push_back(std::move(decoded));
+        completions->tiles.clear();
+    }
+
+    std::stable_sort(ready.begin(), ready.end(), [this](const DecodedTile& a, const DecodedTile& b) {
+        return tiles[a.tile].level > tiles[b.tile].level;
+    });
+    size_t consumed = 0;
+    int uploaded = 0;
+    for (; consumed < ready.size(); consumed++) {
+        DecodedTile& decoded = ready[consumed];
+        Tile& tile = tiles[decoded.tile];
+        if (decoded.error == 0 && tile.requested + VIRTUAL_CANCEL_FRAMES >= frame) {
+            if (uploaded == VIRTUAL_UPLOADS_PER_FRAME) break;
+            if (upload(decoded)) uploaded++;
+        } else if (decoded.error == ECANCELED || decoded.error == 0) {
+            cancellations++;
+        } else {
+            failures++;
+            std::cerr << "ERROR::VIRTUAL_TEXTURE:: " << path << ": tile " << tile.level << "/" << tile.x << "/" << tile.y
+                      << " failed: " << std::strerror(decoded.error) << std::endl;
+        }
+        tile.pending = false;
+        tile.ioId = 0;
+        loading.erase(std::remove(loading.begin(), loading.end(), decoded.tile), loading.end());
+    }
+    ready.erase(ready.begin(), ready.begin() + consumed);
+
+    // Loads the feedback stopped asking for are not worth finishing
+    for (int index : loading) {
+        Tile& tile = tiles[index];
+        if (tile.ioId && tile.requested + VIRTUAL_CANCEL_FRAMES < frame) {
+            io->cancel(tile.ioId);
+            tile.ioId = 0;
+        }
+    }
+
+    std::stable_sort(wanted.begin(), wanted.end(), [this](int a, int b) {
+        return tiles[a].level > tiles[b].level;
+    });
+    for (int index : wanted) {
+        if (loading.size() >= VIRTUAL_MAX_LOADS) break;
+        if (tiles[index].slot < 0 && !tiles[index].pending) load(index);
+    }
+    wanted.clear();
+
+    if (pageTableDirty) rebuildPageTable();
+    frame++;
+}
+
+/**
+ * @brief Read and decode a tile in the background
+ */
+void VirtualTexture::load(int index) {
+    Tile& tile = tiles[index];
+    tile.pending = true;
+    loading.push_back(index);
+
+    // The two coarsest levels cover most of the screen when they are missing
+    IoPriority priority = tile.level >= levelCount - 2 ? IoPriority::High : IoPriority::Normal;
+    std::shared_ptr<Completions> done = completions;
+    tile.ioId = io->read(path, tile.offset, tile.length, priority, [done, index](IoResult& result) {
+        DecodedTile decoded;
+        decoded.tile = index;
+        decoded.error = result.error;
+        std::string error;
+        if (decoded.error == 0 &&
+            !image_decode::decode(result.data.data(), result.data.size(), decoded.info, decoded.pixels, error)) {
+            decoded.error = EILSEQ;
+        }
+        std::lock_guard<std::mutex> lock(done->mutex);
+        done->tiles.push_back(std::move(decoded));
+    });
+}
+
+/**
+ * @brief Copy a decoded tile into a cache slot
+ *
+ * @return bool False if the tile is malformed or every slot is in use this frame
+ */
+bool VirtualTexture::upload(const DecodedTile& decoded) {
+    int stored = tileSize + 2 * border;
+    if (decoded.info.width != stored || decoded.info.height != stored) return false;
+    int slot = allocateSlot();
+    if (slot < 0) return false;
+
+    if (slotTiles[slot] >= 0) {
+        tiles[slotTiles[slot]].slot = -1;
+        evictions++;
+    }
+    Tile& tile = tiles[decoded.tile];
+    slotTiles[slot] = decoded.tile;
+    tile.slot = slot;
+    tile.lastUsed = frame;
+
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glState().bindTexture(VIRTUAL_CACHE_UNIT, GL_TEXTURE_2D, cache);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % VIRTUAL_CACHE_TILES) * stored, (slot / VIRTUAL_CACHE_TILES) * stored,
+                    stored, stored, pixelFormat(decoded.info), GL_UNSIGNED_BYTE, decoded.pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    pageTableDirty = true;
+    uploads++;
+    return true;
+}
+
+/**
+ * @brief Find a free cache slot, or evict the least recently used tile
+ *
+ * @return int Slot, or -1 if every tile is needed this frame
+ *
+ * The root tile and tiles requested this frame are never evicted.
+ */
+int VirtualTexture::allocateSlot() {
+    int victim = -1;
+    for (int slot = 0; slot < static_cast<int>(slotTiles.size()); slot++) {
+        if (slotTiles[slot] < 0) return slot;
+        const Tile& tile = tiles[slotTiles[slot]];
+        if (tile.level == levelCount - 1 || tile.requested == frame) continue;
+        if (victim < 0 || tile.lastUsed < tiles[slotTiles[victim]].lastUsed) victim = slot;
+    }
+    return victim;
+}
+
+/**
+ * @brief Point every page table texel at its tile's slot, or its nearest resident ancestor's
+ *
+ * Texels are (slot x, slot y, resident level, 255); levels are filled
+ * coarsest first so each can copy from the one above.
+ */
+void VirtualTexture::rebuildPageTable() {
+    std::vector<std::vector<unsigned char>> entries(levelCount);
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glState().bindTexture(VIRTUAL_PAGE_TABLE_UNIT, GL_TEXTURE_2D, pageTable);
+    for (int level = levelCount - 1; level >= 0; level--) {
+        int columns = tilesX(level);
+        int rows = tilesY(level);
+        std::vector<unsigned char>& entry = entries[level];
+        entry.resize(static_cast<size_t>(columns) * rows * 4);
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < columns; x++) {
+                unsigned char* texel = &entry[(static_cast<size_t>(y) * columns + x) * 4];
+                const Tile& tile = tiles[tileIndex(level, x, y)];
+                if (tile.slot >= 0) {
+                    texel[0] = static_cast<unsigned char>(tile.slot % VIRTUAL_CACHE_TILES);
+                    texel[1] = static_cast<unsigned char>(tile.slot / VIRTUAL_CACHE_TILES);
+                    texel[2] = static_cast<unsigned char>(level);
+                    texel[3] = 255;
+                } else if (level + 1 < levelCount) {
+                    int parentX = std::min(x >> 1, tilesX(level + 1) - 1);
+                    int parentY = std::min(y >> 1, tilesY(level + 1) - 1);
+                    std::memcpy(texel, &entries[level + 1][(static_cast<size_t>(parentY) * tilesX(level + 1) + parentX) * 4], 4);
+                } else {
+                    std::memset(texel, 0, 4);
+                }
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, columns, rows, GL_RGBA, GL_UNSIGNED_BYTE, entry.data());
+    }
+    pageTableDirty = false;
+}
+
+/**
+ * @brief Set the virtual texture uniforms and textures on a VIRTUAL_TEXTURE permutation
+ *
+ * @param program Currently bound program
+ * @param lodBias Added to the level the shader picks; the feedback pass uses VirtualTextureFeedback::lodBias()
+ */
+void VirtualTexture::apply(GLuint program, float lodBias) const {
+    float cacheSize = static_cast<float>(VIRTUAL_CACHE_TILES * (tileSize + 2 * border));
+    glUniform1i(glGetUniformLocation(program, "virtualPageTable"), VIRTUAL_PAGE_TABLE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "virtualCache"), VIRTUAL_CACHE_UNIT);
+    glUniform4f(glGetUniformLocation(program, "virtualSize"), static_cast<float>(width), static_cast<float>(height),
+                static_cast<float>(levelCount - 1), static_cast<float>(textureId));
+    glUniform4f(glGetUniformLocation(program, "virtualTile"), static_cast<float>(tileSize), static_cast<float>(border),
+                cacheSize, 0.0f);
+    glUniform1f(glGetUniformLocation(program, "virtualLodBias"), lodBias);
+
+    glState().bindTexture(VIRTUAL_PAGE_TABLE_UNIT, GL_TEXTURE_2D, pageTable);
+    glState().bindTexture(VIRTUAL_CACHE_UNIT, GL_TEXTURE_2D, cache);
+}
+
+size_t VirtualTexture::residentTiles() const {
+    return static_cast<size_t>(std::count_if(slotTiles.begin(), slotTiles.end(), [](int tile) { return tile >= 0; }));
+}
+
+size_t VirtualTexture::cacheBytes() const {
+    size_t side = static_cast<size_t>(VIRTUAL_CACHE_TILES) * (tileSize + 2 * border);
+    return side * side * 4;
+}
+
+/**
+ * @brief Print residency and streaming counters
+ */
+void VirtualTexture::report(std::ostream& out) const {
+    out << "Virtual texture " << path << ": " << residentTiles() << "/" << slotTiles.size() << " slots ("
+        << cacheBytes() / (1024 * 1024) << " MB), " << loading.size() << " loading, " << uploads << " uploads, "
+        << evictions << " evictions, " << cancellations << " cancelled, " << failures << " failed" << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// VirtualTextureFeedback
+
+/**
+ * @brief Destructor for VirtualTextureFeedback
+ */
+VirtualTextureFeedback::~VirtualTextureFeedback() {
+    release();
+}
+
+void VirtualTextureFeedback::release() {
+    for (int i = 0; i < 2; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+    glState().forgetFramebuffer(fbo);
+    glState().forgetRenderbuffer(color);
+    glState().forgetRenderbuffer(depth);
+    glState().forgetBuffer(readback[0]);
+    glState().forgetBuffer(readback[1]);
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (color) glDeleteRenderbuffers(1, &color);
+    if (depth) glDeleteRenderbuffers(1, &depth);
+    if (readback[0]) glDeleteBuffers(2, readback);
+    fbo = color = depth = 0;
+    readback[0] = readback[1] = 0;
+}
+
+/**
+ * @brief (Re)create the feedback target for a window size
+ */
+void VirtualTextureFeedback::resize(int windowWidth, int windowHeight) {
+    release();
+    feedbackWidth = std::max(1, windowWidth / VIRTUAL_FEEDBACK_DIVISOR);
+    feedbackHeight = std::max(1, windowHeight / VIRTUAL_FEEDBACK_DIVISOR);
+
+    glGenRenderbuffers(1, &color);
+    glState().bindRenderbuffer(color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedbackWidth, feedbackHeight);
+    glGenRenderbuffers(1, &depth);
+    glState().bindRenderbuffer(depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+    glState().bindRenderbuffer(0);
+
+    glGenFramebuffers(1, &fbo);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::VIRTUAL_TEXTURE:: Feedback framebuffer is not complete" << std::endl;
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(2, readback);
+    for (GLuint buffer : readback) {
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(feedbackWidth) * feedbackHeight * 4, nullptr,
+                     GL_STREAM_READ);
+    }
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    current = 0;
+}
+
+/**
+ * @brief Bind and clear the feedback target; the caller restores the viewport
+ *
+ * Cleared texels read as texture id 0, which no texture uses.
+ */
+void VirtualTextureFeedback::begin() const {
+    const GLfloat none[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    glState().depthMask(GL_TRUE);
+    glClearBufferfv(GL_COLOR, 0, none);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+/**
+ * @brief Start reading the feedback back into the current pack buffer
+ */
+void VirtualTextureFeedback::end() {
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, readback[current]);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (fences[current]) glDeleteSync(fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current ^= 1;
+}
+
+/**
+ * @brief Turn the oldest finished readback into tile requests
+ *
+ * @param textures Textures to route requests to, by id
+ *
+ * Reads the buffer written two end() calls ago, and only if the GPU has
+ * finished with it, so this never stalls; a frame whose readback is late
+ * simply makes no requests.
+ */
+void VirtualTextureFeedback::collect(const std::vector<VirtualTexture*>& textures) {
+    GLsync fence = fences[current];
+    if (!fence) return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+    glDeleteSync(fence);
+    fences[current] = nullptr;
+
+    VirtualTexture* byId[256] = {};
+    for (VirtualTexture* texture : textures) {
+        if (texture->created() && texture->id() > 0 && texture->id() < 256) byId[texture->id()] = texture;
+    }
+
+    size_t count = static_cast<size_t>(feedbackWidth) * feedbackHeight;
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, readback[current]);
+    const uint32_t* pixels = static_cast<const uint32_t*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(count) * 4, GL_MAP_READ_BIT));
+    if (pixels) {
+        uint32_t previous = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t pixel = pixels[i];
+            if (pixel == previous) continue;    // Neighbours mostly need the same tile
+            previous = pixel;
+            unsigned char texel[4];
+            std::memcpy(texel, &pixel, 4);
+            if (VirtualTexture* texture = byId[texel[3]]) texture->request(texel[2], texel[0], texel[1]);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * @brief Level bias that makes the low-resolution feedback pick the levels the full-size frame needs
+ */
+float VirtualTextureFeedback::lodBias() const {
+    return -std::log2(static_cast<float>(VIRTUAL_FEEDBACK_DIVISOR));
+}